@@ -37,49 +37,46 @@
 #include "port.h"
 #include "i2c.h"
 
-size_t at24mac_read( uint8_t id, uint16_t address, uint8_t *rx_data, size_t buf_len, uint32_t timeout )
+/* Reads from the given word address, the address write and the read are chained with a repeated START */
+static size_t at24mac_read_at( uint8_t id, uint8_t addr_offset, uint8_t address, uint8_t *rx_data, size_t buf_len, uint32_t timeout )
 {
     uint8_t i2c_addr;
     uint8_t i2c_interface;
-    uint8_t rx_len = 0;
+    size_t rx_len = 0;
+    int done;
+    i2c_seg_t segs[2] = {
+        { &address, 1, 0 },
+        { rx_data, buf_len, I2C_SEG_READ },
+    };
+
+    if ( rx_data == NULL ) {
+        return 0;
+    }
 
-    if (i2c_take_by_chipid( id, &i2c_addr, &i2c_interface, timeout ) && ( rx_data != NULL ) ) {
-        rx_len = xI2CMasterWriteRead( i2c_interface, i2c_addr, address, rx_data, buf_len );
+    if (i2c_take_by_chipid( id, &i2c_addr, &i2c_interface, timeout ) ) {
+        done = xI2CMasterTransfer( i2c_interface, i2c_addr + addr_offset, segs, 2 );
+        if ( done > 1 ) {
+            rx_len = done - 1;
+        }
         i2c_give( i2c_interface );
     }
 
     return rx_len;
 }
 
-size_t at24mac_read_serial_num( uint8_t id, uint8_t *rx_data, size_t buf_len, uint32_t timeout )
+size_t at24mac_read( uint8_t id, uint16_t address, uint8_t *rx_data, size_t buf_len, uint32_t timeout )
 {
-    uint8_t i2c_addr;
-    uint8_t i2c_interface;
-    uint8_t rx_len = 0;
-
-    if (i2c_take_by_chipid( id, &i2c_addr, &i2c_interface, timeout ) && ( rx_data != NULL ) ) {
-        rx_len = xI2CMasterWriteRead( i2c_interface, i2c_addr+8, AT24MAC_ID_ADDR, rx_data, buf_len);
-
-        i2c_give( i2c_interface );
-    }
+    return at24mac_read_at( id, 0, address, rx_data, buf_len, timeout );
+}
 
-    return rx_len;
+size_t at24mac_read_serial_num( uint8_t id, uint8_t *rx_data, size_t buf_len, uint32_t timeout )
+{
+    return at24mac_read_at( id, AT24MAC_ID_OFFSET, AT24MAC_ID_ADDR, rx_data, buf_len, timeout );
 }
 
 size_t at24mac_read_eui( uint8_t id, uint8_t *rx_data, size_t buf_len, uint32_t timeout )
 {
-    uint8_t i2c_addr;
-    uint8_t i2c_interface;
-    uint8_t rx_len = 0;
-
-    if (i2c_take_by_chipid( id, &i2c_addr, &i2c_interface, timeout ) && ( rx_data != NULL ) ) {
-
-        rx_len = xI2CMasterWriteRead( i2c_interface, i2c_addr+8, AT24MAC_EUI_ADDR, rx_data, buf_len);
-
-        i2c_give( i2c_interface );
-    }
-
-    return rx_len;
+    return at24mac_read_at( id, AT24MAC_ID_OFFSET, AT24MAC_EUI_ADDR, rx_data, buf_len, timeout );
 }
 
 size_t at24mac_write( uint8_t id, uint16_t address, uint8_t *tx_data, size_t buf_len, uint32_t timeout )
@@ -88,24 +85,47 @@ size_t at24mac_write( uint8_t id, uint16_t address, uint8_t *tx_data, size_t buf
     uint8_t i2c_interface;
     uint8_t bytes_to_write;
     uint8_t curr_addr;
-    uint8_t page_buf[17];
+    uint16_t retries;
+    int done;
+    i2c_seg_t segs[2] = {
+        { &curr_addr, 1, 0 },
+        { NULL, 0, I2C_SEG_NOSTART },
+    };
 
     size_t tx_len = 0;
 
-    if (i2c_take_by_chipid( id, &i2c_addr, &i2c_interface, timeout ) && ( tx_data != NULL ) ) {
+    if ( tx_data == NULL ) {
+        return 0;
+    }
+
+    if (i2c_take_by_chipid( id, &i2c_addr, &i2c_interface, timeout ) ) {
         curr_addr = address;
 
         while (tx_len < buf_len) {
-            bytes_to_write = 16 - (curr_addr % 16);
+            bytes_to_write = AT24MAC_PAGE_SIZE - (curr_addr % AT24MAC_PAGE_SIZE);
 
             if (bytes_to_write > ( buf_len - tx_len )) {
                 bytes_to_write = ( buf_len - tx_len );
             }
-            page_buf[0] = curr_addr;
-            memcpy(&page_buf[1], tx_data+tx_len, bytes_to_write);
 
-            /* Write the data */
-            tx_len += xI2CMasterWrite( i2c_interface, i2c_addr, &page_buf[0] , bytes_to_write+1 );
+            /* Word address followed by the data, straight from the caller buffer */
+            segs[1].buff = tx_data + tx_len;
+            segs[1].len = bytes_to_write;
+
+            /* The chip ignores its address while the previous page is still being programmed (acknowledge polling) */
+            retries = 0;
+            do {
+                done = xI2CMasterTransfer( i2c_interface, i2c_addr, segs, 2 );
+            } while ( done == 0 && ++retries < AT24MAC_WRITE_POLL_MAX );
+
+            if ( done < bytes_to_write + 1 ) {
+                if ( done > 1 ) {
+                    tx_len += done - 1;
+                }
+                break;
+            }
+
+            tx_len += bytes_to_write;
             curr_addr += bytes_to_write;
         }
         i2c_give( i2c_interface );
@@ -41,6 +41,14 @@
 
 #define AT24MAC_ID_ADDR 0x80
 
+/* The serial number and EUI are read from a second slave address, 8 above the EEPROM one */
+#define AT24MAC_ID_OFFSET 8
+
+#define AT24MAC_PAGE_SIZE 16
+
+/* Address attempts while waiting for a page write cycle (5 ms max, each attempt takes at least 25 us at 400 kHz) */
+#define AT24MAC_WRITE_POLL_MAX 250
+
 #if defined(AT24MAC402)
 #define AT24MAC_EUI_ADDR 0x9A
 #elif defined(AT24MAC602)
@@ -41,8 +41,13 @@ size_t eeprom_24xx64_read( uint8_t id, uint16_t address, uint8_t *rx_data, size_
 {
     uint8_t i2c_addr;
     uint8_t i2c_interface;
-    uint8_t rx_len = 0;
+    size_t rx_len = 0;
     uint8_t addr8[2];
+    int done;
+    i2c_seg_t segs[2] = {
+        { addr8, sizeof(addr8), 0 },
+        { rx_data, buf_len, I2C_SEG_READ },
+    };
 
     addr8[0] = (address >> 8) & 0xFF;
     addr8[1] = (address) & 0xFF;
@@ -52,11 +57,11 @@ size_t eeprom_24xx64_read( uint8_t id, uint16_t address, uint8_t *rx_data, size_
     }
 
     if (i2c_take_by_chipid( id, &i2c_addr, &i2c_interface, timeout ) ) {
-        /* Sets address register */
-        xI2CMasterWrite( i2c_interface, i2c_addr, addr8 , sizeof(addr8) );
-
-        /* Read data */
-        rx_len = xI2CMasterRead( i2c_interface, i2c_addr, rx_data, buf_len );
+        /* Sets address register and reads the data after a repeated START */
+        done = xI2CMasterTransfer( i2c_interface, i2c_addr, segs, 2 );
+        if ( done > (int) sizeof(addr8) ) {
+            rx_len = done - sizeof(addr8);
+        }
         i2c_give( i2c_interface );
     }
 
@@ -68,8 +73,13 @@ size_t eeprom_24xx64_write( uint8_t id, uint16_t address, uint8_t *tx_data, size
     uint8_t i2c_addr;
     uint8_t i2c_interface;
     uint8_t bytes_to_write;
-    uint8_t page_buf[34];
+    uint8_t addr8[2];
     uint16_t curr_addr;
+    int done;
+    i2c_seg_t segs[2] = {
+        { addr8, sizeof(addr8), 0 },
+        { NULL, 0, I2C_SEG_NOSTART },
+    };
 
     size_t tx_len = 0;
 
@@ -86,15 +96,22 @@ size_t eeprom_24xx64_write( uint8_t id, uint16_t address, uint8_t *tx_data, size
             if (bytes_to_write > ( buf_len - tx_len )) {
                 bytes_to_write = ( buf_len - tx_len );
             }
-            page_buf[0] = (curr_addr >> 8) & 0xFF;
-            page_buf[1] = (curr_addr) & 0xFF;
+            addr8[0] = (curr_addr >> 8) & 0xFF;
+            addr8[1] = (curr_addr) & 0xFF;
 
-            memcpy(&page_buf[2], tx_data+tx_len, bytes_to_write);
-
-            /* Write the data */
-            tx_len += xI2CMasterWrite( i2c_interface, i2c_addr, &page_buf[0] , bytes_to_write+2 );
+            /* Write the address followed by the data, straight from the caller buffer */
+            segs[1].buff = tx_data + tx_len;
+            segs[1].len = bytes_to_write;
+            done = xI2CMasterTransfer( i2c_interface, i2c_addr, segs, 2 );
             vTaskDelay(10);
-            tx_len -= 2; /* Remove the 2 page bytes from the count */
+
+            if ( done < bytes_to_write + (int) sizeof(addr8) ) {
+                if ( done > (int) sizeof(addr8) ) {
+                    tx_len += done - sizeof(addr8);
+                }
+                break;
+            }
+            tx_len += bytes_to_write;
             curr_addr += bytes_to_write;
         }
         i2c_give( i2c_interface );
@@ -99,7 +99,7 @@ void vTaskFPGA_COMM( void * Parameters )
         write_fpga_dword( 0x05, 0x55555555 );
 
         /* Update Sensors Readings */
-        for ( i = 0, temp_sensor = sdr_head; (temp_sensor != NULL) && (i <= NUM_SENSOR); temp_sensor = temp_sensor->next) {
+        for ( i = 0, temp_sensor = sdr_first(); (temp_sensor != NULL) && (i <= NUM_SENSOR); temp_sensor = sdr_next(temp_sensor) ) {
             if (temp_sensor->diag_devID != NO_DIAG) {
                 diag->sensor[i].dev_id = temp_sensor->diag_devID;
                 diag->sensor[i].measure = temp_sensor->readout_value;
@@ -23,6 +23,7 @@
  */
 
 #include "FreeRTOS.h"
+#include "semphr.h"
 
 #include "port.h"
 #include "fru.h"
@@ -57,12 +58,35 @@ fru_data_t fru[FRU_COUNT] = {
 #endif
 };
 
+/* Serializes the accesses of the Write FRU Data handler (run by an IPMI worker) with the reads made by the other tasks */
+static SemaphoreHandle_t fru_mutex;
+
+static bool fru_lock( void )
+{
+    if ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ) {
+        return false;
+    }
+    xSemaphoreTake( fru_mutex, portMAX_DELAY );
+    return true;
+}
+
+static void fru_unlock( bool locked )
+{
+    if ( locked ) {
+        xSemaphoreGive( fru_mutex );
+    }
+}
+
 void fru_init( uint8_t id )
 {
     if ( id >= FRU_COUNT ) {
         return;
     }
 
+    if ( fru_mutex == NULL ) {
+        fru_mutex = xSemaphoreCreateMutex();
+    }
+
 #ifdef FRU_WRITE_EEPROM
     printf(">FRU_WRITE_EEPROM flag enabled! Building FRU info...\n");
     fru[id].fru_size = fru[id].cfg.build_f( &fru[id].buffer );
@@ -241,11 +265,13 @@ size_t fru_read( uint8_t id, uint8_t *rx_buff, uint16_t offset, size_t len )
     uint16_t j = offset;
 
     size_t ret_val = 0;
+    bool locked;
 
     if ( id >= FRU_COUNT ) {
         return 0;
     }
 
+    locked = fru_lock();
     if ( fru[id].runtime ) {
         for ( i = 0; i < len; i++, j++ ) {
             if ( j < fru[id].fru_size ) {
@@ -258,23 +284,29 @@ size_t fru_read( uint8_t id, uint8_t *rx_buff, uint16_t offset, size_t len )
     } else {
         ret_val = fru[id].cfg.read_f( fru[id].cfg.eeprom_id, offset, rx_buff, len, 0 );
     }
+    fru_unlock( locked );
+
     return ret_val;
 }
 
 size_t fru_write( uint8_t id, uint8_t *tx_buff, uint16_t offset, size_t len )
 {
     size_t ret_val = 0;
+    bool locked;
 
     if ( id >= FRU_COUNT ) {
         return 0;
     }
 
+    locked = fru_lock();
     if ( fru[id].runtime ) {
         memcpy( &fru[id].buffer[offset], tx_buff, len );
         ret_val = len;
     } else {
         ret_val = fru[id].cfg.write_f( fru[id].cfg.eeprom_id, offset, tx_buff, len, 0 );
     }
+    fru_unlock( locked );
+
     return ret_val;
 }
 
@@ -321,7 +353,7 @@ IPMI_HANDLER(ipmi_storage_read_fru_data_cmd, NETFN_STORAGE, IPMI_READ_FRU_DATA_C
     rsp->completion_code = IPMI_CC_OK;
 }
 
-IPMI_HANDLER(ipmi_storage_write_fru_data_cmd, NETFN_STORAGE, IPMI_WRITE_FRU_DATA_CMD, ipmi_msg * req, ipmi_msg * rsp )
+IPMI_HANDLER_SLOW(ipmi_storage_write_fru_data_cmd, NETFN_STORAGE, IPMI_WRITE_FRU_DATA_CMD, ipmi_msg * req, ipmi_msg * rsp )
 {
     uint8_t len = rsp->data_len = 0;
     uint16_t offset =  (req->data[2] << 8) | (req->data[1]);
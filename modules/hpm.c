@@ -39,6 +39,16 @@ static uint8_t last_cmd_cc;
 /*Current component under upgrade */
 static uint8_t active_id;
 
+/* The long-duration commands run on an IPMI worker while Get Upgrade Status is answered by the dispatcher,
+ * so the status pair is always updated and read as a whole */
+static void hpm_set_cmd_status( uint8_t cmd, uint8_t cc )
+{
+    taskENTER_CRITICAL();
+    cmd_in_progress = cmd;
+    last_cmd_cc = cc;
+    taskEXIT_CRITICAL();
+}
+
 /* IPMC Capabilities */
 t_ipmc_capabilities ipmc_cap = {
     .flags = { .upgrade_undesirable = 0,
@@ -203,7 +213,7 @@ IPMI_HANDLER(ipmi_picmg_get_component_properties, NETFN_GRPEXT, IPMI_PICMG_CMD_H
     /* This is not a long-duration command, so we don't need to update neither cmd_in_progress nor last_cmd_cc variables */
 }
 
-IPMI_HANDLER(ipmi_picmg_initiate_upgrade_action, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_INITIATE_UPGRADE_ACTION, ipmi_msg *req, ipmi_msg* rsp)
+IPMI_HANDLER_SLOW(ipmi_picmg_initiate_upgrade_action, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_INITIATE_UPGRADE_ACTION, ipmi_msg *req, ipmi_msg* rsp)
 {
     uint8_t len = rsp->data_len = 0;
 
@@ -253,25 +263,29 @@ IPMI_HANDLER(ipmi_picmg_initiate_upgrade_action, NETFN_GRPEXT, IPMI_PICMG_CMD_HP
     rsp->data_len = len;
 
     /* This is a long-duration command, update both cmd_in_progress and last_cmd_cc */
-    cmd_in_progress = req->cmd;
-    last_cmd_cc = rsp->completion_code;
+    hpm_set_cmd_status( req->cmd, rsp->completion_code );
 }
 
 IPMI_HANDLER(ipmi_picmg_get_upgrade_status, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_GET_UPGRADE_STATUS, ipmi_msg *req, ipmi_msg* rsp)
 {
     uint8_t len = rsp->data_len = 0;
+    uint8_t cc;
 
     if (hpm_components[active_id].hpm_get_upgrade_status_f) {
         /* WARNING: This function can't block! */
-        last_cmd_cc = hpm_components[active_id].hpm_get_upgrade_status_f();
+        cc = hpm_components[active_id].hpm_get_upgrade_status_f();
     } else {
         /* Returning IPMI_CC_OK for debug purposes only, should be IPMI_CC_UNSPECIFIED_ERROR */
-        last_cmd_cc = IPMI_CC_OK;
+        cc = IPMI_CC_OK;
     }
 
     rsp->data[len++] = IPMI_PICMG_GRP_EXT;
+
+    taskENTER_CRITICAL();
+    last_cmd_cc = cc;
     rsp->data[len++] = cmd_in_progress;
     rsp->data[len++] = last_cmd_cc;
+    taskEXIT_CRITICAL();
     rsp->data_len = len;
     rsp->completion_code = IPMI_CC_OK;
 
@@ -289,7 +303,7 @@ IPMI_HANDLER(ipmi_picmg_abort_firmware_upgrade, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM
     /* This is not a long-duration command, so we don't need to update neither cmd_in_progress nor last_cmd_cc variables */
 }
 
-IPMI_HANDLER(ipmi_picmg_upload_firmware_block, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_UPLOAD_FIRMWARE_BLOCK, ipmi_msg *req, ipmi_msg* rsp)
+IPMI_HANDLER_SLOW(ipmi_picmg_upload_firmware_block, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_UPLOAD_FIRMWARE_BLOCK, ipmi_msg *req, ipmi_msg* rsp)
 {
     uint8_t len = rsp->data_len = 0;
     uint8_t block_data[HPM_BLOCK_SIZE];
@@ -318,11 +332,10 @@ IPMI_HANDLER(ipmi_picmg_upload_firmware_block, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_
     rsp->data_len = len;
 
     /* This is a long-duration command, update both cmd_in_progress and last_cmd_cc */
-    cmd_in_progress = req->cmd;
-    last_cmd_cc = rsp->completion_code;
+    hpm_set_cmd_status( req->cmd, rsp->completion_code );
 }
 
-IPMI_HANDLER(ipmi_picmg_finish_firmware_upload, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_FINISH_FIRMWARE_UPLOAD, ipmi_msg *req, ipmi_msg* rsp)
+IPMI_HANDLER_SLOW(ipmi_picmg_finish_firmware_upload, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_FINISH_FIRMWARE_UPLOAD, ipmi_msg *req, ipmi_msg* rsp)
 {
     uint8_t len = rsp->data_len = 0;
 
@@ -341,11 +354,10 @@ IPMI_HANDLER(ipmi_picmg_finish_firmware_upload, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM
     rsp->data_len = len;
 
     /* This is a long-duration command, update both cmd_in_progress and last_cmd_cc */
-    cmd_in_progress = req->cmd;
-    last_cmd_cc = rsp->completion_code;
+    hpm_set_cmd_status( req->cmd, rsp->completion_code );
 }
 
-IPMI_HANDLER(ipmi_picmg_activate_firmware, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_ACTIVATE_FIRMWARE, ipmi_msg *req, ipmi_msg* rsp)
+IPMI_HANDLER_SLOW(ipmi_picmg_activate_firmware, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_ACTIVATE_FIRMWARE, ipmi_msg *req, ipmi_msg* rsp)
 {
     uint8_t len = rsp->data_len = 0;
 
@@ -362,6 +374,5 @@ IPMI_HANDLER(ipmi_picmg_activate_firmware, NETFN_GRPEXT, IPMI_PICMG_CMD_HPM_ACTI
     rsp->data_len = len;
 
     /* This is a long-duration command, update both cmd_in_progress and last_cmd_cc */
-    cmd_in_progress = req->cmd;
-    last_cmd_cc = rsp->completion_code;
+    hpm_set_cmd_status( req->cmd, rsp->completion_code );
 }
@@ -21,9 +21,14 @@
 
 /* Project includes */
 #include "FreeRTOS.h"
+#include "task.h"
 #include "port.h"
 #include "i2c.h"
 #include "i2c_mapping.h"
+#include "ipmi.h"
+#include "task_priorities.h"
+#include "task_notify.h"
+#include "string.h"
 
 /**
  * @brief Number of I2C peripheral buses that are being controlled
@@ -41,67 +46,370 @@
  */
 #define I2C_CHIP_MAP_COUNT (sizeof(i2c_chip_map)/sizeof(i2c_chip_mapping_t))
 
-void i2c_init( void )
+/**
+ * @brief Number of logical I2C buses
+ *
+ * @see i2c_mapping.c
+ */
+#define I2C_BUS_MAP_COUNT (sizeof(i2c_bus_map)/sizeof(i2c_bus_mapping_t))
+
+static i2c_mux_state_t * i2c_find_mux( uint8_t i2c_interface )
 {
-    for ( uint8_t i = 0; i < sizeof(i2c_mux)/sizeof(i2c_mux_state_t); i++ ) {
-        i2c_mux[i].semaphore = xSemaphoreCreateBinary();
-        vI2CConfig( i2c_mux[i].i2c_interface, SPEED_100KHZ );
-        xSemaphoreGive( i2c_mux[i].semaphore );
+    uint8_t i;
+
+    for ( i = 0; i < I2C_MUX_COUNT; i++ ) {
+        if ( i2c_mux[i].i2c_interface == i2c_interface ) {
+            return &i2c_mux[i];
+        }
     }
+    return NULL;
 }
 
-bool i2c_take_by_busid( uint8_t bus_id, uint8_t *i2c_interface, TickType_t timeout )
+/* Highest SCL rate (kHz) usable on each logical bus, see i2c_init_speeds() */
+static uint16_t i2c_bus_speed[I2C_BUS_CNT];
+
+/* Bus worker of an enabled bus, NULL if the bus can't be used */
+static i2c_mux_state_t * i2c_bus_mux( uint8_t bus_id )
 {
-    i2c_mux_state_t *p_i2c_mux = NULL;
-    i2c_bus_mapping_t *p_i2c_bus = &i2c_bus_map[bus_id];
+    if ( bus_id >= I2C_BUS_MAP_COUNT || i2c_bus_map[bus_id].enabled == 0 ) {
+        return NULL;
+    }
+    return i2c_find_mux( i2c_bus_map[bus_id].i2c_interface );
+}
+
+static uint16_t i2c_chip_speed( uint8_t chip_id )
+{
+    uint16_t speed = i2c_chip_map[chip_id].max_speed;
+
+    if ( speed == 0 ) {
+        speed = SPEED_100KHZ / 1000;
+    }
+    return ( speed < I2C_MAX_SPEED_KHZ ) ? speed : I2C_MAX_SPEED_KHZ;
+}
+
+/**
+ * @brief Finds the SCL rate of each bus
+ *
+ * A chip on a mux channel only hears the transfers made while its channel is selected, while the ones on the
+ * non-multiplexed part of the interface hear all of them.
+ */
+static void i2c_init_speeds( void )
+{
+    uint8_t bus, chip, i;
+    uint8_t chip_bus;
+    i2c_mux_state_t *mux;
+
+    for ( i = 0; i < I2C_MUX_COUNT; i++ ) {
+        i2c_mux[i].min_speed = I2C_MAX_SPEED_KHZ;
+    }
+
+    for ( bus = 0; bus < I2C_BUS_MAP_COUNT; bus++ ) {
+        i2c_bus_speed[bus] = I2C_MAX_SPEED_KHZ;
 
-    uint8_t tmp_interface_id = i2c_bus_map[bus_id].i2c_interface;
+        for ( chip = 0; chip < I2C_CHIP_MAP_COUNT; chip++ ) {
+            chip_bus = i2c_chip_map[chip].bus_id;
 
-    for ( p_i2c_mux = i2c_mux; p_i2c_mux != NULL; p_i2c_mux++ ) {
-        if ( p_i2c_mux->i2c_interface == tmp_interface_id ) {
+            if ( i2c_bus_map[chip_bus].i2c_interface != i2c_bus_map[bus].i2c_interface ) {
+                continue;
+            }
+
+            if ( chip_bus == bus || i2c_bus_map[chip_bus].mux_bus == -1 || i2c_bus_map[bus].mux_bus == -1 ) {
+                if ( i2c_chip_speed( chip ) < i2c_bus_speed[bus] ) {
+                    i2c_bus_speed[bus] = i2c_chip_speed( chip );
+                }
+            }
+        }
+
+        mux = i2c_find_mux( i2c_bus_map[bus].i2c_interface );
+        if ( mux != NULL && i2c_bus_speed[bus] < mux->min_speed ) {
+            mux->min_speed = i2c_bus_speed[bus];
+        }
+    }
+}
+
+/* Reprograms the SCL divider, only if the rate changes */
+static void i2c_set_speed( i2c_mux_state_t *mux, uint16_t speed )
+{
+    if ( speed != mux->speed ) {
+        vI2CSetSpeed( mux->i2c_interface, speed * 1000 );
+        mux->speed = speed;
+    }
+}
+
+/**
+ * @brief Puts the mux in the channel of the given bus
+ *
+ * Only called by the current bus owner. The cached channel is trusted unless another master may have touched the mux.
+ */
+static bool i2c_select_bus( i2c_mux_state_t *mux, uint8_t bus_id )
+{
+    int8_t mux_bus = i2c_bus_map[bus_id].mux_bus;
+    uint32_t faults;
+
+    /* This bus is not multiplexed, no action needed */
+    if ( mux_bus == -1 ) {
+        i2c_set_speed( mux, i2c_bus_speed[bus_id] );
+        return true;
+    }
+
+    /* An arbitration loss or a bus error since the last access means the mux may have been switched or reset */
+    faults = ulI2CMasterFaults( mux->i2c_interface );
+    if ( faults != mux->faults_seen ) {
+        mux->faults_seen = faults;
+        mux->state = -1;
+    }
+
+    if ( mux->external_master || mux->state == -1 ) {
+        /* Any channel may be selected, so every chip on the interface may be listening */
+        i2c_set_speed( mux, mux->min_speed );
+        mux->state = i2c_get_mux_bus( bus_id, mux );
+        mux->stats.mux_readbacks++;
+    } else {
+        mux->stats.mux_readbacks_saved++;
+    }
+
+    if ( mux->state != mux_bus ) {
+        if ( i2c_set_mux_bus( bus_id, mux, mux_bus ) == false ) {
+            /* We don't know where the mux was left */
+            mux->state = -1;
+            return false;
+        }
+        mux->stats.mux_switches++;
+    }
+
+    i2c_set_speed( mux, i2c_bus_speed[bus_id] );
+    return true;
+}
+
+static void i2c_job_complete( i2c_job_t *job, uint8_t status )
+{
+    /* Without a callback the job may be reused as soon as its status is set */
+    void (*callback)( i2c_job_t *job ) = job->callback;
+    TaskHandle_t task = job->task;
+
+    job->status = status;
+
+    if ( callback != NULL ) {
+        callback( job );
+    } else if ( task != NULL ) {
+        task_notify( task, NOTIFY_I2C_JOB );
+    }
+}
+
+static void i2c_job_run( i2c_mux_state_t *mux, i2c_job_t *job )
+{
+    uint8_t i2c_addr = i2c_chip_map[job->chip_id].i2c_address;
+    i2c_seg_t local[2];
+    i2c_seg_t *segs = job->segs;
+    uint8_t count = job->seg_count;
+    int expected = 0;
+    bool ok = false;
+    uint8_t i;
+
+    if ( segs == NULL ) {
+        /* Plain write and/or read, chained with a repeated START */
+        segs = local;
+        count = 0;
+        if ( job->tx_len > 0 ) {
+            local[count].buff = (uint8_t *) job->tx_buff;
+            local[count].len = job->tx_len;
+            local[count++].flags = 0;
+        }
+        if ( job->rx_len > 0 ) {
+            local[count].buff = job->rx_buff;
+            local[count].len = job->rx_len;
+            local[count++].flags = I2C_SEG_READ;
+        }
+    }
+
+    for ( i = 0; i < count; i++ ) {
+        expected += segs[i].len;
+    }
+
+    if ( i2c_select_bus( mux, job->bus_id ) ) {
+        ok = ( xI2CMasterTransfer( mux->i2c_interface, i2c_addr, segs, count ) == expected );
+    }
+
+    mux->stats.jobs++;
+    i2c_job_complete( job, ok ? I2C_JOB_DONE : I2C_JOB_FAILED );
+}
+
+static void i2c_job_queue( i2c_mux_state_t *mux, i2c_job_t *job )
+{
+    i2c_job_t **link;
+
+    job->status = I2C_JOB_QUEUED;
+    job->bypassed = 0;
+    job->next = NULL;
+
+    taskENTER_CRITICAL();
+    for ( link = &mux->queue; *link != NULL; link = &(*link)->next ) {}
+    *link = job;
+    taskEXIT_CRITICAL();
+
+    task_notify( mux->worker, NOTIFY_I2C_WORKER );
+}
+
+/* Removes a request the worker hasn't started yet */
+static bool i2c_job_cancel( i2c_mux_state_t *mux, i2c_job_t *job )
+{
+    i2c_job_t **link;
+    bool cancelled = false;
+
+    taskENTER_CRITICAL();
+    if ( job->status == I2C_JOB_QUEUED ) {
+        for ( link = &mux->queue; *link != NULL; link = &(*link)->next ) {
+            if ( *link == job ) {
+                *link = job->next;
+                break;
+            }
+        }
+        job->status = I2C_JOB_FAILED;
+        cancelled = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return cancelled;
+}
+
+/**
+ * @brief Takes the next request to be served
+ *
+ * Requests are served in arrival order, except that the ones that need no mux switch go first.
+ * A request overtaken I2C_FAIRNESS_BOUND times is served next regardless of its channel.
+ */
+static i2c_job_t * i2c_job_pick( i2c_mux_state_t *mux )
+{
+    i2c_job_t **link, **pick = NULL;
+    i2c_job_t *job, *older;
+    int8_t mux_bus;
+
+    taskENTER_CRITICAL();
+    for ( link = &mux->queue; *link != NULL; link = &(*link)->next ) {
+        if ( (*link)->bypassed >= I2C_FAIRNESS_BOUND ) {
+            pick = link;
             break;
         }
+        mux_bus = i2c_bus_map[(*link)->bus_id].mux_bus;
+        if ( pick == NULL && ( mux_bus == -1 || mux_bus == mux->state ) ) {
+            pick = link;
+        }
     }
 
-    if ( p_i2c_mux == NULL ) {
-        return false;
+    if ( pick == NULL && mux->queue != NULL ) {
+        pick = &mux->queue;
     }
-    if ( p_i2c_bus->enabled == 0 ) {
-        return false;
+
+    job = NULL;
+    if ( pick != NULL ) {
+        job = *pick;
+        if ( job != mux->queue ) {
+            for ( older = mux->queue; older != job; older = older->next ) {
+                older->bypassed++;
+            }
+            mux->stats.reorders++;
+        }
+        *pick = job->next;
+        job->status = I2C_JOB_ACTIVE;
     }
-    if ( p_i2c_mux->semaphore == 0 ) {
-        return false;
+    taskEXIT_CRITICAL();
+
+    return job;
+}
+
+/* Waits until the bus worker is done with a request */
+static bool i2c_job_wait( i2c_mux_state_t *mux, i2c_job_t *job, TickType_t timeout )
+{
+    if ( task_notify_wait( NOTIFY_I2C_JOB, timeout ) == 0 && i2c_job_cancel( mux, job ) == false ) {
+        /* Already being served, the worker answers within a transfer timeout */
+        task_notify_wait( NOTIFY_I2C_JOB, portMAX_DELAY );
     }
 
-    /* Try to take the semaphore to win the bus */
-    if ( xSemaphoreTake( p_i2c_mux->semaphore, timeout ) == pdFALSE ) {
-        return false;
+    return ( job->status == I2C_JOB_DONE );
+}
+
+static void vTaskI2C( void *pvParameters )
+{
+    i2c_mux_state_t *mux = (i2c_mux_state_t *) pvParameters;
+    i2c_job_t *job;
+
+    for ( ;; ) {
+        job = i2c_job_pick( mux );
+
+        if ( job == NULL ) {
+            task_notify_wait( NOTIFY_I2C_WORKER, portMAX_DELAY );
+            continue;
+        }
+
+        if ( job->grant == 0 ) {
+            i2c_job_run( mux, job );
+            continue;
+        }
+
+        if ( i2c_select_bus( mux, job->bus_id ) == false ) {
+            i2c_job_complete( job, I2C_JOB_FAILED );
+            continue;
+        }
+
+        /* Hand the bus over to the task and wait for i2c_give(), anything queued meanwhile is picked afterwards */
+        mux->owner = job;
+        mux->stats.grants++;
+        i2c_job_complete( job, I2C_JOB_DONE );
+
+        while ( mux->owner != NULL ) {
+            task_notify_wait( NOTIFY_I2C_WORKER, portMAX_DELAY );
+        }
     }
+}
 
-    /* This bus is not multiplexed, no action needed */
-    if ( p_i2c_bus->mux_bus == -1 ) {
-        *i2c_interface = p_i2c_mux->i2c_interface;
-        portENABLE_INTERRUPTS();
-        return true;
+void i2c_init( void )
+{
+    i2c_init_speeds();
+
+    for ( uint8_t i = 0; i < I2C_MUX_COUNT; i++ ) {
+        i2c_mux[i].queue = NULL;
+        i2c_mux[i].owner = NULL;
+        vI2CConfig( i2c_mux[i].i2c_interface, SPEED_100KHZ );
+        i2c_mux[i].speed = SPEED_100KHZ / 1000;
+        i2c_mux[i].faults_seen = ulI2CMasterFaults( i2c_mux[i].i2c_interface );
+        xTaskCreate( vTaskI2C, "I2C", I2C_WORKER_STACK_SIZE, (void *) &i2c_mux[i], tskI2C_PRIORITY, &i2c_mux[i].worker );
     }
+}
+
+bool i2c_take_by_busid( uint8_t bus_id, uint8_t *i2c_interface, TickType_t timeout )
+{
+    i2c_mux_state_t *p_i2c_mux = i2c_bus_mux( bus_id );
+    i2c_job_t job = {0};
 
+    if ( p_i2c_mux == NULL ) {
+        return false;
+    }
 
-    p_i2c_mux->state = i2c_get_mux_bus( bus_id, p_i2c_mux );
+    if ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ) {
+        /* Initialization code runs alone, there's no worker to ask for the bus yet.
+         * API calls made before the scheduler is started leave the interrupts masked, but the transfers need them */
+        portENABLE_INTERRUPTS();
+        if ( i2c_select_bus( p_i2c_mux, bus_id ) == false ) {
+            return false;
+        }
+    } else {
+        job.bus_id = bus_id;
+        job.grant = 1;
+        job.task = xTaskGetCurrentTaskHandle();
 
-    /* This bus mux is in correct state */
-    if ( p_i2c_mux->state != p_i2c_bus->mux_bus ) {
-        if ( i2c_set_mux_bus( bus_id, p_i2c_mux, p_i2c_bus->mux_bus ) == false ) {
+        i2c_job_queue( p_i2c_mux, &job );
+        if ( i2c_job_wait( p_i2c_mux, &job, timeout ) == false ) {
             return false;
         }
     }
+
     *i2c_interface = p_i2c_mux->i2c_interface;
-    portENABLE_INTERRUPTS();
     return true;
 }
 
-bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t *i2c_interface,  uint32_t timeout )
+bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t *i2c_interface,  TickType_t timeout )
 {
-    if ( chip_id > I2C_CHIP_MAP_COUNT ) {
+    if ( chip_id >= I2C_CHIP_MAP_COUNT ) {
         return false;
     }
 
@@ -114,12 +422,174 @@ bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t *i2c_int
 }
 
 void i2c_give( uint8_t i2c_interface )
+{
+    i2c_mux_state_t *mux = i2c_find_mux( i2c_interface );
+
+    /* Nothing to hand back when the bus was taken before the scheduler started */
+    if ( mux != NULL && mux->owner != NULL ) {
+        mux->owner = NULL;
+        task_notify( mux->worker, NOTIFY_I2C_WORKER );
+    }
+}
+
+bool i2c_submit( i2c_job_t *job )
 {
     i2c_mux_state_t *mux;
-    for ( mux = i2c_mux; mux != NULL; mux++ ) {
-        if ( mux->i2c_interface == i2c_interface ) {
-            xSemaphoreGive( mux->semaphore );
-            break;
-        }
+
+    if ( job->chip_id >= I2C_CHIP_MAP_COUNT ) {
+        return false;
+    }
+
+    job->bus_id = i2c_chip_map[job->chip_id].bus_id;
+    job->grant = 0;
+
+    mux = i2c_bus_mux( job->bus_id );
+    if ( mux == NULL ) {
+        return false;
+    }
+
+    if ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ) {
+        portENABLE_INTERRUPTS();
+        job->status = I2C_JOB_ACTIVE;
+        i2c_job_run( mux, job );
+    } else {
+        i2c_job_queue( mux, job );
+    }
+    return true;
+}
+
+bool i2c_transfer( i2c_job_t *job, TickType_t timeout )
+{
+    bool running = ( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING );
+
+    job->callback = NULL;
+    job->task = running ? xTaskGetCurrentTaskHandle() : NULL;
+
+    if ( i2c_submit( job ) == false ) {
+        return false;
+    }
+
+    if ( running ) {
+        return i2c_job_wait( i2c_bus_mux( job->bus_id ), job, timeout );
+    }
+    return ( job->status == I2C_JOB_DONE );
+}
+
+void i2c_set_external_master( uint8_t i2c_interface, bool present )
+{
+    i2c_mux_state_t *mux = i2c_find_mux( i2c_interface );
+
+    if ( mux != NULL ) {
+        mux->external_master = present;
+    }
+}
+
+bool i2c_get_stats( uint8_t i2c_interface, i2c_stats_t *stats, bool reset )
+{
+    i2c_mux_state_t *mux = i2c_find_mux( i2c_interface );
+
+    if ( mux == NULL ) {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    *stats = mux->stats;
+    if ( reset ) {
+        memset( &mux->stats, 0, sizeof(i2c_stats_t) );
+    }
+    taskEXIT_CRITICAL();
+
+    return true;
+}
+
+/* IPMI Handlers */
+
+/**
+ * @brief Reads the bus worker counters of an I2C interface
+ *
+ * Request:  [0] = physical I2C interface, [1] = reset the counters after reading (optional)
+ * Response: 4 bytes each, LSB first: [0-3] bus handoffs, [4-7] asynchronous jobs, [8-11] mux switches, [12-15] reordered requests,
+ *           [16-19] mux channel reads, [20-23] mux channel reads saved by the cached channel
+ */
+IPMI_HANDLER(ipmi_custom_get_i2c_stats, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_I2C_STATS, ipmi_msg *req, ipmi_msg *rsp)
+{
+    i2c_stats_t stats;
+    uint32_t counters[6];
+    uint8_t len = 0;
+    uint8_t i;
+
+    if ( req->data_len < 1 ) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        rsp->data_len = 0;
+        return;
+    }
+
+    if ( i2c_get_stats( req->data[0], &stats, ( req->data_len > 1 ) && req->data[1] ) == false ) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        rsp->data_len = 0;
+        return;
+    }
+
+    counters[0] = stats.grants;
+    counters[1] = stats.jobs;
+    counters[2] = stats.mux_switches;
+    counters[3] = stats.reorders;
+    counters[4] = stats.mux_readbacks;
+    counters[5] = stats.mux_readbacks_saved;
+
+    for ( i = 0; i < sizeof(counters)/sizeof(counters[0]); i++ ) {
+        rsp->data[len++] = counters[i] & 0xFF;
+        rsp->data[len++] = (counters[i] >> 8) & 0xFF;
+        rsp->data[len++] = (counters[i] >> 16) & 0xFF;
+        rsp->data[len++] = (counters[i] >> 24) & 0xFF;
+    }
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
+
+/**
+ * @brief Reads the bus health counters of an I2C interface
+ *
+ * Request:  [0] = physical I2C interface, [1] = reset the counters after reading (optional)
+ * Response: 4 bytes each, LSB first: [0-3] transfer timeouts, [4-7] arbitration losses, [8-11] bus errors,
+ *           [12-15] bus recoveries, [16-19] failed recoveries, [20-23] longest recovery (us)
+ */
+IPMI_HANDLER(ipmi_custom_get_i2c_health, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_I2C_HEALTH, ipmi_msg *req, ipmi_msg *rsp)
+{
+    i2c_health_t health;
+    uint32_t counters[6];
+    uint8_t len = 0;
+    uint8_t i;
+
+    if ( req->data_len < 1 ) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        rsp->data_len = 0;
+        return;
     }
+
+    if ( i2c_find_mux( req->data[0] ) == NULL ) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        rsp->data_len = 0;
+        return;
+    }
+
+    vI2CMasterHealth( req->data[0], &health, ( req->data_len > 1 ) && req->data[1] );
+
+    counters[0] = health.timeouts;
+    counters[1] = health.arb_lost;
+    counters[2] = health.bus_errors;
+    counters[3] = health.recoveries;
+    counters[4] = health.recovery_failures;
+    counters[5] = health.recovery_max_us;
+
+    for ( i = 0; i < sizeof(counters)/sizeof(counters[0]); i++ ) {
+        rsp->data[len++] = counters[i] & 0xFF;
+        rsp->data[len++] = (counters[i] >> 8) & 0xFF;
+        rsp->data[len++] = (counters[i] >> 16) & 0xFF;
+        rsp->data[len++] = (counters[i] >> 24) & 0xFF;
+    }
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
 }
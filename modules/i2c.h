@@ -23,7 +23,8 @@
 #define I2C_H_
 
 #include "FreeRTOS.h"
-#include "semphr.h"
+#include "task.h"
+#include "port.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -35,6 +36,7 @@ typedef struct i2c_chip_mapping {
                                      * @note This bus has to be defined in a i2c_bus_mapping_t table
                                      */
     uint8_t i2c_address;            /**< Chip I2C slave address (7-bit) */
+    uint16_t max_speed;             /**< Highest SCL rate the chip supports, in kHz (0 for 100 kHz) */
 } i2c_chip_mapping_t;
 
 /**
@@ -46,19 +48,106 @@ typedef struct i2c_bus_mapping {
     uint8_t enabled;                /**< Enabled flag */
 } i2c_bus_mapping_t;
 
+/**
+ * @brief Bus worker stack size
+ *
+ * Job callbacks run on this stack, so they have to be kept short. The deepest paths, a mux readback with a bus
+ * recovery and a callback that queues the next job of a chain, come to about 100 words with the task context.
+ */
+#define I2C_WORKER_STACK_SIZE           160
+
+/**
+ * @brief Upper limit for the SCL rate, in kHz
+ *
+ * Build with -DI2C_MAX_SPEED_KHZ=100 to keep every bus at the original rate, e.g. to compare the sensor sweep times
+ */
+#ifndef I2C_MAX_SPEED_KHZ
+#define I2C_MAX_SPEED_KHZ               400
+#endif
+
+/**
+ * @brief Number of times a pending request may be overtaken by requests for the current mux channel
+ */
+#define I2C_FAIRNESS_BOUND              4
+
+/**
+ * @brief I2C request states
+ */
+enum {
+    I2C_JOB_QUEUED = 0,             /**< Waiting in the bus worker queue */
+    I2C_JOB_ACTIVE,                 /**< Taken by the bus worker */
+    I2C_JOB_DONE,                   /**< Completed: all bytes were transferred (or the bus was granted) */
+    I2C_JOB_FAILED,                 /**< Mux selection or transfer failed, or the request timed out */
+};
+
+/**
+ * @brief Queued I2C transaction
+ *
+ * Asynchronous jobs are filled by the caller and handed to #i2c_submit. The bus worker selects the chip mux channel,
+ * writes tx_buff and then reads rx_buff after a repeated START (or runs the segments list, if given), and reports the
+ * completion through the callback or, if there is none, with a task notification.
+ * The structure is owned by the bus layer until its status leaves I2C_JOB_QUEUED/I2C_JOB_ACTIVE.
+ */
+typedef struct i2c_job {
+    uint8_t chip_id;                /**< Chip to communicate with */
+    const uint8_t *tx_buff;         /**< Data to write (may be NULL if tx_len is 0) */
+    uint8_t tx_len;                 /**< Number of bytes to write */
+    uint8_t *rx_buff;               /**< Buffer for the data read (may be NULL if rx_len is 0) */
+    uint8_t rx_len;                 /**< Number of bytes to read */
+    i2c_seg_t *segs;                /**< Segments of a combined transfer, used instead of tx_buff/rx_buff when not NULL */
+    uint8_t seg_count;              /**< Number of segments */
+    void (*callback)( struct i2c_job *job ); /**< Completion callback, called from the bus worker. It must not block nor take the same bus */
+    void *arg;                      /**< Free for the callback use */
+    TaskHandle_t task;              /**< Task notified on completion when there's no callback */
+    volatile uint8_t status;        /**< Request state (I2C_JOB_*) */
+
+    /* Used by the bus layer */
+    uint8_t bus_id;                 /**< Bus the chip is attached to */
+    uint8_t grant;                  /**< Blocking take: the bus is handed to the task instead of running a transfer */
+    uint8_t bypassed;               /**< Times this request was overtaken while pending */
+    struct i2c_job *next;           /**< Next request in the queue */
+} i2c_job_t;
+
+/**
+ * @brief Bus worker counters
+ */
+typedef struct i2c_stats {
+    uint32_t grants;                /**< Bus handoffs to tasks (blocking takes) */
+    uint32_t jobs;                  /**< Asynchronous jobs run by the worker */
+    uint32_t mux_switches;          /**< Mux channel changes */
+    uint32_t reorders;              /**< Requests served ahead of older ones to avoid a mux switch */
+    uint32_t mux_readbacks;         /**< Mux channel reads */
+    uint32_t mux_readbacks_saved;   /**< Mux channel reads skipped because the cached channel was valid */
+} i2c_stats_t;
+
 /**
  * @brief I2C Mux state
+ *
+ * Each physical interface is owned by a bus worker task, which serves the queued requests one at a time.
+ *
+ * The selected mux channel is cached in state and only read back from the mux when it may have been changed
+ * behind our back: after an arbitration loss or a bus error, or always if another master shares the bus.
+ *
+ * The SCL rate follows the selected bus: it's the highest one supported by every chip that can hear the transfer,
+ * i.e. the ones on the selected mux channel and on the non-multiplexed part of the interface.
  */
 typedef struct i2c_mux_state {
-    uint8_t i2c_interface;         /**< Physical I2C bus number */
-    int8_t state;                   /**< Mux state */
-    SemaphoreHandle_t semaphore;    /**< Bus semaphore handle */
+    uint8_t i2c_interface;          /**< Physical I2C bus number */
+    int8_t state;                   /**< Mux state (-1 if unknown) */
+    uint8_t external_master;        /**< Another master (e.g. the FPGA) may switch the mux */
+    uint32_t faults_seen;           /**< Controller fault count when the state was last known to be valid */
+    uint16_t speed;                 /**< Current SCL rate (kHz) */
+    uint16_t min_speed;             /**< SCL rate supported by every chip on the interface (kHz) */
+    TaskHandle_t worker;            /**< Bus worker task handle */
+    i2c_job_t *queue;               /**< Pending requests, oldest first */
+    i2c_job_t * volatile owner;     /**< Blocking take currently holding the bus */
+    i2c_stats_t stats;              /**< Bus worker counters */
 } i2c_mux_state_t;
 
 /**
  * @brief Initialize peripheral I2C buses
  *
- * This function initializes all buses listed on the i2c_mux table, configuring the controller hardware and creating a binary semaphore for each.
+ * This function initializes all buses listed on the i2c_mux table, configuring the controller hardware and creating a bus worker task for each.
  */
 void i2c_init( void );
 
@@ -80,13 +169,16 @@ bool i2c_set_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux, int8_t new_state
  * @param bus_id Target bus ID
  * @param i2c_mux Pointer to bus mux structure
  *
- * @return Bus current state
+ * @return Bus current state, -1 if it could not be read
  */
-uint8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux );
+int8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux );
 
 /**
  * @brief Take control over an I2C bus given a bus id
  *
+ * The request is queued on the bus worker, which selects the mux channel and hands the bus to the calling task.
+ * Requests for the channel already selected may be served ahead of older ones, up to #I2C_FAIRNESS_BOUND times.
+ *
  * @param[in] bus_id Bus ID to take control
  * @param[out] i2c_interface Pointer to variable that will hold the I2C physical bus ID
  * @param[in] timeout Limit time to perform this operation
@@ -116,4 +208,49 @@ bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t * i2c_in
  */
 void i2c_give( uint8_t i2c_interface );
 
+/**
+ * @brief Queue an asynchronous transaction
+ *
+ * Before the scheduler is started the transaction is run right away, on the caller context.
+ *
+ * @param job Transaction description, which must stay valid until its completion
+ *
+ * @retval true Job was queued
+ * @retval false Invalid chip or disabled bus, the job was not queued
+ */
+bool i2c_submit( i2c_job_t *job );
+
+/**
+ * @brief Run a transaction through the bus worker and wait for its completion
+ *
+ * @param job Transaction description (callback and task are overwritten)
+ * @param timeout Max time to wait for the bus
+ *
+ * @retval true All bytes were transferred
+ * @retval false Bus could not be gained in time or the transfer failed
+ */
+bool i2c_transfer( i2c_job_t *job, TickType_t timeout );
+
+/**
+ * @brief Tell whether another master may switch the mux of an interface
+ *
+ * While set, the mux channel is read back before every access instead of trusting the cached one
+ *
+ * @param i2c_interface Physical I2C bus ID
+ * @param present Another master is active on the bus
+ */
+void i2c_set_external_master( uint8_t i2c_interface, bool present );
+
+/**
+ * @brief Read the bus worker counters
+ *
+ * @param i2c_interface Physical I2C bus ID
+ * @param[out] stats Copy of the counters
+ * @param reset Clear the counters after reading them
+ *
+ * @retval true Counters were read
+ * @retval false The interface has no bus worker
+ */
+bool i2c_get_stats( uint8_t i2c_interface, i2c_stats_t *stats, bool reset );
+
 #endif
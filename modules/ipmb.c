@@ -35,6 +35,8 @@
 #include "led.h"
 #include "port.h"
 #include "task_priorities.h"
+#include "ipmi_stats.h"
+#include "task_notify.h"
 
 /**
  * @brief Encode IPMI msg struct to a byte formatted buffer
@@ -75,14 +77,12 @@ ipmb_error ipmb_encode ( uint8_t * buffer, ipmi_msg * msg );
 ipmb_error ipmb_decode ( ipmi_msg * msg, uint8_t * buffer, uint8_t len );
 
 /**
- * @brief Notifies the client that a new request has arrived and copies the message to its queue.
- * This function receives a message wrapped in a ipmi_msg_cfg struct and copies only the ipmi_msg
- * field to the client queue.
- * Also, if a task has registered its handle in the caller_task field, notify it.
+ * @brief Notifies the client that a new request has arrived by putting a pointer to it in the client queue.
+ * The ownership of the pool slot is passed to the client, which has to release it with #ipmb_msg_free.
  *
  * @param[in] msg_cfg The message that arrived, wrapped in the configuration struct ipmi_msg_cfg.
  *
- * @retval ipmb_error_success The message was successfully copied.
+ * @retval ipmb_error_success The message was successfully queued.
  * @retval ipmb_error_timeout The client_queue was full.
  */
 ipmb_error ipmb_notify_client ( ipmi_msg_cfg * msg_cfg );
@@ -94,7 +94,346 @@ QueueHandle_t ipmb_txqueue = NULL;
 QueueHandle_t client_queue = NULL;
 
 static uint8_t current_seq;
-static ipmi_msg_cfg *last_sent_req;
+static ipmb_pending_req pending_req[IPMB_MAX_PENDING_REQ];
+
+/* Static message pool, the free slots are kept in a stack of indexes */
+static ipmi_msg_cfg msg_pool[IPMB_MSG_POOL_SIZE];
+static uint8_t msg_pool_free[IPMB_MSG_POOL_SIZE];
+static uint8_t msg_pool_free_cnt;
+static ipmb_pool_stats msg_pool_stats;
+
+/* Last responses sent, replayed when the requester retries a request we've already answered */
+static ipmb_replay_entry replay_cache[IPMB_REPLAY_CACHE_LEN];
+static ipmb_replay_stats replay_stats;
+
+/* Requests passed to the client and not answered yet, a retry of one of them is dropped */
+static ipmb_inflight_entry inflight_req[IPMB_INFLIGHT_LEN];
+
+static void ipmb_pool_init( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < IPMB_MSG_POOL_SIZE; i++ ) {
+        msg_pool_free[i] = i;
+    }
+    msg_pool_free_cnt = IPMB_MSG_POOL_SIZE;
+    memset( &msg_pool_stats, 0, sizeof(msg_pool_stats) );
+}
+
+ipmi_msg_cfg * ipmb_msg_alloc( void )
+{
+    ipmi_msg_cfg *msg_cfg = NULL;
+    UBaseType_t int_mask;
+
+    /* Masking interrupts (up to the syscall priority) keeps this usable from both tasks and ISRs */
+    int_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    if ( msg_pool_free_cnt > 0 ) {
+        msg_cfg = &msg_pool[msg_pool_free[--msg_pool_free_cnt]];
+        msg_pool_stats.in_use++;
+        if ( msg_pool_stats.in_use > msg_pool_stats.high_water ) {
+            msg_pool_stats.high_water = msg_pool_stats.in_use;
+        }
+    } else {
+        msg_pool_stats.exhausted++;
+    }
+
+    portCLEAR_INTERRUPT_MASK_FROM_ISR( int_mask );
+
+    return msg_cfg;
+}
+
+void ipmb_msg_free( ipmi_msg_cfg * msg_cfg )
+{
+    UBaseType_t int_mask;
+
+    if ( msg_cfg == NULL ) {
+        return;
+    }
+
+    configASSERT( (msg_cfg >= &msg_pool[0]) && (msg_cfg < &msg_pool[IPMB_MSG_POOL_SIZE]) );
+
+    int_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    configASSERT( msg_pool_free_cnt < IPMB_MSG_POOL_SIZE );
+    msg_pool_free[msg_pool_free_cnt++] = msg_cfg - &msg_pool[0];
+    msg_pool_stats.in_use--;
+
+    portCLEAR_INTERRUPT_MASK_FROM_ISR( int_mask );
+}
+
+void ipmb_pool_get_stats( ipmb_pool_stats * stats )
+{
+    UBaseType_t int_mask;
+
+    int_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    memcpy( stats, &msg_pool_stats, sizeof(ipmb_pool_stats) );
+    portCLEAR_INTERRUPT_MASK_FROM_ISR( int_mask );
+}
+
+/* Allocates an entry in the pending table and a sequence number not used by any other outstanding request */
+static ipmb_pending_req * ipmb_pending_add( ipmi_msg * req, ipmi_msg * resp )
+{
+    ipmb_pending_req *entry = NULL;
+    uint8_t i, tries;
+    bool seq_in_use;
+
+    taskENTER_CRITICAL();
+
+    for ( i = 0; i < IPMB_MAX_PENDING_REQ; i++ ) {
+        if ( !pending_req[i].in_use ) {
+            entry = &pending_req[i];
+            break;
+        }
+    }
+
+    if ( entry ) {
+        for ( tries = 0; tries <= IPMB_MAX_PENDING_REQ; tries++ ) {
+            req->seq = current_seq++ & (IPMB_SEQ_MASK >> 2);
+            seq_in_use = false;
+            for ( i = 0; i < IPMB_MAX_PENDING_REQ; i++ ) {
+                if ( pending_req[i].in_use && pending_req[i].seq == req->seq ) {
+                    seq_in_use = true;
+                }
+            }
+            if ( !seq_in_use ) {
+                break;
+            }
+        }
+
+        entry->in_use = 1;
+        entry->matched = 0;
+        entry->armed = 0;
+        entry->seq = req->seq;
+        entry->netfn = req->netfn;
+        entry->cmd = req->cmd;
+        entry->dest_addr = req->dest_addr;
+        entry->caller_task = xTaskGetCurrentTaskHandle();
+        entry->resp = resp;
+    }
+
+    taskEXIT_CRITICAL();
+
+    return entry;
+}
+
+static void ipmb_pending_remove( ipmb_pending_req * entry )
+{
+    taskENTER_CRITICAL();
+    entry->in_use = 0;
+    taskEXIT_CRITICAL();
+}
+
+/* Looks for the request that originated this response and wakes up its caller */
+static bool ipmb_pending_match( ipmi_msg * resp )
+{
+    ipmb_pending_req *entry;
+    bool found = false;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+
+    for ( i = 0; i < IPMB_MAX_PENDING_REQ; i++ ) {
+        entry = &pending_req[i];
+
+        if ( !entry->in_use || entry->matched ) {
+            continue;
+        }
+        if ( (entry->seq != resp->seq) || (entry->netfn + 1 != resp->netfn) ||
+             (entry->cmd != resp->cmd) || (entry->dest_addr != resp->src_addr) ) {
+            continue;
+        }
+        /* A response that arrives after the deadline is ignored, the caller is already reporting a timeout */
+        if ( entry->armed && ((int32_t)(xTaskGetTickCount() - entry->deadline) >= 0) ) {
+            break;
+        }
+
+        memcpy( entry->resp, resp, sizeof(ipmi_msg) );
+        entry->matched = 1;
+        task_notify( entry->caller_task, NOTIFY_IPMB_RESPONSE );
+        found = true;
+        break;
+    }
+
+    taskEXIT_CRITICAL();
+
+    return found;
+}
+
+/* Waits for the transmission result sent by #ipmb_notify_caller */
+static ipmb_error ipmb_wait_tx( void )
+{
+    uint32_t bits = task_notify_wait( NOTIFY_IPMB_TX_OK | NOTIFY_IPMB_TX_FAILED, portMAX_DELAY );
+
+    return ( bits & NOTIFY_IPMB_TX_OK ) ? ipmb_error_success : ipmb_error_failure;
+}
+
+/* Replayed responses have no task waiting for the transmission result */
+static void ipmb_notify_caller( ipmi_msg_cfg * msg_cfg, ipmb_error error )
+{
+    if ( msg_cfg->caller_task ) {
+        task_notify( msg_cfg->caller_task, ( error == ipmb_error_success ) ? NOTIFY_IPMB_TX_OK : NOTIFY_IPMB_TX_FAILED );
+    }
+}
+
+/* FNV-1a hash of the request data, so a new request that reuses (seq, netfn, cmd) isn't taken for a retry */
+static uint32_t ipmb_req_hash( ipmi_msg * req )
+{
+    uint32_t hash = 2166136261UL;
+    uint8_t i;
+
+    hash = (hash ^ req->data_len) * 16777619UL;
+    for ( i = 0; i < req->data_len; i++ ) {
+        hash = (hash ^ req->data[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+/* Keeps a copy of a response that was transmitted, so it can be sent again if the requester retries the same request */
+static void ipmb_replay_store( ipmi_msg * resp, uint32_t req_hash )
+{
+    ipmb_replay_entry *entry = &replay_cache[0];
+    uint8_t i;
+
+    /* A busy node must run the request again when it's retried */
+    if ( resp->completion_code == IPMI_CC_NODE_BUSY ) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    /* Reuse the oldest entry */
+    for ( i = 1; i < IPMB_REPLAY_CACHE_LEN; i++ ) {
+        if ( (int32_t)(replay_cache[i].timestamp - entry->timestamp) < 0 ) {
+            entry = &replay_cache[i];
+        }
+    }
+    memcpy( &entry->resp, resp, sizeof(ipmi_msg) );
+    entry->req_hash = req_hash;
+    entry->timestamp = xTaskGetTickCount();
+    entry->valid = 1;
+    taskEXIT_CRITICAL();
+}
+
+/* Forgets a request once its response was sent or given up, the replay cache answers its retries from then on */
+static void ipmb_inflight_remove( uint8_t src_addr, uint8_t seq, uint8_t netfn, uint8_t cmd, uint32_t req_hash )
+{
+    ipmb_inflight_entry *req_entry;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    for ( i = 0; i < IPMB_INFLIGHT_LEN; i++ ) {
+        req_entry = &inflight_req[i];
+        if ( req_entry->valid && (req_entry->src_addr == src_addr) && (req_entry->seq == seq) &&
+             (req_entry->netfn == netfn) && (req_entry->cmd == cmd) && (req_entry->req_hash == req_hash) ) {
+            req_entry->valid = 0;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+/* Forgets the request a response (not a replayed one) answers */
+static void ipmb_inflight_answered( ipmi_msg_cfg * resp_cfg )
+{
+    if ( resp_cfg->caller_task ) {
+        ipmb_inflight_remove( resp_cfg->buffer.dest_addr, resp_cfg->buffer.seq, resp_cfg->buffer.netfn - 1,
+                              resp_cfg->buffer.cmd, resp_cfg->req_hash );
+    }
+}
+
+/* Looks for the response already sent to a retried request and queues it again. A request that isn't answered from
+ * the cache is recorded as in flight, unless it retries one that still is. Both tables are checked in the same critical
+ * section, so a response stored by the TX task in between can't let a retry through */
+static bool ipmb_replay_lookup( ipmi_msg * req, uint32_t req_hash )
+{
+    ipmb_replay_entry *entry;
+    ipmb_inflight_entry *req_entry, *slot = NULL;
+    ipmi_msg_cfg *resp_cfg = NULL;
+    TickType_t now;
+    bool cached, slot_live = false, duplicate = false;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    now = xTaskGetTickCount();
+    for ( i = 0; i < IPMB_REPLAY_CACHE_LEN; i++ ) {
+        entry = &replay_cache[i];
+        if ( entry->valid && (entry->resp.dest_addr == req->src_addr) && (entry->resp.seq == req->seq) &&
+             (entry->resp.netfn == req->netfn + 1) && (entry->resp.cmd == req->cmd) && (entry->req_hash == req_hash) &&
+             ((now - entry->timestamp) < IPMB_REPLAY_WINDOW) ) {
+            resp_cfg = ipmb_msg_alloc();
+            if ( resp_cfg ) {
+                memcpy( &resp_cfg->buffer, &entry->resp, sizeof(ipmi_msg) );
+            }
+            break;
+        }
+    }
+    cached = ( i < IPMB_REPLAY_CACHE_LEN );
+
+    if ( !cached ) {
+        for ( i = 0; i < IPMB_INFLIGHT_LEN; i++ ) {
+            req_entry = &inflight_req[i];
+            /* An entry whose response was never sent expires like the cached responses */
+            if ( !req_entry->valid || ((now - req_entry->timestamp) >= IPMB_REPLAY_WINDOW) ) {
+                if ( (slot == NULL) || slot_live ) {
+                    slot = req_entry;
+                    slot_live = false;
+                }
+                continue;
+            }
+            if ( (req_entry->src_addr == req->src_addr) && (req_entry->seq == req->seq) &&
+                 (req_entry->netfn == req->netfn) && (req_entry->cmd == req->cmd) && (req_entry->req_hash == req_hash) ) {
+                duplicate = true;
+                break;
+            }
+            /* With no free entry, the oldest request is forgotten */
+            if ( (slot == NULL) || (slot_live && ((int32_t)(req_entry->timestamp - slot->timestamp) < 0)) ) {
+                slot = req_entry;
+                slot_live = true;
+            }
+        }
+
+        if ( !duplicate ) {
+            slot->src_addr = req->src_addr;
+            slot->seq = req->seq;
+            slot->netfn = req->netfn;
+            slot->cmd = req->cmd;
+            slot->req_hash = req_hash;
+            slot->timestamp = now;
+            slot->valid = 1;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if ( duplicate ) {
+        replay_stats.inflight++;
+        return true;
+    }
+
+    if ( !cached ) {
+        replay_stats.misses++;
+        return false;
+    }
+
+    replay_stats.hits++;
+
+    if ( resp_cfg ) {
+        resp_cfg->caller_task = NULL;
+        resp_cfg->retries = 0;
+        if ( xQueueSend( ipmb_txqueue, &resp_cfg, 0 ) != pdTRUE ) {
+            /* The requester will retry again */
+            ipmb_msg_free( resp_cfg );
+        }
+    }
+
+    return true;
+}
+
+void ipmb_replay_get_stats( ipmb_replay_stats * stats )
+{
+    taskENTER_CRITICAL();
+    memcpy( stats, &replay_stats, sizeof(ipmb_replay_stats) );
+    taskEXIT_CRITICAL();
+}
 
 void IPMB_TXTask ( void * pvParameters )
 {
@@ -113,9 +452,10 @@ void IPMB_TXTask ( void * pvParameters )
 
             /* See if we've already tried sending this message 3 times */
             if ( current_msg_tx->retries > IPMB_MAX_RETRIES ) {
-                xTaskNotify( current_msg_tx->caller_task ,ipmb_error_failure , eSetValueWithOverwrite);
+                ipmb_inflight_answered( current_msg_tx );
+                ipmb_notify_caller( current_msg_tx, ipmb_error_failure );
                 /* Free the message buffer */
-                vPortFree( current_msg_tx );
+                ipmb_msg_free( current_msg_tx );
                 current_msg_tx = NULL;
                 continue;
             }
@@ -127,16 +467,24 @@ void IPMB_TXTask ( void * pvParameters )
             /* Encode the message buffer to the IPMB format */
             ipmb_encode( &ipmb_buffer_tx[0], &current_msg_tx->buffer );
             uint8_t resp_tx_size = current_msg_tx->buffer.data_len + IPMB_RESP_HEADER_LENGTH;
-            if ( xI2CMasterWrite( IPMB_I2C, current_msg_tx->buffer.dest_addr >> 1, &ipmb_buffer_tx[1], resp_tx_size ) < resp_tx_size ) {
+            uint32_t tx_start = cycle_counter_read();
+            int tx_len = xI2CMasterWrite( IPMB_I2C, current_msg_tx->buffer.dest_addr >> 1, &ipmb_buffer_tx[1], resp_tx_size );
+            ipmi_stats_tx( cycle_counter_read() - tx_start );
+
+            if ( tx_len < resp_tx_size ) {
                 /* Message couldn't be transmitted right now, increase retry counter and try again later */
                 current_msg_tx->retries++;
                 xQueueSendToFront( ipmb_txqueue, &current_msg_tx, 0 );
 
             } else {
-                /* Success case*/
-                xTaskNotify( current_msg_tx->caller_task , ipmb_error_success, eSetValueWithOverwrite);
+                /* Success case, only a response that reached the requester may be replayed (replays have no caller) */
+                if ( current_msg_tx->caller_task ) {
+                    ipmb_replay_store( &current_msg_tx->buffer, current_msg_tx->req_hash );
+                }
+                ipmb_inflight_answered( current_msg_tx );
+                ipmb_notify_caller( current_msg_tx, ipmb_error_success );
                 /* Free the message buffer */
-                vPortFree( current_msg_tx );
+                ipmb_msg_free( current_msg_tx );
                 current_msg_tx = NULL;
             }
 
@@ -158,19 +506,19 @@ void IPMB_TXTask ( void * pvParameters )
                 current_msg_tx->retries++;
 
                 if ( current_msg_tx->retries > IPMB_MAX_RETRIES ){
-                    xTaskNotify ( current_msg_tx->caller_task, ipmb_error_failure, eSetValueWithOverwrite);
+                    ipmb_notify_caller( current_msg_tx, ipmb_error_failure );
                     /* Free the message buffer */
-                    vPortFree( current_msg_tx );
+                    ipmb_msg_free( current_msg_tx );
                     current_msg_tx = NULL;
                 } else {
                     xQueueSendToFront( ipmb_txqueue, &current_msg_tx, 0 );
                 }
 
             } else {
-                /* Request was successfully sent, keep a copy here for future comparison and clean the last used buffer */
-                vPortFree( last_sent_req );
-                last_sent_req = current_msg_tx;
-                xTaskNotify ( current_msg_tx->caller_task, ipmb_error_success, eSetValueWithOverwrite);
+                /* Request was successfully sent, the pending table keeps what we need to match its response */
+                ipmb_notify_caller( current_msg_tx, ipmb_error_success );
+                ipmb_msg_free( current_msg_tx );
+                current_msg_tx = NULL;
             }
         }
     }
@@ -179,58 +527,70 @@ void IPMB_TXTask ( void * pvParameters )
 void IPMB_RXTask ( void *pvParameters )
 {
     ipmi_msg_cfg *current_msg_rx;
-    uint8_t ipmb_buffer_rx[IPMI_MSG_MAX_LENGTH];
+    uint8_t *frame;
     uint8_t rx_len;
 
     for ( ;; ) {
-        /* Checks if there's any incoming messages (the task remains blocked here) */
-        rx_len = xI2CSlaveReceive( IPMB_I2C, &ipmb_buffer_rx[1], (sizeof(ipmb_buffer_rx)/sizeof(ipmb_buffer_rx[0])), portMAX_DELAY );
-
-        if ( rx_len > 0 ) {
-
-            ipmb_buffer_rx[0] = ipmb_addr;
-            rx_len++;
-
-            /* Perform a checksum test on the message, if it doesn't pass, just ignore it.
-             * Following the IPMB specs, we have no way to know if we're the one who should
-             * receive it. In MicroTCA crates with star topology for IPMB, we are assured we
-             * are the recipients, however, malformed messages may be safely ignored as the
-             * MCMC should take care of retrying.
-             */
-
-            if ( ipmb_assert_chksum( ipmb_buffer_rx, rx_len ) != ipmb_error_success ) {
-                continue;
-            }
+        /* Checks if there's any incoming messages (the task remains blocked here).
+         * The frame is read in place from the I2C driver's receive ring, already prefixed with our address */
+        frame = xI2CSlaveReceiveFrame( IPMB_I2C, &rx_len, portMAX_DELAY );
 
-            current_msg_rx = pvPortMalloc(sizeof(ipmi_msg_cfg));
+        if ( frame == NULL ) {
+            continue;
+        }
 
-            /* Clear our local buffer before writing new data into it */
-            memset(current_msg_rx, 0, sizeof(ipmi_msg_cfg));
+        /* Perform a checksum test on the message, if it doesn't pass, just ignore it.
+         * Following the IPMB specs, we have no way to know if we're the one who should
+         * receive it. In MicroTCA crates with star topology for IPMB, we are assured we
+         * are the recipients, however, malformed messages may be safely ignored as the
+         * MCMC should take care of retrying.
+         */
+        if ( ipmb_assert_chksum( frame, rx_len ) != ipmb_error_success ) {
+            vI2CSlaveReleaseFrame( IPMB_I2C );
+            continue;
+        }
 
-            ipmb_decode( &(current_msg_rx->buffer), ipmb_buffer_rx, rx_len );
+        current_msg_rx = ipmb_msg_alloc();
+        if ( current_msg_rx == NULL ) {
+            /* No free slots, drop the message. The MCH will retry it */
+            vI2CSlaveReleaseFrame( IPMB_I2C );
+            continue;
+        }
 
-            if ( IS_RESPONSE( current_msg_rx->buffer ) ) {
-                /* The message is a response, check if it's been received in time */
-                if ( (xTaskGetTickCount() - last_sent_req->timestamp) < IPMB_MSG_TIMEOUT ) {
-                    /* Seq number checking is enough to match the messages */
-                    if ( current_msg_rx->buffer.seq == last_sent_req->buffer.seq ) {
-                        ipmb_notify_client ( current_msg_rx );
-                    }
-                    /* If we received a response that doesn't match a previously sent request, just discard it */
-                }
+        current_msg_rx->caller_task = NULL;
+        current_msg_rx->retries = 0;
+        current_msg_rx->timestamp = xTaskGetTickCount();
+        current_msg_rx->rx_cycles = cycle_counter_read();
+
+        /* Decoding is the only copy made, the frame goes back to the driver right after it */
+        ipmb_decode( &(current_msg_rx->buffer), frame, rx_len );
+        vI2CSlaveReleaseFrame( IPMB_I2C );
+
+        if ( IS_RESPONSE( current_msg_rx->buffer ) ) {
+            /* The message is a response, hand it to the task waiting for it.
+             * If it doesn't match any pending request (or arrived too late), just discard it */
+            ipmb_pending_match( &current_msg_rx->buffer );
+            ipmb_msg_free( current_msg_rx );
+            continue;
+        }
 
-            }else {
-                /* The received message is a request */
+        current_msg_rx->req_hash = ipmb_req_hash( &current_msg_rx->buffer );
 
-                /* Notify the client about the new request */
-                ipmb_notify_client ( current_msg_rx );
-            }
+        if ( ipmb_replay_lookup( &current_msg_rx->buffer, current_msg_rx->req_hash ) ) {
+            /* Retry of a request we've already answered (the stored response was sent again) or are still handling,
+             * either way without calling the handler */
+            ipmb_msg_free( current_msg_rx );
+        } else {
+            /* The received message is a request, pass its ownership to the client */
+            ipmb_notify_client ( current_msg_rx );
         }
     }
 }
 
 void ipmb_init ( void )
 {
+    ipmb_pool_init();
+
     vI2CConfig( IPMB_I2C, IPMB_I2C_FREQ );
     ipmb_addr = get_ipmb_addr( );
     vI2CSlaveSetup( IPMB_I2C, ipmb_addr );
@@ -244,7 +604,14 @@ void ipmb_init ( void )
 
 ipmb_error ipmb_send_request ( ipmi_msg * req )
 {
-    ipmi_msg_cfg *req_cfg = pvPortMalloc( sizeof( ipmi_msg_cfg ) );
+    ipmb_pending_req *entry;
+    ipmb_error ret;
+    TickType_t now;
+    ipmi_msg_cfg *req_cfg = ipmb_msg_alloc();
+
+    if ( req_cfg == NULL ) {
+        return ipmb_error_failure;
+    }
 
     /* Builds the message according to the IPMB specification */
 
@@ -254,24 +621,65 @@ ipmb_error ipmb_send_request ( ipmi_msg * req )
     req_cfg->buffer.dest_addr = MCH_ADDRESS;
     req_cfg->buffer.dest_LUN = 0;
     req_cfg->buffer.src_addr = ipmb_addr;
-    req_cfg->buffer.seq = current_seq++;
     req_cfg->buffer.src_LUN = 0;
     req_cfg->caller_task = xTaskGetCurrentTaskHandle();
     req_cfg->retries = 0;
 
+    /* Get a free slot in the pending table (this also assigns the sequence number) */
+    entry = ipmb_pending_add( &req_cfg->buffer, req );
+    if ( entry == NULL ) {
+        ipmb_msg_free( req_cfg );
+        return ipmb_error_failure;
+    }
+
     /* Blocks here until is able put message in tx queue */
     if (xQueueSend( ipmb_txqueue, &req_cfg, 1) != pdTRUE ){
-        vPortFree( req_cfg );
+        ipmb_pending_remove( entry );
+        ipmb_msg_free( req_cfg );
         return ipmb_error_failure;
     }
 
-    /* Use this notification to block the function while the response does not arrive */
-    return ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+    /* Wait for the TX task to put the message on the bus */
+    ret = ipmb_wait_tx();
+
+    taskENTER_CRITICAL();
+    if ( ret == ipmb_error_success ) {
+        entry->deadline = xTaskGetTickCount() + IPMB_MSG_TIMEOUT;
+        entry->armed = 1;
+    }
+    taskEXIT_CRITICAL();
+
+    if ( ret == ipmb_error_success ) {
+        /* The response may have arrived already, otherwise block until it's matched or the deadline expires */
+        while ( !entry->matched ) {
+            now = xTaskGetTickCount();
+            if ( (int32_t)(entry->deadline - now) <= 0 ) {
+                break;
+            }
+            task_notify_wait( NOTIFY_IPMB_RESPONSE, entry->deadline - now );
+        }
+        ret = entry->matched ? ipmb_error_success : ipmb_error_timeout;
+    }
+
+    ipmb_pending_remove( entry );
+
+    /* Once the entry is removed no response can be matched to it anymore. If it was matched before the loop had to
+     * wait (or right at the deadline) its notification is still set, and must not wake up the next request */
+    task_notify_wait( NOTIFY_IPMB_RESPONSE, 0 );
+
+    return ret;
 }
 
 ipmb_error ipmb_send_response ( ipmi_msg * req, ipmi_msg * resp )
 {
-    ipmi_msg_cfg *resp_cfg = pvPortMalloc( sizeof(ipmi_msg_cfg) );
+    uint32_t req_hash = ipmb_req_hash( req );
+    ipmi_msg_cfg *resp_cfg = ipmb_msg_alloc();
+
+    if ( resp_cfg == NULL ) {
+        /* Nothing will answer the request, let its retry reach the handler */
+        ipmb_inflight_remove( req->src_addr, req->seq, req->netfn, req->cmd, req_hash );
+        return ipmb_error_failure;
+    }
 
     /* Builds the message according to the IPMB specification */
 
@@ -288,35 +696,33 @@ ipmb_error ipmb_send_response ( ipmi_msg * req, ipmi_msg * resp )
     resp_cfg->buffer.cmd = req->cmd;
     resp_cfg->caller_task = xTaskGetCurrentTaskHandle();
     resp_cfg->retries = 0;
+    resp_cfg->req_hash = req_hash;
 
     /* Blocks here until is able put message in tx queue */
     if ( xQueueSend( ipmb_txqueue, &resp_cfg, portMAX_DELAY) != pdTRUE ){
-        vPortFree( resp_cfg );
+        ipmb_inflight_answered( resp_cfg );
+        ipmb_msg_free( resp_cfg );
         return ipmb_error_failure;
     }
 
-    /* Use this notification to block the function while the response does not arrive */
-    return ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+    /* Block the function until the response is sent */
+    return ipmb_wait_tx();
 }
 
 ipmb_error ipmb_notify_client ( ipmi_msg_cfg * msg_cfg )
 {
     configASSERT( client_queue );
     configASSERT( msg_cfg );
-    /* Sends only the ipmi msg, not the control struct */
-    if (!IS_RESPONSE(msg_cfg->buffer)) {
-        if ( xQueueSend( client_queue, &(msg_cfg->buffer), CLIENT_NOTIFY_TIMEOUT ) == pdFALSE ) {
-            /* This shouldn't happen, but if it does, clear the message buffer, since the IPMB_TX task gives us its ownership */
-            vPortFree( msg_cfg );
-            return ipmb_error_timeout;
-        }
-    }
-    if ( msg_cfg->caller_task ) {
-        xTaskNotifyGive( msg_cfg->caller_task );
-    }
 
-    /* The message has already been copied to the responsible task, free it so we don't run out of resources */
-    vPortFree( msg_cfg );
+    /* Only the pointer is queued, the client returns the slot to the pool once it's done with the request */
+    if ( xQueueSend( client_queue, &msg_cfg, CLIENT_NOTIFY_TIMEOUT ) == pdFALSE ) {
+        /* This shouldn't happen, but if it does, clear the message buffer, since the IPMB_RX task gives us its ownership.
+         * The request is dropped, so its retry must not be taken for a duplicate */
+        ipmb_inflight_remove( msg_cfg->buffer.src_addr, msg_cfg->buffer.seq, msg_cfg->buffer.netfn, msg_cfg->buffer.cmd,
+                              msg_cfg->req_hash );
+        ipmb_msg_free( msg_cfg );
+        return ipmb_error_timeout;
+    }
 
     return ipmb_error_success;
 }
@@ -325,7 +731,7 @@ ipmb_error ipmb_register_rxqueue ( QueueHandle_t * queue )
 {
     configASSERT( queue != NULL );
 
-    *queue = xQueueCreate( IPMB_CLIENT_QUEUE_LEN, sizeof( ipmi_msg ) );
+    *queue = xQueueCreate( IPMB_CLIENT_QUEUE_LEN, sizeof( ipmi_msg_cfg * ) );
     vQueueAddToRegistry(*queue, "ipmi_rx_queue");
     /* Copies the queue handler so we know where to write */
     client_queue = *queue;
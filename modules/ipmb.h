@@ -54,6 +54,11 @@
  */
 #define IPMB_CLIENT_QUEUE_LEN   2
 
+/**
+ * @brief Maximum count of received requests the client may keep at the same time (dispatcher and worker tasks)
+ */
+#define IPMB_CLIENT_MSG_HELD    5
+
 /**
  * @brief Maximum retries made by IPMB TX Task when sending a message
  */
@@ -64,6 +69,34 @@
  */
 #define IPMB_MSG_TIMEOUT        250/portTICK_PERIOD_MS
 
+/**
+ * @brief Maximum count of requests waiting for a response at the same time
+ */
+#define IPMB_MAX_PENDING_REQ    4
+
+/**
+ * @brief Number of #ipmi_msg_cfg slots in the static message pool
+ *
+ * Must cover the TX queue, one message per pending request, the client queue, the requests held by the client
+ * and the one being received
+ */
+#define IPMB_MSG_POOL_SIZE      (IPMB_TXQUEUE_LEN + IPMB_MAX_PENDING_REQ + IPMB_CLIENT_QUEUE_LEN + IPMB_CLIENT_MSG_HELD + 1)
+
+/**
+ * @brief Number of sent responses kept to answer retried requests
+ */
+#define IPMB_REPLAY_CACHE_LEN   4
+
+/**
+ * @brief Time window in which a request with the same (rqSA, seq, netfn, cmd) and data is considered a retry
+ */
+#define IPMB_REPLAY_WINDOW      (1000/portTICK_PERIOD_MS)
+
+/**
+ * @brief Number of received requests tracked until their response is sent, as many as the client may hold
+ */
+#define IPMB_INFLIGHT_LEN       (IPMB_CLIENT_QUEUE_LEN + IPMB_CLIENT_MSG_HELD)
+
 /**
  * @brief Timeout limit waiting a free space in client queue to put a received message
  */
@@ -180,8 +213,70 @@ typedef struct ipmi_msg_cfg {
     TaskHandle_t caller_task;           /**< Task to be notified when the send/receive process is done */
     uint8_t retries;                    /**< Current retry counter */
     uint32_t timestamp;                 /**< Tick count at the beginning of the process */
+    uint32_t rx_cycles;                 /**< Cycle counter when the request was decoded (used by the IPMI statistics) */
+    uint32_t req_hash;                  /**< Hash of the request data, on received requests and their responses (see #ipmb_replay_entry) */
 } ipmi_msg_cfg;
 
+/**
+ * @brief Outstanding request entry
+ *
+ * Every request sent by #ipmb_send_request is kept in a pending table until a response with the same
+ * (seq, netfn, cmd, dest_addr) arrives or its deadline expires.
+ */
+typedef struct ipmb_pending_req {
+    uint8_t in_use;                     /**< Entry is being used by a request */
+    uint8_t matched;                    /**< A valid response was received for this entry */
+    uint8_t armed;                      /**< Request was transmitted and #deadline is valid */
+    uint8_t seq;                        /**< Sequence number of the request */
+    uint8_t netfn;                      /**< Net Function of the request */
+    uint8_t cmd;                        /**< Command of the request */
+    uint8_t dest_addr;                  /**< Slave address the request was sent to */
+    TaskHandle_t caller_task;           /**< Task waiting for the response */
+    TickType_t deadline;                /**< Tick count after which a response is no longer accepted */
+    ipmi_msg *resp;                     /**< Where the response will be copied to */
+} ipmb_pending_req;
+
+/**
+ * @brief Message pool usage statistics
+ */
+typedef struct ipmb_pool_stats {
+    uint8_t in_use;                     /**< Slots currently allocated */
+    uint8_t high_water;                 /**< Maximum number of slots allocated at the same time */
+    uint32_t exhausted;                 /**< Number of allocations that failed because the pool was empty */
+} ipmb_pool_stats;
+
+/**
+ * @brief Response replay cache entry
+ */
+typedef struct ipmb_replay_entry {
+    ipmi_msg resp;                      /**< Response as it was sent (its header identifies the request) */
+    uint32_t req_hash;                  /**< Hash of the request data, the 6-bit seq alone wraps too quickly */
+    TickType_t timestamp;               /**< Tick count when the response was sent */
+    uint8_t valid;                      /**< Entry holds a response */
+} ipmb_replay_entry;
+
+/**
+ * @brief Received request whose response wasn't sent yet
+ */
+typedef struct ipmb_inflight_entry {
+    uint8_t src_addr;                   /**< Requester's slave address */
+    uint8_t seq;                        /**< Sequence number of the request */
+    uint8_t netfn;                      /**< Net Function of the request */
+    uint8_t cmd;                        /**< Command of the request */
+    uint32_t req_hash;                  /**< Hash of the request data */
+    TickType_t timestamp;               /**< Tick count when the request was received */
+    uint8_t valid;                      /**< Entry holds a request */
+} ipmb_inflight_entry;
+
+/**
+ * @brief Response replay cache counters
+ */
+typedef struct ipmb_replay_stats {
+    uint32_t hits;                      /**< Retried requests answered from the cache */
+    uint32_t misses;                    /**< Requests passed to the client */
+    uint32_t inflight;                  /**< Retried requests dropped because the first one was still being handled */
+} ipmb_replay_stats;
+
 /**
  * @brief IPMB errors enumeration
  */
@@ -233,9 +328,14 @@ void IPMB_TXTask ( void *pvParameters );
  * If the message is a request, we have to check if it's a new one or just a retransmission of the last. In order to do this, the sequential number is tested, since every request has a different one.<br>
  * Right after that, the arrival time and the message body are stored for future checking and the specified client is notified using #ipmb_notify_client.
  *
- * If we have received a response instead, we match it with the last stored request and also check if the awating request hasn't timed-out yet.
+ * If we have received a response instead, we look for a pending request with the same sequence number, netfn, command and address, check if its deadline hasn't expired yet and wake up the task waiting for it.
  *
- * @note When a malformed message, a response without a request or a repeated request are received, they are just ignored, following the IPMB specifications.
+ * A request that matches a response sent in the last #IPMB_REPLAY_WINDOW (same rqSA, seq, netfn, cmd and data) is a retry from the
+ * requester: the stored response (kept only once it was transmitted) is sent again and the client is not notified, so non-idempotent handlers don't run twice.
+ * Until its response is transmitted (or given up) a request is also kept in an in-flight table, and a retry that arrives
+ * meanwhile is dropped: the response to the first one answers it.
+ *
+ * @note When a malformed message or a response without a request are received, they are just ignored, following the IPMB specifications.
  *
  * @param pvParameters: Default parameter to FreeRTOS tasks, not used here.
  * @see IPMB_TXTask
@@ -252,6 +352,15 @@ void ipmb_init ( void );
 
 /**
  * @brief Format and send a request via IPMB channel
+ *
+ * The request is registered in the pending table and the calling task blocks until the matching response is received
+ * or #IPMB_MSG_TIMEOUT expires. Several tasks may have requests in flight at the same time.
+ *
+ * @param[in,out] req Request to be sent. When a response is received, it's copied over this struct.
+ *
+ * @retval ipmb_error_success The response was received and copied to \p req
+ * @retval ipmb_error_timeout The request was sent, but no response arrived in time
+ * @retval ipmb_error_failure The request couldn't be sent or the pending table is full
  */
 ipmb_error ipmb_send_request ( ipmi_msg * req );
 
@@ -260,10 +369,41 @@ ipmb_error ipmb_send_request ( ipmi_msg * req );
  */
 ipmb_error ipmb_send_response ( ipmi_msg * req, ipmi_msg * resp );
 
+/**
+ * @brief Takes a message slot from the static IPMB pool
+ *
+ * Constant time and safe to be called from tasks and interrupts.
+ *
+ * @return Pointer to a free #ipmi_msg_cfg or NULL if the pool is exhausted
+ */
+ipmi_msg_cfg * ipmb_msg_alloc ( void );
+
+/**
+ * @brief Returns a message slot to the static IPMB pool
+ *
+ * @param msg_cfg Slot obtained from #ipmb_msg_alloc (NULL is ignored)
+ */
+void ipmb_msg_free ( ipmi_msg_cfg * msg_cfg );
+
+/**
+ * @brief Reads the message pool usage counters
+ *
+ * @param[out] stats Pointer to the struct to be filled
+ */
+void ipmb_pool_get_stats ( ipmb_pool_stats * stats );
+
+/**
+ * @brief Reads the response replay cache counters
+ *
+ * @param[out] stats Pointer to the struct to be filled
+ */
+void ipmb_replay_get_stats ( ipmb_replay_stats * stats );
+
 /**
  * @brief Creates and returns a queue in which the client can block to receive the incoming requests.
  *
  * The queue is created and its handler is written at the given pointer (queue).
+ * Its items are pointers to #ipmi_msg_cfg slots of the message pool, which must be given back with #ipmb_msg_free.
  * Also keeps a copy of the handler to know where to write the incoming messages.
  *
  * @param queue Pointer to a QueueHandle_t variable which will be written by this function.
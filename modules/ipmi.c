@@ -32,12 +32,15 @@
 
 /* Project includes */
 #include "FreeRTOS.h"
+#include "semphr.h"
 #include "ipmi.h"
 #include "port.h"
 #include "task_priorities.h"
 #include "led.h"
 #include "payload.h"
 #include "uart_debug.h"
+#include "ipmi_stats.h"
+#include "task_notify.h"
 
 /* Local variables */
 /**
@@ -55,46 +58,274 @@ volatile const t_req_handler_record *ipmiEntries = (t_req_handler_record *) &_ip
  */
 volatile const t_req_handler_record *ipmiEntries_end = (t_req_handler_record *) &_eipmi_handlers;
 
+/**
+ * @brief Netfns indexed by a dense row in #dispatch_dense
+ */
+static const uint8_t dispatch_dense_netfn[] = { NETFN_APP, NETFN_SE, NETFN_STORAGE, NETFN_GRPEXT };
+
+#define DISPATCH_DENSE_ROWS     (sizeof(dispatch_dense_netfn)/sizeof(dispatch_dense_netfn[0]))
+
+/* Dense row (+1) of each netfn, 0 when the netfn has no row */
+static uint8_t dispatch_row[64];
+/* Handler record index (+1) of each command, 0 when there's no handler */
+static uint8_t dispatch_dense[DISPATCH_DENSE_ROWS][IPMI_DISPATCH_DENSE_CMDS];
+/* Record indexes of handlers that didn't fit in the dense rows */
+static uint8_t dispatch_fallback[IPMI_DISPATCH_MAX_FALLBACK];
+static uint8_t dispatch_fallback_cnt;
+
+/* Slow handlers of the same netfn share the state of their module (HPM upload, FRU writes, OEM bus sequences),
+ * each netfn has a lock so that two workers never run them at the same time */
+static struct {
+    uint8_t netfn;
+    SemaphoreHandle_t lock;
+} slow_netfn_lock[IPMI_SLOW_NETFN_MAX];
+static uint8_t slow_netfn_cnt;
+
+static SemaphoreHandle_t ipmi_slow_lock( uint8_t netfn )
+{
+    uint8_t i;
+
+    for ( i = 0; i < slow_netfn_cnt; i++ ) {
+        if ( slow_netfn_lock[i].netfn == netfn ) {
+            return slow_netfn_lock[i].lock;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Builds the two-level dispatch index from the .ipmi_handlers section
+ *
+ * Must be called before any request is dispatched. Duplicated netfn/cmd registrations trigger an assert.
+ */
+static void ipmi_dispatch_init( void )
+{
+    const t_req_handler_record *records = (const t_req_handler_record *) ipmiEntries;
+    uint32_t count = ipmiEntries_end - ipmiEntries;
+    uint8_t row;
+    uint32_t i;
+
+    /* Indexes are stored in a byte */
+    configASSERT( count < 0xFF );
+
+    for ( i = 0; i < DISPATCH_DENSE_ROWS; i++ ) {
+        dispatch_row[dispatch_dense_netfn[i]] = i + 1;
+    }
+
+    for ( i = 0; i < count; i++ ) {
+        /* Duplicated netfn/cmd pair, only the first one would ever be called */
+        configASSERT( ipmi_retrieve_handler( records[i].netfn, records[i].cmd ) == 0 );
+
+        row = (records[i].netfn < 64) ? dispatch_row[records[i].netfn] : 0;
+
+        if ( row && (records[i].cmd < IPMI_DISPATCH_DENSE_CMDS) ) {
+            dispatch_dense[row-1][records[i].cmd] = i + 1;
+        } else {
+            configASSERT( dispatch_fallback_cnt < IPMI_DISPATCH_MAX_FALLBACK );
+            dispatch_fallback[dispatch_fallback_cnt++] = i;
+        }
+
+        if ( (records[i].flags & IPMI_HANDLER_FLAG_SLOW) && (ipmi_slow_lock( records[i].netfn ) == NULL) ) {
+            configASSERT( slow_netfn_cnt < IPMI_SLOW_NETFN_MAX );
+            slow_netfn_lock[slow_netfn_cnt].netfn = records[i].netfn;
+            slow_netfn_lock[slow_netfn_cnt].lock = xSemaphoreCreateMutex();
+            slow_netfn_cnt++;
+        }
+    }
+}
+
+/**
+ * @brief Slow request waiting for (or being handled by) a worker
+ */
+typedef struct {
+    ipmi_msg_cfg *req_cfg;
+    t_req_handler req_handler;
+    SemaphoreHandle_t lock;         /* Lock of the netfn */
+} ipmi_job_t;
+
+static QueueHandle_t ipmi_worker_queue = NULL;
+
+/* Requests handed to the worker pool, used to recognize retransmissions of a request still being handled */
+static struct {
+    uint8_t in_use;
+    uint8_t src_addr;
+    uint8_t seq;
+    uint8_t netfn;
+    uint8_t cmd;
+} ipmi_jobs_inflight[IPMI_WORKER_COUNT + IPMI_WORKER_QUEUE_LEN];
+
+#define IPMI_JOBS_INFLIGHT_CNT  (sizeof(ipmi_jobs_inflight)/sizeof(ipmi_jobs_inflight[0]))
+
+static int ipmi_job_find( ipmi_msg * req )
+{
+    uint8_t i;
+
+    for ( i = 0; i < IPMI_JOBS_INFLIGHT_CNT; i++ ) {
+        if ( ipmi_jobs_inflight[i].in_use && (ipmi_jobs_inflight[i].src_addr == req->src_addr) &&
+             (ipmi_jobs_inflight[i].seq == req->seq) && (ipmi_jobs_inflight[i].netfn == req->netfn) &&
+             (ipmi_jobs_inflight[i].cmd == req->cmd) ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Registers a new slow request, returns false if it's already being handled or if there's no room for it */
+static bool ipmi_job_add( ipmi_msg * req )
+{
+    uint8_t i;
+    bool added = false;
+
+    taskENTER_CRITICAL();
+    if ( ipmi_job_find( req ) < 0 ) {
+        for ( i = 0; i < IPMI_JOBS_INFLIGHT_CNT; i++ ) {
+            if ( !ipmi_jobs_inflight[i].in_use ) {
+                ipmi_jobs_inflight[i].in_use = 1;
+                ipmi_jobs_inflight[i].src_addr = req->src_addr;
+                ipmi_jobs_inflight[i].seq = req->seq;
+                ipmi_jobs_inflight[i].netfn = req->netfn;
+                ipmi_jobs_inflight[i].cmd = req->cmd;
+                added = true;
+                break;
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return added;
+}
+
+static void ipmi_job_remove( ipmi_msg * req )
+{
+    int i;
+
+    taskENTER_CRITICAL();
+    i = ipmi_job_find( req );
+    if ( i >= 0 ) {
+        ipmi_jobs_inflight[i].in_use = 0;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/* Runs the handler and sends its response. The response is correlated to the request by ipmb_send_response, which copies its seq */
+static void ipmi_handle_request( ipmi_msg_cfg * req_cfg, t_req_handler req_handler )
+{
+    ipmi_msg *req = &req_cfg->buffer;
+    ipmi_msg response;
+    ipmb_error error_code;
+    uint32_t start, end;
+
+    response.completion_code = IPMI_CC_UNSPECIFIED_ERROR;
+    response.data_len = 0;
+
+    start = cycle_counter_read();
+
+    /// Call user-defined function, give request data and retrieve required response
+    req_handler(req, &response);
+
+    end = cycle_counter_read();
+    ipmi_stats_request( req->netfn, req->cmd, response.completion_code, start - req_cfg->rx_cycles, end - start );
+
+    error_code = ipmb_send_response(req, &response);
+
+    /** In case of error during IPMB response, the MMC may wait for a
+        new command from the MCH. Check this for debugging purposes
+        only. */
+    configASSERT( (error_code == ipmb_error_success) );
+}
+
+/**
+ * @brief IPMI worker task
+ *
+ * Runs the handlers registered with #IPMI_HANDLER_SLOW, so the dispatcher is free to answer other requests meanwhile
+ */
+static void IPMIWorkerTask( void * pvParameters )
+{
+    ipmi_job_t job;
+
+    for ( ;; ) {
+        if ( xQueueReceive( ipmi_worker_queue, &job, portMAX_DELAY ) == pdFALSE ) {
+            continue;
+        }
+
+        xSemaphoreTake( job.lock, portMAX_DELAY );
+        ipmi_handle_request( job.req_cfg, job.req_handler );
+        xSemaphoreGive( job.lock );
+
+        ipmi_job_remove( &job.req_cfg->buffer );
+        ipmb_msg_free( job.req_cfg );
+    }
+}
+
 void IPMITask( void * pvParameters )
 {
-    ipmi_msg req_received;
+    ipmi_msg_cfg *req_cfg;
+    ipmi_msg *req_received;
     ipmi_msg response;
     ipmb_error error_code;
-    t_req_handler req_handler = (t_req_handler) 0;
+    const t_req_handler_record *record;
+    ipmi_job_t job;
+    bool inflight;
 
     for ( ;; ) {
 
-        if( xQueueReceive( ipmi_rxqueue, &req_received , portMAX_DELAY ) == pdFALSE) {
+        /* The IPMB layer gives us a pointer to the request, which is ours until it's freed */
+        if( xQueueReceive( ipmi_rxqueue, &req_cfg , portMAX_DELAY ) == pdFALSE) {
             /* Should no return pdFALSE */
             configASSERT(pdFALSE);
             continue;
         }
+        req_received = &req_cfg->buffer;
 #if 0
         printf(" IPMI Message Received: \n ");
-        printf(" \tNETFn: 0x%X\tCMD: 0x%X\t Data: ", req_received.netfn, req_received.cmd);
-        for (int i=0; i < req_received.data_len; i++) {
-            printf("0x%X ", req_received.data[i]);
+        printf(" \tNETFn: 0x%X\tCMD: 0x%X\t Data: ", req_received->netfn, req_received->cmd);
+        for (int i=0; i < req_received->data_len; i++) {
+            printf("0x%X ", req_received->data[i]);
         }
         printf("\n");
 #endif
-        req_handler = (t_req_handler) 0;
-        req_handler = ipmi_retrieve_handler(req_received.netfn, req_received.cmd);
-
-        if (req_handler != 0) {
+        record = ipmi_retrieve_record(req_received->netfn, req_received->cmd);
+
+        if (record != NULL) {
+
+            if (record->flags & IPMI_HANDLER_FLAG_SLOW) {
+                /* A retransmission of a request that is still being handled is dropped, the worker will answer it.
+                 * The lookup is done under the same lock as the updates, which are made by the workers too */
+                taskENTER_CRITICAL();
+                inflight = (ipmi_job_find(req_received) >= 0);
+                taskEXIT_CRITICAL();
+
+                if (inflight) {
+                    ipmb_msg_free(req_cfg);
+                    continue;
+                }
+
+                /* The worker takes over the request buffer */
+                job.req_cfg = req_cfg;
+                job.req_handler = record->req_handler;
+                job.lock = ipmi_slow_lock(req_received->netfn);
+
+                if (ipmi_job_add(req_received)) {
+                    if (xQueueSend(ipmi_worker_queue, &job, 0) == pdTRUE) {
+                        continue;
+                    }
+                    ipmi_job_remove(req_received);
+                }
+
+                /* All workers are busy, let the MCH retry later */
+                response.completion_code = IPMI_CC_NODE_BUSY;
+                response.data_len = 0;
+                ipmi_stats_request(req_received->netfn, req_received->cmd, response.completion_code,
+                                   cycle_counter_read() - req_cfg->rx_cycles, 0);
+                error_code = ipmb_send_response(req_received, &response);
+
+                configASSERT((error_code == ipmb_error_success));
+                ipmb_msg_free(req_cfg);
+                continue;
+            }
 
-            response.completion_code = IPMI_CC_UNSPECIFIED_ERROR;
-            response.data_len = 0;
-
-            /// Call user-defined function, give request data and retrieve required response
             /** @warning Since IPMI task have a high priority, this handler function should not wait other tasks to unblock */
-            req_handler(&req_received, &response);
-
-            error_code = ipmb_send_response(&req_received, &response);
-
-            /** In case of error during IPMB response, the MMC may wait for a
-               new command from the MCH. Check this for debugging purposes
-               only. */
-            configASSERT( (error_code == ipmb_error_success) );
+            ipmi_handle_request(req_cfg, record->req_handler);
 
         } else {
             /** If there is no function handler, use data from received
@@ -103,20 +334,72 @@ void IPMITask( void * pvParameters )
 
             response.completion_code = IPMI_CC_INV_CMD;
             response.data_len = 0;
-            error_code = ipmb_send_response(&req_received, &response);
+            ipmi_stats_request(req_received->netfn, req_received->cmd, response.completion_code,
+                               cycle_counter_read() - req_cfg->rx_cycles, 0);
+            error_code = ipmb_send_response(req_received, &response);
 
             configASSERT((error_code == ipmb_error_success));
         }
+
+        ipmb_msg_free(req_cfg);
     }
 }
 
 TaskHandle_t TaskIPMI_Handle;
+static TaskHandle_t TaskIPMIEvent_Handle;
+
+static void IPMIEventTask( void * pvParameters );
 
 void ipmi_init ( void )
 {
+    uint8_t i;
+
+    ipmi_dispatch_init();
+    ipmi_stats_init();
     ipmb_init();
     ipmb_register_rxqueue( &ipmi_rxqueue );
     xTaskCreate( IPMITask, (const char*)"IPMI Dispatcher", 100, ( void * ) NULL, tskIPMI_PRIORITY, &TaskIPMI_Handle );
+
+    xTaskCreate( IPMIEventTask, (const char*)"IPMI Event", 100, ( void * ) NULL, tskIPMI_EVENT_PRIORITY, &TaskIPMIEvent_Handle );
+
+    ipmi_worker_queue = xQueueCreate( IPMI_WORKER_QUEUE_LEN, sizeof(ipmi_job_t) );
+    vQueueAddToRegistry( ipmi_worker_queue, "IPMI Worker Queue" );
+    for ( i = 0; i < IPMI_WORKER_COUNT; i++ ) {
+        xTaskCreate( IPMIWorkerTask, (const char*)"IPMI Worker", 100, ( void * ) NULL, tskIPMI_HANDLERS_PRIORITY, ( TaskHandle_t * ) NULL );
+    }
+}
+
+/**
+ * @brief Finds the handler record associated with a given netfunction and command.
+ *
+ * Standard netfns are resolved with a single table lookup, OEM ones with a short search in the fallback list.
+ *
+ * @param[in] netfn 8-bit network function code
+ * @param[in] cmd 8-bit command code
+ *
+ * @return Pointer to the handler record, as defined in the netfn handler list, or NULL if there's none.
+ */
+const t_req_handler_record * ipmi_retrieve_record( uint8_t netfn, uint8_t cmd )
+{
+    const t_req_handler_record *records = (const t_req_handler_record *) ipmiEntries;
+    uint8_t row, index;
+    uint8_t i;
+
+    row = (netfn < 64) ? dispatch_row[netfn] : 0;
+
+    if ( row && (cmd < IPMI_DISPATCH_DENSE_CMDS) ) {
+        index = dispatch_dense[row-1][cmd];
+        return ( index ? &records[index-1] : NULL );
+    }
+
+    for ( i = 0; i < dispatch_fallback_cnt; i++ ) {
+        index = dispatch_fallback[i];
+        if ( (records[index].netfn == netfn) && (records[index].cmd == cmd) ) {
+            return &records[index];
+        }
+    }
+
+    return NULL;
 }
 
 /**
@@ -129,53 +412,171 @@ void ipmi_init ( void )
  */
 t_req_handler ipmi_retrieve_handler( uint8_t netfn, uint8_t cmd )
 {
-    t_req_handler handler = 0;
-    t_req_handler_record * p_ptr = (t_req_handler_record *) ipmiEntries;
-
-    while (p_ptr < ipmiEntries_end) {
-        if( (p_ptr->netfn == netfn) &&   \
-            (p_ptr->cmd == cmd)) {
-            handler = p_ptr->req_handler;
-            break;
-        }
-        p_ptr++;
-    }
+    const t_req_handler_record *record = ipmi_retrieve_record( netfn, cmd );
 
-    return handler;
+    return ( record ? record->req_handler : 0 );
 }
 
 /**
- * @brief Sends an event message via IPMB interface
+ * @brief Platform event waiting in the outbox
+ */
+typedef struct {
+    uint8_t in_use;
+    uint8_t sending;                    /* Being sent by the event task, can't be coalesced anymore */
+    uint8_t retries;
+    uint8_t data[7];                    /* Platform Event request data */
+    uint32_t order;                     /* Enqueue order, events are delivered FIFO */
+    TickType_t next_try;
+} ipmi_event_entry_t;
+
+static ipmi_event_entry_t event_outbox[IPMI_EVENT_OUTBOX_LEN];
+static uint32_t event_order;
+
+#define EVENT_SENSOR_NUM(e)     ((e)->data[2])
+#define EVENT_DIR(e)            ((e)->data[3] & DEASSERTION_EVENT)
+#define EVENT_OFFSET(e)         ((e)->data[4] & 0x0F)
+
+/**
+ * @brief Puts an event message in the outbox
  *
  * @param[in] sensor Pointer to sensor structure defined in sensor.h
  * @param[in] assert_deassert Flag to indicate an (de)assertion event
  * @param[in] evData Data buffer holding the event data, size indicated by \p length
  * @param[in] length Lenght of \p evData buffer
  *
- * @return ipmb_error return value from #ipmb_send_request
- *
- * @see ipmb_send_request()
+ * @return ipmb_error_success if the event was queued or coalesced, ipmb_error_failure if the outbox is full
  */
 ipmb_error ipmi_event_send( sensor_t * sensor, uint8_t assert_deassert, uint8_t *evData, uint8_t length)
 {
-    ipmi_msg evt;
+    ipmi_event_entry_t new_evt, *entry, *free_entry = NULL;
+    ipmb_error ret = ipmb_error_failure;
     uint8_t data_len = 0;
+    uint8_t i;
 
-    evt.dest_LUN = 0;
-    evt.netfn = NETFN_SE;
-    evt.cmd = IPMI_PLATFORM_EVENT_CMD;
+    new_evt.data[data_len++] = IPMI_EVENT_MESSAGE_REV;
+    new_evt.data[data_len++] = GET_SENSOR_TYPE(sensor);
+    new_evt.data[data_len++] = sensor->num;
+    new_evt.data[data_len++] = assert_deassert | (GET_EVENT_TYPE_CODE(sensor) & 0x7F);
+    new_evt.data[data_len++] = (length >= 1)? evData[0] : 0xFF;
+    new_evt.data[data_len++] = (length >= 2)? evData[1] : 0xFF;
+    new_evt.data[data_len++] = (length >= 3)? evData[2] : 0xFF;
 
-    evt.data[data_len++] = IPMI_EVENT_MESSAGE_REV;
-    evt.data[data_len++] = GET_SENSOR_TYPE(sensor);
-    evt.data[data_len++] = sensor->num;
-    evt.data[data_len++] = assert_deassert | (GET_EVENT_TYPE_CODE(sensor) & 0x7F);
-    evt.data[data_len++] = (length >= 1)? evData[0] : 0xFF;
-    evt.data[data_len++] = (length >= 2)? evData[1] : 0xFF;
-    evt.data[data_len++] = (length >= 3)? evData[2] : 0xFF;
+    taskENTER_CRITICAL();
 
-    evt.data_len = data_len;
+    for ( i = 0; i < IPMI_EVENT_OUTBOX_LEN; i++ ) {
+        entry = &event_outbox[i];
 
-    return (ipmb_send_request( &evt ));
+        if ( !entry->in_use ) {
+            if ( free_entry == NULL ) {
+                free_entry = entry;
+            }
+            continue;
+        }
+
+        if ( entry->sending || (EVENT_SENSOR_NUM(entry) != EVENT_SENSOR_NUM(&new_evt)) ||
+             (EVENT_OFFSET(entry) != EVENT_OFFSET(&new_evt)) ) {
+            continue;
+        }
+
+        if ( EVENT_DIR(entry) != EVENT_DIR(&new_evt) ) {
+            /* The new event undoes the one still waiting, none of them has to be sent */
+            entry->in_use = 0;
+        } else {
+            /* Same transition queued twice, keep only the newest one (and its place in the delivery order) */
+            memcpy( entry->data, new_evt.data, sizeof(entry->data) );
+            entry->order = event_order++;
+        }
+        free_entry = NULL;
+        ret = ipmb_error_success;
+        break;
+    }
+
+    if ( free_entry ) {
+        memcpy( free_entry->data, new_evt.data, sizeof(free_entry->data) );
+        free_entry->sending = 0;
+        free_entry->retries = 0;
+        free_entry->order = event_order++;
+        free_entry->next_try = xTaskGetTickCount();
+        free_entry->in_use = 1;
+        ret = ipmb_error_success;
+    }
+
+    taskEXIT_CRITICAL();
+
+    if ( free_entry && TaskIPMIEvent_Handle ) {
+        task_notify( TaskIPMIEvent_Handle, NOTIFY_IPMI_EVENT );
+    }
+
+    return ret;
+}
+
+/**
+ * @brief IPMI event delivery task
+ *
+ * Sends the events queued by #ipmi_event_send in order, waiting for the MCH acknowledge of each one.
+ * An event that fails is retried after a backoff delay, so a slow or absent event receiver never blocks the sensor tasks.
+ */
+static void IPMIEventTask( void * pvParameters )
+{
+    ipmi_event_entry_t *entry, *next;
+    ipmi_msg evt;
+    TickType_t now, wait, backoff;
+    uint8_t i;
+
+    for ( ;; ) {
+        next = NULL;
+        wait = portMAX_DELAY;
+        now = xTaskGetTickCount();
+
+        /* Look for the oldest event whose retry time has come */
+        taskENTER_CRITICAL();
+        for ( i = 0; i < IPMI_EVENT_OUTBOX_LEN; i++ ) {
+            entry = &event_outbox[i];
+            if ( !entry->in_use ) {
+                continue;
+            }
+            if ( (int32_t)(entry->next_try - now) > 0 ) {
+                if ( (entry->next_try - now) < wait ) {
+                    wait = entry->next_try - now;
+                }
+                continue;
+            }
+            if ( (next == NULL) || ((int32_t)(entry->order - next->order) < 0) ) {
+                next = entry;
+            }
+        }
+        if ( next ) {
+            next->sending = 1;
+        }
+        taskEXIT_CRITICAL();
+
+        if ( next == NULL ) {
+            task_notify_wait( NOTIFY_IPMI_EVENT, wait );
+            continue;
+        }
+
+        evt.dest_LUN = 0;
+        evt.netfn = NETFN_SE;
+        evt.cmd = IPMI_PLATFORM_EVENT_CMD;
+        memcpy( evt.data, next->data, sizeof(next->data) );
+        evt.data_len = sizeof(next->data);
+
+        if ( ipmb_send_request( &evt ) == ipmb_error_success ) {
+            next->in_use = 0;
+        } else {
+            backoff = IPMI_EVENT_BACKOFF_MIN << ((next->retries < 8) ? next->retries : 8);
+            if ( backoff > IPMI_EVENT_BACKOFF_MAX ) {
+                backoff = IPMI_EVENT_BACKOFF_MAX;
+            }
+            if ( next->retries < 0xFF ) {
+                next->retries++;
+            }
+            taskENTER_CRITICAL();
+            next->next_try = xTaskGetTickCount() + backoff;
+            next->sending = 0;
+            taskEXIT_CRITICAL();
+        }
+    }
 }
 
 /**
@@ -186,6 +186,24 @@
  * @}
  */
 
+/**
+ * @defgroup IPMI_CUSTOM_CMD IPMI Commands - Custom (0x32)
+ * @{
+ */
+/* Diagnostics commands, common to all boards */
+#define IPMI_CUSTOM_CMD_GET_CMD_STATS                           0x00
+#define IPMI_CUSTOM_CMD_GET_LATENCY_HIST                        0x01
+#define IPMI_CUSTOM_CMD_RESET_IPMI_STATS                        0x02
+#define IPMI_CUSTOM_CMD_GET_SENSOR_RATES                        0x03
+#define IPMI_CUSTOM_CMD_GET_SENSOR_HISTORY                      0x04
+#define IPMI_CUSTOM_CMD_GET_SENSOR_STATS                        0x05
+#define IPMI_CUSTOM_CMD_GET_I2C_STATS                           0x06
+#define IPMI_CUSTOM_CMD_GET_I2C_HEALTH                          0x07
+#define IPMI_CUSTOM_CMD_GET_ALERT_LATENCY                       0x08
+/**
+ * @}
+ */
+
 /**
  * @defgroup IPMI_CHASSIS_CMD IPMI Commands - Chassis (0x00)
  * @ingroup IPMI_CMD
@@ -509,6 +527,52 @@
 #define FRU_CTLCODE_DIAGNOSTIC_INTERRUPT                        0x03
 #define FRU_CTLCODE_QUIESCE                                     0x04
 
+/**
+ * @brief Number of commands covered by each dense row of the dispatch index
+ *
+ * Handlers with a command code above this limit are looked up in the fallback list
+ */
+#define IPMI_DISPATCH_DENSE_CMDS                                0x40
+
+/**
+ * @brief Maximum count of handlers that can't be placed in the dense rows (OEM netfns)
+ */
+#define IPMI_DISPATCH_MAX_FALLBACK                              16
+
+/**
+ * @brief Number of worker tasks running slow handlers (max. slow requests being handled at the same time)
+ */
+#define IPMI_WORKER_COUNT                                       2
+
+/**
+ * @brief Maximum count of netfns with slow handlers (each one has its own lock)
+ */
+#define IPMI_SLOW_NETFN_MAX                                     4
+
+/**
+ * @brief Maximum count of slow requests waiting for a free worker
+ */
+#define IPMI_WORKER_QUEUE_LEN                                   2
+
+/**
+ * @brief Maximum count of platform events waiting to be delivered
+ */
+#define IPMI_EVENT_OUTBOX_LEN                                   8
+
+/**
+ * @brief Delay before the first retry of an event that wasn't acknowledged (doubled on each new failure)
+ */
+#define IPMI_EVENT_BACKOFF_MIN                                  (50/portTICK_PERIOD_MS)
+
+/**
+ * @brief Maximum delay between retries of an event
+ */
+#define IPMI_EVENT_BACKOFF_MAX                                  (2000/portTICK_PERIOD_MS)
+
+#if (IPMB_CLIENT_MSG_HELD < (1 + IPMI_WORKER_COUNT + IPMI_WORKER_QUEUE_LEN))
+#error "IPMB_CLIENT_MSG_HELD must account for the dispatcher, the workers and the worker queue"
+#endif
+
 /**
  * @brief IPMI Handler function type definition
  *
@@ -522,9 +586,15 @@ typedef void (* t_req_handler)(ipmi_msg * req, ipmi_msg * resp);
 typedef struct{
     uint8_t netfn;                 /**< Net Function */
     uint8_t cmd;                   /**< Command */
+    uint8_t flags;                 /**< Handler flags (IPMI_HANDLER_FLAG_*) */
     t_req_handler req_handler;     /**< IPMI handler function */
 } t_req_handler_record;
 
+/**
+ * @brief Handler touches slow hardware and is run by the worker pool instead of the dispatcher task
+ */
+#define IPMI_HANDLER_FLAG_SLOW                                  (1 << 0)
+
 /**
  * @brief Pointer to IPMI Handler record list start byte stored in ROM
  */
@@ -550,12 +620,27 @@ extern const t_req_handler_record *_eipmi_handlers;
  *       _eipmi_handlers = .;
  * } >FLASHAREA
  * @endcode
+ *
+ * @note Registering the same netfn/cmd pair with the same tokens fails at link time, since the record symbol would be
+ * defined twice. Pairs that only have the same value are caught by #ipmi_init when the dispatch index is built.
  */
 #define IPMI_HANDLER(name, netfn_id, cmd_id, args...)                   \
     void ipmi_handler_##netfn_id##__##cmd_id##_f(args);                 \
     const t_req_handler_record __attribute__ ((section (".ipmi_handlers"))) ipmi_handler_##netfn_id##__##cmd_id##_s = { .req_handler = ipmi_handler_##netfn_id##__##cmd_id##_f , .netfn = netfn_id, .cmd = cmd_id }; \
     void ipmi_handler_##netfn_id##__##cmd_id##_f(args)
 
+/**
+ * @brief Same as #IPMI_HANDLER, but for handlers that may take long to complete (slow buses, flash programming)
+ *
+ * These requests are handed to a pool of #IPMI_WORKER_COUNT worker tasks, so they don't delay the ones queued behind them.
+ * Slow handlers of the same netfn are never run at the same time, so the state of their module needs no extra locking
+ * against each other. State that is also used by the fast handlers (run by the dispatcher) must still be protected.
+ */
+#define IPMI_HANDLER_SLOW(name, netfn_id, cmd_id, args...)              \
+    void ipmi_handler_##netfn_id##__##cmd_id##_f(args);                 \
+    const t_req_handler_record __attribute__ ((section (".ipmi_handlers"))) ipmi_handler_##netfn_id##__##cmd_id##_s = { .req_handler = ipmi_handler_##netfn_id##__##cmd_id##_f , .netfn = netfn_id, .cmd = cmd_id, .flags = IPMI_HANDLER_FLAG_SLOW }; \
+    void ipmi_handler_##netfn_id##__##cmd_id##_f(args)
+
 /* Function Prototypes */
 
 /**
@@ -571,13 +656,16 @@ void IPMITask ( void *pvParameters );
 /**
  * @brief Initializes the IPMI Dispatcher
  *
- * This function initializes the IPMB Layer, registers the RX queue for incoming requests and creates the IPMI task
+ * This function builds the netfn/cmd dispatch index from the .ipmi_handlers section, initializes the IPMB Layer,
+ * registers the RX queue for incoming requests and creates the IPMI task
  */
 void ipmi_init ( void );
 
 /**
  * @brief Finds a handler associated with a given netfunction and command.
  *
+ * Standard netfns are resolved with a single table lookup, OEM ones with a short search in the fallback list.
+ *
  * @param netfn 8-bit network function code
  * @param cmd 8-bit command code
  *
@@ -586,14 +674,29 @@ void ipmi_init ( void );
 t_req_handler ipmi_retrieve_handler(uint8_t netfn, uint8_t cmd);
 
 /**
- * @brief Sends an event message (Platform Event) via IPMI
+ * @brief Finds the handler record (function and flags) associated with a given netfunction and command.
+ *
+ * @param netfn 8-bit network function code
+ * @param cmd 8-bit command code
+ *
+ * @return Pointer to the handler record or NULL if the command is not implemented
+ */
+const t_req_handler_record * ipmi_retrieve_record(uint8_t netfn, uint8_t cmd);
+
+/**
+ * @brief Queues an event message (Platform Event) to be sent via IPMI
+ *
+ * This function never blocks: the event is put in an outbox and delivered by the IPMI Event task, which retries it with
+ * an exponential backoff until the MCH acknowledges it. If an event for the same sensor and offset, but in the opposite
+ * direction, is still waiting in the outbox, both are dropped since the second one supersedes the first.
  *
  * @param sensor          Pointer to sensor information struct
  * @param assert_deassert Evetn transition direction (0) for assertion, (1) for Deassertion
  * @param evData          Pointer to event message buffer
  * @param length          Event message buffer len (max len = 3)
  *
- * @return ipmb_error
+ * @retval ipmb_error_success The event was queued (or coalesced with a pending one)
+ * @retval ipmb_error_failure The outbox is full
  *
  * @see sdr.h
  * @see ipmb.h
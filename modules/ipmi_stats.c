@@ -0,0 +1,251 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Project Includes */
+#include "port.h"
+#include "ipmi.h"
+#include "ipmi_stats.h"
+#include "string.h"
+
+/* Local Variables */
+
+/* Commands are given a slot the first time they are seen, the last slot collects everything that doesn't fit */
+static struct {
+    uint8_t netfn;
+    uint8_t cmd;
+    ipmi_cmd_stats stats;
+} cmd_stats[IPMI_STATS_MAX_CMDS];
+static uint8_t cmd_stats_count;
+
+static uint32_t latency_hist[IPMI_STATS_PHASES][IPMI_STATS_HIST_BUCKETS];
+
+static uint8_t hist_bucket( uint32_t cycles )
+{
+    uint8_t bucket = 0;
+
+    while ( (cycles >>= 1) && (bucket < IPMI_STATS_HIST_BUCKETS-1) ) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static ipmi_cmd_stats * cmd_stats_slot( uint8_t netfn, uint8_t cmd )
+{
+    uint8_t i;
+
+    for ( i = 0; i < cmd_stats_count; i++ ) {
+        if ( (cmd_stats[i].netfn == netfn) && (cmd_stats[i].cmd == cmd) ) {
+            return &cmd_stats[i].stats;
+        }
+    }
+
+    if ( cmd_stats_count < IPMI_STATS_MAX_CMDS-1 ) {
+        cmd_stats[cmd_stats_count].netfn = netfn;
+        cmd_stats[cmd_stats_count].cmd = cmd;
+        return &cmd_stats[cmd_stats_count++].stats;
+    }
+
+    /* Overflow slot, reported as netfn/cmd 0xFF */
+    return &cmd_stats[IPMI_STATS_MAX_CMDS-1].stats;
+}
+
+void ipmi_stats_reset( void )
+{
+    taskENTER_CRITICAL();
+    memset( cmd_stats, 0, sizeof(cmd_stats) );
+    cmd_stats[IPMI_STATS_MAX_CMDS-1].netfn = 0xFF;
+    cmd_stats[IPMI_STATS_MAX_CMDS-1].cmd = 0xFF;
+    cmd_stats_count = 0;
+    memset( latency_hist, 0, sizeof(latency_hist) );
+    taskEXIT_CRITICAL();
+}
+
+void ipmi_stats_init( void )
+{
+    cycle_counter_init();
+    ipmi_stats_reset();
+}
+
+void ipmi_stats_request( uint8_t netfn, uint8_t cmd, uint8_t cc, uint32_t queue_cycles, uint32_t handler_cycles )
+{
+    ipmi_cmd_stats *stats;
+
+    /* Called from the dispatcher and from the workers */
+    taskENTER_CRITICAL();
+
+    stats = cmd_stats_slot( netfn, cmd );
+    stats->count++;
+
+    if ( cc == IPMI_CC_OK ) {
+        stats->cc_ok++;
+    } else if ( cc == IPMI_CC_NODE_BUSY ) {
+        stats->cc_busy++;
+    } else if ( (cc > IPMI_CC_NODE_BUSY) && (cc <= IPMI_CC_ILLEGAL_COMMAND_DISABLED) ) {
+        stats->cc_invalid++;
+    } else {
+        stats->cc_other++;
+    }
+
+    if ( handler_cycles > stats->handler_max ) {
+        stats->handler_max = handler_cycles;
+    }
+    stats->handler_total += handler_cycles;
+
+    latency_hist[IPMI_STATS_QUEUE_WAIT][hist_bucket( queue_cycles )]++;
+    if ( handler_cycles ) {
+        latency_hist[IPMI_STATS_HANDLER][hist_bucket( handler_cycles )]++;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+void ipmi_stats_tx( uint32_t cycles )
+{
+    taskENTER_CRITICAL();
+    latency_hist[IPMI_STATS_TX][hist_bucket( cycles )]++;
+    taskEXIT_CRITICAL();
+}
+
+/* IPMI Handlers */
+
+/**
+ * @brief Reads the counters of one command
+ *
+ * Request:  [0] = index (0 .. count-1)
+ * Response: [0] = number of tracked commands, [1] netfn, [2] cmd, [3..6] count,
+ *           [7..8] cc ok, [9..10] cc busy, [11..12] cc invalid, [13..14] cc other,
+ *           [15..18] handler max cycles, [19..22] handler total cycles (all LSB first)
+ */
+IPMI_HANDLER(ipmi_custom_get_cmd_stats, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_CMD_STATS, ipmi_msg *req, ipmi_msg *rsp)
+{
+    uint8_t len = 0;
+    uint8_t idx;
+    uint8_t netfn, cmd;
+    ipmi_cmd_stats stats;
+
+    if ( req->data_len < 1 ) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        rsp->data_len = 0;
+        return;
+    }
+
+    idx = req->data[0];
+
+    /* The overflow slot is always reported as the last entry */
+    if ( idx == cmd_stats_count ) {
+        idx = IPMI_STATS_MAX_CMDS-1;
+    } else if ( idx > cmd_stats_count ) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        rsp->data_len = 0;
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    netfn = cmd_stats[idx].netfn;
+    cmd = cmd_stats[idx].cmd;
+    stats = cmd_stats[idx].stats;
+    taskEXIT_CRITICAL();
+
+    rsp->data[len++] = cmd_stats_count + 1;
+    rsp->data[len++] = netfn;
+    rsp->data[len++] = cmd;
+    rsp->data[len++] = stats.count & 0xFF;
+    rsp->data[len++] = (stats.count >> 8) & 0xFF;
+    rsp->data[len++] = (stats.count >> 16) & 0xFF;
+    rsp->data[len++] = (stats.count >> 24) & 0xFF;
+    rsp->data[len++] = stats.cc_ok & 0xFF;
+    rsp->data[len++] = (stats.cc_ok >> 8) & 0xFF;
+    rsp->data[len++] = stats.cc_busy & 0xFF;
+    rsp->data[len++] = (stats.cc_busy >> 8) & 0xFF;
+    rsp->data[len++] = stats.cc_invalid & 0xFF;
+    rsp->data[len++] = (stats.cc_invalid >> 8) & 0xFF;
+    rsp->data[len++] = stats.cc_other & 0xFF;
+    rsp->data[len++] = (stats.cc_other >> 8) & 0xFF;
+    rsp->data[len++] = stats.handler_max & 0xFF;
+    rsp->data[len++] = (stats.handler_max >> 8) & 0xFF;
+    rsp->data[len++] = (stats.handler_max >> 16) & 0xFF;
+    rsp->data[len++] = (stats.handler_max >> 24) & 0xFF;
+    rsp->data[len++] = stats.handler_total & 0xFF;
+    rsp->data[len++] = (stats.handler_total >> 8) & 0xFF;
+    rsp->data[len++] = (stats.handler_total >> 16) & 0xFF;
+    rsp->data[len++] = (stats.handler_total >> 24) & 0xFF;
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
+
+#define HIST_BUCKETS_PER_RSP    5
+
+/**
+ * @brief Reads part of a latency histogram
+ *
+ * Request:  [0] = phase (0 queue wait, 1 handler, 2 tx), [1] = first bucket
+ * Response: [0] = number of buckets returned, followed by up to 5 bucket counters (4 bytes each, LSB first)
+ */
+IPMI_HANDLER(ipmi_custom_get_latency_hist, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_LATENCY_HIST, ipmi_msg *req, ipmi_msg *rsp)
+{
+    uint8_t len = 0;
+    uint8_t phase, first, n, i;
+    uint32_t value;
+
+    if ( req->data_len < 2 ) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        rsp->data_len = 0;
+        return;
+    }
+
+    phase = req->data[0];
+    first = req->data[1];
+
+    if ( (phase >= IPMI_STATS_PHASES) || (first >= IPMI_STATS_HIST_BUCKETS) ) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        rsp->data_len = 0;
+        return;
+    }
+
+    n = IPMI_STATS_HIST_BUCKETS - first;
+    if ( n > HIST_BUCKETS_PER_RSP ) {
+        n = HIST_BUCKETS_PER_RSP;
+    }
+
+    rsp->data[len++] = n;
+    for ( i = 0; i < n; i++ ) {
+        value = latency_hist[phase][first+i];
+        rsp->data[len++] = value & 0xFF;
+        rsp->data[len++] = (value >> 8) & 0xFF;
+        rsp->data[len++] = (value >> 16) & 0xFF;
+        rsp->data[len++] = (value >> 24) & 0xFF;
+    }
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
+
+IPMI_HANDLER(ipmi_custom_reset_ipmi_stats, NETFN_CUSTOM, IPMI_CUSTOM_CMD_RESET_IPMI_STATS, ipmi_msg *req, ipmi_msg *rsp)
+{
+    ipmi_stats_reset();
+    rsp->data_len = 0;
+    rsp->completion_code = IPMI_CC_OK;
+}
@@ -0,0 +1,111 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file ipmi_stats.h
+ *
+ * @brief Per-command IPMI statistics and latency histograms
+ *
+ * Counts every request by netfn/cmd and completion code and keeps log2 histograms (in CPU cycles) of the time a request
+ * waits in queue, the time spent in its handler and the time taken to transmit its response.
+ * The data is read and reset with the NETFN_CUSTOM commands IPMI_CUSTOM_CMD_*.
+ *
+ * @warning When MODULE_IPMI_STATS is not defined, the recording functions are replaced by macros that do nothing
+ */
+
+#ifndef IPMI_STATS_H_
+#define IPMI_STATS_H_
+
+#include "ipmi.h"
+
+/**
+ * @brief Latency phases with their own histogram
+ */
+enum {
+    IPMI_STATS_QUEUE_WAIT = 0,          /**< From the frame decode to the start of the handler */
+    IPMI_STATS_HANDLER,                 /**< Handler execution */
+    IPMI_STATS_TX,                      /**< Response transmission on IPMB */
+    IPMI_STATS_PHASES
+};
+
+/**
+ * @brief Number of histogram buckets (bucket N counts latencies from 2^N to 2^(N+1)-1 cycles)
+ */
+#define IPMI_STATS_HIST_BUCKETS     32
+
+/**
+ * @brief Maximum number of distinct commands tracked (one slot per registered handler, plus one for unknown commands)
+ */
+#define IPMI_STATS_MAX_CMDS         48
+
+/**
+ * @brief Per-command counters
+ */
+typedef struct ipmi_cmd_stats {
+    uint32_t count;                     /**< Requests received */
+    uint16_t cc_ok;                     /**< Responses with IPMI_CC_OK */
+    uint16_t cc_busy;                   /**< Responses with IPMI_CC_NODE_BUSY */
+    uint16_t cc_invalid;                /**< Responses with other standard error codes (0xC1-0xD6) */
+    uint16_t cc_other;                  /**< Responses with any other completion code */
+    uint32_t handler_max;               /**< Longest handler execution, in cycles */
+    uint32_t handler_total;             /**< Accumulated handler execution, in cycles */
+} ipmi_cmd_stats;
+
+#ifdef MODULE_IPMI_STATS
+
+/**
+ * @brief Enables the cycle counter and clears all statistics
+ */
+void ipmi_stats_init( void );
+
+/**
+ * @brief Accounts a request that was answered
+ *
+ * @param netfn Request netfn
+ * @param cmd Request command
+ * @param cc Completion code sent back
+ * @param queue_cycles Cycles the request waited before its handler started
+ * @param handler_cycles Cycles spent in the handler (0 if no handler was called)
+ */
+void ipmi_stats_request( uint8_t netfn, uint8_t cmd, uint8_t cc, uint32_t queue_cycles, uint32_t handler_cycles );
+
+/**
+ * @brief Accounts the transmission time of a response
+ *
+ * @param cycles Cycles taken by the IPMB TX task to put the response on the bus
+ */
+void ipmi_stats_tx( uint32_t cycles );
+
+/**
+ * @brief Clears all counters and histograms
+ */
+void ipmi_stats_reset( void );
+
+#else
+
+#define ipmi_stats_init()                               (void)0
+#define ipmi_stats_request(netfn, cmd, cc, qc, hc)      ((void)(qc), (void)(hc))
+#define ipmi_stats_tx(cycles)                           ((void)(cycles))
+#define ipmi_stats_reset()                              (void)0
+
+#endif
+
+#endif
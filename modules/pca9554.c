@@ -50,13 +50,20 @@ static uint8_t pca9554_read_reg ( uint8_t reg, uint8_t *readout )
     uint8_t i2c_addr;
     uint8_t i2c_id;
     uint8_t rx_len = 0;
+    i2c_seg_t segs[2] = {
+        { &reg, 1, 0 },
+        { readout, 1, I2C_SEG_READ },
+    };
 
     if (readout == NULL) {
         return 0;
     }
 
     if( i2c_take_by_chipid( CHIP_ID_RTM_PCA9554, &i2c_addr, &i2c_id, (TickType_t) 10) ) {
-        rx_len = xI2CMasterWriteRead(i2c_id, i2c_addr, reg, readout, 1);
+        /* Command byte, repeated START and the register value */
+        if ( xI2CMasterTransfer( i2c_id, i2c_addr, segs, 2 ) == 2 ) {
+            rx_len = 1;
+        }
         i2c_give(i2c_id);
     }
     return rx_len;
@@ -74,11 +81,14 @@ static uint8_t pca9554_write_reg ( uint8_t reg, uint8_t data )
 {
     uint8_t i2c_addr;
     uint8_t i2c_id;
-    uint8_t cmd_data[2] = {reg, data};
     uint8_t tx_len = 0;
+    i2c_seg_t segs[2] = {
+        { &reg, 1, 0 },
+        { &data, 1, I2C_SEG_NOSTART },
+    };
 
     if( i2c_take_by_chipid( CHIP_ID_RTM_PCA9554, &i2c_addr, &i2c_id, (TickType_t) 10) ) {
-        tx_len = xI2CMasterWrite(i2c_id, i2c_addr, cmd_data, sizeof(cmd_data));
+        tx_len = xI2CMasterTransfer( i2c_id, i2c_addr, segs, 2 );
         i2c_give(i2c_id);
     }
 
@@ -97,10 +97,10 @@ void RTM_Manage( void * Parameters )
                 }
 
                 /* Activate RTM sensors in the SDR table */
-                //sdr_activate_sensors(); /* Not implemented yet */
+                sdr_set_group_active( SDR_GROUP_RTM, true );
 
             } else if ( ps_new_state == HOTSWAP_STATE_URTM_ABSENT ) {
-                //sdr_disable_sensors(); /* Not implemented yet */
+                sdr_set_group_active( SDR_GROUP_RTM, false );
 
                 printf("RTM Board disconnected!\n");
 
@@ -33,8 +33,10 @@
 /* Project Includes */
 #include "sdr.h"
 #include "sensors.h"
+#include "sensor_history.h"
 #include "ipmi.h"
 #include "fpga_spi.h"
+#include "string.h"
 
 volatile uint8_t sdr_count = 0;
 
@@ -65,6 +67,9 @@ size_t sdr_get_size_by_entry(sensor_t * entry)
 
 void sensor_init( void )
 {
+    /* The scheduler must exist before the drivers add their sensors to it */
+    sensor_sched_init();
+
     /* This function must be provided by the board port */
     amc_sdr_init();
 #ifdef MODULE_RTM
@@ -83,15 +88,62 @@ void sensor_init( void )
 #if defined(MODULE_INA220_CURRENT) || defined(MODULE_INA220_VOLTAGE)
     ina220_init();
 #endif
+#ifdef MODULE_OVERTEMP_ALERT
+    overtemp_init();
+#endif
+}
+
+/* Sensors are stored by their number, so a sensor number (or SDR record ID) is also its index in this table */
+sensor_t sensor_table[SDR_MAX_ENTRIES];
+
+/* Open addressing hash from the SDR pointer to the sensor number (plus one, 0 marks an empty bucket) */
+static uint8_t sdr_ptr_index[SDR_PTR_INDEX_SIZE];
+
+#define SDR_PTR_HASH(sdr)       ((((uintptr_t) (sdr)) >> 2) & (SDR_PTR_INDEX_SIZE-1))
+
+static void sdr_ptr_index_add( sensor_t * entry )
+{
+    uint8_t i = SDR_PTR_HASH(entry->sdr);
+
+    while ( sdr_ptr_index[i] ) {
+        i = (i + 1) & (SDR_PTR_INDEX_SIZE-1);
+    }
+    sdr_ptr_index[i] = entry->num + 1;
+}
+
+static void sdr_ptr_index_remove( sensor_t * entry )
+{
+    uint8_t i = SDR_PTR_HASH(entry->sdr);
+    uint8_t j, home;
+
+    while ( sdr_ptr_index[i] != (entry->num + 1) ) {
+        if ( sdr_ptr_index[i] == 0 ) {
+            return;
+        }
+        i = (i + 1) & (SDR_PTR_INDEX_SIZE-1);
+    }
+    sdr_ptr_index[i] = 0;
+
+    /* Shift back the following entries of the probe sequence, so no lookup stops at the hole */
+    for ( j = (i + 1) & (SDR_PTR_INDEX_SIZE-1); sdr_ptr_index[j]; j = (j + 1) & (SDR_PTR_INDEX_SIZE-1) ) {
+        home = SDR_PTR_HASH(sensor_table[sdr_ptr_index[j]-1].sdr);
+
+        /* Move it only if its home bucket isn't cyclically in (i, j] */
+        if ( ((j - home) & (SDR_PTR_INDEX_SIZE-1)) >= ((j - i) & (SDR_PTR_INDEX_SIZE-1)) ) {
+            sdr_ptr_index[i] = sdr_ptr_index[j];
+            sdr_ptr_index[j] = 0;
+            i = j;
+        }
+    }
 }
 
 void sdr_init( void )
 {
-    sdr_head = NULL;
-    sdr_tail = NULL;
+    memset( sensor_table, 0, sizeof(sensor_table) );
+    memset( sdr_ptr_index, 0, sizeof(sdr_ptr_index) );
 
     /* Populate AMC SDR Device Locator Record */
-    sdr_head = sdr_insert_entry( TYPE_12, (void *) &SDR0, NULL, 0, 0 );
+    sdr_insert_entry( TYPE_12, (void *) &SDR0, NULL, 0, 0 );
 #ifdef MODULE_RTM
     sdr_insert_entry( TYPE_12, (void *) &SDR_RTM_DEV_LOCATOR, NULL, 0, 0 );
 #endif
@@ -100,54 +152,81 @@ void sdr_init( void )
 sensor_t * sdr_insert_entry( SDR_TYPE type, void * sdr, TaskHandle_t *monitor_task, uint8_t diag_id, uint8_t chipid )
 {
     uint8_t sdr_len = sdr_get_size_by_type(type);
+    sensor_t * entry = NULL;
+    uint8_t i;
 
-    sensor_t * entry = pvPortMalloc( sizeof(sensor_t) );
+    taskENTER_CRITICAL();
 
-    entry->num = sdr_count;
-    entry->sdr_type = type;
-    entry->sdr = sdr;
-    entry->sdr_length = sdr_len;
-    entry->task_handle = monitor_task;
-    entry->diag_devID = diag_id;
-    entry->chipid = chipid;
-    entry->ownerID = ipmb_addr;
-    entry->entityinstance =  0x60 | ((ipmb_addr - 0x70) >> 1);
-    entry->readout_value = 0;
-    entry->state = SENSOR_STATE_LOW_NON_REC;
+    /* Take the lowest free number, so the records of a static population are numbered in the order they're inserted */
+    for ( i = 0; i < SDR_MAX_ENTRIES; i++ ) {
+        if ( sensor_table[i].sdr == NULL ) {
+            entry = &sensor_table[i];
+            break;
+        }
+    }
 
-    /* Link the sdr list */
-    if (sdr_tail) {
-        sdr_tail->next = entry;
+    if ( entry != NULL ) {
+        memset( entry, 0, sizeof(sensor_t) );
+        entry->num = i;
+        entry->sdr_type = type;
+        entry->sdr = sdr;
+        entry->sdr_length = sdr_len;
+        entry->task_handle = monitor_task;
+        entry->diag_devID = diag_id;
+        entry->chipid = chipid;
+        entry->ownerID = ipmb_addr;
+        entry->entityinstance =  0x60 | ((ipmb_addr - 0x70) >> 1);
+        entry->readout_value = 0;
+        entry->state = SENSOR_STATE_NORMAL;
+        entry->active = 1;
+
+        sdr_ptr_index_add( entry );
+        sensor_history_clear( entry );
+
+        sdr_count++;
+        sdr_change_count++;
     }
-    sdr_tail = entry;
-    entry->next = NULL;
 
-    sdr_count++;
-    sdr_change_count++;
+    taskEXIT_CRITICAL();
+
+    configASSERT( entry );
 
     return entry;
 }
 
 sensor_t * find_sensor_by_sdr( void * sdr )
 {
-    sensor_t * cur;
+    uint8_t i = SDR_PTR_HASH(sdr);
 
-    for ( cur = sdr_head; cur != NULL; cur = cur->next ) {
-        if (cur->sdr == sdr) {
-            return cur;
+    while ( sdr_ptr_index[i] ) {
+        if ( sensor_table[sdr_ptr_index[i]-1].sdr == sdr ) {
+            return &sensor_table[sdr_ptr_index[i]-1];
         }
+        i = (i + 1) & (SDR_PTR_INDEX_SIZE-1);
     }
     return NULL;
-
 }
 
 sensor_t * find_sensor_by_id( uint8_t id )
 {
-    sensor_t * cur;
+    if ( (id >= SDR_MAX_ENTRIES) || (sensor_table[id].sdr == NULL) ) {
+        return NULL;
+    }
+    return &sensor_table[id];
+}
+
+sensor_t * sdr_first( void )
+{
+    return sdr_next( NULL );
+}
+
+sensor_t * sdr_next( sensor_t * cur )
+{
+    uint8_t i = (cur == NULL) ? 0 : cur->num + 1;
 
-    for ( cur = sdr_head; cur != NULL; cur = cur->next ) {
-        if (cur->num == id) {
-            return cur;
+    for ( ; i < SDR_MAX_ENTRIES; i++ ) {
+        if ( sensor_table[i].sdr != NULL ) {
+            return &sensor_table[i];
         }
     }
     return NULL;
@@ -155,41 +234,162 @@ sensor_t * find_sensor_by_id( uint8_t id )
 
 void sdr_remove_entry( sensor_t * entry )
 {
-    sensor_t * cur = sdr_head;
-    sensor_t * prev = NULL;
+    if ( (entry == NULL) || (entry->sdr == NULL) ) {
+        return;
+    }
+
+    sensor_sched_remove( entry );
+
+    taskENTER_CRITICAL();
+
+    sdr_ptr_index_remove( entry );
+
+    /* The number stays free until a new record is inserted */
+    entry->sdr = NULL;
+    entry->task_handle = NULL;
+    sensor_history_clear( entry );
 
-    if (entry == sdr_head) {
-        sdr_pop();
+    if ( entry->active ) {
+        sdr_count--;
+        sdr_change_count++;
     }
 
-    while (cur != entry) {
-        prev = cur;
-        cur = cur->next;
-        if (cur == NULL) {
-            /* We reached the end of the list and didn't find the entry */
-            return;
+    taskEXIT_CRITICAL();
+}
+
+void sdr_set_group( sensor_t * entry, uint8_t group )
+{
+    if ( entry == NULL ) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+
+    entry->group = group;
+    if ( (group != SDR_GROUP_NONE) && entry->active ) {
+        entry->active = 0;
+        sdr_count--;
+        sdr_change_count++;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+void sdr_set_group_active( uint8_t group, bool active )
+{
+    sensor_t * entry;
+
+    for ( entry = sdr_first(); entry != NULL; entry = sdr_next( entry ) ) {
+        if ( (entry->group != group) || (entry->active == active) ) {
+            continue;
+        }
+
+        if ( !active ) {
+            sensor_sched_suspend( entry );
+        }
+
+        taskENTER_CRITICAL();
+
+        entry->active = active;
+        if ( active ) {
+            /* Start over from a clean state, events asserted before the removal were lost with it */
+            entry->readout_value = 0;
+            entry->thr_crossed = 0;
+            entry->asserted_events = 0;
+            entry->state = SENSOR_STATE_NORMAL;
+            sdr_count++;
+        } else {
+            sdr_count--;
+        }
+        sdr_change_count++;
+
+        taskEXIT_CRITICAL();
+
+        if ( active ) {
+            sensor_sched_resume( entry );
         }
     }
+}
 
-    /* Relink the table */
-    prev->next = cur->next;
+/* Serialized copy of the SDR repository, as Get Device SDR returns it. Rebuilt when sdr_change_count moves */
+static uint8_t * sdr_image;
+static uint16_t sdr_image_size;
+static uint32_t sdr_image_change_count = 0xFFFFFFFF;
 
-    sdr_count--;
-    sdr_change_count++;
+static struct {
+    uint16_t offset;        /* Start of the record in sdr_image */
+    uint8_t length;         /* Record length, 0 if there's no record with this ID */
+    uint16_t next;          /* Next record ID, 0xFFFF for the last one */
+} sdr_image_index[SDR_MAX_ENTRIES];
 
-    /* Free the entry */
-    vPortFree(cur);
+/* Only the active entries are listed in the repository */
+static sensor_t * sdr_next_active( sensor_t * cur )
+{
+    do {
+        cur = sdr_next( cur );
+    } while ( (cur != NULL) && !cur->active );
+
+    return cur;
 }
 
-void sdr_pop( void )
+static void sdr_image_build( void )
 {
-    sensor_t * new_head;
+    sensor_t * cur;
+    sensor_t * next;
+    uint8_t * pSDR;
+    uint16_t size, offset = 0;
+    uint32_t change_count;
+
+    /* Records are only inserted or removed by tasks, so holding the scheduler is enough to get a coherent copy */
+    vTaskSuspendAll();
+
+    do {
+        change_count = sdr_change_count;
 
-    if ( sdr_head ) {
-        new_head = sdr_head->next;
-        vPortFree( sdr_head );
-        sdr_head = new_head;
+        size = 0;
+        for ( cur = sdr_next_active( NULL ); cur != NULL; cur = sdr_next_active( cur ) ) {
+            size += cur->sdr_length;
+        }
+
+        if ( size > sdr_image_size ) {
+            /* Allocate outside of the suspended section, the repository may change meanwhile so check again */
+            xTaskResumeAll();
+            vPortFree( sdr_image );
+            sdr_image = pvPortMalloc( size );
+            configASSERT( sdr_image );
+            vTaskSuspendAll();
+            sdr_image_size = size;
+        }
+    } while ( (change_count != sdr_change_count) || (size > sdr_image_size) );
+
+    memset( sdr_image_index, 0, sizeof(sdr_image_index) );
+
+    for ( cur = sdr_next_active( NULL ); cur != NULL; cur = next ) {
+        next = sdr_next_active( cur );
+        pSDR = &sdr_image[offset];
+
+        memcpy( pSDR, cur->sdr, cur->sdr_length );
+
+        /* Fields that are only known at runtime */
+        pSDR[0] = cur->num;
+        pSDR[5] = cur->ownerID;
+        if ( pSDR[3] == TYPE_01 || pSDR[3] == TYPE_02 ) {
+            pSDR[7] = cur->num;
+            pSDR[9] = cur->entityinstance;
+        } else if ( pSDR[3] == TYPE_11 || pSDR[3] == TYPE_12 ) {
+            pSDR[13] = cur->entityinstance;
+        }
+
+        sdr_image_index[cur->num].offset = offset;
+        sdr_image_index[cur->num].length = cur->sdr_length;
+        sdr_image_index[cur->num].next = next ? next->num : 0xFFFF;
+
+        offset += cur->sdr_length;
     }
+
+    sdr_image_change_count = change_count;
+
+    xTaskResumeAll();
 }
 
 /******************************/
@@ -210,13 +410,14 @@ IPMI_HANDLER(ipmi_se_get_sdr_info, NETFN_SE, IPMI_GET_DEVICE_SDR_INFO_CMD, ipmi_
         /* Return number of SDR entries */
         rsp->data[len++] = sdr_count-1;
     }
-    /* Static Sensor population and LUN 0 has sensors */
-    rsp->data[len++] = (1 << 7) | (1 << 1) | (1 << 0) ; // if dynamic, additional 4 bytes required (see Table 20-2 Get Device SDR INFO Command)
+    /* Dynamic Sensor population and LUN 0 has sensors */
+    rsp->data[len++] = (1 << 7) | (1 << 1) | (1 << 0) ;
 
-    rsp->data[len++] = (sdr_change_count << 0 ) & 0x000000FF;
-    rsp->data[len++] = (sdr_change_count << 8 ) & 0x0000FF00;
-    rsp->data[len++] = (sdr_change_count << 16) & 0x00FF0000;
-    rsp->data[len++] = (sdr_change_count << 24) & 0xFF000000;
+    /* Sensor Population Change Indicator, LS byte first (see Table 20-2 Get Device SDR INFO Command) */
+    rsp->data[len++] = (sdr_change_count >> 0 ) & 0xFF;
+    rsp->data[len++] = (sdr_change_count >> 8 ) & 0xFF;
+    rsp->data[len++] = (sdr_change_count >> 16) & 0xFF;
+    rsp->data[len++] = (sdr_change_count >> 24) & 0xFF;
 
     rsp->data_len = len;
     rsp->completion_code = IPMI_CC_OK;
@@ -275,6 +476,7 @@ IPMI_HANDLER(ipmi_se_get_sdr, NETFN_SE, IPMI_GET_DEVICE_SDR_CMD, ipmi_msg *req,
     uint8_t offset = req->data[4];
     uint8_t size = req->data[5];
     uint8_t len = rsp->data_len = 0;
+    uint16_t next_id;
 
     rsp->completion_code = IPMI_CC_OK;
 
@@ -285,52 +487,28 @@ IPMI_HANDLER(ipmi_se_get_sdr, NETFN_SE, IPMI_GET_DEVICE_SDR_CMD, ipmi_msg *req,
         return;
     }
 
-    sensor_t * cur_sensor = find_sensor_by_id( record_id );
-
-    if ( cur_sensor == NULL ) {
-        rsp->completion_code = IPMI_CC_REQ_DATA_NOT_PRESENT;
+    if ( size > (IPMI_MAX_DATA_LEN - 2) ) {
+        rsp->completion_code = IPMI_CC_CANT_RET_NUM_REQ_BYTES;
         return;
     }
 
-    if ( (record_id >= sdr_count) || ((size + offset) > cur_sensor->sdr_length)) {
+    if ( sdr_image_change_count != sdr_change_count ) {
+        sdr_image_build();
+    }
+
+    if ( (record_id >= SDR_MAX_ENTRIES) || (sdr_image_index[record_id].length == 0) ||
+         ((size + offset) > sdr_image_index[record_id].length) ) {
         rsp->completion_code = IPMI_CC_REQ_DATA_NOT_PRESENT;
         return;
-    } else if (record_id == sdr_count - 1) {
-        rsp->data[len++] = 0xFF;
-        rsp->data[len++] = 0xFF;
-    } else {
-        rsp->data[len++] = (record_id + 1) & 0xFF; /* next record ID */
-        rsp->data[len++] = (record_id + 1) >> 8; /* next record ID */
-    }
-
-    uint8_t tmp_c, index;
-    uint8_t * pSDR = (uint8_t *) cur_sensor->sdr;
-    uint8_t sdr_type = pSDR[3];
-
-    for (uint8_t i = 0; i < size; i++) {
-        index = i + offset;
-        tmp_c = pSDR[index];
-
-        /* Return not-const data from SDR */
-        if (index == 0) {
-            tmp_c = record_id;
-        } else if (index == 5) {
-            tmp_c = cur_sensor->ownerID;
-        } else if ( sdr_type == TYPE_01 || sdr_type == TYPE_02 ) {
-            if (index == 9) {
-                tmp_c = cur_sensor->entityinstance;
-            }
-            if (index == 7) {
-                tmp_c = record_id;
-            }
-        } else if ( sdr_type == TYPE_11 || sdr_type == TYPE_12 ) {
-            if (index == 13) {
-                tmp_c = cur_sensor->entityinstance;
-            }
-        }
-        rsp->data[len++] = tmp_c;
     }
 
+    next_id = sdr_image_index[record_id].next;
+    rsp->data[len++] = next_id & 0xFF; /* next record ID */
+    rsp->data[len++] = next_id >> 8; /* next record ID */
+
+    memcpy( &rsp->data[len], &sdr_image[sdr_image_index[record_id].offset + offset], size );
+    len += size;
+
     rsp->data_len = len;
 }
 
@@ -354,23 +532,27 @@ IPMI_HANDLER(ipmi_se_get_sensor_reading, NETFN_SE, IPMI_GET_SENSOR_READING_CMD,
 
     sensor_t * cur_sensor = find_sensor_by_id( sensor_number );
 
-    if (sensor_number > sdr_count) {
+    if (cur_sensor == NULL) {
         rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
         rsp->data_len = 0;
         return;
     }
 
-    if (*(cur_sensor->task_handle) == vTaskHotSwap_Handle) {
+    if (cur_sensor->task_handle && (*(cur_sensor->task_handle) == vTaskHotSwap_Handle)) {
         rsp->data[len++] = 0x00;
         rsp->data[len++] = 0xC0;
         /* Current State Mask */
         rsp->data[len++] = cur_sensor->readout_value;
+    } else if ( !cur_sensor->active ) {
+        /* Scanning disabled, reading unavailable */
+        rsp->data[len++] = 0x00;
+        rsp->data[len++] = 0x20;
+        rsp->data[len++] = 0xC0;
     } else {
         rsp->data[len++] = cur_sensor->readout_value;
         rsp->data[len++] = 0x40;
         /* Present threshold status */
-        /* TODO: Implement threshold reading */
-        rsp->data[len++] = 0xC0;
+        rsp->data[len++] = 0xC0 | cur_sensor->thr_crossed;
     }
 
     rsp->data_len = len;
@@ -381,15 +563,15 @@ IPMI_HANDLER(ipmi_se_get_sensor_threshold, NETFN_SE, IPMI_GET_SENSOR_THRESHOLD_C
     int sensor_number = req->data[0];
     int len = rsp->data_len;
 
+    sensor_t *cur_sensor = find_sensor_by_id( sensor_number );
+
     /* Check if the requested sensor exists */
-    if (sensor_number > sdr_count) {
+    if (cur_sensor == NULL) {
         rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
         rsp->data_len = 0;
         return;
     }
 
-    sensor_t *cur_sensor = find_sensor_by_id( sensor_number );
-
     /* Check if the selected sensor has a Full Sensor Record */
     if ( cur_sensor->sdr_type != TYPE_01) {
         rsp->completion_code = IPMI_CC_INV_DATA_FIELD_IN_REQ;
@@ -413,12 +595,40 @@ IPMI_HANDLER(ipmi_se_get_sensor_threshold, NETFN_SE, IPMI_GET_SENSOR_THRESHOLD_C
     rsp->completion_code = IPMI_CC_OK;
 }
 
-/* Sensor alarm checking function adapted from CERN MMCv2 implementation, credits in this file header */
+/* Event offsets of each threshold: [0] when the reading crosses it outwards, [1] when the reading comes back */
+static const uint8_t thr_events[THR_COUNT][2] = {
+    [THR_LNC] = { IPMI_THRESHOLD_LNC_GL, IPMI_THRESHOLD_LNC_GH },
+    [THR_LC]  = { IPMI_THRESHOLD_LC_GL,  IPMI_THRESHOLD_LC_GH },
+    [THR_LNR] = { IPMI_THRESHOLD_LNR_GL, IPMI_THRESHOLD_LNR_GH },
+    [THR_UNC] = { IPMI_THRESHOLD_UNC_GH, IPMI_THRESHOLD_UNC_GL },
+    [THR_UC]  = { IPMI_THRESHOLD_UC_GH,  IPMI_THRESHOLD_UC_GL },
+    [THR_UNR] = { IPMI_THRESHOLD_UNR_GH, IPMI_THRESHOLD_UNR_GL },
+};
+
+#define THR_NORM_ID(sensor)     ((sensor)->signed_flag ? 2 : 1)
+
+static void sensor_thr_normalize( sensor_t * sensor, SDR_type_01h_t * sdr )
+{
+    uint8_t bias = SENSOR_NORM_BIAS(sensor);
+
+    sensor->thr_level[THR_LNC] = (int8_t) (sdr->lower_noncritical_thr ^ bias);
+    sensor->thr_level[THR_LC]  = (int8_t) (sdr->lower_critical_thr ^ bias);
+    sensor->thr_level[THR_LNR] = (int8_t) (sdr->lower_nonrecover_thr ^ bias);
+    sensor->thr_level[THR_UNC] = (int8_t) (sdr->upper_noncritical_thr ^ bias);
+    sensor->thr_level[THR_UC]  = (int8_t) (sdr->upper_critical_thr ^ bias);
+    sensor->thr_level[THR_UNR] = (int8_t) (sdr->upper_nonrecover_thr ^ bias);
+
+    sensor->thr_norm = THR_NORM_ID(sensor);
+}
+
 void check_sensor_event( sensor_t * sensor )
 {
-    /** Should be rewritten to be compliant with RTM management !! */
-    uint8_t ev = 0xFF;
-    uint8_t ev_type;
+    uint8_t bias, k;
+    uint8_t crossed, changed, enter = 0, leave = 0;
+    uint8_t ev_out, ev_back;
+    uint16_t assert_mask, deassert_mask;
+    int16_t reading;
+    uint8_t ev_data[3];
 
     configASSERT(sensor);
 
@@ -429,388 +639,108 @@ void check_sensor_event( sensor_t * sensor )
         return;
     }
 
-    /** Compare value with threshold */
-    switch(sensor->state) {
-    case SENSOR_STATE_HIGH_NON_REC:
-        if(sensor->signed_flag){
-            if(((int8_t)sensor->readout_value) <= (((int8_t)sdr->upper_nonrecover_thr) - (1+((int8_t)sdr->pos_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_non_recoverable_go_high){
-                    ev = IPMI_THRESHOLD_UNR_GH;
-                    sensor->asserted_event.upper_non_recoverable_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_HIGH_CRIT;
-            }
-
-            if(sensor->old_state != sensor->state && ((int8_t)sensor->readout_value) <= ((int8_t)sdr->upper_nonrecover_thr) && !sensor->asserted_event.upper_non_recoverable_go_low){
-                ev = IPMI_THRESHOLD_UNR_GL;
-                sensor->asserted_event.upper_non_recoverable_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(((int8_t)sensor->readout_value) >= (((int8_t)sdr->upper_nonrecover_thr) + (1+((int8_t)sdr->neg_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_non_recoverable_go_low){
-                    ev = IPMI_THRESHOLD_UNR_GL;
-                    sensor->asserted_event.upper_non_recoverable_go_low = 0;
+    /* The signedness is set by the sensor driver after the entry is inserted, so it's checked on every call */
+    if ( sensor->thr_norm != THR_NORM_ID(sensor) ) {
+        sensor_thr_normalize( sensor, sdr );
+    }
 
-                }
-            }
-        }
-        else{
-            if(sensor->readout_value <= (sdr->upper_nonrecover_thr - (1+sdr->pos_thr_hysteresis))){
-                if(sensor->asserted_event.upper_non_recoverable_go_high){
-                    ev = IPMI_THRESHOLD_UNR_GH;
-                    sensor->asserted_event.upper_non_recoverable_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_HIGH_CRIT;
-            }
+    bias = SENSOR_NORM_BIAS(sensor);
+    reading = SENSOR_NORM_READING(sensor);
 
-            if(sensor->old_state != sensor->state && sensor->readout_value <= sdr->upper_nonrecover_thr && !sensor->asserted_event.upper_non_recoverable_go_low){
-                ev = IPMI_THRESHOLD_UNR_GL;
-                sensor->asserted_event.upper_non_recoverable_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(sensor->readout_value >= (sdr->upper_nonrecover_thr + (1+sdr->neg_thr_hysteresis))){
-                if(sensor->asserted_event.upper_non_recoverable_go_low){
-                    ev = IPMI_THRESHOLD_UNR_GL;
-                    sensor->asserted_event.upper_non_recoverable_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
-        }
-        break;
-
-    case SENSOR_STATE_HIGH_CRIT:
-        if(sensor->signed_flag){
-            if(((int8_t)sensor->readout_value) >= ((int8_t)sdr->upper_nonrecover_thr)){
-                ev = IPMI_THRESHOLD_UNR_GH;
-                sensor->asserted_event.upper_non_recoverable_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_HIGH_NON_REC;
-            }
-            else if(((int8_t)sensor->readout_value) <= (((int8_t)sdr->upper_critical_thr) - (1+((int8_t)sdr->pos_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_critical_go_high){
-                    ev = IPMI_THRESHOLD_UC_GH;
-                    sensor->asserted_event.upper_critical_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_HIGH;
-            }
+    /* A threshold is crossed when the reading reaches it and released only after moving past the hysteresis band */
+    for ( k = THR_LNC; k <= THR_LNR; k++ ) {
+        enter |= (reading <= sensor->thr_level[k]) << k;
+        leave |= (reading >= (sensor->thr_level[k] + 1 + sdr->neg_thr_hysteresis)) << k;
+    }
+    for ( k = THR_UNC; k <= THR_UNR; k++ ) {
+        enter |= (reading >= sensor->thr_level[k]) << k;
+        leave |= (reading <= (sensor->thr_level[k] - 1 - sdr->pos_thr_hysteresis)) << k;
+    }
 
-            if(sensor->old_state != sensor->state && ((int8_t)sensor->readout_value) <= ((int8_t)sdr->upper_critical_thr) && !sensor->asserted_event.upper_critical_go_low){
-                ev = IPMI_THRESHOLD_UC_GL;
-                sensor->asserted_event.upper_critical_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(((int8_t)sensor->readout_value) >= (((int8_t)sdr->upper_critical_thr) + (1+((int8_t)sdr->neg_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_critical_go_low){
-                    ev = IPMI_THRESHOLD_UC_GL;
-                    sensor->asserted_event.upper_critical_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
-        }
-        else{
-            if(sensor->readout_value >= sdr->upper_nonrecover_thr){
-                ev = IPMI_THRESHOLD_UNR_GH;
-                sensor->asserted_event.upper_non_recoverable_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_HIGH_NON_REC;
-            }
-            else if(sensor->readout_value <= (sdr->upper_critical_thr - (1+sdr->pos_thr_hysteresis))){
-                if(sensor->asserted_event.upper_critical_go_high){
-                    ev = IPMI_THRESHOLD_UC_GH;
-                    sensor->asserted_event.upper_critical_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_HIGH;
-            }
+    crossed = (enter | (sensor->thr_crossed & ~leave)) & sdr->readable_threshold_mask & THR_ALL_MASK;
+    changed = crossed ^ sensor->thr_crossed;
+    sensor->thr_crossed = crossed;
+
+    /* Report the most severe threshold crossed */
+    if ( crossed & THR_UPPER_MASK ) {
+        sensor->state = (crossed & (1 << THR_UNR)) ? SENSOR_STATE_HIGH_NON_REC :
+            (crossed & (1 << THR_UC)) ? SENSOR_STATE_HIGH_CRIT : SENSOR_STATE_HIGH;
+    } else if ( crossed & THR_LOWER_MASK ) {
+        sensor->state = (crossed & (1 << THR_LNR)) ? SENSOR_STATE_LOW_NON_REC :
+            (crossed & (1 << THR_LC)) ? SENSOR_STATE_LOW_CRIT : SENSOR_STATE_LOW;
+    } else {
+        sensor->state = SENSOR_STATE_NORMAL;
+    }
 
-            if(sensor->old_state != sensor->state && sensor->readout_value <= sdr->upper_critical_thr && !sensor->asserted_event.upper_critical_go_low){
-                ev = IPMI_THRESHOLD_UC_GL;
-                sensor->asserted_event.upper_critical_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(sensor->readout_value >= (sdr->upper_critical_thr + (1+sdr->neg_thr_hysteresis))){
-                if(sensor->asserted_event.upper_critical_go_low){
-                    ev = IPMI_THRESHOLD_UC_GL;
-                    sensor->asserted_event.upper_critical_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
-        }
+    if ( !changed ) {
+        return;
+    }
 
-        break;
+    assert_mask = sdr->assertion_event_mask[0] | (sdr->assertion_event_mask[1] << 8);
+    deassert_mask = sdr->deassertion_event_mask[0] | (sdr->deassertion_event_mask[1] << 8);
 
-    case SENSOR_STATE_HIGH:
-        if(sensor->signed_flag){
-            if(((int8_t)sensor->readout_value) >= ((int8_t)sdr->upper_critical_thr)){
-                ev = IPMI_THRESHOLD_UC_GH;
-                sensor->asserted_event.upper_critical_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_HIGH_CRIT;
-            }
-            else if(((int8_t)sensor->readout_value) <= (((int8_t)sdr->upper_noncritical_thr) - (1+((int8_t)sdr->pos_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_non_critical_go_high){
-                    ev = IPMI_THRESHOLD_UNC_GH;
-                    sensor->asserted_event.upper_non_critical_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_NORMAL;
-            }
+    /* Event Data 1: trigger reading in byte 2, trigger threshold in byte 3 */
+    ev_data[1] = sensor->readout_value & 0xFF;
 
-            if(sensor->old_state != sensor->state && ((int8_t)sensor->readout_value) <= ((int8_t)sdr->upper_noncritical_thr) && !sensor->asserted_event.upper_non_critical_go_low){
-                ev = IPMI_THRESHOLD_UNC_GL;
-                sensor->asserted_event.upper_non_critical_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(((int8_t)sensor->readout_value) >= (((int8_t)sdr->upper_noncritical_thr) + (1+((int8_t)sdr->neg_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_non_critical_go_low){
-                    ev = IPMI_THRESHOLD_UNC_GL;
-                    sensor->asserted_event.upper_non_critical_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
+    for ( k = 0; k < THR_COUNT; k++ ) {
+        if ( !(changed & (1 << k)) ) {
+            continue;
         }
-        else{
-            if(sensor->readout_value >= sdr->upper_critical_thr){
-                ev = IPMI_THRESHOLD_UC_GH;
-                sensor->asserted_event.upper_critical_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_HIGH_CRIT;
-            }
-            else if(sensor->readout_value <= (sdr->upper_noncritical_thr - (1+sdr->pos_thr_hysteresis))){
-                if(sensor->asserted_event.upper_non_critical_go_high){
-                    ev = IPMI_THRESHOLD_UNC_GH;
-                    sensor->asserted_event.upper_non_critical_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_NORMAL;
-            }
 
-            if(sensor->old_state != sensor->state && sensor->readout_value <= sdr->upper_noncritical_thr && !sensor->asserted_event.upper_non_critical_go_low){
-                ev = IPMI_THRESHOLD_UNC_GL;
-                sensor->asserted_event.upper_non_critical_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(sensor->readout_value >= (sdr->upper_noncritical_thr + (1+sdr->neg_thr_hysteresis))){
-                if(sensor->asserted_event.upper_non_critical_go_low){
-                    ev = IPMI_THRESHOLD_UNC_GL;
-                    sensor->asserted_event.upper_non_critical_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
+        /* Moving outwards asserts the outward event and clears the inward one, and the other way round */
+        if ( crossed & (1 << k) ) {
+            ev_out = thr_events[k][0];
+            ev_back = thr_events[k][1];
+        } else {
+            ev_out = thr_events[k][1];
+            ev_back = thr_events[k][0];
         }
-        break;
-
-    case SENSOR_STATE_NORMAL:
-        if(sensor->signed_flag){
-            if(((int8_t)sensor->readout_value) >= ((int8_t)sdr->upper_noncritical_thr)){
-                ev = IPMI_THRESHOLD_UNC_GH;
-                sensor->asserted_event.upper_non_critical_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_HIGH;
-            }
 
-            else if(((int8_t)sensor->readout_value) <= ((int8_t)sdr->lower_noncritical_thr)){
-                ev = IPMI_THRESHOLD_LNC_GL;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_LOW;
-            }
-        }
-        else{
-            if(sensor->readout_value >= sdr->upper_noncritical_thr){
-                ev = IPMI_THRESHOLD_UNC_GH;
-                sensor->asserted_event.upper_non_critical_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_HIGH;
-            }
+        ev_data[2] = ((uint8_t) sensor->thr_level[k]) ^ bias;
 
-            else if(sensor->readout_value <= sdr->lower_noncritical_thr){
-                ev = IPMI_THRESHOLD_LNC_GL;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_LOW;
+        if ( sensor->asserted_events & (1 << ev_back) ) {
+            sensor->asserted_events &= ~(1 << ev_back);
+            if ( deassert_mask & (1 << ev_back) ) {
+                ev_data[0] = 0x50 | ev_back;
+                ipmi_event_send( sensor, DEASSERTION_EVENT, ev_data, sizeof(ev_data) );
             }
         }
-        break;
-
-    case SENSOR_STATE_LOW:
-        if(sensor->signed_flag){
-            if(((int8_t)sensor->readout_value) <= ((int8_t)sdr->lower_critical_thr)){
-                ev = IPMI_THRESHOLD_LC_GH;
-                sensor->asserted_event.lower_critical_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_LOW_CRIT;
-            }
-            else if(((int8_t)sensor->readout_value) >= (((int8_t)sdr->lower_noncritical_thr) + (1+((int8_t)sdr->pos_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_non_critical_go_high){
-                    ev = IPMI_THRESHOLD_LNC_GH;
-                    sensor->asserted_event.lower_non_critical_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_NORMAL;
-            }
 
-            if(sensor->old_state != sensor->state && ((int8_t)sensor->readout_value) >= ((int8_t)sdr->lower_noncritical_thr)){
-                ev = IPMI_THRESHOLD_LNC_GL;
-                sensor->asserted_event.lower_non_critical_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(((int8_t)sensor->readout_value) <= (((int8_t)sdr->lower_noncritical_thr) - (1+((int8_t)sdr->neg_thr_hysteresis)))){
-                if(sensor->asserted_event.lower_non_critical_go_low){
-                    ev = IPMI_THRESHOLD_LNC_GL;
-                    sensor->asserted_event.lower_non_critical_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
+        sensor->asserted_events |= (1 << ev_out);
+        if ( assert_mask & (1 << ev_out) ) {
+            ev_data[0] = 0x50 | ev_out;
+            ipmi_event_send( sensor, ASSERTION_EVENT, ev_data, sizeof(ev_data) );
         }
-        else{
-            if(sensor->readout_value <= sdr->lower_critical_thr){
-                ev = IPMI_THRESHOLD_LC_GH;
-                sensor->asserted_event.lower_critical_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_LOW_CRIT;
-            }
-            else if(sensor->readout_value >= (sdr->lower_noncritical_thr + (1+sdr->pos_thr_hysteresis))){
-                if(sensor->asserted_event.upper_non_critical_go_high){
-                    ev = IPMI_THRESHOLD_LNC_GH;
-                    sensor->asserted_event.lower_non_critical_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_NORMAL;
-            }
+    }
+}
 
-            if(sensor->old_state != sensor->state && sensor->readout_value >= sdr->lower_noncritical_thr){
-                ev = IPMI_THRESHOLD_LNC_GL;
-                sensor->asserted_event.lower_non_critical_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(sensor->readout_value <= (sdr->lower_noncritical_thr - (1+sdr->neg_thr_hysteresis))){
-                if(sensor->asserted_event.lower_non_critical_go_low){
-                    ev = IPMI_THRESHOLD_LNC_GL;
-                    sensor->asserted_event.lower_non_critical_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
-        }
-        break;
-
-    case SENSOR_STATE_LOW_CRIT:
-        if(sensor->signed_flag){
-            if(((int8_t)sensor->readout_value) <= ((int8_t)sdr->lower_nonrecover_thr)){
-                ev = IPMI_THRESHOLD_LNR_GH;
-                sensor->asserted_event.lower_non_recorverable_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_LOW_NON_REC;
-            }
-            else if(((int8_t)sensor->readout_value) >= (((int8_t)sdr->lower_critical_thr) + (1+((int8_t)sdr->pos_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_critical_go_high){
-                    ev = IPMI_THRESHOLD_LC_GH;
-                    sensor->asserted_event.lower_critical_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_LOW;
-            }
+uint8_t sensor_thr_distance( sensor_t * sensor )
+{
+    SDR_type_01h_t * sdr = ( SDR_type_01h_t * ) sensor->sdr;
+    int16_t reading, dist;
+    uint8_t k, min_dist = 0xFF;
 
-            if(sensor->old_state != sensor->state && ((int8_t)sensor->readout_value) >= ((int8_t)sdr->lower_critical_thr)){
-                ev = IPMI_THRESHOLD_LC_GL;
-                sensor->asserted_event.lower_critical_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(((int8_t)sensor->readout_value) <= (((int8_t)sdr->lower_critical_thr) - (1+((int8_t)sdr->neg_thr_hysteresis)))){
-                if(sensor->asserted_event.lower_critical_go_low){
-                    ev = IPMI_THRESHOLD_LC_GL;
-                    sensor->asserted_event.lower_critical_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
-        }
-        else{
-            if(sensor->readout_value <= sdr->lower_nonrecover_thr){
-                ev = IPMI_THRESHOLD_LNR_GH;
-                sensor->asserted_event.lower_non_recorverable_go_high = 1;
-                ev_type = ASSERTION_EVENT;
-                sensor->state = SENSOR_STATE_LOW_NON_REC;
-            }
-            else if(sensor->readout_value >= (sdr->lower_critical_thr + (1+sdr->pos_thr_hysteresis))){
-                if(sensor->asserted_event.upper_critical_go_high){
-                    ev = IPMI_THRESHOLD_LC_GH;
-                    sensor->asserted_event.lower_critical_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_LOW;
-            }
+    /* Thresholds are normalized by check_sensor_event, they're not known before the first reading is checked */
+    if ( (sdr == NULL) || (sdr->hdr.rectype != TYPE_01) || (sensor->thr_norm != THR_NORM_ID(sensor)) ) {
+        return 0xFF;
+    }
 
-            if(sensor->old_state != sensor->state && sensor->readout_value >= sdr->lower_critical_thr){
-                ev = IPMI_THRESHOLD_LC_GL;
-                sensor->asserted_event.lower_critical_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(sensor->readout_value <= (sdr->lower_critical_thr - (1+sdr->neg_thr_hysteresis))){
-                if(sensor->asserted_event.lower_critical_go_low){
-                    ev = IPMI_THRESHOLD_LC_GL;
-                    sensor->asserted_event.lower_critical_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
-        }
-        break;
-
-    case SENSOR_STATE_LOW_NON_REC:
-        if(sensor->signed_flag){
-            if(((int8_t)sensor->readout_value) >= (((int8_t)sdr->lower_nonrecover_thr) + (1+((int8_t)sdr->pos_thr_hysteresis)))){
-                if(sensor->asserted_event.upper_non_recoverable_go_high){
-                    ev = IPMI_THRESHOLD_LNR_GH;
-                    sensor->asserted_event.lower_non_recorverable_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_LOW_CRIT;
-            }
+    reading = SENSOR_NORM_READING(sensor);
 
-            if(sensor->old_state != sensor->state && ((int8_t)sensor->readout_value) >= ((int8_t)sdr->lower_nonrecover_thr)){
-                ev = IPMI_THRESHOLD_LNR_GL;
-                sensor->asserted_event.lower_non_recoverable_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(((int8_t)sensor->readout_value) <= (((int8_t)sdr->lower_critical_thr) - (1+((int8_t)sdr->neg_thr_hysteresis)))){
-                if(sensor->asserted_event.lower_non_recoverable_go_low){
-                    ev = IPMI_THRESHOLD_LNR_GL;
-                    sensor->asserted_event.lower_non_recoverable_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
+    for ( k = 0; k < THR_COUNT; k++ ) {
+        if ( !(sdr->readable_threshold_mask & (1 << k)) ) {
+            continue;
         }
-        else{
-            if(sensor->readout_value >= (sdr->lower_nonrecover_thr + (1+sdr->pos_thr_hysteresis))){
-                if(sensor->asserted_event.upper_non_recoverable_go_high){
-                    ev = IPMI_THRESHOLD_LNR_GH;
-                    sensor->asserted_event.lower_non_recorverable_go_high = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-                sensor->state = SENSOR_STATE_LOW_CRIT;
-            }
-
-            if(sensor->old_state != sensor->state && sensor->readout_value >= sdr->lower_nonrecover_thr){
-                ev = IPMI_THRESHOLD_LNR_GL;
-                sensor->asserted_event.lower_non_recoverable_go_low = 1;
-                ev_type = ASSERTION_EVENT;
-            }
-            else if(sensor->readout_value <= (sdr->lower_critical_thr - (1+sdr->neg_thr_hysteresis))){
-                if(sensor->asserted_event.lower_non_recoverable_go_low){
-                    ev = IPMI_THRESHOLD_LNR_GL;
-                    sensor->asserted_event.lower_non_recoverable_go_low = 0;
-                    ev_type = DEASSERTION_EVENT;
-                }
-            }
+        dist = reading - sensor->thr_level[k];
+        if ( dist < 0 ) {
+            dist = -dist;
+        }
+        if ( dist < min_dist ) {
+            min_dist = dist;
         }
-        break;
     }
 
-    sensor->old_state = sensor->state;
-
-    if ((ev != 0xFF)) {
-        ipmi_event_send(sensor, ev_type, &ev, 1);
-    }
+    return min_dist;
 }
 
 /* Management Controller Device Locator Record 37.9 SDR Type 12h */
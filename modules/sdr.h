@@ -23,11 +23,17 @@
 #ifndef SDR_H_
 #define SDR_H_
 
+#include <stdbool.h>
 #include "ipmb.h"
 
 #define NUM_SENSOR                      21      /* Number of sensors */
 #define NUM_SDR                         (NUM_SENSOR+1)  /* Number of SDRs */
 
+/* Size of the sensor table, the highest sensor number is SDR_MAX_ENTRIES-1 */
+#define SDR_MAX_ENTRIES                 32
+/* Buckets of the lookup index by SDR pointer (power of 2, at least twice SDR_MAX_ENTRIES) */
+#define SDR_PTR_INDEX_SIZE              64
+
 /* Sensor Types */
 #define SENSOR_TYPE_TEMPERATURE         0x01
 #define SENSOR_TYPE_VOLTAGE             0x02
@@ -50,6 +56,24 @@
 #define SENSOR_STATE_HIGH_CRIT          0x10    // temperature is higher upper critical
 #define SENSOR_STATE_HIGH_NON_REC       0x20    // temperature is higher high non recoverable
 
+/* Threshold indexes, in the bit order of the IPMI threshold masks and of the Get Sensor Reading threshold status */
+enum {
+    THR_LNC = 0,
+    THR_LC,
+    THR_LNR,
+    THR_UNC,
+    THR_UC,
+    THR_UNR,
+    THR_COUNT
+};
+#define THR_LOWER_MASK                  ((1 << THR_LNC) | (1 << THR_LC) | (1 << THR_LNR))
+#define THR_UPPER_MASK                  ((1 << THR_UNC) | (1 << THR_UC) | (1 << THR_UNR))
+#define THR_ALL_MASK                    (THR_LOWER_MASK | THR_UPPER_MASK)
+
+/* Readings and thresholds are compared in the signed domain, unsigned values are moved to it by flipping their MSB (which keeps their order) */
+#define SENSOR_NORM_BIAS(sensor)        ((sensor)->signed_flag ? 0x00 : 0x80)
+#define SENSOR_NORM_READING(sensor)     ((int8_t) (((sensor)->readout_value & 0xFF) ^ SENSOR_NORM_BIAS(sensor)))
+
 /* IPMI Sensor Events */
 #define IPMI_THRESHOLD_LNC_GL           0x00    // lower non critical going low
 #define IPMI_THRESHOLD_LNC_GH           0x01    // lower non critical going high
@@ -171,40 +195,49 @@ typedef struct {
     char IDstring[16];
 } SDR_type_12h_t;
 
+/* Integer coefficients converting between a driver's measurement and the IPMI reading, see sensor_linear.h */
+typedef struct {
+    int32_t mul;                        /* reading = (measurement * mul + off * 2^off_shift) >> shift */
+    int32_t off;
+    int32_t inv_mul;                    /* measurement = (reading * inv_mul + inv_off * 2^inv_off_shift) >> inv_shift */
+    int32_t inv_off;
+    uint8_t shift;
+    uint8_t off_shift;
+    uint8_t inv_shift;
+    uint8_t inv_off_shift;
+} sensor_linear_t;
+
 typedef struct sensor_t {
     uint8_t num;
     SDR_TYPE sdr_type;
     void * sdr;
     uint8_t sdr_length;
     uint8_t diag_devID;
-    uint8_t state;
-    uint8_t old_state;
+    uint8_t state;                      /* Most severe threshold crossed (SENSOR_STATE_*) */
     uint16_t readout_value;
+    TickType_t readout_time;            /* Tick count when readout_value was acquired */
     uint8_t chipid;
     uint8_t signed_flag;
     uint8_t ownerID; /* This field is repeated here because its value is assigned during initialization, so it can't be const */
     uint8_t entityinstance; /* This field is repeated here because its value is assigned during initialization, so it can't be const */
     TaskHandle_t * task_handle;
-    struct {
-        uint16_t upper_non_recoverable_go_high:1;
-        uint16_t upper_non_recoverable_go_low:1;
-        uint16_t upper_critical_go_high:1;
-        uint16_t upper_critical_go_low:1;
-        uint16_t upper_non_critical_go_high:1;
-        uint16_t upper_non_critical_go_low:1;
-        uint16_t lower_non_recorverable_go_high:1;
-        uint16_t lower_non_recoverable_go_low:1;
-        uint16_t lower_critical_go_high:1;
-        uint16_t lower_critical_go_low:1;
-        uint16_t lower_non_critical_go_high:1;
-        uint16_t lower_non_critical_go_low:1;
-    } asserted_event;
-    struct sensor_t *next;
+    uint8_t thr_crossed;                /* Thresholds currently crossed, one bit per THR_* index */
+    uint16_t asserted_events;           /* Threshold events currently asserted, one bit per event offset */
+    int8_t thr_level[THR_COUNT];        /* Thresholds normalized to the signed domain */
+    uint8_t thr_norm;                   /* Domain thr_level was normalized to, 0 if not yet done */
+    sensor_linear_t lin;                /* Conversion coefficients, computed from the SDR by sensor_linear_init() */
+    uint8_t group;                      /* SDR_GROUP_* the sensor belongs to */
+    uint8_t active;                     /* Inactive sensors are not read nor listed in the SDR repository */
 } sensor_t;
 
+/* Sensors which are only present with some hardware, activated by #sdr_set_group_active */
+enum {
+    SDR_GROUP_NONE = 0,                 /* Always active */
+    SDR_GROUP_RTM
+};
+
 extern volatile uint8_t sdr_count;
-sensor_t *sdr_head;
-sensor_t *sdr_tail;
+extern sensor_t sensor_table[SDR_MAX_ENTRIES];
 
 const SDR_type_12h_t SDR0;
 const SDR_type_12h_t SDR_RTM_DEV_LOCATOR;
@@ -221,10 +254,52 @@ void rtm_sdr_init( void );
 void sensor_init( void );
 void check_sensor_event( sensor_t * sensor );
 
+/**
+ * @brief Distance from the current reading to the nearest readable threshold
+ *
+ * @param sensor Sensor with a Full Sensor Record
+ *
+ * @return Distance in raw reading counts, 0xFF if the sensor has no thresholds (or the distance doesn't fit)
+ */
+uint8_t sensor_thr_distance( sensor_t * sensor );
+
 sensor_t * sdr_insert_entry( SDR_TYPE type, void * sdr, TaskHandle_t *monitor_task, uint8_t diag_id, uint8_t slave_addr);
 void sdr_remove_entry( sensor_t * entry );
-void sdr_pop( void );
+
+/**
+ * @brief Assigns an entry to a presence group
+ *
+ * The entry starts inactive, until its group is activated. Must be called before the sensor drivers are initialized.
+ *
+ * @param entry Entry returned by #sdr_insert_entry
+ * @param group SDR_GROUP_* the entry belongs to
+ */
+void sdr_set_group( sensor_t * entry, uint8_t group );
+
+/**
+ * @brief Activates or deactivates all the entries of a presence group
+ *
+ * Inactive sensors are removed from the SDR repository (the change count is updated, so the Shelf Manager reads it
+ * again) and from the sensor schedule. Calling it with the current state does nothing, so it can be called on every
+ * presence poll.
+ *
+ * @param group SDR_GROUP_* to be changed
+ * @param active New state of its entries
+ */
+void sdr_set_group_active( uint8_t group, bool active );
 sensor_t * find_sensor_by_sdr( void * sdr );
 sensor_t * find_sensor_by_id( uint8_t id );
 
+/**
+ * @brief Iterates through the sensor table in record ID order
+ *
+ * Use as: for ( s = sdr_first(); s != NULL; s = sdr_next( s ) )
+ *
+ * @param cur Current entry
+ *
+ * @return Next valid entry or NULL at the end of the table
+ */
+sensor_t * sdr_next( sensor_t * cur );
+sensor_t * sdr_first( void );
+
 #endif
@@ -74,7 +74,7 @@ void hotswap_init( void )
     sensor_t * hotswap_sensor;
 
     /* Iterate through the SDR Table to find all the Hotswap entries */
-    for ( hotswap_sensor = sdr_head; hotswap_sensor != NULL; hotswap_sensor = hotswap_sensor->next) {
+    for ( hotswap_sensor = sdr_first(); hotswap_sensor != NULL; hotswap_sensor = sdr_next(hotswap_sensor) ) {
 
         if ( hotswap_sensor->task_handle == NULL ) {
             continue;
@@ -42,7 +42,11 @@
 #include "ina220.h"
 #include "fpga_spi.h"
 #include "fru.h"
+#include "sensor_sched.h"
+#include "sensor_linear.h"
+#include "uart_debug.h"
 
+/* Identifies the INA220 entries in the SDR table, they are read by the sensor scheduler */
 TaskHandle_t vTaskINA220_Handle;
 
 const ina220_config_t ina220_cfg = {
@@ -57,69 +61,60 @@ const ina220_config_t ina220_cfg = {
     .shunt_div = 100,
     .bus_voltage_shift = 3,
     .bus_voltage_lsb = 4, /* in mV */
+    .current_lsb = 1, /* in mA */
     .power_lsb = 20
 };
 
 static ina220_data_t ina220_data[MAX_INA220_COUNT];
 
-void vTaskINA220( void *Parameters )
+void ina220_read( sensor_t * ina220_sensor, void * priv )
 {
-    uint8_t i;
-    TickType_t xLastWakeTime;
-    /* Task will run every 100ms */
-    const TickType_t xFrequency = INA220_UPDATE_RATE / portTICK_PERIOD_MS;
-
-    extern const SDR_type_01h_t SDR_FMC1_12V;
-
-    sensor_t * ina220_sensor;
-    ina220_data_t * data_ptr;
-
-    /* Initialise the xLastWakeTime variable with the current time. */
-    xLastWakeTime = xTaskGetTickCount();
+    if ( !ina220_read_plan( (ina220_data_t *) priv ) ) {
+        sensor_sched_read_done( ina220_sensor );
+    }
+}
 
-    for (;;) {
-        /* Read all registers from the INA220s */
-        for ( i = 0; i < MAX_INA220_COUNT; i++) {
-            ina220_readall( &ina220_data[i] );
+static void ina220_read_done( sensor_t * ina220_sensor, void * priv )
+{
+    ina220_data_t * data_ptr = (ina220_data_t *) priv;
+    int32_t bus_voltage;
 
-            ina220_sensor = ina220_data[i].sensor;
-            data_ptr = &ina220_data[i];
+    extern const SDR_type_01h_t SDR_FMC1_12V;
 
-            if (ina220_sensor == NULL) {
-                continue;
-            }
+    if ( !data_ptr->read_ok ) {
+        return;
+    }
 
-            switch ((GET_SENSOR_TYPE(ina220_sensor))) {
-            case SENSOR_TYPE_VOLTAGE:
-                ina220_sensor->readout_value = (data_ptr->regs[INA220_BUS_VOLTAGE] >> data_ptr->config->bus_voltage_shift)/16;
-                break;
-            case SENSOR_TYPE_CURRENT:
-                /* Current in mA */
-                ina220_sensor->readout_value = data_ptr->regs[INA220_CURRENT]/32;
-                break;
-            default:
-                /* Shunt voltage and power not implemented */
-                break;
-            }
+    ina220_sensor->readout_time = xTaskGetTickCount();
+    bus_voltage = data_ptr->regs[INA220_BUS_VOLTAGE] >> data_ptr->config->bus_voltage_shift;
+
+    switch ((GET_SENSOR_TYPE(ina220_sensor))) {
+    case SENSOR_TYPE_VOLTAGE:
+        ina220_sensor->readout_value = sensor_linear_to_reading( ina220_sensor, bus_voltage );
+        break;
+    case SENSOR_TYPE_CURRENT:
+        ina220_sensor->readout_value = sensor_linear_to_reading( ina220_sensor, (int16_t) data_ptr->regs[INA220_CURRENT] );
+        break;
+    default:
+        /* Shunt voltage and power not implemented */
+        break;
+    }
 
-            /* Check for threshold events */
-            check_sensor_event(ina220_sensor);
+    /* Check for threshold events */
+    check_sensor_event(ina220_sensor);
 
 #ifdef MODULE_PAYLOAD
-            if( ina220_sensor->sdr == &SDR_FMC1_12V ) {
-                /* Check if the Payload power is in an acceptable zone */
-                SDR_type_01h_t * ina220_sdr = ( SDR_type_01h_t * ) ina220_sensor->sdr;
-                if ( ( ina220_sensor->readout_value >= (ina220_sdr->lower_critical_thr ) ) &&
-                     ( ina220_sensor->readout_value <= (ina220_sdr->upper_critical_thr ) ) ) {
-                    payload_send_message( FRU_AMC, PAYLOAD_MESSAGE_PPGOOD );
-                } else {
-                    payload_send_message( FRU_AMC, PAYLOAD_MESSAGE_PPGOODn );
-                }
-            }
-#endif
-            vTaskDelayUntil( &xLastWakeTime, xFrequency );
+    if( ina220_sensor->sdr == &SDR_FMC1_12V ) {
+        /* Check if the Payload power is in an acceptable zone, with the full resolution of the bus voltage register */
+        SDR_type_01h_t * ina220_sdr = ( SDR_type_01h_t * ) ina220_sensor->sdr;
+        if ( ( bus_voltage >= sensor_linear_to_measurement( ina220_sensor, ina220_sdr->lower_critical_thr ) ) &&
+             ( bus_voltage <= sensor_linear_to_measurement( ina220_sensor, ina220_sdr->upper_critical_thr ) ) ) {
+            payload_send_message( FRU_AMC, PAYLOAD_MESSAGE_PPGOOD );
+        } else {
+            payload_send_message( FRU_AMC, PAYLOAD_MESSAGE_PPGOODn );
         }
     }
+#endif
 }
 
 uint8_t ina220_config( ina220_data_t * data )
@@ -147,30 +142,57 @@ uint8_t ina220_config( ina220_data_t * data )
     return -1;
 }
 
-Bool ina220_readvalue( ina220_data_t * data, uint8_t reg, uint16_t *read )
+/* Queues the read of the lowest register left in data->pending, false if there's none left or it can't be queued */
+static Bool ina220_read_next( ina220_data_t * data )
 {
-    uint8_t i2c_interf, i2c_addr;
-    uint8_t val[2] = {0};
-
-    if( i2c_take_by_chipid( data->sensor->chipid, &i2c_addr, &i2c_interf, portMAX_DELAY) == pdTRUE ) {
+    uint8_t reg;
+
+    for ( reg = 0; reg < INA220_REGISTERS; reg++ ) {
+        if ( data->pending & (1 << reg) ) {
+            data->pending &= ~(1 << reg);
+            data->reg = reg;
+            if ( i2c_submit( &data->job ) ) {
+                return true;
+            }
+            data->read_ok = false;
+            return false;
+        }
+    }
 
-        xI2CMasterWriteRead( i2c_interf, i2c_addr, reg, &val[0], sizeof(val)/sizeof(val[0]) );
+    return false;
+}
 
-        i2c_give( i2c_interf );
+/* Bus worker context */
+static void ina220_job_done( i2c_job_t * job )
+{
+    ina220_data_t * data = (ina220_data_t *) job->arg;
 
-        *read = (val[0] << 8) | (val[1]);
-        return true;
+    if ( job->status == I2C_JOB_DONE ) {
+        data->regs[data->reg] = (data->val[0] << 8) | (data->val[1]);
+    } else {
+        data->read_ok = false;
     }
 
-    return false;
+    if ( !ina220_read_next( data ) ) {
+        sensor_sched_read_done( data->sensor );
+    }
 }
 
-void ina220_readall( ina220_data_t * data )
+Bool ina220_read_plan( ina220_data_t * data )
 {
-    /* Read all INA220 Registers */
-    for ( uint8_t i = 0; i < INA220_REGISTERS; i++ ) {
-        ina220_readvalue( data, i, &(data->regs[i]) );
-    }
+    data->job.chip_id = data->sensor->chipid;
+    data->job.tx_buff = &data->reg;
+    data->job.tx_len = 1;
+    data->job.rx_buff = data->val;
+    data->job.rx_len = sizeof(data->val);
+    data->job.segs = NULL;
+    data->job.callback = ina220_job_done;
+    data->job.arg = data;
+
+    data->pending = data->read_mask;
+    data->read_ok = true;
+
+    return ina220_read_next( data );
 }
 
 Bool ina220_calibrate( ina220_data_t * data )
@@ -194,18 +216,14 @@ void ina220_init( void )
 {
     sensor_t *temp_sensor;
     uint8_t i = 0;
-
-    xTaskCreate( vTaskINA220, "INA220", 200, (void *) NULL, tskINA220SENSOR_PRIORITY, &vTaskINA220_Handle);
+    uint8_t count;
+    Bool linearized;
 
     /* Iterate through the SDR Table to find all the INA220 entries */
-    for ( temp_sensor = sdr_head; temp_sensor != NULL; temp_sensor = temp_sensor->next) {
+    for ( temp_sensor = sdr_first(); temp_sensor != NULL; temp_sensor = sdr_next(temp_sensor) ) {
 
-        if ( temp_sensor->task_handle == NULL ) {
-            continue;
-        }
-
-        /* Check if this task should update the selected SDR */
-        if ( *(temp_sensor->task_handle) != vTaskINA220_Handle ) {
+        /* Check if this driver should update the selected SDR */
+        if ( temp_sensor->task_handle != &vTaskINA220_Handle ) {
             continue;
         }
 
@@ -214,11 +232,39 @@ void ina220_init( void )
             ina220_config( &ina220_data[i] );
             ina220_calibrate( &ina220_data[i] );
             ina220_data[i].sensor->signed_flag = 0;
+            linearized = true;
 
-            if ((GET_SENSOR_TYPE(ina220_data[i].sensor)) == SENSOR_TYPE_CURRENT ) {
+            /* Only the register holding the measurement of this sensor type is read periodically */
+            switch ( GET_SENSOR_TYPE(ina220_data[i].sensor) ) {
+            case SENSOR_TYPE_VOLTAGE:
+                ina220_data[i].read_mask = (1 << INA220_BUS_VOLTAGE);
+                linearized = sensor_linear_init( temp_sensor, ina220_cfg.bus_voltage_lsb, -3 );
+                break;
+            case SENSOR_TYPE_CURRENT:
+                ina220_data[i].read_mask = (1 << INA220_CURRENT);
                 ina220_data[i].sensor->signed_flag = 1;
+                linearized = sensor_linear_init( temp_sensor, ina220_cfg.current_lsb, -3 );
+                break;
+            default:
+                ina220_data[i].read_mask = (1 << INA220_REGISTERS) - 1;
+                break;
+            }
+
+            if ( !linearized ) {
+                printf("INA220: sensor %d SDR can't be linearized, readings are not converted\n", temp_sensor->num);
             }
             i++;
         }
     }
+
+    /* One sensor is read every INA220_UPDATE_RATE, in turns, as the bus load would be too high reading all of them at once */
+    count = i;
+    for ( i = 0; i < count; i++ ) {
+        sensor_sched_add( ina220_data[i].sensor, ina220_read, ina220_read_done, &ina220_data[i],
+                          (count * INA220_UPDATE_RATE) / portTICK_PERIOD_MS, (i * INA220_UPDATE_RATE) / portTICK_PERIOD_MS );
+        sensor_sched_set_bounds( ina220_data[i].sensor, INA220_UPDATE_RATE / portTICK_PERIOD_MS,
+                                 INA220_UPDATE_RATE_MAX / portTICK_PERIOD_MS );
+    }
+
+    vTaskINA220_Handle = vTaskSensorSched_Handle;
 }
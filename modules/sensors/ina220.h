@@ -42,9 +42,11 @@
 
 #include "FreeRTOS.h"
 #include "port.h"
+#include "i2c.h"
 
 #define MAX_INA220_COUNT        12
 #define INA220_UPDATE_RATE      100
+#define INA220_UPDATE_RATE_MAX  5000    /* Longest reading period of a stable sensor (the shortest is INA220_UPDATE_RATE) */
 
 /**
  * @defgroup INA220_REGS INA220 Registers
@@ -183,7 +185,8 @@ typedef struct {
     uint8_t registers;
     uint8_t shunt_div;
     uint8_t bus_voltage_shift;
-    uint16_t bus_voltage_lsb;    /* uV */
+    uint16_t bus_voltage_lsb;    /* mV */
+    uint16_t current_lsb;        /* mA, set by calibration_reg */
     uint16_t power_lsb;          /* uW */
 } ina220_config_t;
 
@@ -193,15 +196,41 @@ typedef struct {
     uint32_t rshunt;
     ina220_config_reg_t curr_reg_config;
     uint16_t regs[INA220_REGISTERS];
+    uint8_t read_mask;                  /* Registers needed by the sensor type, one bit per register address */
+
+    /* Register reads queued by ina220_read_plan() */
+    i2c_job_t job;
+    uint8_t reg;                        /* Register being read */
+    uint8_t val[2];
+    uint8_t pending;                    /* Registers left to read, one bit per register address */
+    Bool read_ok;                       /* All the registers read so far were transferred */
 } ina220_data_t;
 
 extern TaskHandle_t vTaskINA220_Handle;
 
 uint8_t ina220_config( ina220_data_t * data );
 Bool ina220_calibrate( ina220_data_t * data );
-Bool ina220_readvalue( ina220_data_t * data, uint8_t reg, uint16_t *read );
-void ina220_readall( ina220_data_t * data );
+
+/**
+ * @brief Queues the reads of the registers selected in data->read_mask on the bus worker
+ *
+ * The registers are read one after the other, each job queueing the next one from its completion. The last one calls
+ * #sensor_sched_read_done, data->regs then holds the values and data->read_ok tells whether all of them were read.
+ *
+ * @param data INA220 data, the registers read are updated in data->regs
+ *
+ * @return True if the first read was queued
+ */
+Bool ina220_read_plan( ina220_data_t * data );
 void ina220_init( void );
-void vTaskINA220( void* Parameters );
+/**
+ * @brief Sensor scheduler callback, queues the reads of the INA220 registers of the sensor
+ *
+ * The sensor reading is updated and the threshold events checked once all of them are over
+ *
+ * @param ina220_sensor INA220 sensor entry
+ * @param priv Pointer to the #ina220_data_t of the sensor
+ */
+void ina220_read( sensor_t * ina220_sensor, void * priv );
 
 #endif
@@ -41,51 +41,140 @@
 #include "lm75.h"
 #include "utils.h"
 #include "uart_debug.h"
+#include "sensor_sched.h"
+#include "sensor_linear.h"
+#include "overtemp.h"
 
+/* Identifies the LM75 entries in the SDR table, they are read by the sensor scheduler */
 TaskHandle_t vTaskLM75_Handle;
 
-void vTaskLM75( void* Parameters )
+/* Reading job of each sensor */
+typedef struct {
+    sensor_t * sensor;
+    i2c_job_t job;
+    uint8_t temp[2];
+} lm75_data_t;
+
+static lm75_data_t lm75_data[LM75_MAX_COUNT];
+
+/* Bus worker context */
+static void lm75_job_done( i2c_job_t * job )
+{
+    sensor_sched_read_done( ((lm75_data_t *) job->arg)->sensor );
+}
+
+void lm75_read( sensor_t * temp_sensor, void * priv )
+{
+    lm75_data_t * data = (lm75_data_t *) priv;
+
+    /* The pointer register is left on the temperature, only the reading is transferred */
+    data->job.chip_id = temp_sensor->chipid;
+    data->job.tx_len = 0;
+    data->job.rx_buff = data->temp;
+    data->job.rx_len = sizeof(data->temp);
+    data->job.segs = NULL;
+    data->job.callback = lm75_job_done;
+    data->job.arg = data;
+
+    if ( !i2c_submit( &data->job ) ) {
+        sensor_sched_read_done( temp_sensor );
+    }
+}
+
+static void lm75_read_done( sensor_t * temp_sensor, void * priv )
 {
-    const TickType_t xFrequency = LM75_UPDATE_RATE;
+    lm75_data_t * data = (lm75_data_t *) priv;
+
+    /* Update the temperature reading */
+    if ( data->job.status == I2C_JOB_DONE ) {
+        /* 9-bit two's complement temperature, left aligned */
+        temp_sensor->readout_value = sensor_linear_to_reading( temp_sensor, ((int16_t) ((data->temp[0] << 8) | data->temp[1])) >> 7 );
+        temp_sensor->readout_time = xTaskGetTickCount();
+    }
 
+    /* Check for threshold events */
+    check_sensor_event(temp_sensor);
+}
+
+#ifdef MODULE_OVERTEMP_ALERT
+static Bool lm75_write_limits( sensor_t * temp_sensor, int32_t tos, int32_t thyst )
+{
     uint8_t i2c_addr, i2c_interf;
-    sensor_t * temp_sensor;
-    uint8_t temp[2];
-    uint16_t converted_temp;
-
-    for ( ;; ) {
-        /* Iterate through the SDR Table to find all the LM75 entries */
-
-        for ( temp_sensor = sdr_head; temp_sensor != NULL; temp_sensor = temp_sensor->next) {
-
-            if ( temp_sensor->task_handle == NULL ) {
-                continue;
-            }
-
-            /* Check if this task should update the selected SDR */
-            if ( *(temp_sensor->task_handle) != xTaskGetCurrentTaskHandle() ) {
-                continue;
-            }
-
-            /* Try to gain the I2C bus */
-            if ( i2c_take_by_chipid( temp_sensor->chipid, &i2c_addr, &i2c_interf, portMAX_DELAY ) == pdTRUE ) {
-
-                /* Update the temperature reading */
-                if (xI2CMasterRead( i2c_interf, i2c_addr, &temp[0], 2) == 2) {
-                    converted_temp = ((temp[0] << 1) | ((temp[1]>>7)));
-                    temp_sensor->readout_value = converted_temp;
-                }
-                /* Check for threshold events */
-                i2c_give(i2c_interf);
-                check_sensor_event(temp_sensor);
-            }
-        }
-        vTaskDelay(xFrequency);
+    /* Interrupt mode: OS is asserted when TOS is exceeded (and again when the temperature drops below THYST) and released
+     * when any register is read, so the other devices on the shared line can still signal their alerts */
+    uint8_t conf[2] = { LM75_REG_CONF, LM75_CONF_OS_INT | LM75_CONF_FAULT_QUEUE_2 };
+    uint8_t thyst_reg[3] = { LM75_REG_THYST, (thyst >> 1) & 0xFF, (thyst & 1) << 7 };
+    uint8_t tos_reg[3] = { LM75_REG_TOS, (tos >> 1) & 0xFF, (tos & 1) << 7 };
+    uint8_t ptr = LM75_REG_TEMP;
+    Bool written = false;
+
+    if ( i2c_take_by_chipid( temp_sensor->chipid, &i2c_addr, &i2c_interf, portMAX_DELAY ) == pdTRUE ) {
+        written = ( xI2CMasterWrite( i2c_interf, i2c_addr, conf, sizeof(conf) ) == sizeof(conf) ) &&
+            ( xI2CMasterWrite( i2c_interf, i2c_addr, thyst_reg, sizeof(thyst_reg) ) == sizeof(thyst_reg) ) &&
+            ( xI2CMasterWrite( i2c_interf, i2c_addr, tos_reg, sizeof(tos_reg) ) == sizeof(tos_reg) );
+
+        /* lm75_read() relies on the pointer selecting the temperature register */
+        xI2CMasterWrite( i2c_interf, i2c_addr, &ptr, 1 );
+        i2c_give( i2c_interf );
     }
+
+    return written;
 }
 
+static void lm75_set_alert( sensor_t * temp_sensor )
+{
+    int32_t tos, thyst;
+
+    if ( !overtemp_limits( temp_sensor, &tos, &thyst ) ) {
+        return;
+    }
+
+    if ( tos > LM75_TEMP_MAX ) {
+        tos = LM75_TEMP_MAX;
+    }
+    if ( thyst > tos ) {
+        thyst = tos;
+    }
+
+    if ( lm75_write_limits( temp_sensor, tos, thyst ) ) {
+        /* Excursions are signalled by the OS line, the periodic reading can be relaxed */
+        sensor_sched_set_alert( temp_sensor, SENSOR_ALERT_OVERTEMP );
+        sensor_sched_set_bounds( temp_sensor, LM75_UPDATE_RATE_MIN / portTICK_PERIOD_MS,
+                                 LM75_ALERT_UPDATE_RATE_MAX / portTICK_PERIOD_MS );
+    }
+}
+#endif
 
 void LM75_init( void )
 {
-    xTaskCreate( vTaskLM75, "LM75", 200, (void *) NULL, tskLM75SENSOR_PRIORITY, &vTaskLM75_Handle);
+    sensor_t * temp_sensor;
+    uint8_t i = 0;
+
+    for ( temp_sensor = sdr_first(); temp_sensor != NULL; temp_sensor = sdr_next( temp_sensor ) ) {
+        if ( temp_sensor->task_handle != &vTaskLM75_Handle ) {
+            continue;
+        }
+
+        if ( !sensor_linear_init( temp_sensor, LM75_LSB, LM75_LSB_EXP ) ) {
+            printf("LM75: sensor %d SDR can't be linearized, readings are not converted\n", temp_sensor->num);
+        }
+
+        if ( i < LM75_MAX_COUNT ) {
+            lm75_data[i].sensor = temp_sensor;
+            sensor_sched_add( temp_sensor, lm75_read, lm75_read_done, &lm75_data[i], LM75_UPDATE_RATE / portTICK_PERIOD_MS, 0 );
+            sensor_sched_set_bounds( temp_sensor, LM75_UPDATE_RATE_MIN / portTICK_PERIOD_MS, LM75_UPDATE_RATE_MAX / portTICK_PERIOD_MS );
+            i++;
+        }
+    }
+
+#ifdef MODULE_OVERTEMP_ALERT
+    for ( temp_sensor = sdr_first(); temp_sensor != NULL; temp_sensor = sdr_next( temp_sensor ) ) {
+        if ( temp_sensor->task_handle == &vTaskLM75_Handle ) {
+            lm75_set_alert( temp_sensor );
+        }
+    }
+#endif
+
+    /* Sensors which report who updates them refer to the scheduler */
+    vTaskLM75_Handle = vTaskSensorSched_Handle;
 }
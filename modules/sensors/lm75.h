@@ -45,7 +45,38 @@
  * @brief Rate at which the LM75 sensors are read (in ms)
  */
 #define LM75_UPDATE_RATE        500
+/**
+ * @brief Bounds of the adaptive reading period of the LM75 sensors (in ms)
+ */
+#define LM75_UPDATE_RATE_MIN    100
+#define LM75_UPDATE_RATE_MAX    2000
 
+/**
+ * @brief Number of LM75 sensors that can be read
+ */
+#define LM75_MAX_COUNT          8
+
+/**
+ * @brief Longest reading period of a stable LM75 whose limits are signalled by the OS line (in ms)
+ */
+#define LM75_ALERT_UPDATE_RATE_MAX  10000
+
+#define LM75_REG_TEMP           0x00
+#define LM75_REG_CONF           0x01
+#define LM75_REG_THYST          0x02
+#define LM75_REG_TOS            0x03
+
+#define LM75_CONF_OS_INT        (1 << 1)    /* OS in interrupt mode (comparator mode otherwise) */
+#define LM75_CONF_FAULT_QUEUE_2 (1 << 3)    /* Two consecutive faults assert OS */
+
+/* Temperature resolution: 0.5 C */
+#define LM75_LSB                5
+#define LM75_LSB_EXP            (-1)
+#define LM75_TEMP_MAX           255         /* Largest 9-bit temperature, in LSBs */
+
+/**
+ * @brief Identifies the LM75 entries in the SDR table (points to the sensor scheduler task after #LM75_init)
+ */
 extern TaskHandle_t vTaskLM75_Handle;
 
 extern const SDR_type_01h_t SDR_LM75_uC;
@@ -54,19 +85,21 @@ extern const SDR_type_01h_t SDR_LM75_DCDC;
 extern const SDR_type_01h_t SDR_LM75_RAM;
 
 /**
- * @brief Initializes LM75 monitoring task
+ * @brief Schedules the reading of all LM75 sensors
  *
  * @return None
  */
 void LM75_init( void );
 
 /**
- * @brief Monitoring task for LM75 sensor
+ * @brief Sensor scheduler callback, queues the temperature reading of a LM75 sensor on its bus worker
  *
- * This task unblocks after every #LM75_UPDATE_RATE ms and updates the read from all the LM75 sensors listed in this module's SDR table
+ * Called every #LM75_UPDATE_RATE ms for each LM75 listed in this module's SDR table. The reading is converted and the
+ * threshold events checked once the transfer is over.
  *
- * @param Parameters Pointer to parameter list passed to task upon initialization (not used here)
+ * @param temp_sensor LM75 sensor entry
+ * @param priv Reading job of the sensor
  */
-void vTaskLM75( void* Parameters );
+void lm75_read( sensor_t * temp_sensor, void * priv );
 
 #endif
@@ -40,42 +40,147 @@
 #include "max6642.h"
 #include "utils.h"
 #include "uart_debug.h"
+#include "sensor_sched.h"
+#include "sensor_linear.h"
+#include "overtemp.h"
 
+/* Identifies the MAX6642 entries in the SDR table, they are read by the sensor scheduler */
 TaskHandle_t vTaskMAX6642_Handle;
 
-void vTaskMAX6642( void* Parameters )
+/* Reading jobs of each sensor */
+typedef struct {
+    sensor_t * sensor;
+    i2c_job_t job;
+    uint8_t cmd;                        /* Register read by the job */
+    uint8_t value;
+    Bool temp_read;                     /* The remote temperature was read */
+} max6642_data_t;
+
+static max6642_data_t max6642_data[MAX6642_MAX_COUNT];
+
+static Bool max6642_submit( max6642_data_t * data, uint8_t cmd )
 {
-    const TickType_t xFrequency = MAX6642_UPDATE_RATE;
+    data->cmd = cmd;
+    data->job.tx_buff = &data->cmd;
+    data->job.tx_len = 1;
+    data->job.rx_buff = &data->value;
+    data->job.rx_len = 1;
 
-    sensor_t * temp_sensor;
+    return i2c_submit( &data->job );
+}
 
-    for ( ;; ) {
-        /* Iterate through the SDR Table to find all the LM75 entries */
+/* Bus worker context */
+static void max6642_job_done( i2c_job_t * job )
+{
+    max6642_data_t * data = (max6642_data_t *) job->arg;
 
-        for ( temp_sensor = sdr_head; temp_sensor != NULL; temp_sensor = temp_sensor->next ) {
+    if ( data->cmd == MAX6642_CMD_READ_STATUS ) {
+        /* The status only had to be read, the temperature comes next */
+        if ( max6642_submit( data, MAX6642_CMD_READ_REMOTE ) ) {
+            return;
+        }
+    } else {
+        data->temp_read = ( job->status == I2C_JOB_DONE );
+    }
 
-            if ( temp_sensor->task_handle == NULL ) {
-                continue;
-            }
+    sensor_sched_read_done( data->sensor );
+}
 
-            /* Check if this task should update the selected SDR */
-            if ( *(temp_sensor->task_handle) != xTaskGetCurrentTaskHandle() ) {
-                continue;
-            }
+void max6642_read( sensor_t * temp_sensor, void * priv )
+{
+    max6642_data_t * data = (max6642_data_t *) priv;
+    uint8_t cmd = MAX6642_CMD_READ_REMOTE;
 
-            /* Update the temperature reading */
-            max6642_read_remote( temp_sensor, (uint8_t *) &(temp_sensor->readout_value) );
+#ifdef MODULE_OVERTEMP_ALERT
+    /* 'ALERT stays asserted until the status is read */
+    if ( overtemp_asserted() ) {
+        cmd = MAX6642_CMD_READ_STATUS;
+    }
+#endif
 
-            /* Check for threshold events */
-            check_sensor_event( temp_sensor );
-        }
-        vTaskDelay(xFrequency);
+    data->job.chip_id = temp_sensor->chipid;
+    data->job.segs = NULL;
+    data->job.callback = max6642_job_done;
+    data->job.arg = data;
+    data->temp_read = false;
+
+    if ( !max6642_submit( data, cmd ) ) {
+        sensor_sched_read_done( temp_sensor );
     }
 }
 
+static void max6642_read_done( sensor_t * temp_sensor, void * priv )
+{
+    max6642_data_t * data = (max6642_data_t *) priv;
+
+    /* Update the temperature reading */
+    if ( data->temp_read ) {
+        temp_sensor->readout_value = sensor_linear_to_reading( temp_sensor, data->value );
+        temp_sensor->readout_time = xTaskGetTickCount();
+    }
+
+    /* Check for threshold events */
+    check_sensor_event( temp_sensor );
+}
+
+#ifdef MODULE_OVERTEMP_ALERT
+static void max6642_set_alert( sensor_t * temp_sensor )
+{
+    int32_t limit, release;
+
+    /* There's no hysteresis setting, 'ALERT is asserted while the remote temperature is above the limit */
+    if ( !overtemp_limits( temp_sensor, &limit, &release ) ) {
+        return;
+    }
+
+    if ( limit > UINT8_MAX ) {
+        limit = UINT8_MAX;
+    } else if ( limit < 0 ) {
+        limit = 0;
+    }
+
+    /* Without the limit in the chip the 'ALERT line can't be relied on, the sensor stays on its normal polling */
+    if ( max6642_write_remote_limit( temp_sensor, limit ) ) {
+        /* Excursions are signalled by the 'ALERT line, the periodic reading can be relaxed */
+        sensor_sched_set_alert( temp_sensor, SENSOR_ALERT_OVERTEMP );
+        sensor_sched_set_bounds( temp_sensor, MAX6642_UPDATE_RATE_MIN / portTICK_PERIOD_MS,
+                                 MAX6642_ALERT_UPDATE_RATE_MAX / portTICK_PERIOD_MS );
+    }
+}
+#endif
+
 void MAX6642_init( void )
 {
-    xTaskCreate( vTaskMAX6642, "MAX6642", 200, (void *) NULL, tskMAX6642SENSOR_PRIORITY, &vTaskMAX6642_Handle );
+    sensor_t * temp_sensor;
+    uint8_t i = 0;
+
+    for ( temp_sensor = sdr_first(); temp_sensor != NULL; temp_sensor = sdr_next( temp_sensor ) ) {
+        if ( temp_sensor->task_handle != &vTaskMAX6642_Handle ) {
+            continue;
+        }
+
+        if ( !sensor_linear_init( temp_sensor, MAX6642_LSB, MAX6642_LSB_EXP ) ) {
+            printf("MAX6642: sensor %d SDR can't be linearized, readings are not converted\n", temp_sensor->num);
+        }
+
+        if ( i < MAX6642_MAX_COUNT ) {
+            max6642_data[i].sensor = temp_sensor;
+            sensor_sched_add( temp_sensor, max6642_read, max6642_read_done, &max6642_data[i], MAX6642_UPDATE_RATE / portTICK_PERIOD_MS, 0 );
+            sensor_sched_set_bounds( temp_sensor, MAX6642_UPDATE_RATE_MIN / portTICK_PERIOD_MS, MAX6642_UPDATE_RATE_MAX / portTICK_PERIOD_MS );
+            i++;
+        }
+    }
+
+#ifdef MODULE_OVERTEMP_ALERT
+    for ( temp_sensor = sdr_first(); temp_sensor != NULL; temp_sensor = sdr_next( temp_sensor ) ) {
+        if ( temp_sensor->task_handle == &vTaskMAX6642_Handle ) {
+            max6642_set_alert( temp_sensor );
+        }
+    }
+#endif
+
+    /* Sensors which report who updates them refer to the scheduler */
+    vTaskMAX6642_Handle = vTaskSensorSched_Handle;
 }
 
 Bool max6642_read_local( sensor_t *sensor, uint8_t *temp )
@@ -186,26 +291,32 @@ void max6642_write_cfg( sensor_t *sensor, uint8_t cfg )
     }
 }
 
-void max6642_write_local_limit( sensor_t *sensor, uint8_t limit )
+Bool max6642_write_local_limit( sensor_t *sensor, uint8_t limit )
 {
     uint8_t i2c_interf, i2c_addr;
     uint8_t msg[2] = { MAX6642_CMD_WRITE_LOCAL_LIMIT, limit };
+    Bool written = false;
 
     if ( i2c_take_by_chipid( sensor->chipid, &i2c_addr, &i2c_interf, portMAX_DELAY) == pdTRUE ) {
 
-        xI2CMasterWrite( i2c_interf, i2c_addr, &msg[0], 2);
+        written = ( xI2CMasterWrite( i2c_interf, i2c_addr, &msg[0], 2) == 2 );
         i2c_give( i2c_interf );
     }
+
+    return written;
 }
 
-void max6642_write_remote_limit( sensor_t *sensor, uint8_t limit )
+Bool max6642_write_remote_limit( sensor_t *sensor, uint8_t limit )
 {
     uint8_t i2c_interf, i2c_addr;
     uint8_t msg[2] = { MAX6642_CMD_WRITE_REMOTE_LIMIT, limit };
+    Bool written = false;
 
     if ( i2c_take_by_chipid( sensor->chipid, &i2c_addr, &i2c_interf, portMAX_DELAY) == pdTRUE ) {
 
-        xI2CMasterWrite( i2c_interf, i2c_addr, &msg[0], 2);
+        written = ( xI2CMasterWrite( i2c_interf, i2c_addr, &msg[0], 2) == 2 );
         i2c_give( i2c_interf );
     }
+
+    return written;
 }
@@ -36,6 +36,14 @@
 #define MAX6642_H_
 
 #define MAX6642_UPDATE_RATE             500
+#define MAX6642_UPDATE_RATE_MIN         100     /* Adaptive reading period bounds */
+#define MAX6642_UPDATE_RATE_MAX         2000
+#define MAX6642_ALERT_UPDATE_RATE_MAX   10000   /* Longest reading period when the limit is signalled by 'ALERT */
+#define MAX6642_MAX_COUNT               2       /* Number of MAX6642 sensors that can be read */
+
+/* Temperature resolution of the main registers: 1 C */
+#define MAX6642_LSB                     1
+#define MAX6642_LSB_EXP                 0
 
 #define MAX6642_CMD_READ_LOCAL          0x00
 #define MAX6642_CMD_READ_REMOTE         0x01
@@ -64,25 +72,29 @@
 #define MAX6642_STATUS_OPEN_MASK        (1 << 4)
 
 /**
- * @brief MAX6642 monitor Task Handle
+ * @brief Identifies the MAX6642 entries in the SDR table (points to the sensor scheduler task after #MAX6642_init)
  */
 extern TaskHandle_t vTaskMAX6642_Handle;
 
 extern const SDR_type_01h_t SDR_MAX6642_FPGA;
 
 /**
- * @brief Initializes MAX6642 sensor and creates #vTaskMAX6642
+ * @brief Schedules the reading of all MAX6642 sensors
  *
  * @return None
  */
 void MAX6642_init( void );
 
 /**
- * @brief MAX6642 Monitor Task
+ * @brief Sensor scheduler callback, queues the remote temperature reading of a MAX6642 sensor on its bus worker
+ *
+ * While the 'ALERT line is asserted the status register is read first, which releases it. The reading is converted and
+ * the threshold events checked once the transfers are over.
  *
- * @param Parameters Pointer to parameter list passed to task upon initialization (not used here)
+ * @param temp_sensor MAX6642 sensor entry
+ * @param priv Reading jobs of the sensor
  */
-void vTaskMAX6642( void *Parameters );
+void max6642_read( sensor_t * temp_sensor, void * priv );
 
 /**
  * @brief Reads MAX6642's local temperature value
@@ -180,15 +192,19 @@ void max6642_write_cfg( sensor_t *sensor, uint8_t cfg );
  *
  * @param sensor Pointer to sensor info struct
  * @param limit High temperature limit value
+ *
+ * @return true if the limit was written
  */
-void max6642_write_local_limit( sensor_t *sensor, uint8_t limit );
+Bool max6642_write_local_limit( sensor_t *sensor, uint8_t limit );
 
 /**
  * @brief Sets external high temperature limit that asserts 'ALERT
  *
  * @param sensor Pointer to sensor info struct
  * @param limit High temperature limit value
+ *
+ * @return true if the limit was written
  */
-void max6642_write_remote_limit( sensor_t *sensor, uint8_t limit );
+Bool max6642_write_remote_limit( sensor_t *sensor, uint8_t limit );
 
 #endif
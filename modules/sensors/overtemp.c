@@ -0,0 +1,102 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file overtemp.c
+ * @author agent <agent@local>
+ *
+ * @brief Over-temperature alert line handling
+ *
+ * @ingroup SENSORS
+ */
+
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Project Includes */
+#include "port.h"
+#include "sdr.h"
+#include "sensor_sched.h"
+#include "sensor_linear.h"
+#include "overtemp.h"
+
+void GPIO_INT_IRQHandler( void )
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if ( gpio_int_falling_pending( PIN_PORT(GPIO_OVERTEMPn), PIN_NUMBER(GPIO_OVERTEMPn) ) ) {
+        gpio_int_clear( PIN_PORT(GPIO_OVERTEMPn), PIN_NUMBER(GPIO_OVERTEMPn) );
+        sensor_sched_alert_from_isr( SENSOR_ALERT_OVERTEMP, &xHigherPriorityTaskWoken );
+    }
+
+    portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+}
+
+void overtemp_init( void )
+{
+    gpio_int_clear( PIN_PORT(GPIO_OVERTEMPn), PIN_NUMBER(GPIO_OVERTEMPn) );
+    gpio_int_enable_falling( PIN_PORT(GPIO_OVERTEMPn), PIN_NUMBER(GPIO_OVERTEMPn) );
+
+    irq_set_priority( GPIO_INT_IRQ, configMAX_SYSCALL_INTERRUPT_PRIORITY );
+    irq_enable( GPIO_INT_IRQ );
+}
+
+Bool overtemp_limits( sensor_t * sensor, int32_t * limit, int32_t * release )
+{
+    SDR_type_01h_t * sdr = (SDR_type_01h_t *) sensor->sdr;
+    int16_t thr, rel;
+    uint8_t k;
+
+    for ( k = THR_UNC; k <= THR_UNR; k++ ) {
+        if ( sdr->readable_threshold_mask & (1 << k) ) {
+            break;
+        }
+    }
+
+    switch ( k ) {
+    case THR_UNC:
+        thr = sdr->upper_noncritical_thr;
+        break;
+    case THR_UC:
+        thr = sdr->upper_critical_thr;
+        break;
+    case THR_UNR:
+        thr = sdr->upper_nonrecover_thr;
+        break;
+    default:
+        return false;
+    }
+
+    /* Same rule as check_sensor_event(): crossed at the threshold, released one count past the hysteresis */
+    if ( sensor->signed_flag ) {
+        thr = (int8_t) thr;
+    }
+    rel = thr - 1 - sdr->pos_thr_hysteresis;
+    if ( rel < (sensor->signed_flag ? INT8_MIN : 0) ) {
+        rel = (sensor->signed_flag ? INT8_MIN : 0);
+    }
+
+    *limit = sensor_linear_to_measurement( sensor, (uint8_t) thr ) - 1;
+    *release = sensor_linear_to_measurement( sensor, (uint8_t) rel );
+
+    return true;
+}
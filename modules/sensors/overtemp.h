@@ -0,0 +1,66 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file overtemp.h
+ * @author agent <agent@local>
+ *
+ * @brief Over-temperature alert line handling
+ *
+ * The temperature sensors which have a limit output (LM75 OS, MAX6642 'ALERT) drive the shared GPIO_OVERTEMPn line.
+ * Their limits are programmed from the SDR thresholds, and a falling edge on the line makes the sensor scheduler read
+ * all of them right away, so an excursion doesn't wait for the next periodic reading.
+ *
+ * @ingroup SENSORS
+ */
+
+#ifndef OVERTEMP_H_
+#define OVERTEMP_H_
+
+#include "port.h"
+#include "sdr.h"
+
+/**
+ * @brief Enables the GPIO_OVERTEMPn interrupt. Must be called after the drivers programmed their limits
+ */
+void overtemp_init( void );
+
+/**
+ * @brief Finds the limits to be programmed in a temperature sensor from its SDR
+ *
+ * The lowest readable upper threshold is used, so the line is asserted as soon as the first threshold event is due.
+ *
+ * @param[in] sensor Sensor, with its linear conversion already initialized
+ * @param[out] limit Measurement above which the threshold is crossed (in the driver units)
+ * @param[out] release Measurement at which the threshold is released, taking the SDR hysteresis into account
+ *
+ * @return false if the sensor has no readable upper threshold
+ */
+Bool overtemp_limits( sensor_t * sensor, int32_t * limit, int32_t * release );
+
+/**
+ * @brief Reads the state of the alert line
+ *
+ * @return true if some sensor is asserting the line
+ */
+#define overtemp_asserted()     ( gpio_read_pin( PIN_PORT(GPIO_OVERTEMPn), PIN_NUMBER(GPIO_OVERTEMPn) ) == 0 )
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_history.c
+ * @author agent <agent@local>
+ *
+ * @brief Sensor readings history implementation
+ *
+ * @ingroup SENSORS
+ */
+
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Project Includes */
+#include "string.h"
+#include "sdr.h"
+#include "ipmi.h"
+#include "sensor_history.h"
+
+typedef struct {
+    uint8_t value[SENSOR_HISTORY_LEN];  /* Raw readings */
+    uint16_t time[SENSOR_HISTORY_LEN];  /* Reading times, in SENSOR_HISTORY_TIME_UNIT */
+    uint8_t head;                       /* Next position to be written */
+    uint8_t count;                      /* Readings stored */
+    TickType_t last_time;               /* readout_time of the last reading stored */
+    /* Statistics, kept in the normalized (signed) domain */
+    int8_t min;
+    int8_t max;
+    uint32_t samples;
+    int64_t sum;
+} sensor_history_t;
+
+/* Indexed by sensor number */
+static sensor_history_t history[SDR_MAX_ENTRIES];
+
+#define TICKS_TO_TIME(t)        ((uint16_t) (((t) * portTICK_PERIOD_MS) / SENSOR_HISTORY_TIME_UNIT))
+
+void sensor_history_record( sensor_t * sensor )
+{
+    sensor_history_t * hist = &history[sensor->num];
+    int8_t norm = SENSOR_NORM_READING(sensor);
+
+    taskENTER_CRITICAL();
+
+    /* The driver didn't get a new reading */
+    if ( (hist->count > 0) && (hist->last_time == sensor->readout_time) ) {
+        taskEXIT_CRITICAL();
+        return;
+    }
+
+    hist->last_time = sensor->readout_time;
+    hist->value[hist->head] = sensor->readout_value & 0xFF;
+    hist->time[hist->head] = TICKS_TO_TIME( sensor->readout_time );
+    hist->head = (hist->head + 1) % SENSOR_HISTORY_LEN;
+    if ( hist->count < SENSOR_HISTORY_LEN ) {
+        hist->count++;
+    }
+
+    if ( (hist->samples == 0) || (norm < hist->min) ) {
+        hist->min = norm;
+    }
+    if ( (hist->samples == 0) || (norm > hist->max) ) {
+        hist->max = norm;
+    }
+    hist->samples++;
+    hist->sum += norm;
+
+    taskEXIT_CRITICAL();
+}
+
+void sensor_history_clear( sensor_t * sensor )
+{
+    taskENTER_CRITICAL();
+    memset( &history[sensor->num], 0, sizeof(sensor_history_t) );
+    taskEXIT_CRITICAL();
+}
+
+void sensor_history_reset_stats( sensor_t * sensor )
+{
+    sensor_history_t * hist = &history[sensor->num];
+
+    taskENTER_CRITICAL();
+    hist->samples = 0;
+    hist->sum = 0;
+    taskEXIT_CRITICAL();
+}
+
+/* IPMI Handlers */
+
+#define HISTORY_ENTRIES_PER_RSP     7
+
+/**
+ * @brief Reads a page of the readings history of a sensor, newest first
+ *
+ * Request:  [0] = sensor number, [1] = index of the first reading (0 is the newest)
+ * Response: [0] = readings stored, [1] = readings returned, followed by up to 7 entries of
+ *           [raw reading, age in SENSOR_HISTORY_TIME_UNIT (2 bytes, LSB first)]
+ */
+IPMI_HANDLER(ipmi_custom_get_sensor_history, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_SENSOR_HISTORY, ipmi_msg *req, ipmi_msg *rsp)
+{
+    uint8_t len = 0;
+    uint8_t i, n, pos;
+    uint16_t now, age;
+    sensor_history_t * hist;
+
+    if ( req->data_len < 2 ) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        rsp->data_len = 0;
+        return;
+    }
+
+    if ( find_sensor_by_id( req->data[0] ) == NULL ) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        rsp->data_len = 0;
+        return;
+    }
+
+    hist = &history[req->data[0]];
+    now = TICKS_TO_TIME( xTaskGetTickCount() );
+
+    taskENTER_CRITICAL();
+
+    n = (req->data[1] < hist->count) ? (hist->count - req->data[1]) : 0;
+    if ( n > HISTORY_ENTRIES_PER_RSP ) {
+        n = HISTORY_ENTRIES_PER_RSP;
+    }
+
+    rsp->data[len++] = hist->count;
+    rsp->data[len++] = n;
+
+    /* Walk backwards from the newest reading, only the requested page is copied */
+    for ( i = 0; i < n; i++ ) {
+        pos = (hist->head + 2 * SENSOR_HISTORY_LEN - 1 - req->data[1] - i) % SENSOR_HISTORY_LEN;
+        age = now - hist->time[pos];
+        rsp->data[len++] = hist->value[pos];
+        rsp->data[len++] = age & 0xFF;
+        rsp->data[len++] = age >> 8;
+    }
+
+    taskEXIT_CRITICAL();
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
+
+/**
+ * @brief Reads the statistics of a sensor since their last reset
+ *
+ * Request:  [0] = sensor number, [1] = 1 to reset the statistics after reading them (optional)
+ * Response: [0] = min, [1] = max (raw readings), [2..3] = mean in raw units, 8.8 fixed point (LSB first, signed for
+ *           sensors with signed readings), [4..7] = number of readings (LSB first)
+ */
+IPMI_HANDLER(ipmi_custom_get_sensor_stats, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_SENSOR_STATS, ipmi_msg *req, ipmi_msg *rsp)
+{
+    uint8_t len = 0;
+    sensor_t * sensor;
+    sensor_history_t * hist;
+    uint8_t bias;
+    int8_t min = 0, max = 0;
+    uint32_t samples;
+    int64_t sum;
+    int32_t mean = 0;
+
+    if ( req->data_len < 1 ) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        rsp->data_len = 0;
+        return;
+    }
+
+    sensor = find_sensor_by_id( req->data[0] );
+    if ( sensor == NULL ) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        rsp->data_len = 0;
+        return;
+    }
+
+    hist = &history[sensor->num];
+
+    taskENTER_CRITICAL();
+    samples = hist->samples;
+    sum = hist->sum;
+    min = hist->min;
+    max = hist->max;
+    taskEXIT_CRITICAL();
+
+    if ( (req->data_len > 1) && (req->data[1] & 0x01) ) {
+        sensor_history_reset_stats( sensor );
+    }
+
+    bias = SENSOR_NORM_BIAS(sensor);
+
+    if ( samples ) {
+        /* Back from the normalized domain: unsigned readings were offset by -128 */
+        mean = (int32_t) ((sum * 256) / (int64_t) samples) + (bias << 8);
+    }
+
+    rsp->data[len++] = ((uint8_t) min) ^ bias;
+    rsp->data[len++] = ((uint8_t) max) ^ bias;
+    rsp->data[len++] = mean & 0xFF;
+    rsp->data[len++] = (mean >> 8) & 0xFF;
+    rsp->data[len++] = samples & 0xFF;
+    rsp->data[len++] = (samples >> 8) & 0xFF;
+    rsp->data[len++] = (samples >> 16) & 0xFF;
+    rsp->data[len++] = (samples >> 24) & 0xFF;
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
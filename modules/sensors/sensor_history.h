@@ -0,0 +1,86 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_history.h
+ * @author agent <agent@local>
+ *
+ * @brief Recent readings and running statistics of each sensor
+ *
+ * Every reading taken by the sensor scheduler is stored, with its time, in a small ring buffer of the sensor. The
+ * minimum, maximum and mean since the last reset are kept too. Both are read with the NETFN_CUSTOM commands
+ * IPMI_CUSTOM_CMD_GET_SENSOR_HISTORY and IPMI_CUSTOM_CMD_GET_SENSOR_STATS.
+ *
+ * @warning When MODULE_SENSOR_HISTORY is not defined, the functions below are replaced by macros that do nothing
+ *
+ * @ingroup SENSORS
+ */
+
+#ifndef SENSOR_HISTORY_H_
+#define SENSOR_HISTORY_H_
+
+#include "sdr.h"
+
+/**
+ * @brief Number of readings kept per sensor
+ */
+#define SENSOR_HISTORY_LEN              16
+
+/**
+ * @brief Resolution of the reading timestamps (in ms). Their 16 bits wrap after ~109 minutes
+ */
+#define SENSOR_HISTORY_TIME_UNIT        100
+
+#ifdef MODULE_SENSOR_HISTORY
+
+/**
+ * @brief Stores the latest reading of a sensor, if it wasn't stored yet
+ *
+ * @param sensor Sensor just read
+ */
+void sensor_history_record( sensor_t * sensor );
+
+/**
+ * @brief Forgets the readings and statistics stored for a sensor number
+ *
+ * Called when an SDR entry is inserted or removed, so a new sensor taking a freed number doesn't show the old one's
+ * readings.
+ *
+ * @param sensor Sensor whose number is being (re)used
+ */
+void sensor_history_clear( sensor_t * sensor );
+
+/**
+ * @brief Clears the statistics of a sensor (the stored readings are kept)
+ *
+ * @param sensor Sensor to be reset
+ */
+void sensor_history_reset_stats( sensor_t * sensor );
+
+#else
+
+#define sensor_history_record(sensor)           (void)0
+#define sensor_history_clear(sensor)            (void)0
+#define sensor_history_reset_stats(sensor)      (void)0
+
+#endif
+
+#endif
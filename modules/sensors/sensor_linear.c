@@ -0,0 +1,240 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_linear.c
+ * @author agent <agent@local>
+ *
+ * @brief Conversion between the drivers' measurements and the IPMI sensor readings
+ *
+ * @ingroup SENSORS
+ */
+
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+
+/* Project Includes */
+#include "port.h"
+#include "sdr.h"
+#include "sensor_linear.h"
+
+/* Largest power of ten used while folding the exponents */
+#define LINEAR_MAX_EXP          9
+
+static const int32_t pow10_table[LINEAR_MAX_EXP + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/* Largest shift of the products: x * mul stays within 62 bits for any 32-bit x, and the offset checks shift by s + 3 */
+#define LINEAR_MAX_SHIFT        60
+
+#define ABS64(x)                ((uint64_t) (((x) < 0) ? -(x) : (x)))
+
+/* Sign extends the n-bit value x */
+#define SIGN_EXTEND(x, n)       ((int32_t) (((x) ^ (1 << ((n) - 1))) - (1 << ((n) - 1))))
+
+static uint64_t gcd( uint64_t a, uint64_t b )
+{
+    uint64_t t;
+
+    while ( b ) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* round(a * 2^s / den) for den > 0, without overflowing when a * 2^s doesn't fit in 64 bits but the result does */
+static int64_t div_scaled( int64_t a, int64_t den, uint8_t s )
+{
+    uint64_t rem = ABS64( a % den ), frac = 0;
+    uint8_t i;
+
+    /* Binary long division of the remainder, one bit of the fraction at a time */
+    for ( i = 0; i < s; i++ ) {
+        rem <<= 1;
+        frac <<= 1;
+        if ( rem >= (uint64_t) den ) {
+            rem -= den;
+            frac |= 1;
+        }
+    }
+    if ( 2 * rem >= (uint64_t) den ) {
+        frac++;
+    }
+
+    return (a / den) * ((int64_t) 1 << s) + ( (a < 0) ? -(int64_t) frac : (int64_t) frac );
+}
+
+/*
+ * Finds the coefficients for which (x * mul + off * 2^off_shift) >> shift == round((x * num + add) / den), taking the
+ * largest shift which keeps mul in 32 bits. The offset, which may be much larger than the product (e.g. a big B), keeps
+ * its own exponent so it doesn't limit the precision of mul. Only called when the sensor is registered, the divisions
+ * are done here.
+ */
+static Bool linear_coeffs( int64_t num, int64_t add, int64_t den, int32_t * mul, int32_t * off, uint8_t * shift,
+                           uint8_t * off_shift )
+{
+    uint64_t g;
+    int64_t m, o, q;
+    int8_t s, t;
+
+    if ( den == 0 ) {
+        return false;
+    }
+
+    if ( den < 0 ) {
+        num = -num;
+        add = -add;
+        den = -den;
+    }
+
+    g = gcd( gcd( ABS64( num ), ABS64( add ) ), den );
+    num /= (int64_t) g;
+    add /= (int64_t) g;
+    den /= (int64_t) g;
+
+    q = add / den;
+
+    /* x * mul and the offset must add up in 63 bits */
+    for ( s = LINEAR_MAX_SHIFT; s >= 0; s-- ) {
+        if ( (ABS64( num / den ) > (UINT64_MAX >> (s + 2))) || (ABS64( q ) > (UINT64_MAX >> (s + 3))) ) {
+            continue;
+        }
+
+        m = div_scaled( num, den, s );
+        if ( (m > INT32_MAX) || (m < INT32_MIN) ) {
+            continue;
+        }
+
+        /* Offset, plus half an LSB so the final shift rounds to nearest */
+        o = div_scaled( add, den, s ) + ( s ? ((int64_t) 1 << (s - 1)) : 0 );
+
+        for ( t = 0; (o > INT32_MAX) || (o < INT32_MIN); t++ ) {
+            o = (o + 1) >> 1;
+        }
+
+        *mul = m;
+        *off = o;
+        *shift = s;
+        *off_shift = t;
+        return true;
+    }
+
+    return false;
+}
+
+Bool sensor_linear_init( sensor_t * sensor, int32_t lsb_num, int8_t lsb_exp )
+{
+    SDR_type_01h_t * sdr = (SDR_type_01h_t *) sensor->sdr;
+    sensor_linear_t lin;
+    int32_t m, b;
+    int8_t r_exp, b_exp, e, base;
+    int64_t a_term, b_term, m_term;
+
+    /* Identity, in case the SDR can't be used */
+    sensor->lin.mul = 1;
+    sensor->lin.off = 0;
+    sensor->lin.shift = 0;
+    sensor->lin.off_shift = 0;
+    sensor->lin.inv_mul = 1;
+    sensor->lin.inv_off = 0;
+    sensor->lin.inv_shift = 0;
+    sensor->lin.inv_off_shift = 0;
+
+    if ( (sensor->sdr_type != TYPE_01) || ((sdr->linearization & 0x7F) != 0) || (lsb_num == 0) ) {
+        return false;
+    }
+
+    /* 10-bit signed M and B, their two MSBs share a byte with the tolerance and accuracy fields */
+    m = SIGN_EXTEND( sdr->M | ((sdr->M_tol & 0xC0) << 2), 10 );
+    b = SIGN_EXTEND( sdr->B | ((sdr->B_accuracy & 0xC0) << 2), 10 );
+    r_exp = SIGN_EXTEND( sdr->Rexp_Bexp >> 4, 4 );
+    b_exp = SIGN_EXTEND( sdr->Rexp_Bexp & 0x0F, 4 );
+
+    /*
+     * reading = (measurement * lsb_num * 10^(lsb_exp - Rexp) - B * 10^Bexp) / M
+     * Every term is scaled by 10^-base, so that all the exponents are positive
+     */
+    e = lsb_exp - r_exp;
+    base = 0;
+    if ( e < base ) {
+        base = e;
+    }
+    if ( b_exp < base ) {
+        base = b_exp;
+    }
+
+    if ( (e - base > LINEAR_MAX_EXP) || (b_exp - base > LINEAR_MAX_EXP) || (-base > LINEAR_MAX_EXP) ) {
+        return false;
+    }
+
+    a_term = (int64_t) lsb_num * pow10_table[e - base];
+    b_term = (int64_t) b * pow10_table[b_exp - base];
+    m_term = (int64_t) m * pow10_table[-base];
+
+    if ( !linear_coeffs( a_term, -b_term, m_term, &lin.mul, &lin.off, &lin.shift, &lin.off_shift ) ||
+         !linear_coeffs( m_term, b_term, a_term, &lin.inv_mul, &lin.inv_off, &lin.inv_shift, &lin.inv_off_shift ) ) {
+        return false;
+    }
+
+    sensor->lin = lin;
+    return true;
+}
+
+uint8_t sensor_linear_to_reading( const sensor_t * sensor, int32_t measurement )
+{
+    /* The offset is shifted unsigned, shifting a negative value left is undefined */
+    int64_t reading = ((int64_t) measurement * sensor->lin.mul + (int64_t) ((uint64_t) (int64_t) sensor->lin.off << sensor->lin.off_shift))
+                      >> sensor->lin.shift;
+
+    if ( sensor->signed_flag ) {
+        if ( reading > INT8_MAX ) {
+            reading = INT8_MAX;
+        } else if ( reading < INT8_MIN ) {
+            reading = INT8_MIN;
+        }
+    } else {
+        if ( reading > UINT8_MAX ) {
+            reading = UINT8_MAX;
+        } else if ( reading < 0 ) {
+            reading = 0;
+        }
+    }
+
+    return (uint8_t) reading;
+}
+
+int32_t sensor_linear_to_measurement( const sensor_t * sensor, uint8_t reading )
+{
+    int32_t value = sensor->signed_flag ? (int8_t) reading : reading;
+    int64_t measurement = ((int64_t) value * sensor->lin.inv_mul +
+                           (int64_t) ((uint64_t) (int64_t) sensor->lin.inv_off << sensor->lin.inv_off_shift)) >> sensor->lin.inv_shift;
+
+    if ( measurement > INT32_MAX ) {
+        measurement = INT32_MAX;
+    } else if ( measurement < INT32_MIN ) {
+        measurement = INT32_MIN;
+    }
+
+    return (int32_t) measurement;
+}
@@ -0,0 +1,74 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_linear.h
+ * @author agent <agent@local>
+ *
+ * @brief Conversion between the drivers' measurements and the IPMI sensor readings
+ *
+ * A linear Full Sensor Record describes its reading as <tt>value = (M * reading + B * 10^Bexp) * 10^Rexp</tt>. The
+ * drivers describe their measurement (usually the register value) the same way, as <tt>value = measurement * lsb_num *
+ * 10^lsb_exp</tt>. When the sensor is registered both are folded into integer coefficients, so converting a measurement
+ * to a reading (and a reading back, to compare thresholds in the device units) costs a multiply and a shift.
+ *
+ * @ingroup SENSORS
+ */
+
+#ifndef SENSOR_LINEAR_H_
+#define SENSOR_LINEAR_H_
+
+#include "port.h"
+#include "sdr.h"
+
+/**
+ * @brief Computes the conversion coefficients of a sensor from its SDR
+ *
+ * @param sensor Sensor with a Full Sensor Record (type 01h)
+ * @param lsb_num Value of one count of the driver's measurement, in units of 10^lsb_exp (in the unit set in the SDR)
+ * @param lsb_exp Decimal exponent of @a lsb_num
+ *
+ * @return true if the coefficients were computed, false if the SDR is not linear or can't be represented. In that case
+ * the measurement is used as the reading, unchanged.
+ */
+Bool sensor_linear_init( sensor_t * sensor, int32_t lsb_num, int8_t lsb_exp );
+
+/**
+ * @brief Converts a driver's measurement to the IPMI reading
+ *
+ * @param sensor Sensor initialized by #sensor_linear_init
+ * @param measurement Measurement, in counts of the driver's LSB
+ *
+ * @return Reading, rounded to nearest and saturated to the 8-bit range (signed when the sensor's signed_flag is set)
+ */
+uint8_t sensor_linear_to_reading( const sensor_t * sensor, int32_t measurement );
+
+/**
+ * @brief Converts an IPMI reading (or threshold) back to the driver's measurement units
+ *
+ * @param sensor Sensor initialized by #sensor_linear_init
+ * @param reading IPMI reading, signed when the sensor's signed_flag is set
+ *
+ * @return Measurement, in counts of the driver's LSB, rounded to nearest and saturated to the 32-bit range
+ */
+int32_t sensor_linear_to_measurement( const sensor_t * sensor, uint8_t reading );
+
+#endif
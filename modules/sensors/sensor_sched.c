@@ -0,0 +1,636 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_sched.c
+ * @author agent <agent@local>
+ *
+ * @brief Deadline based sensor polling implementation
+ *
+ * @ingroup SENSOR_SCHED
+ */
+
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Project Includes */
+#include "port.h"
+#include "string.h"
+#include "sdr.h"
+#include "ipmi.h"
+#include "task_priorities.h"
+#include "task_notify.h"
+#include "sensor_sched.h"
+#include "sensor_history.h"
+
+TaskHandle_t vTaskSensorSched_Handle;
+
+typedef struct {
+    sensor_read_fn read;
+    sensor_done_fn done;                /* NULL for drivers whose reading is complete when read returns */
+    void * priv;
+    TickType_t period;
+    TickType_t min_period;              /* Adaptive range, min_period == max_period keeps the period fixed */
+    TickType_t max_period;
+    TickType_t deadline;
+    int8_t last_reading;                /* Normalized reading of the previous sample */
+    uint8_t heap_pos;                   /* Position in sched_heap, SCHED_NOT_QUEUED if the sensor isn't scheduled */
+    uint8_t alert_lines;                /* Alert lines which make this sensor due immediately */
+    uint8_t busy;                       /* Reading started and not signalled by sensor_sched_read_done() yet */
+} sched_entry_t;
+
+#define SCHED_NOT_QUEUED        0xFF
+
+/* Indexed by sensor number */
+static sched_entry_t sched_entries[SDR_MAX_ENTRIES];
+
+/* Min-heap of sensor numbers ordered by deadline */
+static uint8_t sched_heap[SDR_MAX_ENTRIES];
+static uint8_t sched_heap_len;
+
+/* Sensors whose reading was signalled by sensor_sched_read_done(), one bit per sensor number */
+#if SDR_MAX_ENTRIES > 32
+#error "sched_done_mask holds one bit per sensor number"
+#endif
+static volatile uint32_t sched_done_mask;
+
+/* Alert lines signalled by interrupts and not yet handled by the task */
+static volatile uint8_t sched_alert_pending;
+/* Cycle count of the first pending alert, and sensors still to be read since then */
+static uint32_t sched_alert_cycles;
+static uint8_t sched_alert_reads;
+/* Latency from an alert interrupt until all the sensors which may have raised it were read */
+static sensor_sched_alert_stats_t sched_alert_stats;
+
+#define DEADLINE(n)             (sched_entries[sched_heap[(n)]].deadline)
+/* Tick counts wrap, so deadlines are compared by their difference */
+#define DEADLINE_BEFORE(a, b)   ((int32_t)((a) - (b)) < 0)
+
+static void heap_swap( uint8_t a, uint8_t b )
+{
+    uint8_t tmp = sched_heap[a];
+
+    sched_heap[a] = sched_heap[b];
+    sched_heap[b] = tmp;
+    sched_entries[sched_heap[a]].heap_pos = a;
+    sched_entries[sched_heap[b]].heap_pos = b;
+}
+
+static void heap_sift_up( uint8_t pos )
+{
+    uint8_t parent;
+
+    while ( pos > 0 ) {
+        parent = (pos - 1) / 2;
+        if ( !DEADLINE_BEFORE( DEADLINE(pos), DEADLINE(parent) ) ) {
+            break;
+        }
+        heap_swap( pos, parent );
+        pos = parent;
+    }
+}
+
+static void heap_sift_down( uint8_t pos )
+{
+    uint8_t child;
+
+    for ( ;; ) {
+        child = 2 * pos + 1;
+        if ( child >= sched_heap_len ) {
+            break;
+        }
+        if ( (child + 1 < sched_heap_len) && DEADLINE_BEFORE( DEADLINE(child + 1), DEADLINE(child) ) ) {
+            child++;
+        }
+        if ( !DEADLINE_BEFORE( DEADLINE(child), DEADLINE(pos) ) ) {
+            break;
+        }
+        heap_swap( pos, child );
+        pos = child;
+    }
+}
+
+/* Queues an entry (or restores its position after a deadline change). Must be called inside a critical section */
+static void heap_insert( sched_entry_t * entry, uint8_t num )
+{
+    if ( entry->heap_pos == SCHED_NOT_QUEUED ) {
+        entry->heap_pos = sched_heap_len;
+        sched_heap[sched_heap_len++] = num;
+    }
+    heap_sift_up( entry->heap_pos );
+    heap_sift_down( entry->heap_pos );
+}
+
+/* Must be called inside a critical section */
+static void heap_remove( sched_entry_t * entry )
+{
+    uint8_t pos = entry->heap_pos;
+
+    if ( pos == SCHED_NOT_QUEUED ) {
+        return;
+    }
+
+    /* Move the last item to the hole and restore the heap order from there */
+    sched_heap_len--;
+    if ( pos != sched_heap_len ) {
+        heap_swap( pos, sched_heap_len );
+        heap_sift_up( pos );
+        heap_sift_down( pos );
+    }
+    entry->heap_pos = SCHED_NOT_QUEUED;
+}
+
+void sensor_sched_add( sensor_t * sensor, sensor_read_fn read, sensor_done_fn done, void * priv, TickType_t period, TickType_t phase )
+{
+    sched_entry_t * entry;
+
+    configASSERT( sensor && read && (period > 0) );
+
+    taskENTER_CRITICAL();
+
+    entry = &sched_entries[sensor->num];
+    entry->read = read;
+    entry->done = done;
+    entry->priv = priv;
+    entry->period = period;
+    entry->min_period = period;
+    entry->max_period = period;
+    entry->deadline = xTaskGetTickCount() + phase;
+    entry->last_reading = SENSOR_NORM_READING(sensor);
+
+    /* Inactive sensors are only queued when their group is activated */
+    if ( sensor->active ) {
+        heap_insert( entry, sensor->num );
+    } else {
+        heap_remove( entry );
+    }
+
+    taskEXIT_CRITICAL();
+
+    /* The new sensor may be due before the one the task is waiting for */
+    if ( vTaskSensorSched_Handle ) {
+        task_notify( vTaskSensorSched_Handle, NOTIFY_SENSOR_SCHED );
+    }
+}
+
+void sensor_sched_add_driver( TaskHandle_t * driver_id, sensor_read_fn read, sensor_done_fn done, TickType_t period, TickType_t min_period, TickType_t max_period )
+{
+    sensor_t * sensor;
+
+    for ( sensor = sdr_first(); sensor != NULL; sensor = sdr_next( sensor ) ) {
+        if ( sensor->task_handle == driver_id ) {
+            sensor_sched_add( sensor, read, done, NULL, period, 0 );
+            sensor_sched_set_bounds( sensor, min_period, max_period );
+        }
+    }
+
+    /* Sensors which report who updates them refer to the scheduler */
+    *driver_id = vTaskSensorSched_Handle;
+}
+
+void sensor_sched_remove( sensor_t * sensor )
+{
+    sched_entry_t * entry = &sched_entries[sensor->num];
+
+    taskENTER_CRITICAL();
+    heap_remove( entry );
+    entry->read = NULL;
+    entry->done = NULL;
+    taskEXIT_CRITICAL();
+}
+
+void sensor_sched_suspend( sensor_t * sensor )
+{
+    taskENTER_CRITICAL();
+    heap_remove( &sched_entries[sensor->num] );
+    taskEXIT_CRITICAL();
+}
+
+void sensor_sched_resume( sensor_t * sensor )
+{
+    sched_entry_t * entry = &sched_entries[sensor->num];
+
+    taskENTER_CRITICAL();
+
+    if ( (entry->read != NULL) && (entry->heap_pos == SCHED_NOT_QUEUED) ) {
+        /* Read it right away, at the fastest rate, and let the period adapt from there */
+        entry->period = entry->min_period;
+        entry->deadline = xTaskGetTickCount();
+        entry->last_reading = SENSOR_NORM_READING(sensor);
+        heap_insert( entry, sensor->num );
+    }
+
+    taskEXIT_CRITICAL();
+
+    if ( vTaskSensorSched_Handle ) {
+        task_notify( vTaskSensorSched_Handle, NOTIFY_SENSOR_SCHED );
+    }
+}
+
+/* Must be called inside a critical section */
+static void sched_change_period( sched_entry_t * entry, TickType_t period )
+{
+    if ( (entry->heap_pos == SCHED_NOT_QUEUED) || (period == entry->period) ) {
+        return;
+    }
+
+    /* Count the new period from the last reading */
+    entry->deadline = entry->deadline - entry->period + period;
+    entry->period = period;
+    heap_sift_up( entry->heap_pos );
+    heap_sift_down( entry->heap_pos );
+}
+
+void sensor_sched_set_period( sensor_t * sensor, TickType_t period )
+{
+    sched_entry_t * entry = &sched_entries[sensor->num];
+
+    configASSERT( period > 0 );
+
+    taskENTER_CRITICAL();
+    entry->min_period = period;
+    entry->max_period = period;
+    sched_change_period( entry, period );
+    taskEXIT_CRITICAL();
+
+    if ( vTaskSensorSched_Handle ) {
+        task_notify( vTaskSensorSched_Handle, NOTIFY_SENSOR_SCHED );
+    }
+}
+
+void sensor_sched_set_bounds( sensor_t * sensor, TickType_t min_period, TickType_t max_period )
+{
+    sched_entry_t * entry = &sched_entries[sensor->num];
+
+    configASSERT( (min_period > 0) && (min_period <= max_period) );
+
+    taskENTER_CRITICAL();
+    entry->min_period = min_period;
+    entry->max_period = max_period;
+    if ( entry->period < min_period ) {
+        sched_change_period( entry, min_period );
+    } else if ( entry->period > max_period ) {
+        sched_change_period( entry, max_period );
+    }
+    taskEXIT_CRITICAL();
+}
+
+void sensor_sched_set_alert( sensor_t * sensor, uint8_t lines )
+{
+    taskENTER_CRITICAL();
+    sched_entries[sensor->num].alert_lines = lines;
+    taskEXIT_CRITICAL();
+}
+
+void sensor_sched_alert_from_isr( uint8_t lines, BaseType_t * pxHigherPriorityTaskWoken )
+{
+    UBaseType_t status = taskENTER_CRITICAL_FROM_ISR();
+
+    /* An alert raised while the previous one is still being handled is accounted with it */
+    if ( !sched_alert_pending && !sched_alert_reads ) {
+        sched_alert_cycles = cycle_counter_read();
+    }
+    sched_alert_pending |= lines;
+
+    taskEXIT_CRITICAL_FROM_ISR( status );
+
+    if ( vTaskSensorSched_Handle ) {
+        task_notify_from_isr( vTaskSensorSched_Handle, NOTIFY_SENSOR_SCHED, pxHigherPriorityTaskWoken );
+    }
+}
+
+void sensor_sched_read_done( sensor_t * sensor )
+{
+    taskENTER_CRITICAL();
+    sched_done_mask |= ( 1UL << sensor->num );
+    taskEXIT_CRITICAL();
+
+    task_notify( vTaskSensorSched_Handle, NOTIFY_SENSOR_SCHED );
+}
+
+static void sched_alert_done( uint32_t cycles )
+{
+    taskENTER_CRITICAL();
+    sched_alert_stats.count++;
+    sched_alert_stats.last = cycles;
+    if ( cycles > sched_alert_stats.max ) {
+        sched_alert_stats.max = cycles;
+    }
+    sched_alert_stats.total += cycles;
+    taskEXIT_CRITICAL();
+}
+
+void sensor_sched_get_alert_stats( sensor_sched_alert_stats_t * stats, Bool clear )
+{
+    taskENTER_CRITICAL();
+    *stats = sched_alert_stats;
+    if ( clear ) {
+        memset( &sched_alert_stats, 0, sizeof(sched_alert_stats) );
+    }
+    taskEXIT_CRITICAL();
+}
+
+/* Makes every sensor on the pending alert lines due now, at its fastest rate. Must be called inside a critical section */
+static void sched_handle_alerts( TickType_t now )
+{
+    sched_entry_t * entry;
+    uint8_t i;
+
+    /* Walk the sensor numbers, the heap order changes while the deadlines are moved */
+    for ( i = 0; i < SDR_MAX_ENTRIES; i++ ) {
+        entry = &sched_entries[i];
+        if ( (entry->heap_pos != SCHED_NOT_QUEUED) && (entry->alert_lines & sched_alert_pending) ) {
+            entry->period = entry->min_period;
+            entry->deadline = now;
+            heap_sift_up( entry->heap_pos );
+            sched_alert_reads++;
+        }
+    }
+
+    sched_alert_pending = 0;
+}
+
+/* Picks the period of the next reading from the one just taken */
+static void sched_adapt( sensor_t * sensor, sched_entry_t * entry )
+{
+    int8_t reading = SENSOR_NORM_READING(sensor);
+    int16_t delta = reading - entry->last_reading;
+    uint8_t dist = sensor_thr_distance( sensor );
+    TickType_t period;
+
+    if ( delta < 0 ) {
+        delta = -delta;
+    }
+
+    taskENTER_CRITICAL();
+
+    entry->last_reading = reading;
+
+    if ( entry->min_period != entry->max_period ) {
+        if ( sensor->thr_crossed || (dist <= SENSOR_SCHED_NEAR_THR) || (delta >= SENSOR_SCHED_FAST_DELTA) ) {
+            period = entry->min_period;
+        } else if ( delta <= SENSOR_SCHED_STABLE_DELTA ) {
+            period = entry->period * 2;
+        } else {
+            period = entry->period / 2;
+        }
+
+        if ( period < entry->min_period ) {
+            period = entry->min_period;
+        } else if ( period > entry->max_period ) {
+            period = entry->max_period;
+        }
+
+        sched_change_period( entry, period );
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+/* Records a reading that is over and adapts the sensor period to it */
+static void sched_read_finished( sensor_t * sensor, sensor_read_fn read )
+{
+    sched_entry_t * entry = &sched_entries[sensor->num];
+
+    sensor_history_record( sensor );
+
+    if ( sched_alert_reads && (entry->alert_lines) ) {
+        if ( --sched_alert_reads == 0 ) {
+            sched_alert_done( cycle_counter_read() - sched_alert_cycles );
+        }
+    }
+
+    /* Skip the adaptation if the sensor was removed or rescheduled by another driver meanwhile */
+    if ( (entry->heap_pos != SCHED_NOT_QUEUED) && (entry->read == read) ) {
+        sched_adapt( sensor, entry );
+    }
+}
+
+/* Completes the readings signalled by sensor_sched_read_done() */
+static void sched_handle_done( void )
+{
+    sched_entry_t * entry;
+    sensor_read_fn read;
+    sensor_done_fn done;
+    void * priv;
+    sensor_t * sensor;
+    uint32_t mask;
+    uint8_t num;
+
+    taskENTER_CRITICAL();
+    mask = sched_done_mask;
+    sched_done_mask = 0;
+    taskEXIT_CRITICAL();
+
+    for ( num = 0; mask != 0; num++, mask >>= 1 ) {
+        if ( !(mask & 1) ) {
+            continue;
+        }
+
+        entry = &sched_entries[num];
+
+        taskENTER_CRITICAL();
+        entry->busy = 0;
+        read = entry->read;
+        done = entry->done;
+        priv = entry->priv;
+        taskEXIT_CRITICAL();
+
+        sensor = find_sensor_by_id( num );
+        if ( (sensor == NULL) || (done == NULL) ) {
+            /* Removed while it was being read */
+            continue;
+        }
+
+        done( sensor, priv );
+        sched_read_finished( sensor, read );
+    }
+}
+
+void vTaskSensorSched( void * Parameters )
+{
+    sched_entry_t * entry;
+    sensor_read_fn read;
+    sensor_done_fn done;
+    void * priv;
+    sensor_t * sensor;
+    TickType_t now, wait;
+
+    for ( ;; ) {
+        read = NULL;
+        done = NULL;
+        wait = portMAX_DELAY;
+
+        if ( sched_done_mask ) {
+            sched_handle_done();
+        }
+
+        taskENTER_CRITICAL();
+
+        now = xTaskGetTickCount();
+
+        if ( sched_alert_pending ) {
+            sched_handle_alerts( now );
+        }
+
+        if ( sched_heap_len > 0 ) {
+            sensor = find_sensor_by_id( sched_heap[0] );
+            entry = &sched_entries[sched_heap[0]];
+
+            if ( DEADLINE_BEFORE( now, entry->deadline ) ) {
+                wait = entry->deadline - now;
+            } else {
+                if ( entry->busy ) {
+                    /* The previous reading is still on the bus, this one is skipped */
+                    wait = 0;
+                } else {
+                    read = entry->read;
+                    done = entry->done;
+                    priv = entry->priv;
+                    entry->busy = ( done != NULL ) && ( sensor != NULL );
+                }
+
+                /* A late sensor is not read again in a burst to catch up, the next reading is a whole period from now */
+                entry->deadline += entry->period;
+                if ( !DEADLINE_BEFORE( now, entry->deadline ) ) {
+                    entry->deadline = now + entry->period;
+                }
+                heap_sift_down( 0 );
+            }
+        }
+
+        taskEXIT_CRITICAL();
+
+        if ( read == NULL ) {
+            /* Woken up earlier when the schedule changes or a reading is over */
+            task_notify_wait( NOTIFY_SENSOR_SCHED, wait );
+            continue;
+        }
+
+        if ( sensor ) {
+            read( sensor, priv );
+
+            /* Readings with a completion callback are finished once the driver signals them */
+            if ( done == NULL ) {
+                sched_read_finished( sensor, read );
+            }
+        }
+    }
+}
+
+void sensor_sched_init( void )
+{
+    uint8_t i;
+
+    for ( i = 0; i < SDR_MAX_ENTRIES; i++ ) {
+        sched_entries[i].heap_pos = SCHED_NOT_QUEUED;
+        sched_entries[i].alert_lines = 0;
+        sched_entries[i].busy = 0;
+    }
+    sched_heap_len = 0;
+    sched_done_mask = 0;
+
+    xTaskCreate( vTaskSensorSched, "Sensors", SENSOR_SCHED_STACK_SIZE, (void *) NULL, tskSENSOR_PRIORITY, &vTaskSensorSched_Handle );
+}
+
+/* IPMI Handlers */
+
+#define SENSOR_RATES_PER_RSP    7
+
+/**
+ * @brief Reads the current reading period of the scheduled sensors
+ *
+ * Request:  [0] = first sensor number
+ * Response: [0] = sensor number to start the next request from (0xFF if there are no more sensors),
+ *           followed by up to 7 entries of [sensor number, period in ms (2 bytes, LSB first)]
+ */
+IPMI_HANDLER(ipmi_custom_get_sensor_rates, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_SENSOR_RATES, ipmi_msg *req, ipmi_msg *rsp)
+{
+    uint8_t len = 0;
+    uint8_t num, count = 0;
+    uint32_t period_ms;
+
+    if ( req->data_len < 1 ) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        rsp->data_len = 0;
+        return;
+    }
+
+    /* Filled at the end */
+    rsp->data[len++] = 0xFF;
+
+    for ( num = req->data[0]; num < SDR_MAX_ENTRIES; num++ ) {
+        if ( sched_entries[num].heap_pos == SCHED_NOT_QUEUED ) {
+            continue;
+        }
+
+        if ( count == SENSOR_RATES_PER_RSP ) {
+            rsp->data[0] = num;
+            break;
+        }
+
+        period_ms = sched_entries[num].period * portTICK_PERIOD_MS;
+        if ( period_ms > 0xFFFF ) {
+            period_ms = 0xFFFF;
+        }
+
+        rsp->data[len++] = num;
+        rsp->data[len++] = period_ms & 0xFF;
+        rsp->data[len++] = (period_ms >> 8) & 0xFF;
+        count++;
+    }
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
+
+/**
+ * @brief Reads the latency of the alert handling, from the alert interrupt until all the sensors on its lines were read
+ *
+ * Request:  [0] = 1 to clear the counters after reading them (optional)
+ * Response: [0..3] alerts handled, [4..7] last latency, [8..11] longest latency, [12..19] total latency
+ *           (in CPU cycles, all LSB first)
+ */
+IPMI_HANDLER(ipmi_custom_get_alert_latency, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_ALERT_LATENCY, ipmi_msg *req, ipmi_msg *rsp)
+{
+    sensor_sched_alert_stats_t stats;
+    uint8_t len = 0;
+    uint8_t i;
+
+    sensor_sched_get_alert_stats( &stats, (req->data_len > 0) && (req->data[0] & 1) );
+
+    for ( i = 0; i < 4; i++ ) {
+        rsp->data[len++] = (stats.count >> (8 * i)) & 0xFF;
+    }
+    for ( i = 0; i < 4; i++ ) {
+        rsp->data[len++] = (stats.last >> (8 * i)) & 0xFF;
+    }
+    for ( i = 0; i < 4; i++ ) {
+        rsp->data[len++] = (stats.max >> (8 * i)) & 0xFF;
+    }
+    for ( i = 0; i < 8; i++ ) {
+        rsp->data[len++] = (stats.total >> (8 * i)) & 0xFF;
+    }
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
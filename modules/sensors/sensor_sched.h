@@ -0,0 +1,205 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @defgroup SENSOR_SCHED Sensor Scheduler
+ * @ingroup SENSORS
+ */
+
+/**
+ * @file sensor_sched.h
+ * @author agent <agent@local>
+ *
+ * @brief Deadline based polling of the sensors
+ *
+ * A single task reads every polled sensor. Each sensor has its own period and the next one to be read is taken from a
+ * min-heap of deadlines, so the task only wakes up when some reading is due. The sensor drivers just provide a read
+ * callback, which updates sensor->readout_value and checks the threshold events.
+ *
+ * Drivers of I2C sensors also give a completion callback: their read callback only queues an I2C job (see #i2c_submit)
+ * and the job completion calls #sensor_sched_read_done. The task goes on with the other due sensors meanwhile, so the
+ * bus workers get all of them at once and can group them by mux channel. The completion callback then converts the
+ * reading and checks the threshold events, on the scheduler task.
+ *
+ * A sensor given a range of periods with #sensor_sched_set_bounds has its period adapted after each reading: it drops to
+ * the minimum when the reading is close to a threshold or moving fast, and doubles up to the maximum while it's stable.
+ *
+ * @ingroup SENSOR_SCHED
+ */
+
+#ifndef SENSOR_SCHED_H_
+#define SENSOR_SCHED_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sdr.h"
+
+#define SENSOR_SCHED_STACK_SIZE         256
+
+/* Alert lines, signalled by sensor_sched_alert_from_isr() */
+#define SENSOR_ALERT_OVERTEMP           (1 << 0)
+
+/* Adaptive rate tuning, in raw reading counts */
+#define SENSOR_SCHED_NEAR_THR           4       /* Distance to a threshold below which the sensor is read at its fastest rate */
+#define SENSOR_SCHED_FAST_DELTA         3       /* Change between readings above which the sensor is read at its fastest rate */
+#define SENSOR_SCHED_STABLE_DELTA       1       /* Change between readings up to which the reading is considered stable */
+
+/**
+ * @brief Alert handling latency, from the alert interrupt until all the sensors on its lines were read (in CPU cycles)
+ */
+typedef struct {
+    uint32_t count;                     /**< Alerts handled */
+    uint32_t last;                      /**< Latency of the last alert */
+    uint32_t max;                       /**< Longest latency */
+    uint64_t total;                     /**< Accumulated latency */
+} sensor_sched_alert_stats_t;
+
+/**
+ * @brief Sensor read callback
+ *
+ * @param sensor Sensor whose reading is due
+ * @param priv Driver data given to #sensor_sched_add
+ */
+typedef void (* sensor_read_fn)( sensor_t * sensor, void * priv );
+
+/**
+ * @brief Sensor read completion callback
+ *
+ * @param sensor Sensor whose reading was signalled with #sensor_sched_read_done
+ * @param priv Driver data given to #sensor_sched_add
+ */
+typedef void (* sensor_done_fn)( sensor_t * sensor, void * priv );
+
+extern TaskHandle_t vTaskSensorSched_Handle;
+
+/**
+ * @brief Creates the scheduler task. Must be called before any sensor is added
+ */
+void sensor_sched_init( void );
+
+/**
+ * @brief Schedules a sensor to be read periodically
+ *
+ * An inactive sensor (see #sdr_set_group_active) is only read after its group is activated.
+ *
+ * @param sensor Sensor to be read
+ * @param read Driver read callback
+ * @param done Completion callback, NULL if the reading is complete when read returns
+ * @param priv Driver data passed to the callbacks
+ * @param period Interval between readings, in ticks
+ * @param phase Delay before the first reading, in ticks (can be used to spread readings of the same bus)
+ */
+void sensor_sched_add( sensor_t * sensor, sensor_read_fn read, sensor_done_fn done, void * priv, TickType_t period, TickType_t phase );
+
+/**
+ * @brief Schedules all the sensors inserted in the SDR table with the given task handle pointer
+ *
+ * The task handle pointer passed to #sdr_insert_entry identifies the driver of the sensor.
+ *
+ * @param driver_id Task handle pointer used in the SDR insertion of the driver sensors
+ * @param read Driver read callback (it's given a NULL priv)
+ * @param done Completion callback, NULL if the reading is complete when read returns
+ * @param period Initial interval between readings, in ticks
+ * @param min_period Adaptive range lower bound, in ticks (see #sensor_sched_set_bounds)
+ * @param max_period Adaptive range upper bound, in ticks
+ */
+void sensor_sched_add_driver( TaskHandle_t * driver_id, sensor_read_fn read, sensor_done_fn done, TickType_t period, TickType_t min_period, TickType_t max_period );
+
+/**
+ * @brief Signals the end of a reading started by a read callback, from any task
+ *
+ * Must be called once for each read of a sensor that has a completion callback, whether the reading succeeded or not.
+ * The sensor isn't read again until then. Callable from an I2C job callback.
+ *
+ * @param sensor Sensor whose reading is over
+ */
+void sensor_sched_read_done( sensor_t * sensor );
+
+/**
+ * @brief Stops reading a sensor
+ *
+ * @param sensor Sensor to be removed from the schedule (nothing happens if it isn't scheduled)
+ */
+void sensor_sched_remove( sensor_t * sensor );
+
+/**
+ * @brief Stops reading a sensor, keeping its schedule settings so it can be resumed
+ *
+ * @param sensor Scheduled sensor
+ */
+void sensor_sched_suspend( sensor_t * sensor );
+
+/**
+ * @brief Reads a suspended sensor again, starting right away
+ *
+ * @param sensor Sensor previously added with #sensor_sched_add (nothing happens otherwise)
+ */
+void sensor_sched_resume( sensor_t * sensor );
+
+/**
+ * @brief Lets the period of a scheduled sensor adapt to its readings
+ *
+ * @param sensor Scheduled sensor
+ * @param min_period Period used near thresholds or while the reading changes quickly, in ticks
+ * @param max_period Period reached while the reading is stable and far from the thresholds, in ticks
+ */
+void sensor_sched_set_bounds( sensor_t * sensor, TickType_t min_period, TickType_t max_period );
+
+/**
+ * @brief Changes the reading period of a scheduled sensor
+ *
+ * The new period is applied from the next reading on.
+ *
+ * @param sensor Scheduled sensor
+ * @param period New interval between readings, in ticks
+ */
+void sensor_sched_set_period( sensor_t * sensor, TickType_t period );
+
+/**
+ * @brief Attaches a scheduled sensor to alert lines
+ *
+ * When one of the lines is signalled the sensor is read right away and its period drops to the minimum of its adaptive
+ * range, so the periodic reading only has to catch slow changes.
+ *
+ * @param sensor Scheduled sensor
+ * @param lines Mask of SENSOR_ALERT_* lines whose alert may come from this sensor (0 detaches it)
+ */
+void sensor_sched_set_alert( sensor_t * sensor, uint8_t lines );
+
+/**
+ * @brief Signals alert lines, from an interrupt handler
+ *
+ * @param lines Mask of SENSOR_ALERT_* lines asserted
+ * @param pxHigherPriorityTaskWoken Set to pdTRUE if the scheduler task must run when the interrupt returns
+ */
+void sensor_sched_alert_from_isr( uint8_t lines, BaseType_t * pxHigherPriorityTaskWoken );
+
+/**
+ * @brief Reads the alert handling latency counters (also read with IPMI_CUSTOM_CMD_GET_ALERT_LATENCY)
+ *
+ * @param[out] stats Counters
+ * @param clear Clears the counters after reading them
+ */
+void sensor_sched_get_alert_stats( sensor_sched_alert_stats_t * stats, Bool clear );
+
+void vTaskSensorSched( void * Parameters );
+
+#endif
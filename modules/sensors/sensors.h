@@ -40,5 +40,8 @@
 #include "hotswap.h"
 #include "lm75.h"
 #include "max6642.h"
+#include "sensor_sched.h"
+#include "sensor_linear.h"
+#include "overtemp.h"
 
 #endif
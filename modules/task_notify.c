@@ -0,0 +1,53 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file task_notify.c
+ *
+ * @brief Task notification bits
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "task_notify.h"
+
+uint32_t task_notify_wait( uint32_t bits, TickType_t timeout )
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    TimeOut_t timeout_state;
+    uint32_t value;
+
+    vTaskSetTimeOutState( &timeout_state );
+
+    for ( ;; ) {
+        /* xTaskNotifyWait() only clears bits when a notification is pending: mark one, so the bits can be checked and
+         * cleared without blocking, whatever was consumed by the other waits */
+        xTaskNotifyAndQuery( self, 0, eNoAction, NULL );
+        xTaskNotifyWait( 0, bits, &value, 0 );
+
+        if ( ( value & bits ) || ( xTaskCheckForTimeOut( &timeout_state, &timeout ) == pdTRUE ) ) {
+            return value & bits;
+        }
+
+        /* Woken by any bit, ours are checked again at the top */
+        xTaskNotifyWait( 0, 0, NULL, timeout );
+    }
+}
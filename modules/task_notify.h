@@ -0,0 +1,86 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file task_notify.h
+ *
+ * @brief Task notification bits
+ *
+ * A task has a single notification value, but it may be signalled by several subsystems: an IPMI worker waits for its
+ * I2C transfers, for bus grants and for IPMB transmissions. Each subsystem owns one bit of the value, sets it with
+ * #task_notify and only waits for (and clears) its own bit with #task_notify_wait, so no signal is ever lost.
+ */
+
+#ifndef TASK_NOTIFY_H_
+#define TASK_NOTIFY_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * @defgroup TASK_NOTIFY_BITS Task notification bits
+ * @{
+ */
+#define NOTIFY_I2C_MASTER               (1 << 0)    /**< I2C master transfer finished (IRQ) */
+#define NOTIFY_I2C_SLAVE                (1 << 1)    /**< Frame received as I2C slave (IRQ) */
+#define NOTIFY_SSP                      (1 << 2)    /**< SSP transfer finished (IRQ) */
+#define NOTIFY_I2C_JOB                  (1 << 3)    /**< Bus worker finished a request or granted the bus */
+#define NOTIFY_I2C_WORKER               (1 << 4)    /**< Request queued to a bus worker or bus given back */
+#define NOTIFY_IPMB_TX_OK               (1 << 5)    /**< IPMB message sent */
+#define NOTIFY_IPMB_TX_FAILED           (1 << 6)    /**< IPMB message dropped after the retries */
+#define NOTIFY_IPMB_RESPONSE            (1 << 7)    /**< Response matched to a pending IPMB request */
+#define NOTIFY_IPMI_EVENT               (1 << 8)    /**< Event queued in the outbox */
+#define NOTIFY_SENSOR_SCHED             (1 << 9)    /**< Sensor scheduler must re-evaluate its deadlines */
+/**
+ * @}
+ */
+
+/**
+ * @brief Sets notification bits of a task
+ *
+ * @param task Task to notify
+ * @param bits NOTIFY_* bits
+ */
+#define task_notify( task, bits )                       xTaskNotify( (task), (bits), eSetBits )
+
+/**
+ * @brief Sets notification bits of a task from an interrupt
+ *
+ * @param task Task to notify
+ * @param bits NOTIFY_* bits
+ * @param woken Set to pdTRUE if a context switch should be requested before leaving the interrupt
+ */
+#define task_notify_from_isr( task, bits, woken )       xTaskNotifyFromISR( (task), (bits), eSetBits, (woken) )
+
+/**
+ * @brief Waits for notification bits of the calling task
+ *
+ * Returns as soon as any of the requested bits is set and clears them. The other bits are left untouched for the
+ * subsystems that own them, even if they are set while waiting.
+ *
+ * @param bits NOTIFY_* bits to wait for
+ * @param timeout Max time (in ticks) to wait, 0 only checks (and clears) the bits
+ *
+ * @return The requested bits that were set, 0 if the timeout expired
+ */
+uint32_t task_notify_wait( uint32_t bits, TickType_t timeout );
+
+#endif
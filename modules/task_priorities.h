@@ -32,14 +32,13 @@
 
 #define tskSENSOR_PRIORITY              (tskIDLE_PRIORITY+2)
 #define tskHOTSWAP_PRIORITY             (tskIDLE_PRIORITY+2)
-#define tskLM75SENSOR_PRIORITY          (tskIDLE_PRIORITY+2)
-#define tskMAX6642SENSOR_PRIORITY       (tskIDLE_PRIORITY+2)
-#define tskINA220SENSOR_PRIORITY        (tskIDLE_PRIORITY+2)
 
 #define tskPAYLOAD_PRIORITY             (tskIDLE_PRIORITY+3)
 #define tskRTM_MANAGE_PRIORITY          (tskIDLE_PRIORITY+3)
+#define tskIPMI_EVENT_PRIORITY          (tskIDLE_PRIORITY+3)
 
 #define tskIPMI_HANDLERS_PRIORITY       (tskIDLE_PRIORITY+4)
+#define tskI2C_PRIORITY                 (tskIDLE_PRIORITY+4)
 #define tskIPMI_PRIORITY                (tskIDLE_PRIORITY+4)
 
 #define tskIPMB_RX_PRIORITY             (tskIDLE_PRIORITY+5)
@@ -3,9 +3,14 @@
 #include "port.h"
 
 
+/*
+ * The FPGA gateware may act as a master on the interface of I2C_BUS_FPGA_ID and switch the mux while we're idle, so the
+ * channel is read back before each access there. On this board it's I2C1, I2C2 is kept as on the other AFC boards.
+ * Only clear external_master once the gateware is known never to master the bus.
+ */
 i2c_mux_state_t i2c_mux[I2C_MUX_CNT] = {
-    { I2C1, -1, 0 },
-    { I2C2, -1, 0 },
+    { .i2c_interface = I2C1, .state = -1, .external_master = 1 },
+    { .i2c_interface = I2C2, .state = -1, .external_master = 1 },
 };
 
 i2c_bus_mapping_t i2c_bus_map[I2C_BUS_CNT] = {
@@ -18,28 +23,29 @@ i2c_bus_mapping_t i2c_bus_map[I2C_BUS_CNT] = {
     [I2C_BUS_FPGA_ID]    = { I2C1,  0, 0 },
 };
 
+/* Chips left without a speed (FMC mezzanines, RTM EEPROM) are driven at SPEED_100KHZ */
 i2c_chip_mapping_t i2c_chip_map[I2C_CHIP_CNT] = {
-    [CHIP_ID_MUX]         = { I2C_BUS_CPU_ID,     0x70 },
-    [CHIP_ID_LM75AIM_0]   = { I2C_BUS_CPU_ID,     0x4C },
-    [CHIP_ID_LM75AIM_1]   = { I2C_BUS_CPU_ID,     0x4D },
-    [CHIP_ID_LM75AIM_2]   = { I2C_BUS_CPU_ID,     0x4E },
-    [CHIP_ID_LM75AIM_3]   = { I2C_BUS_CPU_ID,     0x4F },
-    [CHIP_ID_MAX6642]     = { I2C_BUS_CPU_ID,     0x48 },
-
-    [CHIP_ID_RTC]         = { I2C_BUS_CPU_ID,     0x9F },
-    [CHIP_ID_RTC_EEPROM]  = { I2C_BUS_CPU_ID,     0x57 },
-    [CHIP_ID_EEPROM]      = { I2C_BUS_CPU_ID,     0x50 },
-    [CHIP_ID_EEPROM_ID]   = { I2C_BUS_CPU_ID,     0x58 },
-
-    [CHIP_ID_INA_0]       = { I2C_BUS_CPU_ID,     0x40 },
-    [CHIP_ID_INA_1]       = { I2C_BUS_CPU_ID,     0x41 },
-    [CHIP_ID_INA_2]       = { I2C_BUS_CPU_ID,     0x42 },
-    [CHIP_ID_INA_3]       = { I2C_BUS_CPU_ID,     0x43 },
-    [CHIP_ID_INA_4]       = { I2C_BUS_CPU_ID,     0x44 },
-    [CHIP_ID_INA_5]       = { I2C_BUS_CPU_ID,     0x45 },
-
-    [CHIP_ID_ADN]         = { I2C_BUS_CPU_ID,     0x4B },
-    [CHIP_ID_SI57x]       = { I2C_BUS_CLOCK_ID,   0x30 },
+    [CHIP_ID_MUX]         = { I2C_BUS_CPU_ID,     0x70, 400 },
+    [CHIP_ID_LM75AIM_0]   = { I2C_BUS_CPU_ID,     0x4C, 400 },
+    [CHIP_ID_LM75AIM_1]   = { I2C_BUS_CPU_ID,     0x4D, 400 },
+    [CHIP_ID_LM75AIM_2]   = { I2C_BUS_CPU_ID,     0x4E, 400 },
+    [CHIP_ID_LM75AIM_3]   = { I2C_BUS_CPU_ID,     0x4F, 400 },
+    [CHIP_ID_MAX6642]     = { I2C_BUS_CPU_ID,     0x48, 400 },
+
+    [CHIP_ID_RTC]         = { I2C_BUS_CPU_ID,     0x9F, 400 },
+    [CHIP_ID_RTC_EEPROM]  = { I2C_BUS_CPU_ID,     0x57, 400 },
+    [CHIP_ID_EEPROM]      = { I2C_BUS_CPU_ID,     0x50, 400 },
+    [CHIP_ID_EEPROM_ID]   = { I2C_BUS_CPU_ID,     0x58, 400 },
+
+    [CHIP_ID_INA_0]       = { I2C_BUS_CPU_ID,     0x40, 400 },
+    [CHIP_ID_INA_1]       = { I2C_BUS_CPU_ID,     0x41, 400 },
+    [CHIP_ID_INA_2]       = { I2C_BUS_CPU_ID,     0x42, 400 },
+    [CHIP_ID_INA_3]       = { I2C_BUS_CPU_ID,     0x43, 400 },
+    [CHIP_ID_INA_4]       = { I2C_BUS_CPU_ID,     0x44, 400 },
+    [CHIP_ID_INA_5]       = { I2C_BUS_CPU_ID,     0x45, 400 },
+
+    [CHIP_ID_ADN]         = { I2C_BUS_CPU_ID,     0x4B, 400 },
+    [CHIP_ID_SI57x]       = { I2C_BUS_CLOCK_ID,   0x30, 400 },
 
     [CHIP_ID_FMC1_EEPROM] = { I2C_BUS_FMC1_ID,    0x50 },
     [CHIP_ID_FMC1_LM75_0] = { I2C_BUS_FMC1_ID,    0x48 },
@@ -49,10 +55,10 @@ i2c_chip_mapping_t i2c_chip_map[I2C_CHIP_CNT] = {
     [CHIP_ID_FMC2_LM75_0] = { I2C_BUS_FMC2_ID,    0x48 },
     [CHIP_ID_FMC2_LM75_1] = { I2C_BUS_FMC2_ID,    0x49 },
 
-    [CHIP_ID_RTM_PCA9554] = { I2C_BUS_RTM_ID,     0x20 },
+    [CHIP_ID_RTM_PCA9554] = { I2C_BUS_RTM_ID,     0x20, 400 },
     [CHIP_ID_RTM_EEPROM]  = { I2C_BUS_RTM_ID,     0x50 },
-    [CHIP_ID_RTM_LM75_0]  = { I2C_BUS_RTM_ID,     0x48 },
-    [CHIP_ID_RTM_LM75_1]  = { I2C_BUS_RTM_ID,     0x49 },
+    [CHIP_ID_RTM_LM75_0]  = { I2C_BUS_RTM_ID,     0x48, 400 },
+    [CHIP_ID_RTM_LM75_1]  = { I2C_BUS_RTM_ID,     0x49, 400 },
 };
 
 bool i2c_set_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux, int8_t new_state )
@@ -65,8 +71,7 @@ bool i2c_set_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux, int8_t new_state
 
         /* Select desired channel in the I2C switch */
         if( xI2CMasterWrite( i2c_bus_map[i2c_chip_map[CHIP_ID_MUX].bus_id].i2c_interface, i2c_chip_map[CHIP_ID_MUX].i2c_address, &pca_channel, 1 ) != 1 ) {
-            /* We failed to configure the I2C Mux, release the semaphore */
-            xSemaphoreGive( i2c_mux->semaphore );
+            /* We failed to configure the I2C Mux */
             return false;
         }
     }
@@ -75,7 +80,7 @@ bool i2c_set_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux, int8_t new_state
     return true;
 }
 
-uint8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux )
+int8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux )
 {
     if (i2c_mux->i2c_interface == i2c_bus_map[i2c_chip_map[CHIP_ID_MUX].bus_id].i2c_interface) {
         /* Include enable bit (fourth bit) on channel selection byte */
@@ -83,7 +88,14 @@ uint8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux )
 
         portENABLE_INTERRUPTS();
         /* Read bus state (other master on the bus may have switched it */
-        xI2CMasterRead( i2c_bus_map[i2c_chip_map[CHIP_ID_MUX].bus_id].i2c_interface, i2c_chip_map[CHIP_ID_MUX].i2c_address, &pca_channel, 1 );
+        if ( xI2CMasterRead( i2c_bus_map[i2c_chip_map[CHIP_ID_MUX].bus_id].i2c_interface, i2c_chip_map[CHIP_ID_MUX].i2c_address, &pca_channel, 1 ) != 1 ) {
+            return -1;
+        }
+
+        /* No channel is selected while the enable bit is cleared */
+        if ( (pca_channel & (1 << 3)) == 0 ) {
+            return -1;
+        }
 
         return (pca_channel & 0x07);
     } else {
@@ -27,7 +27,8 @@
 
 /** @brief Handler for IPMI_OEM_CMD_I2C_TRANSFER IPMI command
  *
- * Performs a raw I2C master read on the selected bus and return the data
+ * Performs a raw I2C master write and/or read on the selected bus and return the data
+ * When both are requested, the read follows the write after a repeated START
  * Req data:
  * [0] - Bus ID @see i2c_mapping.h
  * [1] - #Chip/Address identification - (0) = ChipID identification on byte 2
@@ -42,20 +43,46 @@
  *
  * @return
  */
-IPMI_HANDLER(ipmi_oem_cmd_i2c_transfer, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_I2C_TRANSFER, ipmi_msg *req, ipmi_msg* rsp)
+IPMI_HANDLER_SLOW(ipmi_oem_cmd_i2c_transfer, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_I2C_TRANSFER, ipmi_msg *req, ipmi_msg* rsp)
 {
     uint8_t bus_id = req->data[0];
     uint8_t chipid_sel = req->data[1];
     uint8_t chipid_i2caddr = req->data[2];
     uint8_t write_len = req->data[3];
-    uint8_t read_len = req->data[4+write_len];
-    uint8_t *read_data;
+    uint8_t read_len;
+    i2c_seg_t segs[2];
+    uint8_t seg_count = 0;
 
     uint8_t semph_err;
 
     uint8_t i2c_interf;
     uint8_t i2c_addr;
 
+    rsp->data_len = 0;
+
+    if ( req->data_len < 5 + write_len ) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        return;
+    }
+
+    /* The data read is returned after its length byte */
+    read_len = req->data[4+write_len];
+    if ( read_len > IPMI_MAX_DATA_LEN - 1 ) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        return;
+    }
+
+    if ( write_len > 0 ) {
+        segs[seg_count].buff = &req->data[4];
+        segs[seg_count].len = write_len;
+        segs[seg_count++].flags = 0;
+    }
+    if ( read_len > 0 ) {
+        segs[seg_count].buff = &rsp->data[1];
+        segs[seg_count].len = read_len;
+        segs[seg_count++].flags = I2C_SEG_READ;
+    }
+
     if ( chipid_sel == 0 ) {
         /* Use chip id to take the bus */
         semph_err = i2c_take_by_chipid( chipid_i2caddr, &i2c_addr, &i2c_interf, (TickType_t)10);
@@ -69,30 +96,15 @@ IPMI_HANDLER(ipmi_oem_cmd_i2c_transfer, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_I2C_TRANS
         return;
     }
 
-    if ( write_len > 0 ) {
-        if (xI2CMasterWrite( i2c_interf, i2c_addr, &req->data[4], write_len ) == write_len) {
-            rsp->completion_code = IPMI_CC_OK;
-        } else {
-            rsp->completion_code = IPMI_CC_UNSPECIFIED_ERROR;
-            return;
-        }
-    }
-
-    if ( read_len > 0 ) {
-        read_data = pvPortMalloc( read_len );
-        memset( read_data, read_len, 0 );
-
-        if ( xI2CMasterRead( i2c_interf, i2c_addr, read_data, read_len ) == read_len ) {
+    /* Write and read in a single transfer, with a repeated START in between */
+    if ( seg_count == 0 || xI2CMasterTransfer( i2c_interf, i2c_addr, segs, seg_count ) == write_len + read_len ) {
+        if ( read_len > 0 ) {
             rsp->data[0] = read_len;
-            memcpy( &rsp->data[1], read_data, read_len );
             rsp->data_len = read_len+1;
-            rsp->completion_code = IPMI_CC_OK;
-        } else {
-            rsp->data_len = 0;
-            rsp->completion_code = IPMI_CC_UNSPECIFIED_ERROR;
         }
-
-        vPortFree( read_data );
+        rsp->completion_code = IPMI_CC_OK;
+    } else {
+        rsp->completion_code = IPMI_CC_UNSPECIFIED_ERROR;
     }
 
     i2c_give( i2c_interf );
@@ -170,7 +182,7 @@ IPMI_HANDLER(ipmi_oem_cmd_gpio_pin, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_GPIO_PIN, ipm
 #include "adn4604.h"
 
 /* This command may take a while to execute and hold the IPMI transaction */
-IPMI_HANDLER(ipmi_oem_adn4604_cfg_output, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_ADN4604_SET_OUTPUT_CFG, ipmi_msg *req, ipmi_msg* rsp)
+IPMI_HANDLER_SLOW(ipmi_oem_adn4604_cfg_output, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_ADN4604_SET_OUTPUT_CFG, ipmi_msg *req, ipmi_msg* rsp)
 {
     int len = rsp->data_len = 0;
 
@@ -205,7 +217,7 @@ IPMI_HANDLER(ipmi_oem_adn4604_cfg_output, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_ADN4604
     rsp->completion_code = IPMI_CC_OK;
 }
 
-IPMI_HANDLER(ipmi_oem_adn4604_reset, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_ADN4604_RESET, ipmi_msg *req, ipmi_msg* rsp)
+IPMI_HANDLER_SLOW(ipmi_oem_adn4604_reset, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_ADN4604_RESET, ipmi_msg *req, ipmi_msg* rsp)
 {
     adn4604_reset();
 
@@ -241,6 +241,7 @@ void vTaskPayload( void *pvParameters )
 
         DCDC_good = gpio_read_pin( PIN_PORT(GPIO_DCDC_PGOOD), PIN_NUMBER(GPIO_DCDC_PGOOD) );
 
+
         switch(state) {
 
         case PAYLOAD_NO_POWER:
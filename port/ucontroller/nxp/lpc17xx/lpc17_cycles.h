@@ -0,0 +1,47 @@
+/*
+ *   openMMC  --
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * @file lpc17_cycles.h
+ * @brief CPU cycle counter (DWT) access for LPC17xx
+ */
+
+#ifndef LPC17_CYCLES_H_
+#define LPC17_CYCLES_H_
+
+#include "chip_lpc175x_6x.h"
+
+/**
+ * @brief       Enable the DWT cycle counter
+ * @return      None
+ */
+#define cycle_counter_init()        do { CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+                                         DWT->CYCCNT = 0;                                \
+                                         DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; } while (0)
+
+/**
+ * @brief       Read the current CPU cycle count
+ *
+ * The counter wraps around every 2^32 cycles, so only differences between two readings are meaningful
+ *
+ * @return      Cycle count (uint32_t)
+ */
+#define cycle_counter_read()        (DWT->CYCCNT)
+
+#endif
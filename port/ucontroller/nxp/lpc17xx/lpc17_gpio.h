@@ -134,3 +134,32 @@
  * @return      Bitfield indicating all pins current direction (true (1) for OUTPUT, false (0) for INPUT )
  */
 #define gpio_get_port_dir( port )     Chip_GPIO_GetPortDIR( LPC_GPIO, port )
+
+/**
+ * @brief       Interrupt shared by all the GPIO pin interrupts (ports 0 and 2 only)
+ */
+#define GPIO_INT_IRQ                           EINT3_IRQn
+#define GPIO_INT_IRQHandler                    EINT3_IRQHandler
+
+/**
+ * @brief       Enable the falling edge interrupt of a GPIO pin
+ * @param       port    : GPIO Port number where pin is located (0 or 2)
+ * @param       pin     : pin number
+ */
+#define gpio_int_enable_falling( port, pin )   Chip_GPIOINT_SetIntFalling( LPC_GPIOINT, port, \
+                                                   Chip_GPIOINT_GetIntFalling( LPC_GPIOINT, port ) | (1 << (pin)) )
+
+/**
+ * @brief       Check if a GPIO pin has a pending falling edge interrupt
+ * @param       port    : GPIO Port number where pin is located (0 or 2)
+ * @param       pin     : pin number
+ * @return      true (non zero) if the interrupt is pending
+ */
+#define gpio_int_falling_pending( port, pin )  ( Chip_GPIOINT_GetStatusFalling( LPC_GPIOINT, port ) & (1 << (pin)) )
+
+/**
+ * @brief       Clear the pending interrupts of a GPIO pin
+ * @param       port    : GPIO Port number where pin is located (0 or 2)
+ * @param       pin     : pin number
+ */
+#define gpio_int_clear( port, pin )            Chip_GPIOINT_ClearIntStatus( LPC_GPIOINT, port, (1 << (pin)) )
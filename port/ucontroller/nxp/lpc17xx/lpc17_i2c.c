@@ -27,13 +27,223 @@
 
 #include "port.h"
 #include "string.h"
+#include "modules/task_notify.h"
 
 #define SLAVE_MASK 0xFF
 
+/*! @brief Master transfer control block, one per I2C interface */
+typedef struct {
+    LPC_I2C_T * const lpc_id;
+    const uint32_t sda;                 /* Pin definitions, for the bus recovery */
+    const uint32_t scl;
+    uint32_t speed;
+    bool slave;
+    TaskHandle_t caller_task;
+    I2C_XFER_T * volatile xfer;
+    uint32_t faults;
+    i2c_seg_t *segs;                    /* Segments of the current transfer */
+    uint8_t seg_count;
+    volatile uint8_t seg_idx;           /* Segment loaded in xfer */
+    i2c_health_t health;
+} i2c_master_cfg_t;
+
+static i2c_master_cfg_t i2c_master[I2C_NUM_INTERFACE] = {
+    [I2C0] = { .lpc_id = LPC_I2C0, .sda = I2C0_SDA, .scl = I2C0_SCL },
+    [I2C1] = { .lpc_id = LPC_I2C1, .sda = I2C1_SDA, .scl = I2C1_SCL },
+    [I2C2] = { .lpc_id = LPC_I2C2, .sda = I2C2_SDA, .scl = I2C2_SCL },
+};
+
+/* Bus lines handled as open-drain GPIOs: the output latch is kept low and the line is pulled down by making the pin an output */
+#define i2c_line_high( pin_def )            gpio_read_pin( PIN_PORT(pin_def), PIN_NUMBER(pin_def) )
+#define i2c_line_drive( pin_def, low )      gpio_set_pin_dir( PIN_PORT(pin_def), PIN_NUMBER(pin_def), \
+                                                              (low) ? GPIO_DIR_OUTPUT : GPIO_DIR_INPUT )
+
+static void i2c_delay_cycles( uint32_t cycles )
+{
+    uint32_t start = cycle_counter_read();
+
+    while ( cycle_counter_read() - start < cycles ) {}
+}
+
+/**
+ * @brief Checks for a slave holding SDA low
+ *
+ * SDA may only stay low with SCL high for a moment at START, a transfer from another master keeps SCL moving.
+ * The pin levels are read while the pins still belong to the I2C controller.
+ *
+ * @return true if SDA stayed low with SCL high for i2cBUS_STUCK_TIME_US
+ */
+static bool i2c_bus_stuck( I2C_ID_T id )
+{
+    i2c_master_cfg_t *master = &i2c_master[id];
+    uint32_t limit = i2cBUS_STUCK_TIME_US * ( SystemCoreClock / 1000000 );
+    uint32_t start = cycle_counter_read();
+
+    while ( !i2c_line_high( master->sda ) && i2c_line_high( master->scl ) ) {
+        if ( cycle_counter_read() - start > limit ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Frees a bus held by a slave and restarts the controller
+ *
+ * A slave that was reset or hot-plugged in the middle of a read keeps SDA low, waiting for the clocks of the rest of
+ * its byte. SCL is pulsed (up to i2cRECOVERY_CLOCKS times) until SDA is released, then a STOP brings every slave back
+ * to idle. The controller is re-initialized, which also drops a STOP that it could not send on the stuck bus.
+ *
+ * The pulses are timed by busy-waiting on the cycle counter. When called from a task, the task sleeps for a tick after
+ * every i2cRECOVERY_GROUP_CLOCKS pulses, so the other tasks don't wait for the whole sequence (about 110 us at
+ * 100 kHz). SCL is released meanwhile and the slave just waits for the next clock.
+ *
+ * Must be called with the interface locked and no transfer running.
+ *
+ * @return true if both lines are high after the recovery
+ */
+static bool i2c_bus_recover( I2C_ID_T id )
+{
+    i2c_master_cfg_t *master = &i2c_master[id];
+    uint32_t half_bit = SystemCoreClock / ( 2 * master->speed );
+    uint32_t start = cycle_counter_read();
+    uint32_t elapsed_us;
+    uint8_t i;
+    bool freed;
+
+    master->lpc_id->CONCLR = I2C_CON_I2EN | I2C_CON_STA | I2C_CON_SI | I2C_CON_AA;
+
+    gpio_set_pin_low( PIN_PORT(master->sda), PIN_NUMBER(master->sda) );
+    gpio_set_pin_low( PIN_PORT(master->scl), PIN_NUMBER(master->scl) );
+    i2c_line_drive( master->sda, false );
+    i2c_line_drive( master->scl, false );
+    pin_config( PIN_PORT(master->sda), PIN_NUMBER(master->sda), (IOCON_FUNC0 | IOCON_MODE_INACT) );
+    pin_config( PIN_PORT(master->scl), PIN_NUMBER(master->scl), (IOCON_FUNC0 | IOCON_MODE_INACT) );
+
+    for ( i = 0; ( i < i2cRECOVERY_CLOCKS ) && !i2c_line_high( master->sda ); i++ ) {
+        if ( ( i > 0 ) && ( i % i2cRECOVERY_GROUP_CLOCKS == 0 ) && ( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING ) ) {
+            vTaskDelay( 1 );
+        }
+        i2c_line_drive( master->scl, true );
+        i2c_delay_cycles( half_bit );
+        i2c_line_drive( master->scl, false );
+        i2c_delay_cycles( half_bit );
+    }
+
+    /* STOP: SDA goes high while SCL is high */
+    i2c_line_drive( master->scl, true );
+    i2c_delay_cycles( half_bit );
+    i2c_line_drive( master->sda, true );
+    i2c_delay_cycles( half_bit );
+    i2c_line_drive( master->scl, false );
+    i2c_delay_cycles( half_bit );
+    i2c_line_drive( master->sda, false );
+    i2c_delay_cycles( half_bit );
+
+    freed = i2c_line_high( master->sda ) && i2c_line_high( master->scl );
+
+    pin_config( PIN_PORT(master->sda), PIN_NUMBER(master->sda), PIN_FUNC(master->sda) );
+    pin_config( PIN_PORT(master->scl), PIN_NUMBER(master->scl), PIN_FUNC(master->scl) );
+
+    Chip_I2C_DeInit( id );
+    Chip_I2C_Init( id );
+    Chip_I2C_SetClockRate( id, master->speed );
+    Chip_I2C_Enable( id );
+    if ( master->slave ) {
+        master->lpc_id->CONSET = I2C_CON_AA;
+    }
+
+    elapsed_us = ( cycle_counter_read() - start ) / ( SystemCoreClock / 1000000 );
+
+    /* Whatever the slaves were doing was interrupted, e.g. the mux channel may not be the one cached anymore */
+    master->faults++;
+    master->health.recoveries++;
+    if ( !freed ) {
+        master->health.recovery_failures++;
+    }
+    if ( elapsed_us > master->health.recovery_max_us ) {
+        master->health.recovery_max_us = elapsed_us;
+    }
+
+    return freed;
+}
+
+/* Makes a segment the current one of the LPCOpen transfer block */
+static void i2c_seg_load( I2C_XFER_T *xfer, i2c_seg_t *seg )
+{
+    if ( seg->flags & I2C_SEG_READ ) {
+        xfer->rxBuff = seg->buff;
+        xfer->rxSz = seg->len;
+    } else {
+        xfer->txBuff = seg->buff;
+        xfer->txSz = seg->len;
+    }
+}
+
+/**
+ * @brief Moves a combined transfer on to its next segment
+ *
+ * The LPCOpen state machine only knows a write followed by a read. At the end of each segment the next one is loaded
+ * in the transfer block: the state machine itself issues the repeated START for a read and keeps sending bytes for an
+ * I2C_SEG_NOSTART write, the other cases are handled here.
+ *
+ * @return true if the interrupt was fully handled
+ */
+static bool i2c_seg_advance( I2C_ID_T id )
+{
+    i2c_master_cfg_t *master = &i2c_master[id];
+    I2C_XFER_T *xfer = master->xfer;
+    LPC_I2C_T *lpc_id = master->lpc_id;
+    i2c_seg_t *next;
+
+    if ( master->segs == NULL || master->seg_idx + 1 >= master->seg_count ) {
+        return false;
+    }
+    next = &master->segs[master->seg_idx + 1];
+
+    switch ( lpc_id->STAT & I2C_STAT_CODE_BITMASK ) {
+    case I2C_I2STAT_M_TX_SLAW_ACK:
+    case I2C_I2STAT_M_TX_DAT_ACK:
+        if ( xfer->txSz != 0 ) {
+            return false;
+        }
+        master->seg_idx++;
+        i2c_seg_load( xfer, next );
+        if ( (next->flags & I2C_SEG_READ) || (next->flags & I2C_SEG_NOSTART) ) {
+            return false;
+        }
+        /* Write after a repeated START, the state machine sends SLA+W because txSz isn't 0 */
+        lpc_id->CONSET = I2C_CON_STA;
+        lpc_id->CONCLR = I2C_CON_SI;
+        return true;
+
+    case I2C_I2STAT_M_RX_DAT_NACK:
+        /* Last byte of a read segment: repeated START instead of STOP */
+        *xfer->rxBuff++ = lpc_id->DAT;
+        xfer->rxSz--;
+        master->seg_idx++;
+        i2c_seg_load( xfer, next );
+        lpc_id->CONSET = I2C_CON_STA;
+        lpc_id->CONCLR = I2C_CON_SI;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
 /* State machine handler for I2C0 and I2C1 */
 static void i2c_state_handling(I2C_ID_T id)
 {
     if (Chip_I2C_IsMasterActive(id)) {
+        if (i2c_master[id].xfer == NULL) {
+            /* Late interrupt from an aborted transfer, there's no buffer to feed anymore */
+            i2c_master[id].lpc_id->CONCLR = I2C_CON_SI;
+            return;
+        }
+        if (i2c_seg_advance(id)) {
+            return;
+        }
         Chip_I2C_MasterStateHandler(id);
     } else {
         Chip_I2C_SlaveStateHandler(id);
@@ -59,6 +269,81 @@ void I2C2_IRQHandler(void)
     i2c_state_handling(I2C2);
 }
 
+/* Give up on a transfer that didn't finish in time: stop feeding the state machine and recover the bus */
+static void i2c_master_abort( I2C_ID_T id, I2C_XFER_T *xfer )
+{
+    /* Not a critical section, which would leave the interrupts masked when called before the scheduler is started */
+    portDISABLE_INTERRUPTS();
+    i2c_master[id].xfer = NULL;
+    xfer->status = I2C_STATUS_BUSERR;
+    i2c_master[id].lpc_id->CONCLR = I2C_CON_I2EN | I2C_CON_SI | I2C_CON_STA;
+    portENABLE_INTERRUPTS();
+
+    i2c_master[id].health.timeouts++;
+
+    /* A slave holding the bus is the usual cause and the STOP would never go out, LPCOpen waits for it forever */
+    i2c_bus_recover( id );
+
+    if ( i2c_master[id].caller_task != NULL ) {
+        /* Discard a notification that may have been given right before the abort */
+        task_notify_wait( NOTIFY_I2C_MASTER, 0 );
+    }
+}
+
+/**
+ * @brief       Master event handler
+ *
+ * Replaces Chip_I2C_EventHandler(), which busy-waits on the transfer status.
+ * The caller task is blocked on its NOTIFY_I2C_MASTER notification bit while the transfer is driven
+ * by the I2C interrupt, and the IRQ sets it when the transfer is done.
+ * Before the scheduler is started (sensors and FRU initialization) there's no task to
+ * block, so the status is polled just like the original handler, with the same timeout.
+ */
+static void i2c_master_event( I2C_ID_T id, I2C_EVENT_T event )
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    I2C_XFER_T *xfer = i2c_master[id].xfer;
+    uint32_t start;
+
+    switch (event) {
+    case I2C_EVENT_LOCK:
+        if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+            i2c_master[id].caller_task = xTaskGetCurrentTaskHandle();
+        } else {
+            i2c_master[id].caller_task = NULL;
+        }
+        break;
+
+    case I2C_EVENT_WAIT:
+        if (i2c_master[id].caller_task == NULL) {
+            start = cycle_counter_read();
+            while (xfer->status == I2C_STATUS_BUSY) {
+                if (cycle_counter_read() - start > i2cMASTER_TIMEOUT * portTICK_PERIOD_MS * (SystemCoreClock / 1000)) {
+                    i2c_master_abort( id, xfer );
+                }
+            }
+            break;
+        }
+        while (xfer->status == I2C_STATUS_BUSY) {
+            if (task_notify_wait( NOTIFY_I2C_MASTER, i2cMASTER_TIMEOUT ) == 0 && xfer->status == I2C_STATUS_BUSY) {
+                i2c_master_abort( id, xfer );
+            }
+        }
+        break;
+
+    case I2C_EVENT_DONE:
+        /* Called from the IRQ */
+        if (i2c_master[id].caller_task != NULL) {
+            task_notify_from_isr( i2c_master[id].caller_task, NOTIFY_I2C_MASTER, &xHigherPriorityTaskWoken );
+            portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
 void vI2CConfig( I2C_ID_T id, uint32_t speed )
 {
     IRQn_Type irq;
@@ -85,51 +370,214 @@ void vI2CConfig( I2C_ID_T id, uint32_t speed )
         return;
     }
 
+    /* Time base of the timeouts and of the bus recovery */
+    cycle_counter_init();
+
+    i2c_master[id].speed = speed;
     Chip_I2C_Init(id);
     Chip_I2C_SetClockRate(id, speed);
     NVIC_SetPriority( irq, configMAX_SYSCALL_INTERRUPT_PRIORITY -1 );
     NVIC_EnableIRQ( irq );
     Chip_I2C_Enable( id );
 
-    Chip_I2C_SetMasterEventHandler(id, Chip_I2C_EventHandler);
+    Chip_I2C_SetMasterEventHandler(id, i2c_master_event);
+}
+
+void vI2CSetSpeed( I2C_ID_T id, uint32_t speed )
+{
+    i2c_master[id].speed = speed;
+    Chip_I2C_SetClockRate( id, speed );
+}
+
+static int i2c_master_transfer( I2C_ID_T id, I2C_XFER_T *xfer )
+{
+    i2c_health_t *health = &i2c_master[id].health;
+    uint32_t timeouts = health->timeouts;
+    int status;
+
+    i2c_master[id].xfer = xfer;
+    status = Chip_I2C_MasterTransfer( id, xfer );
+    i2c_master[id].xfer = NULL;
+
+    /* Another master was active on the bus or the transfer was aborted, the devices state is not known anymore */
+    if ( status == I2C_STATUS_ARBLOST || status == I2C_STATUS_BUSERR ) {
+        i2c_master[id].faults++;
+    }
+
+    if ( status == I2C_STATUS_ARBLOST ) {
+        health->arb_lost++;
+    } else if ( status == I2C_STATUS_BUSERR && health->timeouts == timeouts ) {
+        health->bus_errors++;
+    }
+
+    return status;
+}
+
+uint32_t ulI2CMasterFaults( I2C_ID_T id )
+{
+    return i2c_master[id].faults;
+}
+
+void vI2CMasterHealth( I2C_ID_T id, i2c_health_t * health, bool reset )
+{
+    taskENTER_CRITICAL();
+    *health = i2c_master[id].health;
+    if ( reset ) {
+        memset( &i2c_master[id].health, 0, sizeof(i2c_health_t) );
+    }
+    taskEXIT_CRITICAL();
+}
+
+int xI2CMasterTransfer( I2C_ID_T id, uint8_t addr, i2c_seg_t * segs, uint8_t seg_count )
+{
+    i2c_master_cfg_t *master = &i2c_master[id];
+    I2C_XFER_T xfer;
+    i2c_seg_t *last;
+    int status;
+    int done = 0;
+    uint8_t attempts = 0;
+    uint8_t i;
+
+    if ( seg_count == 0 ) {
+        return 0;
+    }
+    for ( i = 0; i < seg_count; i++ ) {
+        if ( segs[i].buff == NULL || segs[i].len == 0 ) {
+            return 0;
+        }
+    }
+
+    do {
+        /* The buffers are consumed as the transfer goes, so a retry starts over from the first segment */
+        memset( &xfer, 0, sizeof(xfer) );
+        xfer.slaveAddr = addr;
+
+        master->segs = segs;
+        master->seg_count = seg_count;
+        master->seg_idx = 0;
+        i2c_seg_load( &xfer, &segs[0] );
+
+        if ( i2c_bus_stuck( id ) && ( i2c_bus_recover( id ) == false ) ) {
+            /* Nothing gets through until the slave lets go of SDA, fail now instead of waiting for the timeout */
+            status = I2C_STATUS_BUSERR;
+            break;
+        }
+
+        status = i2c_master_transfer( id, &xfer );
+    } while ( ( status == I2C_STATUS_ARBLOST || status == I2C_STATUS_BUSERR ) && ( ++attempts < i2cMASTER_ATTEMPTS ) );
+
+    master->segs = NULL;
+
+    for ( i = 0; i < master->seg_idx; i++ ) {
+        done += segs[i].len;
+    }
+    last = &segs[master->seg_idx];
+    done += last->len - ( (last->flags & I2C_SEG_READ) ? xfer.rxSz : xfer.txSz );
+
+    /* The state machine counts a byte as sent when it's loaded, one the slave didn't acknowledge wasn't written.
+     * LPCOpen reports a NACK on the address the same way, but then nothing was loaded from the segment */
+    if ( status == I2C_STATUS_NAK && !(last->flags & I2C_SEG_READ) && xfer.txSz < last->len ) {
+        done--;
+    }
+
+    return done;
+}
+
+int xI2CMasterWrite( I2C_ID_T id, uint8_t addr, const uint8_t * tx_buff, uint8_t tx_len )
+{
+    i2c_seg_t seg = { (uint8_t *) tx_buff, tx_len, 0 };
+
+    return xI2CMasterTransfer( id, addr, &seg, 1 );
+}
+
+int xI2CMasterRead( I2C_ID_T id, uint8_t addr, uint8_t * rx_buff, int rx_len )
+{
+    i2c_seg_t seg = { rx_buff, rx_len, I2C_SEG_READ };
+
+    return xI2CMasterTransfer( id, addr, &seg, 1 );
+}
+
+int xI2CMasterWriteRead( I2C_ID_T id, uint8_t addr, uint8_t cmd, uint8_t * rx_buff, int rx_len )
+{
+    i2c_seg_t segs[2] = {
+        { &cmd, 1, 0 },
+        { rx_buff, rx_len, I2C_SEG_READ },
+    };
+    int done = xI2CMasterTransfer( id, addr, segs, 2 );
+
+    /* Only the bytes read are reported */
+    return ( done > 1 ) ? done - 1 : 0;
 }
 
 static TaskHandle_t slave_task_id;
 I2C_XFER_T slave_cfg;
-uint8_t recv_msg[i2cMAX_MSG_LENGTH];
-uint8_t recv_bytes;
 
-uint8_t xI2CSlaveReceive( I2C_ID_T id, uint8_t * rx_buff, uint8_t buff_len, uint32_t timeout )
+/* Ring of received frames. The ISR fills the frame at slave_ring_head, the task owns slave_ring_count frames starting at slave_ring_tail */
+static uint8_t slave_ring[i2cSLAVE_RING_LEN][i2cMAX_MSG_LENGTH+1];
+static uint8_t slave_ring_len[i2cSLAVE_RING_LEN];
+static volatile uint8_t slave_ring_head;
+static volatile uint8_t slave_ring_tail;
+static volatile uint8_t slave_ring_count;
+static uint32_t slave_ring_overruns;
+
+uint8_t * xI2CSlaveReceiveFrame( I2C_ID_T id, uint8_t * frame_len, uint32_t timeout )
 {
-    uint8_t bytes_to_copy = 0;
     slave_task_id = xTaskGetCurrentTaskHandle();
 
-    if ( ulTaskNotifyTake( pdTRUE, timeout ) == pdTRUE )
-    {
-        if (recv_bytes > buff_len) {
-            bytes_to_copy = buff_len;
-        } else {
-            bytes_to_copy = recv_bytes;
+    if ( slave_ring_count == 0 ) {
+        task_notify_wait( NOTIFY_I2C_SLAVE, timeout );
+        if ( slave_ring_count == 0 ) {
+            return NULL;
         }
-        /* Copy the rx buffer to the pointer given */
-        memcpy( rx_buff, &recv_msg[0], bytes_to_copy );
-        return bytes_to_copy;
-    } else {
-        return 0;
     }
+
+    *frame_len = slave_ring_len[slave_ring_tail];
+    return &slave_ring[slave_ring_tail][0];
+}
+
+void vI2CSlaveReleaseFrame( I2C_ID_T id )
+{
+    taskENTER_CRITICAL();
+    if ( slave_ring_count > 0 ) {
+        slave_ring_tail = (slave_ring_tail + 1) % i2cSLAVE_RING_LEN;
+        slave_ring_count--;
+    }
+    taskEXIT_CRITICAL();
+}
+
+uint32_t ulI2CSlaveOverruns( I2C_ID_T id )
+{
+    return slave_ring_overruns;
 }
 
 static void I2C_Slave_Event(I2C_ID_T id, I2C_EVENT_T event)
 {
-    static BaseType_t xHigherPriorityTaskWoken;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    uint8_t recv_bytes;
+
     switch (event) {
     case I2C_EVENT_DONE:
         recv_bytes = i2cMAX_MSG_LENGTH - slave_cfg.rxSz;
+
+        /* The frame being filled must never be one still owned by the task, so one slot is always kept free */
+        if ( (recv_bytes > 0) && (slave_ring_count < i2cSLAVE_RING_LEN - 1) ) {
+            /* The hardware consumes our own address, put it back in front of the frame */
+            slave_ring[slave_ring_head][0] = slave_cfg.slaveAddr;
+            slave_ring_len[slave_ring_head] = recv_bytes + 1;
+            slave_ring_head = (slave_ring_head + 1) % i2cSLAVE_RING_LEN;
+            slave_ring_count++;
+
+            task_notify_from_isr( slave_task_id, NOTIFY_I2C_SLAVE, &xHigherPriorityTaskWoken );
+        } else if ( recv_bytes > 0 ) {
+            /* No free frames, the current one is reused and the message is lost */
+            slave_ring_overruns++;
+        }
+
         slave_cfg.rxSz = i2cMAX_MSG_LENGTH;
-        slave_cfg.rxBuff = &recv_msg[0];
+        slave_cfg.rxBuff = &slave_ring[slave_ring_head][1];
 
-        vTaskNotifyGiveFromISR( slave_task_id, &xHigherPriorityTaskWoken );
         portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+        break;
 
     case I2C_EVENT_SLAVE_RX:
         break;
@@ -140,10 +588,11 @@ static void I2C_Slave_Event(I2C_ID_T id, I2C_EVENT_T event)
 
 void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr )
 {
+    i2c_master[id].slave = true;
     slave_cfg.slaveAddr = slave_addr;
     slave_cfg.txBuff = NULL; /* Not using Slave transmitter right now */
     slave_cfg.txSz = 0;
-    slave_cfg.rxBuff = &recv_msg[0];
-    slave_cfg.rxSz = (sizeof(recv_msg)/sizeof(recv_msg[0]));
+    slave_cfg.rxBuff = &slave_ring[slave_ring_head][1];
+    slave_cfg.rxSz = i2cMAX_MSG_LENGTH;
     Chip_I2C_SlaveSetup( id, I2C_SLAVE_0, &slave_cfg, I2C_Slave_Event, SLAVE_MASK);
 }
@@ -28,11 +28,165 @@
 /*! @brief Max message length (in bits) used in I2C */
 #define i2cMAX_MSG_LENGTH               32
 
-#define xI2CMasterWrite(id, addr, tx_buff, tx_len) Chip_I2C_MasterSend(id, addr, tx_buff, tx_len)
-#define xI2CMasterRead(id, addr, rx_buff, rx_len) Chip_I2C_MasterRead(id, addr, rx_buff, rx_len)
-#define xI2CMasterWriteRead(id, addr, cmd, rx_buff, rx_len) Chip_I2C_MasterCmdRead(id, addr, cmd, rx_buff, rx_len)
+/*! @brief Max time (in ticks) a master transfer may take before being aborted */
+#define i2cMASTER_TIMEOUT               (50/portTICK_PERIOD_MS)
+
+/*! @brief Max number of attempts of a master transfer that lost the arbitration or ended in a bus error/timeout */
+#define i2cMASTER_ATTEMPTS              3
+
+/*! @brief Max time (in us) SDA may be seen low with SCL high before the bus is considered stuck */
+#define i2cBUS_STUCK_TIME_US            200
+
+/*! @brief SCL pulses sent by the bus recovery, enough for a slave to shift out a byte and its ACK bit */
+#define i2cRECOVERY_CLOCKS              9
+
+/*! @brief SCL pulses sent back to back by the bus recovery, a task sleeps for a tick between the groups */
+#define i2cRECOVERY_GROUP_CLOCKS        3
+
+/*! @brief Health counters of a master interface */
+typedef struct {
+    uint32_t timeouts;              /*!< Transfers aborted after i2cMASTER_TIMEOUT */
+    uint32_t arb_lost;              /*!< Attempts that lost the arbitration */
+    uint32_t bus_errors;            /*!< Attempts ended by a misplaced START or STOP */
+    uint32_t recoveries;            /*!< Bus recovery sequences run, after a timeout or on a stuck SDA */
+    uint32_t recovery_failures;     /*!< Recoveries that left SDA or SCL low */
+    uint32_t recovery_max_us;       /*!< Longest recovery sequence (us), including the sleeps between the pulse groups */
+} i2c_health_t;
+
+/*! @name Combined transfer segment flags
+ * @{
+ */
+#define I2C_SEG_READ                    (1 << 0)    /*!< Read into the segment buffer, otherwise it's written */
+#define I2C_SEG_NOSTART                 (1 << 1)    /*!< Write following another write without a repeated START (gather) */
+/*@}*/
+
+/*! @brief One segment of a combined transfer */
+typedef struct {
+    uint8_t *buff;                  /*!< Data to write or buffer for the data read */
+    uint16_t len;                   /*!< Number of bytes, must not be 0 */
+    uint8_t flags;                  /*!< I2C_SEG_* flags */
+} i2c_seg_t;
+
+/**
+ * @brief Runs several segments as a single transfer to a slave device
+ *
+ * The segments are separated by repeated STARTs and only the last one ends with a STOP, so no other master can take
+ * the bus in between. Write segments flagged with I2C_SEG_NOSTART are sent as a continuation of the previous write,
+ * e.g. an EEPROM address and the data taken from another buffer.
+ *
+ * The calling task sleeps until the transfer is completed by the I2C interrupt or i2cMASTER_TIMEOUT expires.
+ * A slave holding SDA low is detected before the START and a timeout is followed by a bus recovery; the transfer is
+ * then retried, as after a lost arbitration, up to i2cMASTER_ATTEMPTS times.
+ *
+ * @param id I2C interface
+ * @param addr 7-bit slave address
+ * @param segs Segments, in bus order
+ * @param seg_count Number of segments
+ *
+ * @return Number of bytes actually written and read, over all the segments: a byte the slave didn't acknowledge isn't
+ * counted, and 0 means the slave didn't answer its address
+ */
+int xI2CMasterTransfer( I2C_ID_T id, uint8_t addr, i2c_seg_t * segs, uint8_t seg_count );
+
+/**
+ * @brief Write data to a slave device
+ *
+ * The calling task sleeps until the transfer is completed by the I2C interrupt or i2cMASTER_TIMEOUT expires
+ *
+ * @param id I2C interface
+ * @param addr 7-bit slave address
+ * @param tx_buff Data to be sent
+ * @param tx_len Number of bytes to send
+ *
+ * @return Number of bytes actually sent
+ */
+int xI2CMasterWrite( I2C_ID_T id, uint8_t addr, const uint8_t * tx_buff, uint8_t tx_len );
+
+/**
+ * @brief Read data from a slave device
+ *
+ * @param id I2C interface
+ * @param addr 7-bit slave address
+ * @param rx_buff Buffer to store the received data
+ * @param rx_len Number of bytes to read
+ *
+ * @return Number of bytes actually read
+ */
+int xI2CMasterRead( I2C_ID_T id, uint8_t addr, uint8_t * rx_buff, int rx_len );
+
+/**
+ * @brief Write a command byte and read the answer after a repeated START
+ *
+ * @param id I2C interface
+ * @param addr 7-bit slave address
+ * @param cmd Command (register) byte
+ * @param rx_buff Buffer to store the received data
+ * @param rx_len Number of bytes to read
+ *
+ * @return Number of bytes actually read
+ */
+int xI2CMasterWriteRead( I2C_ID_T id, uint8_t addr, uint8_t cmd, uint8_t * rx_buff, int rx_len );
+
+/**
+ * @brief Number of master transfers that lost arbitration or ended in a bus error
+ *
+ * Lets the upper layers notice that some other master used the bus
+ *
+ * @param id I2C interface
+ */
+uint32_t ulI2CMasterFaults( I2C_ID_T id );
+
+/**
+ * @brief Reads the health counters of a master interface
+ *
+ * @param id I2C interface
+ * @param[out] health Counters
+ * @param reset Clear the counters after reading them
+ */
+void vI2CMasterHealth( I2C_ID_T id, i2c_health_t * health, bool reset );
+
+/*! @brief Number of frame buffers in the slave receive ring */
+#define i2cSLAVE_RING_LEN               4
+
+/**
+ * @brief Waits for a frame received as slave
+ *
+ * The frame is written by the I2C interrupt directly into a ring of buffers and is handed to the caller without any copy.
+ * Byte 0 holds our own slave address (consumed by the hardware), the received bytes follow it.
+ * The frame remains owned by the caller until #vI2CSlaveReleaseFrame is called.
+ *
+ * @param id I2C interface
+ * @param[out] frame_len Frame length, including the address byte
+ * @param timeout Max time (in ticks) to wait for a frame
+ *
+ * @return Pointer to the oldest received frame or NULL if the timeout expired
+ */
+uint8_t * xI2CSlaveReceiveFrame( I2C_ID_T id, uint8_t * frame_len, uint32_t timeout );
+
+/**
+ * @brief Gives the oldest frame obtained by #xI2CSlaveReceiveFrame back to the receive ring
+ *
+ * @param id I2C interface
+ */
+void vI2CSlaveReleaseFrame( I2C_ID_T id );
+
+/**
+ * @brief Number of frames lost because the receive ring was full
+ *
+ * @param id I2C interface
+ */
+uint32_t ulI2CSlaveOverruns( I2C_ID_T id );
 
-uint8_t xI2CSlaveReceive( I2C_ID_T id, uint8_t * rx_buff, uint8_t buff_len, uint32_t timeout );
 void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr );
 void vI2CConfig( I2C_ID_T id, uint32_t speed );
 
+/**
+ * @brief Changes the SCL rate of an interface
+ *
+ * Must only be called while the interface is idle
+ *
+ * @param id I2C interface
+ * @param speed New SCL rate (Hz)
+ */
+void vI2CSetSpeed( I2C_ID_T id, uint32_t speed );
+
@@ -28,6 +28,7 @@
 #include "port.h"
 #include "string.h"
 #include "pin_mapping.h"
+#include "modules/task_notify.h"
 
 static ssp_config_t ssp_cfg[MAX_SSP_INTERFACES] = {
     [FPGA_SPI] = {
@@ -68,7 +69,7 @@ static void ssp_irq_handler( LPC_SSP_T * ssp_id )
     }
     else {
         /* Transfer is completed, notify the caller task */
-        vTaskNotifyGiveFromISR(ssp_cfg[ssp_cfg_index].caller_task, &xHigherPriorityTaskWoken);
+        task_notify_from_isr(ssp_cfg[ssp_cfg_index].caller_task, NOTIFY_SSP, &xHigherPriorityTaskWoken);
         /* Deassert SSEL pin */
         ssp_ssel_control(ssp_cfg_index, DEASSERT);
     }
@@ -149,7 +150,7 @@ void ssp_write_read( uint8_t id, uint8_t *tx_buf, uint32_t tx_len, uint8_t *rx_b
 
         /* User defined timeout ? */
         /* Wait until the transfer is finished */
-        ulTaskNotifyTake(pdTRUE, timeout);
+        task_notify_wait(NOTIFY_SSP, timeout);
     }
     if (rx_buf && rx_len > 0) {
         memcpy(rx_buf, rx_ssp, rx_len+tx_len);
@@ -39,6 +39,7 @@
 #include "lpc17_interruptions.h"
 #include "lpc17_hpm.h"
 #include "lpc17_power.h"
+#include "lpc17_cycles.h"
 #include "lpc17_pincfg.h"
 #include "pin_mapping.h"
 
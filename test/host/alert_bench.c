@@ -0,0 +1,295 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file alert_bench.c
+ *
+ * @brief Over-temperature event latency, polled or signalled by the alert line, on the host build
+ *
+ * Each trial waits a random time, then takes one temperature sensor past its lowest upper threshold and measures how
+ * long the threshold event takes to be sent, then brings it back and waits for the deassertion. Without -a the sensors
+ * are only polled, with their adaptive periods (LM75_UPDATE_RATE_MIN to LM75_UPDATE_RATE_MAX). With -a they are set up
+ * as the drivers do under MODULE_OVERTEMP_ALERT: attached to the alert line, with the relaxed polling period, and every
+ * excursion raises the line as the chip's limit output would. The chip's own conversion time is not simulated.
+ *
+ * In alert mode the controller's alert latency counters are also read with IPMI_CUSTOM_CMD_GET_ALERT_LATENCY.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "port.h"
+#include "host_i2c.h"
+#include "host_sensors.h"
+#include "ipmi.h"
+#include "sdr.h"
+#include "sensors.h"
+#include "dut.h"
+#include "mch.h"
+
+#define MAX_TARGETS         SDR_MAX_ENTRIES
+#define EVENT_TIMEOUT_NS    15000000000ULL
+
+typedef struct {
+    sensor_t *sensor;
+    uint8_t limit;              /* Raw reading past the lowest upper threshold */
+    uint8_t nominal;
+} target_t;
+
+static target_t targets[MAX_TARGETS];
+static int target_count;
+
+static uint32_t trials = 10;
+static uint32_t max_delay_ms = 3000;
+static int alert_mode;
+static long seed = 1;
+
+/* Last threshold event of the sensor under test, written by the scheduler task */
+static sensor_t * volatile watched;
+static volatile uint64_t assert_time;
+static volatile uint64_t deassert_time;
+
+ipmb_error __real_ipmi_event_send( sensor_t * sensor, uint8_t assert_deassert, uint8_t * evData, uint8_t length );
+
+ipmb_error __wrap_ipmi_event_send( sensor_t * sensor, uint8_t assert_deassert, uint8_t * evData, uint8_t length )
+{
+    if ( sensor == watched ) {
+        if ( assert_deassert == ASSERTION_EVENT ) {
+            assert_time = host_time_ns();
+        } else {
+            deassert_time = host_time_ns();
+        }
+    }
+    return __real_ipmi_event_send( sensor, assert_deassert, evData, length );
+}
+
+static int is_temperature_sensor( sensor_t * s )
+{
+    return ( s->task_handle == &vTaskLM75_Handle ) || ( s->task_handle == &vTaskMAX6642_Handle );
+}
+
+/* The sensors with a readable upper threshold, the ones overtemp_limits() programs into the chips */
+static void targets_find( void )
+{
+    SDR_type_01h_t *sdr;
+    sensor_t *s;
+    uint8_t k, thr;
+
+    for ( s = sdr_first(); s != NULL; s = sdr_next( s ) ) {
+        if ( !s->active || ( s->sdr_type != TYPE_01 ) || !is_temperature_sensor( s ) ) {
+            continue;
+        }
+        sdr = ( SDR_type_01h_t * ) s->sdr;
+
+        for ( k = THR_UNC; k <= THR_UNR; k++ ) {
+            if ( sdr->readable_threshold_mask & ( 1 << k ) ) {
+                break;
+            }
+        }
+        if ( k == THR_UNC ) {
+            thr = sdr->upper_noncritical_thr;
+        } else if ( k == THR_UC ) {
+            thr = sdr->upper_critical_thr;
+        } else if ( k == THR_UNR ) {
+            thr = sdr->upper_nonrecover_thr;
+        } else {
+            continue;
+        }
+        if ( thr >= UINT8_MAX - 2 ) {
+            continue;
+        }
+
+        targets[target_count].sensor = s;
+        targets[target_count].limit = thr + 2;
+        targets[target_count].nominal = sdr->nominal_reading;
+        target_count++;
+
+        if ( alert_mode ) {
+            /* As lm75_set_alert() and max6642_set_alert() do once the limits are programmed */
+            sensor_sched_set_alert( s, SENSOR_ALERT_OVERTEMP );
+            sensor_sched_set_bounds( s, LM75_UPDATE_RATE_MIN / portTICK_PERIOD_MS,
+                                     LM75_ALERT_UPDATE_RATE_MAX / portTICK_PERIOD_MS );
+        }
+    }
+}
+
+/* Waits for the event time to be set, returns 0 on timeout */
+static uint64_t event_wait( volatile uint64_t * time )
+{
+    uint64_t start = host_time_ns();
+
+    while ( *time == 0 ) {
+        if ( host_time_ns() - start > EVENT_TIMEOUT_NS ) {
+            return 0;
+        }
+        host_sleep_ns( 100000 );
+    }
+    return *time;
+}
+
+static int cmp_u64( const void * a, const void * b )
+{
+    uint64_t x = *( const uint64_t * ) a, y = *( const uint64_t * ) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+/* Alert latency counters of the controller, read over IPMB */
+static int read_alert_counters( void )
+{
+    mch_xfer_t xfer;
+    uint32_t count, last, max;
+    uint64_t total = 0;
+    double us_per_cycle = 1e6 / configCPU_CLOCK_HZ;
+    int i;
+
+    memset( &xfer, 0, sizeof( xfer ) );
+    xfer.netfn = NETFN_CUSTOM;
+    xfer.cmd = IPMI_CUSTOM_CMD_GET_ALERT_LATENCY;
+
+    if ( ( mch_transact( &xfer ) != IPMI_CC_OK ) || ( xfer.resp_len < 20 ) ) {
+        fprintf( stderr, "Get Alert Latency failed\n" );
+        return -1;
+    }
+
+    count = xfer.resp[0] | ( xfer.resp[1] << 8 ) | ( xfer.resp[2] << 16 ) | ( ( uint32_t ) xfer.resp[3] << 24 );
+    last = xfer.resp[4] | ( xfer.resp[5] << 8 ) | ( xfer.resp[6] << 16 ) | ( ( uint32_t ) xfer.resp[7] << 24 );
+    max = xfer.resp[8] | ( xfer.resp[9] << 8 ) | ( xfer.resp[10] << 16 ) | ( ( uint32_t ) xfer.resp[11] << 24 );
+    for ( i = 7; i >= 0; i-- ) {
+        total = ( total << 8 ) | xfer.resp[12 + i];
+    }
+
+    printf( "Controller counters: %u alerts handled, mean %.1f us, last %.1f us, max %.1f us\n", count,
+            count ? total * us_per_cycle / count : 0, last * us_per_cycle, max * us_per_cycle );
+
+    /* One alert going up and one coming back per trial, unless they were handled together */
+    return ( count >= trials ) ? 0 : -1;
+}
+
+static void bench( void * arg )
+{
+    uint64_t *latency = calloc( trials, sizeof( uint64_t ) );
+    uint64_t start, t, total = 0;
+    target_t *tg;
+    uint32_t i, done = 0;
+    int failures = 0;
+
+    mch_init( NULL );
+
+    for ( i = 0; i < trials; i++ ) {
+        tg = &targets[random() % target_count];
+        host_sleep_ns( ( uint64_t ) ( random() % ( max_delay_ms + 1 ) ) * 1000000 );
+
+        /* Past the threshold */
+        assert_time = 0;
+        deassert_time = 0;
+        watched = tg->sensor;
+        start = host_time_ns();
+        host_sensor_raw[tg->sensor->num] = tg->limit;
+        if ( alert_mode ) {
+            host_sensor_alert( SENSOR_ALERT_OVERTEMP );
+        }
+
+        t = event_wait( &assert_time );
+        if ( t == 0 ) {
+            fprintf( stderr, "Sensor %u: no event %.0f s after the excursion\n", tg->sensor->num,
+                     EVENT_TIMEOUT_NS / 1e9 );
+            failures++;
+        } else {
+            latency[done++] = t - start;
+            total += t - start;
+        }
+
+        /* And back, the LM75 in interrupt mode signals it too */
+        host_sensor_raw[tg->sensor->num] = tg->nominal;
+        if ( alert_mode ) {
+            host_sensor_alert( SENSOR_ALERT_OVERTEMP );
+        }
+        if ( event_wait( &deassert_time ) == 0 ) {
+            fprintf( stderr, "Sensor %u: no deassertion\n", tg->sensor->num );
+            failures++;
+        }
+        watched = NULL;
+    }
+
+    if ( done > 0 ) {
+        qsort( latency, done, sizeof( uint64_t ), cmp_u64 );
+        printf( "%s: %u excursions on %d sensors, event latency mean %.2f ms, p50 %.2f ms, max %.2f ms\n",
+                alert_mode ? "Alert line" : "Polling", done, target_count, total / 1e6 / done,
+                latency[done / 2] / 1e6, latency[done - 1] / 1e6 );
+    }
+
+    if ( alert_mode && ( read_alert_counters() < 0 ) ) {
+        failures++;
+    }
+
+    fflush( stdout );
+    exit( failures ? 1 : 0 );
+}
+
+int main( int argc, char ** argv )
+{
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "ad:n:s:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'a':
+            alert_mode = 1;
+            break;
+        case 'd':
+            max_delay_ms = strtoul( optarg, NULL, 0 );
+            break;
+        case 'n':
+            trials = strtoul( optarg, NULL, 0 );
+            break;
+        case 's':
+            seed = strtol( optarg, NULL, 0 );
+            break;
+        default:
+            fprintf( stderr,
+                     "Usage: %s [-a] [-d ms] [-n trials] [-s seed]\n"
+                     "  -a           Signal the excursions on the alert line (polling only otherwise)\n"
+                     "  -d ms        Longest random wait before each excursion (default 3000)\n"
+                     "  -n count     Excursions (default 10)\n"
+                     "  -s seed      Seed of the waits and of the sensors picked (default 1)\n",
+                     argv[0] );
+            return 2;
+        }
+    }
+    if ( trials == 0 ) {
+        fprintf( stderr, "Bad arguments\n" );
+        return 2;
+    }
+    srandom( seed );
+
+    dut_init();
+
+    targets_find();
+    if ( target_count == 0 ) {
+        fprintf( stderr, "No temperature sensor with an upper threshold\n" );
+        return 1;
+    }
+
+    dut_run( bench, NULL );
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file FreeRTOSConfig.h
+ *
+ * @brief FreeRTOS configuration of the host build
+ *
+ * Same kernel settings as FreeRTOS/include/FreeRTOSConfig.h (priorities, tick rate, heap size, APIs), so the modules
+ * run with the limits they have on the board. Only the Cortex-M3 specific settings are left out, and the idle hook is
+ * used by the POSIX port to sleep until the next interrupt.
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#define configUSE_PREEMPTION                    1
+#define configUSE_IDLE_HOOK                     1
+#define configMAX_PRIORITIES                    ( 6 )
+#define configUSE_TICK_HOOK                     0
+#define configCPU_CLOCK_HZ                      ( ( unsigned long ) 100000000 )
+#define configTICK_RATE_HZ                      ( ( TickType_t ) 1000 )
+#define configMINIMAL_STACK_SIZE                ( ( unsigned short ) 80 )
+#define configTOTAL_HEAP_SIZE                   ( ( size_t ) ( 0x4000 ) )
+#define configMAX_TASK_NAME_LEN                 ( 12 )
+#define configUSE_TRACE_FACILITY                1
+#define configUSE_16_BIT_TICKS                  0
+#define configIDLE_SHOULD_YIELD                 0
+#define configUSE_CO_ROUTINES                   0
+#define configUSE_MUTEXES                       1
+#define configMAX_CO_ROUTINE_PRIORITIES         ( 2 )
+#define configUSE_COUNTING_SEMAPHORES           0
+#define configUSE_ALTERNATIVE_API               0
+#define configCHECK_FOR_STACK_OVERFLOW          0
+#define configUSE_RECURSIVE_MUTEXES             0
+#define configQUEUE_REGISTRY_SIZE               3
+#define configGENERATE_RUN_TIME_STATS           0
+#define configUSE_MALLOC_FAILED_HOOK            0
+#define configENABLE_BACKWARD_COMPATIBILITY     1
+#define configUSE_APPLICATION_TASK_TAG          0
+#define configUSE_TASK_NOTIFICATIONS            1
+#define configUSE_STATS_FORMATTING_FUNCTIONS    0
+#define configAPPLICATION_ALLOCATED_HEAP        0
+#define configSUPPORT_DYNAMIC_ALLOCATION        1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+
+void vAssertCalled( char* file, uint32_t line);
+#define configASSERT( x )     if( ( x ) == 0 ) { vAssertCalled( __FILE__, __LINE__ );}
+
+#define INCLUDE_vTaskPrioritySet                1
+#define INCLUDE_uxTaskPriorityGet               0
+#define INCLUDE_vTaskDelete                     1
+#define INCLUDE_vTaskCleanUpResources           1
+#define INCLUDE_vTaskSuspend                    1
+#define INCLUDE_vTaskDelayUntil                 1
+#define INCLUDE_vTaskDelay                      1
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
+#define INCLUDE_xTaskGetCurrentTaskHandle       1
+#define INCLUDE_xTaskGetSchedulerState          1
+
+#endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,344 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file port.c
+ *
+ * @brief FreeRTOS port for POSIX hosts (see portmacro.h)
+ *
+ * A task owns a thread which only runs while its #port_thread_t::run flag is set. A context switch selects the next
+ * task with vTaskSwitchContext(), sets the flag of its thread and waits for its own flag to be set again. Switches
+ * only happen with the critical nesting at 0, the same way PendSV can only fire outside critical sections on the
+ * Cortex-M3, so the nesting count doesn't need to be saved per task.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct {
+    pthread_t thread;
+    pthread_cond_t cond;
+    int run;                        /* Thread is allowed to run */
+    TaskFunction_t code;
+    void *params;
+    uint8_t *stack;                 /* Painted with portSTACK_FILL_BYTE, see xPortTaskStackUsed() */
+} port_thread_t;
+
+#define portTHREAD_STACK_SIZE   ( 256 * 1024 )
+#define portSTACK_FILL_BYTE     0xa5
+
+/* The first member of the TCB points to the word returned by pxPortInitialiseStack(), which holds the thread */
+extern void * volatile pxCurrentTCB;
+#define CURRENT_THREAD()        ( **( port_thread_t *** ) pxCurrentTCB )
+
+/* Context switch hand-over between task threads */
+static pthread_mutex_t run_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Interrupt mask: an ISR only runs while the task side has interrupts enabled, and one at a time */
+static pthread_mutex_t irq_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t irq_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static int irq_masked;
+static int isr_running;
+
+/* Interrupts stay masked from the first critical section until the scheduler starts, as on the target */
+static volatile UBaseType_t uxCriticalNesting = 0xaaaaaaaa;
+static volatile int yield_pending;
+static volatile int scheduler_running;
+
+static __thread int in_isr;
+
+static void prvMask( void )
+{
+    pthread_mutex_lock( &irq_mutex );
+    while ( isr_running ) {
+        pthread_cond_wait( &irq_cond, &irq_mutex );
+    }
+    irq_masked = 1;
+    pthread_mutex_unlock( &irq_mutex );
+}
+
+static void prvUnmask( void )
+{
+    pthread_mutex_lock( &irq_mutex );
+    irq_masked = 0;
+    pthread_cond_broadcast( &irq_cond );
+    pthread_mutex_unlock( &irq_mutex );
+}
+
+static void prvHandOver( port_thread_t * self, port_thread_t * next )
+{
+    pthread_mutex_lock( &run_mutex );
+    self->run = 0;
+    next->run = 1;
+    pthread_cond_signal( &next->cond );
+    while ( !self->run ) {
+        pthread_cond_wait( &self->cond, &run_mutex );
+    }
+    pthread_mutex_unlock( &run_mutex );
+}
+
+static void prvSwitch( void )
+{
+    port_thread_t *self;
+    port_thread_t *next;
+
+    do {
+        self = CURRENT_THREAD();
+
+        prvMask();
+        yield_pending = 0;
+        vTaskSwitchContext();
+        next = CURRENT_THREAD();
+        prvUnmask();
+
+        if ( next != self ) {
+            prvHandOver( self, next );
+        }
+        /* An ISR may have asked for another switch while this task wasn't running */
+    } while ( yield_pending );
+}
+
+static void prvTakePendingYield( void )
+{
+    if ( yield_pending && scheduler_running && ( uxCriticalNesting == 0 ) && !irq_masked ) {
+        prvSwitch();
+    }
+}
+
+void vPortDisableInterrupts( void )
+{
+    if ( !in_isr ) {
+        prvMask();
+    }
+}
+
+void vPortEnableInterrupts( void )
+{
+    if ( !in_isr ) {
+        prvUnmask();
+        prvTakePendingYield();
+    }
+}
+
+void vPortEnterCritical( void )
+{
+    if ( !in_isr ) {
+        prvMask();
+        uxCriticalNesting++;
+    }
+}
+
+void vPortExitCritical( void )
+{
+    if ( !in_isr ) {
+        configASSERT( uxCriticalNesting );
+        uxCriticalNesting--;
+        if ( uxCriticalNesting == 0 ) {
+            prvUnmask();
+            prvTakePendingYield();
+        }
+    }
+}
+
+void vPortYield( void )
+{
+    if ( in_isr ) {
+        vPortYieldFromISR();
+        return;
+    }
+
+    /* Inside a critical section the switch is pended, as PendSV would be */
+    yield_pending = 1;
+    prvTakePendingYield();
+}
+
+void vPortYieldFromISR( void )
+{
+    yield_pending = 1;
+}
+
+int xPortInISR( void )
+{
+    return in_isr;
+}
+
+void vPortRunISR( void (*isr)( void * ), void * arg )
+{
+    pthread_mutex_lock( &irq_mutex );
+    while ( irq_masked || isr_running ) {
+        pthread_cond_wait( &irq_cond, &irq_mutex );
+    }
+    isr_running = 1;
+    pthread_mutex_unlock( &irq_mutex );
+
+    in_isr = 1;
+    isr( arg );
+    in_isr = 0;
+
+    pthread_mutex_lock( &irq_mutex );
+    isr_running = 0;
+    pthread_cond_broadcast( &irq_cond );
+    if ( yield_pending ) {
+        pthread_cond_broadcast( &idle_cond );
+    }
+    pthread_mutex_unlock( &irq_mutex );
+}
+
+static void *prvThreadEntry( void * arg )
+{
+    port_thread_t *t = ( port_thread_t * ) arg;
+
+    pthread_mutex_lock( &run_mutex );
+    while ( !t->run ) {
+        pthread_cond_wait( &t->cond, &run_mutex );
+    }
+    pthread_mutex_unlock( &run_mutex );
+
+    t->code( t->params );
+
+    /* Tasks must not return */
+    vTaskDelete( NULL );
+    return NULL;
+}
+
+StackType_t *pxPortInitialiseStack( StackType_t * pxTopOfStack, TaskFunction_t pxCode, void * pvParameters )
+{
+    port_thread_t *t = calloc( 1, sizeof( port_thread_t ) );
+    port_thread_t **slot;
+    pthread_attr_t attr;
+    sigset_t all, old;
+
+    configASSERT( t );
+    t->code = pxCode;
+    t->params = pvParameters;
+    pthread_cond_init( &t->cond, NULL );
+
+    /* The thread is kept outside the FreeRTOS heap, only its address is stored in the task stack */
+    slot = ( port_thread_t ** ) ( ( ( uintptr_t ) pxTopOfStack - sizeof( port_thread_t * ) ) & ~( uintptr_t ) ( sizeof( void * ) - 1 ) );
+    *slot = t;
+
+    t->stack = malloc( portTHREAD_STACK_SIZE );
+    configASSERT( t->stack );
+    memset( t->stack, portSTACK_FILL_BYTE, portTHREAD_STACK_SIZE );
+    pthread_attr_init( &attr );
+    pthread_attr_setstack( &attr, t->stack, portTHREAD_STACK_SIZE );
+
+    /* Host signals are handled by the threads that aren't tasks */
+    sigfillset( &all );
+    pthread_sigmask( SIG_SETMASK, &all, &old );
+    configASSERT( pthread_create( &t->thread, &attr, prvThreadEntry, t ) == 0 );
+    pthread_sigmask( SIG_SETMASK, &old, NULL );
+    pthread_attr_destroy( &attr );
+
+    return ( StackType_t * ) slot;
+}
+
+size_t xPortTaskStackUsed( void * task )
+{
+    port_thread_t *t = **( port_thread_t *** ) task;
+    size_t i;
+
+    /* The stack grows down from the end of the block */
+    for ( i = 0; ( i < portTHREAD_STACK_SIZE ) && ( t->stack[i] == portSTACK_FILL_BYTE ); i++ ) {
+    }
+    return portTHREAD_STACK_SIZE - i;
+}
+
+static void prvTickISR( void * arg )
+{
+    if ( xTaskIncrementTick() != pdFALSE ) {
+        vPortYieldFromISR();
+    }
+}
+
+static void *prvTickThread( void * arg )
+{
+    struct timespec next;
+
+    clock_gettime( CLOCK_MONOTONIC, &next );
+    for ( ;; ) {
+        next.tv_nsec += 1000000000L / configTICK_RATE_HZ;
+        if ( next.tv_nsec >= 1000000000L ) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL );
+        vPortRunISR( prvTickISR, NULL );
+    }
+    return NULL;
+}
+
+BaseType_t xPortStartScheduler( void )
+{
+    pthread_t tick;
+    port_thread_t *first = CURRENT_THREAD();
+
+    configASSERT( pthread_create( &tick, NULL, prvTickThread, NULL ) == 0 );
+
+    scheduler_running = 1;
+    uxCriticalNesting = 0;
+    prvUnmask();
+
+    pthread_mutex_lock( &run_mutex );
+    first->run = 1;
+    pthread_cond_signal( &first->cond );
+    pthread_mutex_unlock( &run_mutex );
+
+    /* The calling thread has nothing left to do, the host side runs on its own threads */
+    for ( ;; ) {
+        pause();
+    }
+    return pdFALSE;
+}
+
+void vPortEndScheduler( void )
+{
+    exit( 0 );
+}
+
+/* The idle task sleeps until an interrupt asks for a context switch (or for 1 tick at most) */
+void vApplicationIdleHook( void )
+{
+    struct timespec until;
+
+    clock_gettime( CLOCK_REALTIME, &until );
+    until.tv_nsec += 1000000000L / configTICK_RATE_HZ;
+    if ( until.tv_nsec >= 1000000000L ) {
+        until.tv_nsec -= 1000000000L;
+        until.tv_sec++;
+    }
+
+    pthread_mutex_lock( &irq_mutex );
+    if ( !yield_pending ) {
+        pthread_cond_timedwait( &idle_cond, &irq_mutex, &until );
+    }
+    pthread_mutex_unlock( &irq_mutex );
+
+    vPortYield();
+}
@@ -0,0 +1,121 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file portmacro.h
+ *
+ * @brief FreeRTOS port for POSIX hosts (used by the host build only)
+ *
+ * Every task runs on its own thread, but only the thread of the task selected by the kernel is allowed to run, so the
+ * kernel and the modules see a single CPU. Interrupts are simulated by other host threads (tick, pseudo-I2C buses,
+ * fake MCH) through #vPortRunISR: an ISR never runs while a task has interrupts disabled, and a context switch it
+ * requests is taken as soon as the running task leaves its critical section or calls the kernel.
+ */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define portCHAR                char
+#define portFLOAT               float
+#define portDOUBLE              double
+#define portLONG                long
+#define portSHORT               short
+#define portSTACK_TYPE          uint32_t
+#define portBASE_TYPE           long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#if( configUSE_16_BIT_TICKS == 1 )
+typedef uint16_t TickType_t;
+#define portMAX_DELAY           ( TickType_t ) 0xffff
+#else
+typedef uint32_t TickType_t;
+#define portMAX_DELAY           ( TickType_t ) 0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+#endif
+
+#define portPOINTER_SIZE_TYPE   uintptr_t
+
+#define portSTACK_GROWTH        ( -1 )
+#define portTICK_PERIOD_MS      ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT      8
+
+/* Scheduler utilities */
+void vPortYield( void );
+void vPortYieldFromISR( void );
+
+#define portYIELD()                                 vPortYield()
+#define portEND_SWITCHING_ISR( xSwitchRequired )    if( xSwitchRequired != pdFALSE ) vPortYieldFromISR()
+#define portYIELD_FROM_ISR( x )                     portEND_SWITCHING_ISR( x )
+
+/* Critical section management */
+void vPortDisableInterrupts( void );
+void vPortEnableInterrupts( void );
+void vPortEnterCritical( void );
+void vPortExitCritical( void );
+
+#define portDISABLE_INTERRUPTS()                    vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()                     vPortEnableInterrupts()
+#define portENTER_CRITICAL()                        vPortEnterCritical()
+#define portEXIT_CRITICAL()                         vPortExitCritical()
+
+/* ISRs already run with the other interrupts masked */
+#define portSET_INTERRUPT_MASK_FROM_ISR()           0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR( x )      ( void ) ( x )
+
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+
+#define portNOP()
+
+/**
+ * @brief Runs an interrupt handler from a host thread
+ *
+ * Waits until the running task has interrupts enabled and no other ISR is running, then calls @a isr. A context
+ * switch requested by the handler (portYIELD_FROM_ISR) is taken by the running task right after.
+ *
+ * @param isr Interrupt handler
+ * @param arg Argument passed to the handler
+ */
+void vPortRunISR( void (*isr)( void * ), void * arg );
+
+/**
+ * @brief Whether the calling host thread is running an ISR through #vPortRunISR
+ */
+int xPortInISR( void );
+
+/**
+ * @brief Bytes of its host thread stack a task has used so far
+ *
+ * The task code runs on the stack of its host thread, not on the FreeRTOS one, so uxTaskGetStackHighWaterMark() has
+ * nothing to measure. The thread stacks are painted when the tasks are created instead. The count includes the host
+ * side of the context switches.
+ *
+ * @param task Task handle
+ */
+size_t xPortTaskStackUsed( void * task );
+
+#endif /* PORTMACRO_H */
@@ -0,0 +1,73 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file dut.c
+ *
+ * @brief Controller under test of the host build
+ */
+
+#include <pthread.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "port.h"
+#include "host_i2c.h"
+#include "fru.h"
+#include "sdr.h"
+#include "ipmi.h"
+#include "dut.h"
+
+static void (*host_fn)( void * );
+static void *host_arg;
+
+static void *host_thread( void * arg )
+{
+    /* Let the tasks reach their first blocking call */
+    while ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ) {
+        host_sleep_ns( 1000000 );
+    }
+    host_sleep_ns( 20000000 );
+
+    host_fn( host_arg );
+    return NULL;
+}
+
+void dut_init( void )
+{
+    fru_init( FRU_AMC );
+    sdr_init();
+    sensor_init();
+    ipmi_init();
+}
+
+void dut_run( void (*host)( void * ), void * arg )
+{
+    pthread_t thread;
+
+    host_fn = host;
+    host_arg = arg;
+
+    pthread_create( &thread, NULL, host_thread, NULL );
+
+    vTaskStartScheduler();
+}
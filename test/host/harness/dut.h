@@ -0,0 +1,49 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file dut.h
+ *
+ * @brief Controller under test of the host build
+ */
+
+#ifndef DUT_H_
+#define DUT_H_
+
+/**
+ * @brief Brings the modules up as main() does on the board
+ *
+ * The scheduler isn't started yet, so the modules can still be called directly from the host thread.
+ */
+void dut_init( void );
+
+/**
+ * @brief Runs the scheduler, after #dut_init
+ *
+ * @a host is started on its own host thread once the scheduler runs; it plays the other side of the buses (fake MCH,
+ * simulated chips) and ends the program with exit(). This function doesn't return.
+ *
+ * @param host Host side of the test
+ * @param arg Argument passed to @a host
+ */
+void dut_run( void (*host)( void * ), void * arg );
+
+#endif
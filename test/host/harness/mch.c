@@ -0,0 +1,385 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file mch.c
+ *
+ * @brief Scripted MCH of the host build
+ *
+ * All the protocol work runs on one MCH thread. The bus callback only queues the frames written by the DUT, and frames
+ * are only sent with the MCH lock released, since the DUT may be waiting on the bus to write to us.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "port.h"
+#include "host_i2c.h"
+#include "ipmb.h"
+#include "utils.h"
+#include "mch.h"
+
+#define MCH_SEQ_COUNT       64
+#define MCH_RX_RING_LEN     32
+#define MCH_OUTBOX_LEN      ( 2 * MCH_SEQ_COUNT + MCH_RX_RING_LEN )
+#define MCH_FRAME_LEN       ( IPMI_MSG_MAX_LENGTH + IPMB_RESP_HEADER_LENGTH + 2 )
+
+typedef struct {
+    uint8_t buf[MCH_FRAME_LEN];
+    uint8_t len;
+} mch_frame_t;
+
+static mch_cfg_t cfg = { .window = 1, .tries = IPMB_MAX_RETRIES, .timeout_ms = 250, .loss = 0, .seed = 1 };
+static mch_stats_t stats;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t thread;
+
+/* Frames written by the DUT */
+static mch_frame_t rx_ring[MCH_RX_RING_LEN];
+static uint8_t rx_head, rx_tail, rx_count;
+
+/* Requests submitted and not sent yet, and the ones waiting for their response */
+static mch_xfer_t *submit_head, *submit_tail;
+static mch_xfer_t *outstanding[MCH_SEQ_COUNT];
+static uint8_t next_seq;
+static uint32_t busy;
+
+static uint32_t rnd_state;
+
+static int mch_dev_write( host_i2c_dev_t * dev, const uint8_t * data, int len );
+
+static host_i2c_dev_t mch_dev = { .addr = MCH_ADDRESS >> 1, .write = mch_dev_write };
+
+static bool mch_lost( void )
+{
+    if ( cfg.loss <= 0 ) {
+        return false;
+    }
+
+    /* xorshift32 */
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return ( rnd_state / 4294967296.0 ) < cfg.loss;
+}
+
+static int mch_dev_write( host_i2c_dev_t * dev, const uint8_t * data, int len )
+{
+    mch_frame_t *frame;
+
+    pthread_mutex_lock( &lock );
+    if ( ( rx_count < MCH_RX_RING_LEN ) && ( len < MCH_FRAME_LEN ) ) {
+        frame = &rx_ring[rx_head];
+        frame->buf[0] = MCH_ADDRESS;
+        memcpy( &frame->buf[1], data, len );
+        frame->len = len + 1;
+        rx_head = ( rx_head + 1 ) % MCH_RX_RING_LEN;
+        rx_count++;
+        pthread_cond_signal( &wake );
+    }
+    pthread_mutex_unlock( &lock );
+
+    return len;
+}
+
+/* Frames are built here rather than with the IPMB module's own encoder, so framing errors in it show up */
+static void mch_encode( mch_frame_t * frame, ipmi_msg * msg )
+{
+    uint8_t i = 0;
+
+    frame->buf[i++] = msg->dest_addr;
+    frame->buf[i++] = ( msg->netfn << 2 ) | ( msg->dest_LUN & IPMB_DEST_LUN_MASK );
+    frame->buf[i++] = calculate_chksum( &frame->buf[0], 2 );
+    frame->buf[i++] = msg->src_addr;
+    frame->buf[i++] = ( msg->seq << 2 ) | ( msg->src_LUN & IPMB_SRC_LUN_MASK );
+    frame->buf[i++] = msg->cmd;
+    if ( IS_RESPONSE( ( *msg ) ) ) {
+        frame->buf[i++] = msg->completion_code;
+    }
+    memcpy( &frame->buf[i], msg->data, msg->data_len );
+    i += msg->data_len;
+    frame->buf[i] = calculate_chksum( &frame->buf[0], i );
+    frame->len = i + 1;
+}
+
+static void mch_decode( ipmi_msg * msg, mch_frame_t * frame )
+{
+    uint8_t i = 0;
+
+    msg->dest_addr = frame->buf[i++];
+    msg->netfn = frame->buf[i] >> 2;
+    msg->dest_LUN = frame->buf[i++] & IPMB_DEST_LUN_MASK;
+    i++;
+    msg->src_addr = frame->buf[i++];
+    msg->seq = frame->buf[i] >> 2;
+    msg->src_LUN = frame->buf[i++] & IPMB_SRC_LUN_MASK;
+    msg->cmd = frame->buf[i++];
+    msg->completion_code = IS_RESPONSE( ( *msg ) ) ? frame->buf[i++] : 0;
+    msg->data_len = ( frame->len > i + 1 ) ? frame->len - i - 1 : 0;
+    memcpy( msg->data, &frame->buf[i], msg->data_len );
+}
+
+static void mch_encode_request( mch_frame_t * frame, mch_xfer_t * xfer )
+{
+    ipmi_msg msg;
+
+    memset( &msg, 0, sizeof( msg ) );
+    msg.dest_addr = ipmb_addr;
+    msg.netfn = xfer->netfn;
+    msg.src_addr = MCH_ADDRESS;
+    msg.seq = xfer->seq;
+    msg.cmd = xfer->cmd;
+    msg.data_len = xfer->data_len;
+    memcpy( msg.data, xfer->data, xfer->data_len );
+    mch_encode( frame, &msg );
+}
+
+static uint64_t mch_deadline( void )
+{
+    return host_time_ns() + ( uint64_t ) cfg.timeout_ms * 1000000ULL;
+}
+
+static void *mch_thread( void * arg )
+{
+    static mch_frame_t outbox[MCH_OUTBOX_LEN];
+    static mch_xfer_t *finished[MCH_SEQ_COUNT];
+    int out_count, fin_count, i;
+    mch_frame_t *frame;
+    mch_xfer_t *xfer;
+    ipmi_msg msg;
+    uint64_t now, next;
+    struct timespec ts;
+
+    pthread_mutex_lock( &lock );
+    for ( ;; ) {
+        out_count = 0;
+        fin_count = 0;
+
+        /* Frames from the DUT */
+        while ( rx_count > 0 ) {
+            frame = &rx_ring[rx_tail];
+            rx_tail = ( rx_tail + 1 ) % MCH_RX_RING_LEN;
+            rx_count--;
+
+            if ( mch_lost() ) {
+                stats.lost_rx++;
+                continue;
+            }
+            if ( ( frame->len < IPMB_REQ_HEADER_LENGTH + 1 ) ||
+                 ( ipmb_assert_chksum( frame->buf, frame->len ) != ipmb_error_success ) ) {
+                continue;
+            }
+            mch_decode( &msg, frame );
+
+            if ( IS_RESPONSE( msg ) ) {
+                xfer = outstanding[msg.seq];
+                if ( ( xfer == NULL ) || ( msg.netfn != ( xfer->netfn | 1 ) ) || ( msg.cmd != xfer->cmd ) ) {
+                    stats.stale++;
+                    continue;
+                }
+                outstanding[msg.seq] = NULL;
+                xfer->dropped = false;
+                xfer->cc = msg.completion_code;
+                xfer->resp_len = msg.data_len;
+                memcpy( xfer->resp, msg.data, msg.data_len );
+                xfer->latency_ns = host_time_ns() - xfer->start_ns;
+                finished[fin_count++] = xfer;
+            } else {
+                /* Event from the DUT, just acknowledge it */
+                stats.events++;
+                msg.dest_addr = msg.src_addr;
+                msg.src_addr = MCH_ADDRESS;
+                msg.netfn |= 1;
+                msg.completion_code = 0;
+                msg.data_len = 0;
+                if ( out_count < MCH_OUTBOX_LEN ) {
+                    mch_encode( &outbox[out_count++], &msg );
+                }
+            }
+        }
+
+        /* Requests submitted since the last round */
+        while ( submit_head != NULL ) {
+            xfer = submit_head;
+            submit_head = xfer->next;
+
+            while ( outstanding[next_seq] != NULL ) {
+                next_seq = ( next_seq + 1 ) % MCH_SEQ_COUNT;
+            }
+            xfer->seq = next_seq;
+            next_seq = ( next_seq + 1 ) % MCH_SEQ_COUNT;
+            outstanding[xfer->seq] = xfer;
+
+            xfer->tries = 1;
+            xfer->start_ns = host_time_ns();
+            xfer->deadline_ns = mch_deadline();
+            mch_encode_request( &outbox[out_count++], xfer );
+        }
+
+        /* Timeouts: retry with the same sequence number, or give up */
+        now = host_time_ns();
+        next = now + 1000000000ULL;
+        for ( i = 0; i < MCH_SEQ_COUNT; i++ ) {
+            xfer = outstanding[i];
+            if ( xfer == NULL ) {
+                continue;
+            }
+            if ( now >= xfer->deadline_ns ) {
+                if ( xfer->tries < cfg.tries ) {
+                    xfer->tries++;
+                    stats.retries++;
+                    xfer->deadline_ns = mch_deadline();
+                    mch_encode_request( &outbox[out_count++], xfer );
+                } else {
+                    outstanding[i] = NULL;
+                    xfer->dropped = true;
+                    xfer->latency_ns = now - xfer->start_ns;
+                    stats.drops++;
+                    finished[fin_count++] = xfer;
+                    continue;
+                }
+            }
+            if ( xfer->deadline_ns < next ) {
+                next = xfer->deadline_ns;
+            }
+        }
+
+        if ( ( out_count > 0 ) || ( fin_count > 0 ) ) {
+            pthread_mutex_unlock( &lock );
+
+            for ( i = 0; i < out_count; i++ ) {
+                if ( mch_lost() ) {
+                    stats.lost_tx++;
+                    continue;
+                }
+                host_i2c_write_to_dut( IPMB_I2C, outbox[i].buf[0] >> 1, &outbox[i].buf[1], outbox[i].len - 1 );
+            }
+            for ( i = 0; i < fin_count; i++ ) {
+                if ( finished[i]->done ) {
+                    finished[i]->done( finished[i] );
+                }
+            }
+
+            pthread_mutex_lock( &lock );
+            for ( i = 0; i < fin_count; i++ ) {
+                finished[i]->complete = true;
+                stats.sent++;
+                busy--;
+            }
+            if ( fin_count > 0 ) {
+                pthread_cond_broadcast( &done_cond );
+            }
+            continue;
+        }
+
+        if ( ( rx_count == 0 ) && ( submit_head == NULL ) ) {
+            ts.tv_sec = next / 1000000000ULL;
+            ts.tv_nsec = next % 1000000000ULL;
+            pthread_cond_timedwait( &wake, &lock, &ts );
+        }
+    }
+
+    return NULL;
+}
+
+void mch_init( const mch_cfg_t * config )
+{
+    pthread_condattr_t attr;
+
+    if ( config ) {
+        cfg = *config;
+    }
+    if ( ( cfg.window == 0 ) || ( cfg.window >= MCH_SEQ_COUNT ) ) {
+        cfg.window = 1;
+    }
+    if ( cfg.tries == 0 ) {
+        cfg.tries = 1;
+    }
+    rnd_state = cfg.seed ? cfg.seed : 1;
+
+    /* Deadlines are taken from the monotonic clock */
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_cond_init( &wake, &attr );
+    pthread_condattr_destroy( &attr );
+
+    host_i2c_attach( IPMB_I2C, &mch_dev );
+    pthread_create( &thread, NULL, mch_thread, NULL );
+}
+
+void mch_submit( mch_xfer_t * xfer )
+{
+    pthread_mutex_lock( &lock );
+    while ( busy >= cfg.window ) {
+        pthread_cond_wait( &done_cond, &lock );
+    }
+    busy++;
+
+    xfer->complete = false;
+    xfer->next = NULL;
+    if ( submit_head == NULL ) {
+        submit_head = xfer;
+    } else {
+        submit_tail->next = xfer;
+    }
+    submit_tail = xfer;
+
+    pthread_cond_signal( &wake );
+    pthread_mutex_unlock( &lock );
+}
+
+void mch_wait( mch_xfer_t * xfer )
+{
+    pthread_mutex_lock( &lock );
+    while ( !xfer->complete ) {
+        pthread_cond_wait( &done_cond, &lock );
+    }
+    pthread_mutex_unlock( &lock );
+}
+
+int mch_transact( mch_xfer_t * xfer )
+{
+    xfer->done = NULL;
+    mch_submit( xfer );
+    mch_wait( xfer );
+
+    return xfer->dropped ? -1 : xfer->cc;
+}
+
+void mch_drain( void )
+{
+    pthread_mutex_lock( &lock );
+    while ( busy > 0 ) {
+        pthread_cond_wait( &done_cond, &lock );
+    }
+    pthread_mutex_unlock( &lock );
+}
+
+void mch_get_stats( mch_stats_t * out )
+{
+    pthread_mutex_lock( &lock );
+    *out = stats;
+    pthread_mutex_unlock( &lock );
+}
@@ -0,0 +1,132 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file mch.h
+ *
+ * @brief Scripted MCH of the host build
+ *
+ * The fake MCH sits at #MCH_ADDRESS on the IPMB bus. It keeps up to a window of requests outstanding to the DUT, each
+ * with its own 6-bit sequence number, and retries a request that got no response within the timeout with the same
+ * sequence number, as a real carrier manager does. A request still unanswered after the last try is dropped. Requests
+ * sent by the DUT (platform events) are answered with a zero completion code.
+ *
+ * Frame loss can be injected in both directions, to exercise the DUT's retry and replay paths.
+ */
+
+#ifndef MCH_H_
+#define MCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ipmb.h"
+
+typedef struct mch_xfer mch_xfer_t;
+
+/**
+ * @brief One request sent to the DUT, and its outcome
+ */
+struct mch_xfer {
+    uint8_t netfn;
+    uint8_t cmd;
+    uint8_t data[IPMI_MSG_MAX_LENGTH];
+    uint8_t data_len;
+
+    /** Called on the MCH thread once the request completed or was dropped, may be NULL */
+    void (*done)( mch_xfer_t * xfer );
+    void *priv;
+
+    /* Outcome */
+    bool dropped;                       /**< No response after the last try */
+    uint8_t cc;                         /**< Completion code of the response */
+    uint8_t resp[IPMI_MSG_MAX_LENGTH];  /**< Response data */
+    uint8_t resp_len;
+    uint8_t tries;                      /**< Times the request was sent */
+    uint64_t latency_ns;                /**< From the first try to the response */
+
+    /* MCH private */
+    uint8_t seq;
+    uint64_t start_ns;
+    uint64_t deadline_ns;
+    bool complete;
+    mch_xfer_t *next;
+};
+
+/**
+ * @brief MCH configuration
+ */
+typedef struct {
+    uint8_t window;                     /**< Requests outstanding at once (1 to 63) */
+    uint8_t tries;                      /**< Tries per request */
+    uint32_t timeout_ms;                /**< Time to wait for a response before retrying */
+    double loss;                        /**< Probability that a frame is lost on the bus, each direction */
+    uint32_t seed;                      /**< Seed of the loss generator */
+} mch_cfg_t;
+
+/**
+ * @brief MCH counters
+ */
+typedef struct {
+    uint32_t sent;                      /**< Requests completed or dropped */
+    uint32_t retries;                   /**< Tries after the first one */
+    uint32_t drops;                     /**< Requests dropped after the last try */
+    uint32_t lost_tx;                   /**< Frames to the DUT lost on the bus */
+    uint32_t lost_rx;                   /**< Frames from the DUT lost on the bus */
+    uint32_t stale;                     /**< Responses that matched no outstanding request */
+    uint32_t events;                    /**< Requests received from the DUT */
+} mch_stats_t;
+
+/**
+ * @brief Attaches the MCH to the IPMB bus and starts its thread
+ *
+ * @param cfg Configuration, NULL for one request at a time, 3 tries of 250 ms and no loss
+ */
+void mch_init( const mch_cfg_t * cfg );
+
+/**
+ * @brief Queues a request, blocking while the window is full
+ */
+void mch_submit( mch_xfer_t * xfer );
+
+/**
+ * @brief Waits until a submitted request completed or was dropped
+ */
+void mch_wait( mch_xfer_t * xfer );
+
+/**
+ * @brief Sends a request and waits for its outcome
+ *
+ * @return Completion code, or -1 if the request was dropped
+ */
+int mch_transact( mch_xfer_t * xfer );
+
+/**
+ * @brief Waits until every submitted request completed or was dropped
+ */
+void mch_drain( void );
+
+/**
+ * @brief Reads the MCH counters
+ */
+void mch_get_stats( mch_stats_t * stats );
+
+#endif
@@ -0,0 +1,328 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file i2c_bench.c
+ *
+ * @brief Bus worker load of the sensor readings, with the real drivers, on the host build
+ *
+ * The sensors of the board are read by their own drivers, through the bus workers of i2c.c, from the chip models of
+ * host_chips.c. An LM75 is added behind each of the FMC1 and FMC2 channels of the mux, as mezzanine sensors would be, and
+ * the two of the RTM-8SFP behind the RTM channel, so the interface of the mux is read on several channels. That makes
+ * LM75_MAX_COUNT LM75s. Every reading stays at its SDR nominal value.
+ *
+ * After a second of warm-up the bus worker counters of both interfaces are cleared, and read again at the end with
+ * IPMI_CUSTOM_CMD_GET_I2C_STATS. The host stack used by each bus worker is reported next to the one of a task that
+ * only blocks on a notification, which is what the host side of a context switch takes.
+ *
+ * With -s, the time a sweep of all these sensors takes is measured instead: they are all put on the over-temperature
+ * alert line, and the scheduler's alert latency, from the alert until every sensor on the line was read, is read with
+ * IPMI_CUSTOM_CMD_GET_ALERT_LATENCY after each alert. The pseudo-I2C buses take as long as the real ones at the SCL
+ * rate the bus workers set, so i2c_bench_100k, built with I2C_MAX_SPEED_KHZ=100, gives the sweep times at the
+ * original rate.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "port.h"
+#include "host_i2c.h"
+#include "host_chips.h"
+#include "i2c.h"
+#include "i2c_mapping.h"
+#include "ipmi.h"
+#include "sdr.h"
+#include "sensors.h"
+#include "sensor_sched.h"
+#include "task_notify.h"
+#include "task_priorities.h"
+#include "dut.h"
+#include "mch.h"
+
+#define WARMUP_NS           1000000000ULL
+#define SWEEP_GAP_NS        200000000ULL
+#define SWEEP_TIMEOUT_NS    1000000000ULL
+
+static uint32_t duration_s = 10;
+static uint32_t sweeps;
+
+/* LM75s added behind the mux channels */
+static const uint8_t extra_chips[] = {
+    CHIP_ID_FMC1_LM75_0, CHIP_ID_FMC2_LM75_0,
+    CHIP_ID_RTM_LM75_0, CHIP_ID_RTM_LM75_1,
+};
+static SDR_type_01h_t extra_sdrs[sizeof( extra_chips )];
+
+static TaskHandle_t blocked_task;
+
+void __real_amc_sdr_init( void );
+
+void __wrap_amc_sdr_init( void )
+{
+    uint8_t i;
+
+    __real_amc_sdr_init();
+
+    for ( i = 0; i < sizeof( extra_chips ); i++ ) {
+        extra_sdrs[i] = SDR_LM75_uC;
+        sdr_insert_entry( TYPE_01, &extra_sdrs[i], &vTaskLM75_Handle, 0, extra_chips[i] );
+    }
+}
+
+static int is_i2c_sensor( sensor_t * s )
+{
+    return ( s->sdr_type == TYPE_01 ) && ( ( s->task_handle == &vTaskLM75_Handle ) ||
+                                           ( s->task_handle == &vTaskMAX6642_Handle ) ||
+                                           ( s->task_handle == &vTaskINA220_Handle ) );
+}
+
+static void blocked( void * arg )
+{
+    for ( ;; ) {
+        task_notify_wait( NOTIFY_I2C_JOB, portMAX_DELAY );
+    }
+}
+
+static void alert_isr( void * arg )
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    sensor_sched_alert_from_isr( SENSOR_ALERT_OVERTEMP, &xHigherPriorityTaskWoken );
+    portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+}
+
+/* Alert latency counters of the scheduler, read over IPMB: alerts handled and latency of the last one, in us */
+static int read_alert_latency( int reset, uint32_t * count, double * last_us )
+{
+    mch_xfer_t xfer;
+
+    memset( &xfer, 0, sizeof( xfer ) );
+    xfer.netfn = NETFN_CUSTOM;
+    xfer.cmd = IPMI_CUSTOM_CMD_GET_ALERT_LATENCY;
+    xfer.data[0] = reset;
+    xfer.data_len = 1;
+
+    if ( ( mch_transact( &xfer ) != IPMI_CC_OK ) || ( xfer.resp_len < 20 ) ) {
+        fprintf( stderr, "Get Alert Latency failed\n" );
+        return -1;
+    }
+
+    *count = xfer.resp[0] | ( xfer.resp[1] << 8 ) | ( xfer.resp[2] << 16 ) | ( ( uint32_t ) xfer.resp[3] << 24 );
+    *last_us = ( xfer.resp[4] | ( xfer.resp[5] << 8 ) | ( xfer.resp[6] << 16 ) |
+                 ( ( uint32_t ) xfer.resp[7] << 24 ) ) * 1e6 / configCPU_CLOCK_HZ;
+    return 0;
+}
+
+static int cmp_double( const void * a, const void * b )
+{
+    double x = *( const double * ) a, y = *( const double * ) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+/* Times sweeps of all the sensors read through the bus workers, returns the number of failures */
+static int sweep_bench( void )
+{
+    double *times = calloc( sweeps, sizeof( double ) );
+    double total = 0, last_us;
+    uint32_t count, i, done = 0;
+    uint64_t start;
+    sensor_t *s;
+    int sensors = 0;
+
+    for ( s = sdr_first(); s != NULL; s = sdr_next( s ) ) {
+        if ( is_i2c_sensor( s ) ) {
+            sensor_sched_set_alert( s, SENSOR_ALERT_OVERTEMP );
+            sensors++;
+        }
+    }
+
+    if ( read_alert_latency( 1, &count, &last_us ) < 0 ) {
+        return 1;
+    }
+
+    for ( i = 0; i < sweeps; i++ ) {
+        vPortRunISR( alert_isr, NULL );
+
+        start = host_time_ns();
+        do {
+            host_sleep_ns( 1000000 );
+            if ( read_alert_latency( 0, &count, &last_us ) < 0 ) {
+                return 1;
+            }
+        } while ( count <= done && host_time_ns() - start < SWEEP_TIMEOUT_NS );
+
+        if ( count <= done ) {
+            fprintf( stderr, "Sweep %u didn't complete\n", i );
+            continue;
+        }
+        /* Sweeps are spaced out, one alert per sweep */
+        times[done++] = last_us;
+        total += last_us;
+
+        host_sleep_ns( SWEEP_GAP_NS );
+    }
+
+    if ( done > 0 ) {
+        qsort( times, done, sizeof( double ), cmp_double );
+        printf( "Sweep of %d sensors, SCL up to %u kHz: %u sweeps, mean %.0f us, median %.0f us, max %.0f us\n",
+                sensors, I2C_MAX_SPEED_KHZ, done, total / done, times[done / 2], times[done - 1] );
+    }
+    free( times );
+
+    return ( done == sweeps ) ? 0 : 1;
+}
+
+/* Bus worker counters of an interface, read over IPMB */
+static int read_stats( uint8_t iface, int reset, uint32_t counters[6] )
+{
+    mch_xfer_t xfer;
+    int i;
+
+    memset( &xfer, 0, sizeof( xfer ) );
+    xfer.netfn = NETFN_CUSTOM;
+    xfer.cmd = IPMI_CUSTOM_CMD_GET_I2C_STATS;
+    xfer.data[0] = iface;
+    xfer.data[1] = reset;
+    xfer.data_len = 2;
+
+    if ( ( mch_transact( &xfer ) != IPMI_CC_OK ) || ( xfer.resp_len < 24 ) ) {
+        fprintf( stderr, "Get I2C Stats of I2C%u failed\n", iface );
+        return -1;
+    }
+
+    for ( i = 0; i < 6; i++ ) {
+        counters[i] = xfer.resp[4 * i] | ( xfer.resp[4 * i + 1] << 8 ) | ( xfer.resp[4 * i + 2] << 16 ) |
+            ( ( uint32_t ) xfer.resp[4 * i + 3] << 24 );
+    }
+    return 0;
+}
+
+/* Counts the bus worker activity over duration_s, returns the number of failures */
+static int counter_bench( void )
+{
+    static const char *names[6] = { "grants", "jobs", "mux switches", "reordered", "mux reads", "mux reads saved" };
+    uint32_t counters[6];
+    uint64_t start;
+    double seconds;
+    size_t base, used;
+    int failures = 0;
+    uint8_t i, k;
+
+    for ( i = 0; i < I2C_MUX_CNT; i++ ) {
+        if ( read_stats( i2c_mux[i].i2c_interface, 1, counters ) < 0 ) {
+            failures++;
+        }
+    }
+    start = host_time_ns();
+
+    host_sleep_ns( ( uint64_t ) duration_s * 1000000000ULL );
+
+    seconds = ( host_time_ns() - start ) / 1e9;
+    for ( i = 0; i < I2C_MUX_CNT; i++ ) {
+        if ( read_stats( i2c_mux[i].i2c_interface, 0, counters ) < 0 ) {
+            failures++;
+            continue;
+        }
+        printf( "I2C%u:", i2c_mux[i].i2c_interface );
+        for ( k = 0; k < 6; k++ ) {
+            printf( "%s %.2f %s/s", k ? "," : "", counters[k] / seconds, names[k] );
+        }
+        printf( "\n" );
+    }
+
+    base = xPortTaskStackUsed( blocked_task );
+    for ( i = 0; i < I2C_MUX_CNT; i++ ) {
+        used = xPortTaskStackUsed( i2c_mux[i].worker );
+        printf( "I2C%u worker: %zu bytes of host stack, %zu more than a blocked task\n", i2c_mux[i].i2c_interface,
+                used, used - base );
+    }
+
+    return failures;
+}
+
+static void bench( void * arg )
+{
+    sensor_t *s;
+    int failures;
+
+    mch_init( NULL );
+    host_sleep_ns( WARMUP_NS );
+
+    failures = ( sweeps > 0 ) ? sweep_bench() : counter_bench();
+
+    /* The readings went through the drivers unchanged */
+    for ( s = sdr_first(); s != NULL; s = sdr_next( s ) ) {
+        if ( is_i2c_sensor( s ) && ( s->readout_value != ( ( SDR_type_01h_t * ) s->sdr )->nominal_reading ) ) {
+            fprintf( stderr, "Sensor %u: reading 0x%02x, expected 0x%02x\n", s->num, s->readout_value,
+                     ( ( SDR_type_01h_t * ) s->sdr )->nominal_reading );
+            failures++;
+        }
+    }
+
+    fflush( stdout );
+    exit( failures ? 1 : 0 );
+}
+
+int main( int argc, char ** argv )
+{
+    sensor_t *s;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "t:s:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 't':
+            duration_s = strtoul( optarg, NULL, 0 );
+            break;
+        case 's':
+            sweeps = strtoul( optarg, NULL, 0 );
+            break;
+        default:
+            fprintf( stderr,
+                     "Usage: %s [-t seconds] [-s sweeps]\n"
+                     "  -t seconds   Time the counters are taken over, after a second of warm-up (default 10)\n"
+                     "  -s sweeps    Time this many sweeps of the sensors instead\n",
+                     argv[0] );
+            return 2;
+        }
+    }
+    if ( duration_s == 0 ) {
+        fprintf( stderr, "Bad arguments\n" );
+        return 2;
+    }
+
+    i2c_init();
+    host_chips_attach();
+    dut_init();
+
+    for ( s = sdr_first(); s != NULL; s = sdr_next( s ) ) {
+        if ( is_i2c_sensor( s ) ) {
+            host_chips_set_reading( s, ( ( SDR_type_01h_t * ) s->sdr )->nominal_reading );
+        }
+    }
+
+    xTaskCreate( blocked, "Blocked", configMINIMAL_STACK_SIZE, NULL, tskI2C_PRIORITY, &blocked_task );
+
+    dut_run( bench, NULL );
+    return 0;
+}
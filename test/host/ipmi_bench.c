@@ -0,0 +1,338 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file ipmi_bench.c
+ *
+ * @brief IPMI throughput and latency benchmark, on the host build
+ *
+ * The fake MCH sends a weighted mix of requests to the controller under test and reports the request rate, the p50/p99
+ * latency of each netfn/cmd and the retries and drops, next to the IPMB counters of the controller itself.
+ *
+ * Each mix entry is written as netfn:cmd[:data bytes...][=weight], e.g. 0x06:0x01=4 0x04:0x2d:0x01=1, given with -m
+ * or one per line in a file given with -f (# starts a comment).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "port.h"
+#include "host_i2c.h"
+#include "ipmb.h"
+#include "ipmi.h"
+#include "dut.h"
+#include "mch.h"
+
+#define BENCH_MAX_MIX   32
+
+typedef struct {
+    char name[64];
+    uint8_t netfn;
+    uint8_t cmd;
+    uint8_t data[IPMI_MSG_MAX_LENGTH];
+    uint8_t data_len;
+    uint32_t weight;
+
+    uint32_t sent;
+    uint32_t errors;
+    uint32_t drops;
+    uint64_t *lat;
+    uint32_t lat_count;
+} bench_entry_t;
+
+static bench_entry_t mix[BENCH_MAX_MIX];
+static int mix_count;
+static uint32_t total_weight;
+
+static uint32_t count = 1000;
+static int check;
+static int check_once;
+static mch_cfg_t mch_cfg = { .window = 1, .tries = IPMB_MAX_RETRIES, .timeout_ms = 250, .loss = 0, .seed = 1 };
+
+static void usage( const char * prog )
+{
+    fprintf( stderr,
+             "Usage: %s [options] -m netfn:cmd[:data...][=weight]... | -f mixfile\n"
+             "  -m entry     Traffic mix entry, may be repeated\n"
+             "  -f file      Traffic mix file, one entry per line\n"
+             "  -n count     Number of requests to send (default 1000)\n"
+             "  -w window    Requests outstanding at once (default 1)\n"
+             "  -r tries     Tries per request (default %d)\n"
+             "  -t ms        Response timeout before a retry (default 250)\n"
+             "  -l loss      Probability of losing a frame on the bus (default 0)\n"
+             "  -s seed      Seed of the request and loss generators (default 1)\n"
+             "  -c           Exit with an error if any request was dropped\n"
+             "  -u           Exit with an error if a request reached the handlers more than once\n",
+             prog, IPMB_MAX_RETRIES );
+    exit( 2 );
+}
+
+static void mix_add( const char * spec )
+{
+    bench_entry_t *e;
+    char buf[256];
+    char *weight, *field, *save;
+    int n = 0, i, len;
+
+    if ( mix_count >= BENCH_MAX_MIX ) {
+        fprintf( stderr, "Too many mix entries\n" );
+        exit( 2 );
+    }
+    e = &mix[mix_count];
+    memset( e, 0, sizeof( *e ) );
+
+    snprintf( buf, sizeof( buf ), "%s", spec );
+    e->weight = 1;
+    weight = strchr( buf, '=' );
+    if ( weight ) {
+        *weight++ = '\0';
+        e->weight = strtoul( weight, NULL, 0 );
+    }
+
+    for ( field = strtok_r( buf, ":", &save ); field; field = strtok_r( NULL, ":", &save ), n++ ) {
+        if ( n == 0 ) {
+            e->netfn = strtoul( field, NULL, 0 );
+        } else if ( n == 1 ) {
+            e->cmd = strtoul( field, NULL, 0 );
+        } else if ( e->data_len < IPMI_MAX_DATA_LEN ) {
+            e->data[e->data_len++] = strtoul( field, NULL, 0 );
+        }
+    }
+    if ( ( n < 2 ) || ( e->weight == 0 ) ) {
+        fprintf( stderr, "Bad mix entry '%s'\n", spec );
+        exit( 2 );
+    }
+
+    len = snprintf( e->name, sizeof( e->name ), "0x%02x 0x%02x", e->netfn, e->cmd );
+    for ( i = 0; ( i < e->data_len ) && ( i < 4 ); i++ ) {
+        len += snprintf( &e->name[len], sizeof( e->name ) - len, " %02x", e->data[i] );
+    }
+    if ( e->data_len > 4 ) {
+        snprintf( &e->name[len], sizeof( e->name ) - len, " ..." );
+    }
+    total_weight += e->weight;
+    mix_count++;
+}
+
+static void mix_load( const char * path )
+{
+    FILE *f = fopen( path, "r" );
+    char line[256], *p, *end;
+
+    if ( f == NULL ) {
+        perror( path );
+        exit( 2 );
+    }
+    while ( fgets( line, sizeof( line ), f ) ) {
+        if ( ( p = strchr( line, '#' ) ) != NULL ) {
+            *p = '\0';
+        }
+        for ( p = line; ( *p == ' ' ) || ( *p == '\t' ); p++ ) {
+        }
+        for ( end = p + strlen( p ); ( end > p ) && ( ( end[-1] == '\n' ) || ( end[-1] == ' ' ) || ( end[-1] == '\t' ) ); end-- ) {
+        }
+        *end = '\0';
+        if ( *p ) {
+            mix_add( p );
+        }
+    }
+    fclose( f );
+}
+
+static uint32_t rnd_state;
+
+static bench_entry_t *mix_pick( void )
+{
+    uint32_t r;
+    int i;
+
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+
+    r = rnd_state % total_weight;
+    for ( i = 0; r >= mix[i].weight; i++ ) {
+        r -= mix[i].weight;
+    }
+    return &mix[i];
+}
+
+static void bench_done( mch_xfer_t * xfer )
+{
+    bench_entry_t *e = ( bench_entry_t * ) xfer->priv;
+
+    /* Runs on the MCH thread only */
+    e->sent++;
+    if ( xfer->dropped ) {
+        e->drops++;
+    } else {
+        if ( xfer->cc != 0 ) {
+            e->errors++;
+        }
+        e->lat[e->lat_count++] = xfer->latency_ns;
+    }
+}
+
+static int cmp_u64( const void * a, const void * b )
+{
+    uint64_t x = *( const uint64_t * ) a, y = *( const uint64_t * ) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+static double percentile_ms( bench_entry_t * e, int p )
+{
+    uint32_t i;
+
+    if ( e->lat_count == 0 ) {
+        return 0;
+    }
+    i = ( uint64_t ) e->lat_count * p / 100;
+    if ( i >= e->lat_count ) {
+        i = e->lat_count - 1;
+    }
+    return e->lat[i] / 1e6;
+}
+
+static void bench_run( void * arg )
+{
+    mch_xfer_t *xfers;
+    mch_stats_t ms;
+    ipmb_replay_stats replay;
+    ipmb_pool_stats pool;
+    uint64_t start, elapsed;
+    uint32_t i, drops = 0;
+    bench_entry_t *e;
+    int k;
+
+    mch_init( &mch_cfg );
+
+    xfers = calloc( mch_cfg.window, sizeof( mch_xfer_t ) );
+    for ( k = 0; k < mix_count; k++ ) {
+        mix[k].lat = calloc( count, sizeof( uint64_t ) );
+    }
+    rnd_state = mch_cfg.seed ? mch_cfg.seed : 1;
+
+    start = host_time_ns();
+    for ( i = 0; i < count; i++ ) {
+        /* Slots are reused in order, the oldest request must be done before its slot takes a new one */
+        mch_xfer_t *x = &xfers[i % mch_cfg.window];
+
+        if ( i >= mch_cfg.window ) {
+            mch_wait( x );
+        }
+
+        e = mix_pick();
+        memset( x, 0, sizeof( *x ) );
+        x->netfn = e->netfn;
+        x->cmd = e->cmd;
+        x->data_len = e->data_len;
+        memcpy( x->data, e->data, e->data_len );
+        x->done = bench_done;
+        x->priv = e;
+        mch_submit( x );
+    }
+    mch_drain();
+    elapsed = host_time_ns() - start;
+
+    mch_get_stats( &ms );
+    ipmb_replay_get_stats( &replay );
+    ipmb_pool_get_stats( &pool );
+
+    printf( "%u requests in %.2f s: %.1f req/s, window %u, loss %.3f\n", count, elapsed / 1e9,
+            count / ( elapsed / 1e9 ), mch_cfg.window, mch_cfg.loss );
+    printf( "%-26s %8s %8s %8s %10s %10s %10s\n", "netfn cmd", "sent", "errors", "drops", "p50 (ms)", "p99 (ms)",
+            "max (ms)" );
+    for ( k = 0; k < mix_count; k++ ) {
+        e = &mix[k];
+        qsort( e->lat, e->lat_count, sizeof( uint64_t ), cmp_u64 );
+        printf( "%-26s %8u %8u %8u %10.2f %10.2f %10.2f\n", e->name, e->sent, e->errors, e->drops,
+                percentile_ms( e, 50 ), percentile_ms( e, 99 ),
+                e->lat_count ? e->lat[e->lat_count - 1] / 1e6 : 0.0 );
+        drops += e->drops;
+    }
+    printf( "MCH: %u retries, %u drops, %u frames lost to the DUT, %u lost from the DUT, %u stale responses, %u events\n",
+            ms.retries, ms.drops, ms.lost_tx, ms.lost_rx, ms.stale, ms.events );
+    printf( "DUT: replay %u hits / %u misses / %u in flight, msg pool high water %u / %u (%u exhausted), I2C slave overruns %u\n",
+            replay.hits, replay.misses, replay.inflight, pool.high_water, IPMB_MSG_POOL_SIZE, pool.exhausted,
+            ulI2CSlaveOverruns( IPMB_I2C ) );
+
+    /* Each request the client got ran a handler, retries must have been answered by the IPMB layer */
+    if ( check_once && ( replay.misses > count ) ) {
+        printf( "%u requests reached the handlers more than once\n", replay.misses - count );
+        fflush( stdout );
+        exit( 1 );
+    }
+
+    fflush( stdout );
+    exit( ( check && drops ) ? 1 : 0 );
+}
+
+int main( int argc, char ** argv )
+{
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "m:f:n:w:r:t:l:s:cu" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'm':
+            mix_add( optarg );
+            break;
+        case 'f':
+            mix_load( optarg );
+            break;
+        case 'n':
+            count = strtoul( optarg, NULL, 0 );
+            break;
+        case 'w':
+            mch_cfg.window = strtoul( optarg, NULL, 0 );
+            break;
+        case 'r':
+            mch_cfg.tries = strtoul( optarg, NULL, 0 );
+            break;
+        case 't':
+            mch_cfg.timeout_ms = strtoul( optarg, NULL, 0 );
+            break;
+        case 'l':
+            mch_cfg.loss = strtod( optarg, NULL );
+            break;
+        case 's':
+            mch_cfg.seed = strtoul( optarg, NULL, 0 );
+            break;
+        case 'c':
+            check = 1;
+            break;
+        case 'u':
+            check_once = 1;
+            break;
+        default:
+            usage( argv[0] );
+        }
+    }
+    if ( ( mix_count == 0 ) || ( count == 0 ) || ( mch_cfg.window == 0 ) || ( mch_cfg.window > 63 ) ) {
+        usage( argv[0] );
+    }
+
+    dut_init();
+    dut_run( bench_run, NULL );
+    return 0;
+}
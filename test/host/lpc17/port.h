@@ -0,0 +1,159 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/*!
+ * @file port.h
+ *
+ * @brief Port layer of the LPC17xx I2C driver test
+ *
+ * Takes the place of port/ucontroller/nxp/lpc17xx/port.h for lpc17_i2c.c alone: the LPCOpen I2C types and calls it
+ * uses, with the GPIOs of the bus lines and the cycle counter implemented by the test (test_i2c_recovery.c).
+ */
+
+#ifndef PORT_H_
+#define PORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* I2C interfaces, as in the LPCOpen I2C driver */
+typedef enum {
+    I2C0,
+    I2C1,
+    I2C2,
+    I2C_NUM_INTERFACE
+} I2C_ID_T;
+
+#include "lpc17_i2c.h"
+
+/* LPCOpen I2C controller */
+typedef struct {
+    volatile uint32_t CONSET;
+    volatile uint32_t STAT;
+    volatile uint32_t DAT;
+    volatile uint32_t CONCLR;
+} LPC_I2C_T;
+
+extern LPC_I2C_T host_lpc_i2c[I2C_NUM_INTERFACE];
+
+#define LPC_I2C0                        ( &host_lpc_i2c[I2C0] )
+#define LPC_I2C1                        ( &host_lpc_i2c[I2C1] )
+#define LPC_I2C2                        ( &host_lpc_i2c[I2C2] )
+
+#define I2C_CON_AA                      ( 1UL << 2 )
+#define I2C_CON_SI                      ( 1UL << 3 )
+#define I2C_CON_STO                     ( 1UL << 4 )
+#define I2C_CON_STA                     ( 1UL << 5 )
+#define I2C_CON_I2EN                    ( 1UL << 6 )
+
+#define I2C_STAT_CODE_BITMASK           0xF8
+#define I2C_I2STAT_M_TX_SLAW_ACK        0x18
+#define I2C_I2STAT_M_TX_DAT_ACK         0x28
+#define I2C_I2STAT_M_RX_DAT_NACK        0x58
+
+typedef enum {
+    I2C_STATUS_DONE,
+    I2C_STATUS_NAK,
+    I2C_STATUS_ARBLOST,
+    I2C_STATUS_BUSERR,
+    I2C_STATUS_BUSY,
+} I2C_STATUS_T;
+
+typedef struct {
+    uint8_t slaveAddr;
+    const uint8_t *txBuff;
+    int txSz;
+    uint8_t *rxBuff;
+    int rxSz;
+    I2C_STATUS_T status;
+} I2C_XFER_T;
+
+typedef enum {
+    I2C_EVENT_WAIT = 1,
+    I2C_EVENT_DONE,
+    I2C_EVENT_LOCK,
+    I2C_EVENT_UNLOCK,
+    I2C_EVENT_SLAVE_RX,
+    I2C_EVENT_SLAVE_TX,
+} I2C_EVENT_T;
+
+typedef void (*I2C_EVENTHANDLER_T)( I2C_ID_T id, I2C_EVENT_T event );
+
+typedef enum {
+    I2C_SLAVE_GENERAL,
+    I2C_SLAVE_0,
+} I2C_SLAVE_ID;
+
+void Chip_I2C_Init( I2C_ID_T id );
+void Chip_I2C_DeInit( I2C_ID_T id );
+void Chip_I2C_SetClockRate( I2C_ID_T id, uint32_t clockrate );
+void Chip_I2C_Enable( I2C_ID_T id );
+int Chip_I2C_IsMasterActive( I2C_ID_T id );
+void Chip_I2C_MasterStateHandler( I2C_ID_T id );
+void Chip_I2C_SlaveStateHandler( I2C_ID_T id );
+int Chip_I2C_SetMasterEventHandler( I2C_ID_T id, I2C_EVENTHANDLER_T event );
+int Chip_I2C_MasterTransfer( I2C_ID_T id, I2C_XFER_T * xfer );
+void Chip_I2C_SlaveSetup( I2C_ID_T id, I2C_SLAVE_ID sid, I2C_XFER_T * xfer, I2C_EVENTHANDLER_T event, uint8_t addrMask );
+
+/* Interrupts and pads, which the test doesn't model */
+typedef enum {
+    I2C0_IRQn = 10,
+    I2C1_IRQn = 11,
+    I2C2_IRQn = 12,
+} IRQn_Type;
+
+#define NVIC_SetPriority( irq, prio )             ( (void) ( irq ) )
+#define NVIC_EnableIRQ( irq )                     ( (void) ( irq ) )
+#define Chip_IOCON_SetI2CPad( iocon, cfg )
+#define Chip_IOCON_EnableOD( iocon, port, pin )
+
+/* Pin configuration values used by the boards' pin_mapping.h */
+#define IOCON_FUNC0                     0x0
+#define IOCON_FUNC1                     0x1
+#define IOCON_FUNC2                     0x2
+#define IOCON_FUNC3                     0x3
+#define IOCON_MODE_INACT                (0x2 << 2)
+#define IOCON_MODE_PULLDOWN             (0x3 << 2)
+#define IOCON_MODE_PULLUP               (0x0 << 2)
+
+#define GPIO_DIR_INPUT                  0
+#define GPIO_DIR_OUTPUT                 1
+
+/* GPIOs of the bus lines, the pins of the other interfaces always read high */
+bool gpio_read_pin( uint8_t port, uint8_t pin );
+void gpio_set_pin_low( uint8_t port, uint8_t pin );
+void gpio_set_pin_dir( uint8_t port, uint8_t pin, bool dir );
+void pin_config( uint8_t port, uint8_t pin, uint32_t cfg );
+
+/* Cycle counter, driven by the test */
+uint32_t host_cycle_counter( void );
+
+extern uint32_t SystemCoreClock;
+
+#define cycle_counter_init()
+#define cycle_counter_read()            host_cycle_counter()
+
+#include "pin_mapping.h"
+
+#endif
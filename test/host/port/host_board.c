@@ -0,0 +1,73 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file host_board.c
+ *
+ * @brief Board level pieces of the host build: GPIOs, cycle counter, FRU EEPROM, payload and hot swap sensors
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "port.h"
+#include "host_i2c.h"
+#include "at24mac.h"
+#include "payload.h"
+
+volatile uint32_t host_gpio[HOST_GPIO_PORTS];
+
+/* The hot swap sensors have no handle to watch and are not updated */
+TaskHandle_t vTaskHotSwap_Handle;
+
+uint32_t host_cycle_counter( void )
+{
+    return ( uint32_t ) ( host_time_ns() / ( 1000000000ULL / configCPU_CLOCK_HZ ) );
+}
+
+void vAssertCalled( char* file, uint32_t line )
+{
+    fprintf( stderr, "Assertion failed at %s:%u\n", file, ( unsigned ) line );
+    abort();
+}
+
+/* The FRU EEPROM is left blank, so fru_init() builds the runtime FRU information from the board's user_amc_fru.h */
+size_t at24mac_read( uint8_t id, uint16_t address, uint8_t *rx_data, size_t buf_len, uint32_t timeout )
+{
+    return 0;
+}
+
+size_t at24mac_write( uint8_t id, uint16_t address, uint8_t *tx_data, size_t buf_len, uint32_t timeout )
+{
+    return 0;
+}
+
+/* FRU Control requests are accepted, there's no payload behind them */
+void payload_send_message( uint8_t fru_id, EventBits_t msg )
+{
+}
+
+void hotswap_init( void )
+{
+}
@@ -0,0 +1,159 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file host_chips.c
+ *
+ * @brief Chip models of the host build, for the programs linked with the real sensor drivers
+ *
+ * Every chip of the board's i2c_chip_map sits on the interface of its bus. The ones on a mux channel only answer while
+ * the PCA9547 (CHIP_ID_MUX) has their channel selected. Apart from the mux, a chip is a file of 16-bit registers: the
+ * first byte written selects the register and the next ones are stored in it, MSB first, and reads return the selected
+ * register MSB first. The register stays selected, as the LM75 driver expects. The 8-bit registers of the MAX6642 are
+ * the MSBs.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "port.h"
+#include "host_i2c.h"
+#include "host_chips.h"
+#include "i2c.h"
+#include "i2c_mapping.h"
+#include "sdr.h"
+#include "sensors.h"
+#include "sensor_linear.h"
+
+#define PCA9547_ENABLE          ( 1 << 3 )
+
+typedef struct {
+    host_i2c_dev_t dev;
+    int8_t channel;                 /* Mux channel the chip is behind, -1 if it's not multiplexed */
+    uint8_t ptr;                    /* Selected register */
+    volatile uint16_t regs[256];
+} host_chip_t;
+
+static host_chip_t chips[I2C_CHIP_CNT];
+
+/* Control register of the PCA9547 */
+static volatile uint8_t mux_ctrl;
+
+extern const ina220_config_t ina220_cfg;
+
+static bool chip_listening( host_i2c_dev_t * dev )
+{
+    host_chip_t *chip = ( host_chip_t * ) dev->priv;
+
+    return ( chip->channel == -1 ) || ( ( mux_ctrl & PCA9547_ENABLE ) && ( ( mux_ctrl & 0x07 ) == chip->channel ) );
+}
+
+static int chip_write( host_i2c_dev_t * dev, const uint8_t * data, int len )
+{
+    host_chip_t *chip = ( host_chip_t * ) dev->priv;
+    int i;
+
+    if ( len > 0 ) {
+        chip->ptr = data[0];
+    }
+    for ( i = 1; i < len; i++ ) {
+        if ( i & 1 ) {
+            chip->regs[chip->ptr] = ( chip->regs[chip->ptr] & 0x00FF ) | ( data[i] << 8 );
+        } else {
+            chip->regs[chip->ptr] = ( chip->regs[chip->ptr] & 0xFF00 ) | data[i];
+        }
+    }
+    return len;
+}
+
+static int chip_read( host_i2c_dev_t * dev, uint8_t * data, int len )
+{
+    host_chip_t *chip = ( host_chip_t * ) dev->priv;
+    uint16_t reg = chip->regs[chip->ptr];
+    int i;
+
+    for ( i = 0; i < len; i++ ) {
+        data[i] = ( i & 1 ) ? ( reg & 0xFF ) : ( reg >> 8 );
+    }
+    return len;
+}
+
+static int mux_write( host_i2c_dev_t * dev, const uint8_t * data, int len )
+{
+    if ( len > 0 ) {
+        mux_ctrl = data[len - 1];
+    }
+    return len;
+}
+
+static int mux_read( host_i2c_dev_t * dev, uint8_t * data, int len )
+{
+    int i;
+
+    for ( i = 0; i < len; i++ ) {
+        data[i] = mux_ctrl;
+    }
+    return len;
+}
+
+void host_chips_attach( void )
+{
+    host_chip_t *chip;
+    uint8_t id, bus;
+
+    for ( id = 0; id < I2C_CHIP_CNT; id++ ) {
+        chip = &chips[id];
+        bus = i2c_chip_map[id].bus_id;
+
+        chip->dev.addr = i2c_chip_map[id].i2c_address;
+        chip->dev.priv = chip;
+        chip->channel = i2c_bus_map[bus].mux_bus;
+        if ( id == CHIP_ID_MUX ) {
+            chip->dev.write = mux_write;
+            chip->dev.read = mux_read;
+        } else {
+            chip->dev.write = chip_write;
+            chip->dev.read = chip_read;
+            chip->dev.listening = chip_listening;
+        }
+
+        host_i2c_attach( i2c_bus_map[bus].i2c_interface, &chip->dev );
+    }
+}
+
+void host_chips_set_reading( sensor_t * sensor, uint8_t raw )
+{
+    host_chip_t *chip = &chips[sensor->chipid];
+    int32_t value = sensor_linear_to_measurement( sensor, raw );
+
+    if ( sensor->task_handle == &vTaskLM75_Handle ) {
+        /* 9-bit two's complement, left aligned */
+        chip->regs[LM75_REG_TEMP] = ( uint16_t ) ( value << 7 );
+    } else if ( sensor->task_handle == &vTaskMAX6642_Handle ) {
+        chip->regs[MAX6642_CMD_READ_REMOTE] = ( uint16_t ) ( value << 8 );
+    } else if ( sensor->task_handle == &vTaskINA220_Handle ) {
+        if ( GET_SENSOR_TYPE( sensor ) == SENSOR_TYPE_VOLTAGE ) {
+            chip->regs[INA220_BUS_VOLTAGE] = ( uint16_t ) ( value << ina220_cfg.bus_voltage_shift );
+        } else {
+            chip->regs[INA220_CURRENT] = ( uint16_t ) value;
+        }
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file host_chips.h
+ *
+ * @brief Chip models of the host build, for the programs linked with the real sensor drivers
+ */
+
+#ifndef HOST_CHIPS_H_
+#define HOST_CHIPS_H_
+
+#include <stdint.h>
+
+#include "sdr.h"
+
+/**
+ * @brief Attaches a model of every chip of the board's i2c_chip_map to the pseudo-I2C buses
+ *
+ * Must be called before the drivers initialize the chips, i.e. before dut_init().
+ */
+void host_chips_attach( void );
+
+/**
+ * @brief Sets the register a sensor driver reads so that it converts to the given raw reading
+ *
+ * @param sensor LM75, MAX6642 or INA220 sensor, once its driver is initialized
+ * @param raw Raw reading
+ */
+void host_chips_set_reading( sensor_t * sensor, uint8_t raw );
+
+#endif
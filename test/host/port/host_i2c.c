@@ -0,0 +1,379 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file host_i2c.c
+ *
+ * @brief Pseudo-I2C buses, implementing the LPC17xx I2C driver API (lpc17_i2c.h) on the host
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "port.h"
+#include "host_i2c.h"
+#include "task_notify.h"
+
+typedef struct {
+    pthread_mutex_t bus;            /* Held by the master using the bus */
+    uint32_t speed;
+    host_i2c_dev_t *devs;
+    bool configured;
+
+    /* Master transfers of the DUT, run by the controller thread */
+    SemaphoreHandle_t master_mutex;
+    pthread_t controller;
+    pthread_mutex_t ctl_mutex;
+    pthread_cond_t ctl_cond;
+    bool job;
+    uint8_t job_addr;
+    i2c_seg_t *job_segs;
+    uint8_t job_seg_count;
+    int job_result;
+    TaskHandle_t job_task;
+    i2c_health_t health;
+
+    /* Slave receive ring, same layout as the LPC17xx driver */
+    uint8_t slave_addr;
+    bool slave;
+    TaskHandle_t slave_task;
+    uint8_t ring[i2cSLAVE_RING_LEN][i2cMAX_MSG_LENGTH+1];
+    uint8_t ring_len[i2cSLAVE_RING_LEN];
+    volatile uint8_t ring_head;
+    volatile uint8_t ring_tail;
+    volatile uint8_t ring_count;
+    uint32_t overruns;
+
+    /* Frame being delivered by another master, used by the slave ISR */
+    const uint8_t *rx_data;
+    int rx_len;
+} host_i2c_bus_t;
+
+static host_i2c_bus_t buses[I2C_NUM_INTERFACE];
+
+uint64_t host_time_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint64_t ) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void host_sleep_ns( uint64_t ns )
+{
+    struct timespec ts;
+    uint64_t until = host_time_ns() + ns;
+
+    ts.tv_sec = until / 1000000000ULL;
+    ts.tv_nsec = until % 1000000000ULL;
+    while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL ) != 0 ) {
+    }
+}
+
+uint64_t host_i2c_transfer_ns( I2C_ID_T id, int bytes )
+{
+    uint32_t speed = buses[id].speed ? buses[id].speed : 100000;
+
+    /* START + 9 bits per byte (data and ACK) + STOP */
+    return ( ( uint64_t ) ( 9 * bytes + 2 ) * 1000000000ULL ) / speed;
+}
+
+void host_i2c_attach( I2C_ID_T id, host_i2c_dev_t * dev )
+{
+    pthread_mutex_lock( &buses[id].bus );
+    dev->next = buses[id].devs;
+    buses[id].devs = dev;
+    pthread_mutex_unlock( &buses[id].bus );
+}
+
+static host_i2c_dev_t *prvFindDev( host_i2c_bus_t * b, uint8_t addr )
+{
+    host_i2c_dev_t *dev;
+
+    for ( dev = b->devs; dev != NULL; dev = dev->next ) {
+        if ( ( dev->addr == addr ) && ( ( dev->listening == NULL ) || dev->listening( dev ) ) ) {
+            return dev;
+        }
+    }
+    return NULL;
+}
+
+/* Runs a combined transfer on the calling host thread */
+static int prvRunTransfer( I2C_ID_T id, uint8_t addr, i2c_seg_t * segs, uint8_t seg_count )
+{
+    host_i2c_bus_t *b = &buses[id];
+    host_i2c_dev_t *dev;
+    uint8_t gather[256];
+    int bytes = 0;
+    int done = 0;
+    int len, ret;
+    uint8_t i, j;
+
+    for ( i = 0; i < seg_count; i++ ) {
+        bytes += segs[i].len + ( ( segs[i].flags & I2C_SEG_NOSTART ) ? 0 : 1 );
+    }
+
+    pthread_mutex_lock( &b->bus );
+    host_sleep_ns( host_i2c_transfer_ns( id, bytes ) );
+
+    dev = prvFindDev( b, addr );
+    for ( i = 0; ( dev != NULL ) && ( i < seg_count ); i = j ) {
+        if ( segs[i].flags & I2C_SEG_READ ) {
+            len = segs[i].len;
+            ret = dev->read ? dev->read( dev, segs[i].buff, len ) : 0;
+            j = i + 1;
+        } else {
+            /* Gather the writes that continue this one */
+            len = 0;
+            for ( j = i; ( j < seg_count ) && !( segs[j].flags & I2C_SEG_READ ) &&
+                      ( ( j == i ) || ( segs[j].flags & I2C_SEG_NOSTART ) ); j++ ) {
+                memcpy( &gather[len], segs[j].buff, segs[j].len );
+                len += segs[j].len;
+            }
+            ret = dev->write ? dev->write( dev, gather, len ) : 0;
+        }
+
+        done += ret;
+        if ( ret < len ) {
+            break;
+        }
+    }
+    pthread_mutex_unlock( &b->bus );
+
+    return done;
+}
+
+static void prvMasterDoneISR( void * arg )
+{
+    host_i2c_bus_t *b = ( host_i2c_bus_t * ) arg;
+    BaseType_t woken = pdFALSE;
+
+    task_notify_from_isr( b->job_task, NOTIFY_I2C_MASTER, &woken );
+    portYIELD_FROM_ISR( woken );
+}
+
+static void *prvControllerThread( void * arg )
+{
+    host_i2c_bus_t *b = ( host_i2c_bus_t * ) arg;
+    I2C_ID_T id = ( I2C_ID_T ) ( b - buses );
+
+    for ( ;; ) {
+        pthread_mutex_lock( &b->ctl_mutex );
+        while ( !b->job ) {
+            pthread_cond_wait( &b->ctl_cond, &b->ctl_mutex );
+        }
+        pthread_mutex_unlock( &b->ctl_mutex );
+
+        b->job_result = prvRunTransfer( id, b->job_addr, b->job_segs, b->job_seg_count );
+
+        pthread_mutex_lock( &b->ctl_mutex );
+        b->job = false;
+        pthread_mutex_unlock( &b->ctl_mutex );
+
+        vPortRunISR( prvMasterDoneISR, b );
+    }
+    return NULL;
+}
+
+void vI2CConfig( I2C_ID_T id, uint32_t speed )
+{
+    host_i2c_bus_t *b = &buses[id];
+
+    b->speed = speed;
+    if ( !b->configured ) {
+        b->configured = true;
+        b->master_mutex = xSemaphoreCreateMutex();
+        pthread_mutex_init( &b->ctl_mutex, NULL );
+        pthread_cond_init( &b->ctl_cond, NULL );
+        pthread_create( &b->controller, NULL, prvControllerThread, b );
+    }
+}
+
+void vI2CSetSpeed( I2C_ID_T id, uint32_t speed )
+{
+    buses[id].speed = speed;
+}
+
+int xI2CMasterTransfer( I2C_ID_T id, uint8_t addr, i2c_seg_t * segs, uint8_t seg_count )
+{
+    host_i2c_bus_t *b = &buses[id];
+    int ret;
+
+    /* Before the scheduler starts the driver polls, here the transfer just runs on the calling thread */
+    if ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ) {
+        return prvRunTransfer( id, addr, segs, seg_count );
+    }
+
+    xSemaphoreTake( b->master_mutex, portMAX_DELAY );
+
+    pthread_mutex_lock( &b->ctl_mutex );
+    b->job_addr = addr;
+    b->job_segs = segs;
+    b->job_seg_count = seg_count;
+    b->job_task = xTaskGetCurrentTaskHandle();
+    b->job = true;
+    pthread_cond_signal( &b->ctl_cond );
+    pthread_mutex_unlock( &b->ctl_mutex );
+
+    /* The controller always finishes, in the transfer time */
+    task_notify_wait( NOTIFY_I2C_MASTER, portMAX_DELAY );
+    ret = b->job_result;
+
+    xSemaphoreGive( b->master_mutex );
+    return ret;
+}
+
+int xI2CMasterWrite( I2C_ID_T id, uint8_t addr, const uint8_t * tx_buff, uint8_t tx_len )
+{
+    i2c_seg_t seg = { .buff = ( uint8_t * ) tx_buff, .len = tx_len, .flags = 0 };
+
+    return xI2CMasterTransfer( id, addr, &seg, 1 );
+}
+
+int xI2CMasterRead( I2C_ID_T id, uint8_t addr, uint8_t * rx_buff, int rx_len )
+{
+    i2c_seg_t seg = { .buff = rx_buff, .len = rx_len, .flags = I2C_SEG_READ };
+
+    return xI2CMasterTransfer( id, addr, &seg, 1 );
+}
+
+int xI2CMasterWriteRead( I2C_ID_T id, uint8_t addr, uint8_t cmd, uint8_t * rx_buff, int rx_len )
+{
+    i2c_seg_t segs[2] = {
+        { .buff = &cmd, .len = 1, .flags = 0 },
+        { .buff = rx_buff, .len = rx_len, .flags = I2C_SEG_READ },
+    };
+    int ret = xI2CMasterTransfer( id, addr, segs, 2 );
+
+    return ( ret > 0 ) ? ret - 1 : 0;
+}
+
+uint32_t ulI2CMasterFaults( I2C_ID_T id )
+{
+    return buses[id].health.arb_lost + buses[id].health.bus_errors;
+}
+
+void vI2CMasterHealth( I2C_ID_T id, i2c_health_t * health, bool reset )
+{
+    taskENTER_CRITICAL();
+    *health = buses[id].health;
+    if ( reset ) {
+        memset( &buses[id].health, 0, sizeof( i2c_health_t ) );
+    }
+    taskEXIT_CRITICAL();
+}
+
+void vI2CSlaveSetup( I2C_ID_T id, uint8_t slave_addr )
+{
+    buses[id].slave_addr = slave_addr;
+    buses[id].slave = true;
+}
+
+uint8_t * xI2CSlaveReceiveFrame( I2C_ID_T id, uint8_t * frame_len, uint32_t timeout )
+{
+    host_i2c_bus_t *b = &buses[id];
+
+    b->slave_task = xTaskGetCurrentTaskHandle();
+
+    if ( b->ring_count == 0 ) {
+        task_notify_wait( NOTIFY_I2C_SLAVE, timeout );
+        if ( b->ring_count == 0 ) {
+            return NULL;
+        }
+    }
+
+    *frame_len = b->ring_len[b->ring_tail];
+    return &b->ring[b->ring_tail][0];
+}
+
+void vI2CSlaveReleaseFrame( I2C_ID_T id )
+{
+    host_i2c_bus_t *b = &buses[id];
+
+    taskENTER_CRITICAL();
+    if ( b->ring_count > 0 ) {
+        b->ring_tail = ( b->ring_tail + 1 ) % i2cSLAVE_RING_LEN;
+        b->ring_count--;
+    }
+    taskEXIT_CRITICAL();
+}
+
+uint32_t ulI2CSlaveOverruns( I2C_ID_T id )
+{
+    return buses[id].overruns;
+}
+
+static void prvSlaveISR( void * arg )
+{
+    host_i2c_bus_t *b = ( host_i2c_bus_t * ) arg;
+    BaseType_t woken = pdFALSE;
+    int len = ( b->rx_len > i2cMAX_MSG_LENGTH ) ? i2cMAX_MSG_LENGTH : b->rx_len;
+
+    /* The frame being filled must never be one still owned by the task, so one slot is always kept free */
+    if ( b->ring_count < i2cSLAVE_RING_LEN - 1 ) {
+        b->ring[b->ring_head][0] = b->slave_addr;
+        memcpy( &b->ring[b->ring_head][1], b->rx_data, len );
+        b->ring_len[b->ring_head] = len + 1;
+        b->ring_head = ( b->ring_head + 1 ) % i2cSLAVE_RING_LEN;
+        b->ring_count++;
+
+        if ( b->slave_task ) {
+            task_notify_from_isr( b->slave_task, NOTIFY_I2C_SLAVE, &woken );
+        }
+    } else {
+        b->overruns++;
+    }
+
+    portYIELD_FROM_ISR( woken );
+}
+
+int host_i2c_write_to_dut( I2C_ID_T id, uint8_t addr, const uint8_t * data, int len )
+{
+    host_i2c_bus_t *b = &buses[id];
+    int ret = 0;
+
+    pthread_mutex_lock( &b->bus );
+    host_sleep_ns( host_i2c_transfer_ns( id, len + 1 ) );
+
+    if ( b->slave && ( addr == ( b->slave_addr >> 1 ) ) ) {
+        b->rx_data = data;
+        b->rx_len = len;
+        vPortRunISR( prvSlaveISR, b );
+        ret = len;
+    }
+    pthread_mutex_unlock( &b->bus );
+
+    return ret;
+}
+
+static void __attribute__((constructor)) prvInit( void )
+{
+    int i;
+
+    for ( i = 0; i < I2C_NUM_INTERFACE; i++ ) {
+        pthread_mutex_init( &buses[i].bus, NULL );
+    }
+}
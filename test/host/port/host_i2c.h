@@ -0,0 +1,96 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file host_i2c.h
+ *
+ * @brief Pseudo-I2C buses of the host build
+ *
+ * Each interface is a shared bus with the controller under test (the "DUT") and any number of simulated devices. A
+ * transfer holds the bus for the time its bytes take at the configured SCL rate (9 bit times per byte plus the START),
+ * so the latencies seen by the modules follow the real bus. Transfers started by the DUT run on a controller thread
+ * and complete with an interrupt, like the LPC17xx driver; frames sent to the DUT slave by another master are stored
+ * in the same receive ring the LPC17xx driver uses.
+ */
+
+#ifndef HOST_I2C_H_
+#define HOST_I2C_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "port.h"
+
+typedef struct host_i2c_dev host_i2c_dev_t;
+
+/**
+ * @brief Simulated device on a pseudo-I2C bus
+ *
+ * The callbacks run on a host thread, while the DUT is the bus master.
+ */
+struct host_i2c_dev {
+    uint8_t addr;                   /**< 7-bit slave address */
+    /** Bytes written by the DUT, returns how many were ACKed */
+    int (*write)( host_i2c_dev_t * dev, const uint8_t * data, int len );
+    /** Bytes read by the DUT, returns how many were sent */
+    int (*read)( host_i2c_dev_t * dev, uint8_t * data, int len );
+    /** Whether the device hears the bus now (NULL if always), e.g. only while its mux channel is selected */
+    bool (*listening)( host_i2c_dev_t * dev );
+    void *priv;
+    host_i2c_dev_t *next;
+};
+
+/**
+ * @brief Adds a device to a bus
+ */
+void host_i2c_attach( I2C_ID_T id, host_i2c_dev_t * dev );
+
+/**
+ * @brief Another master writes a frame to the DUT slave
+ *
+ * Blocks the calling host thread for the transfer time. As on the LPC17xx, a frame that finds the receive ring full is
+ * still ACKed and then lost (see #ulI2CSlaveOverruns).
+ *
+ * @param id Bus
+ * @param addr 7-bit address
+ * @param data Bytes following the address
+ * @param len Number of bytes
+ *
+ * @return len if the DUT slave ACKed the address, 0 otherwise
+ */
+int host_i2c_write_to_dut( I2C_ID_T id, uint8_t addr, const uint8_t * data, int len );
+
+/**
+ * @brief Time a transfer of @a bytes bytes (address included) holds the bus, in ns
+ */
+uint64_t host_i2c_transfer_ns( I2C_ID_T id, int bytes );
+
+/**
+ * @brief Host monotonic clock, in ns
+ */
+uint64_t host_time_ns( void );
+
+/**
+ * @brief Sleeps the calling host thread
+ */
+void host_sleep_ns( uint64_t ns );
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file host_sensors.c
+ *
+ * @brief Sensor drivers of the host build
+ *
+ * The board SDRs are inserted by the board's sdr_list.c, as on the target. Instead of talking to the chips, the
+ * drivers here take the raw readings from #host_sensor_raw (starting at each SDR's nominal reading) and go through the
+ * same scheduler and threshold evaluation as the real ones. The alert lines are raised by #host_sensor_alert, standing
+ * for the GPIO interrupt of overtemp.c. Programs that look at the bus traffic link the real drivers instead, with the
+ * bus workers of i2c.c and the chip models of host_chips.c.
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sdr.h"
+#include "sensors.h"
+#include "host_sensors.h"
+
+TaskHandle_t vTaskLM75_Handle;
+TaskHandle_t vTaskMAX6642_Handle;
+TaskHandle_t vTaskINA220_Handle;
+
+volatile uint8_t host_sensor_raw[SDR_MAX_ENTRIES];
+
+static void host_sensor_read( sensor_t * sensor, void * priv )
+{
+    sensor->readout_value = host_sensor_raw[sensor->num];
+    sensor->readout_time = xTaskGetTickCount();
+    check_sensor_event( sensor );
+}
+
+static void host_sensor_add( TaskHandle_t * driver_id, uint32_t period_ms, uint32_t min_ms, uint32_t max_ms )
+{
+    sensor_t *sensor;
+
+    for ( sensor = sdr_first(); sensor != NULL; sensor = sdr_next( sensor ) ) {
+        if ( ( sensor->task_handle == driver_id ) && ( sensor->sdr_type == TYPE_01 ) ) {
+            host_sensor_raw[sensor->num] = ( ( SDR_type_01h_t * ) sensor->sdr )->nominal_reading;
+        }
+    }
+
+    sensor_sched_add_driver( driver_id, host_sensor_read, NULL, period_ms / portTICK_PERIOD_MS,
+                             min_ms / portTICK_PERIOD_MS, max_ms / portTICK_PERIOD_MS );
+}
+
+static void host_alert_isr( void * arg )
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    sensor_sched_alert_from_isr( *( uint8_t * ) arg, &xHigherPriorityTaskWoken );
+    portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+}
+
+void host_sensor_alert( uint8_t lines )
+{
+    vPortRunISR( host_alert_isr, &lines );
+}
+
+void LM75_init( void )
+{
+    host_sensor_add( &vTaskLM75_Handle, LM75_UPDATE_RATE, LM75_UPDATE_RATE_MIN, LM75_UPDATE_RATE_MAX );
+}
+
+void MAX6642_init( void )
+{
+    host_sensor_add( &vTaskMAX6642_Handle, MAX6642_UPDATE_RATE, MAX6642_UPDATE_RATE_MIN, MAX6642_UPDATE_RATE_MAX );
+}
+
+void ina220_init( void )
+{
+    host_sensor_add( &vTaskINA220_Handle, INA220_UPDATE_RATE, INA220_UPDATE_RATE, INA220_UPDATE_RATE_MAX );
+}
@@ -0,0 +1,47 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file host_sensors.h
+ *
+ * @brief Sensor drivers of the host build
+ */
+
+#ifndef HOST_SENSORS_H_
+#define HOST_SENSORS_H_
+
+#include <stdint.h>
+
+#include "sdr.h"
+
+/**
+ * @brief Raw reading returned by the next read of each sensor, indexed by sensor number
+ */
+extern volatile uint8_t host_sensor_raw[SDR_MAX_ENTRIES];
+
+/**
+ * @brief Signals alert lines from an interrupt, as a sensor limit output would
+ *
+ * @param lines Mask of SENSOR_ALERT_* lines asserted
+ */
+void host_sensor_alert( uint8_t lines );
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/*!
+ * @file port.h
+ *
+ * @brief Port layer of the host build
+ *
+ * Takes the place of port/ucontroller/nxp/lpc17xx/port.h: the I2C API is the LPC17xx one (same header), implemented
+ * over the pseudo-I2C buses of host_i2c.c. GPIOs are plain variables and the cycle counter follows the host clock.
+ */
+
+#ifndef PORT_H_
+#define PORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+
+/* LPCOpen boolean type, still used by some drivers' prototypes */
+typedef enum {FALSE = 0, TRUE = !FALSE} Bool;
+
+/* I2C interfaces, as in the LPCOpen I2C driver */
+typedef enum {
+    I2C0,
+    I2C1,
+    I2C2,
+    I2C_NUM_INTERFACE
+} I2C_ID_T;
+
+#include "port/ucontroller/nxp/lpc17xx/lpc17_i2c.h"
+
+/* Pin configuration values used by the boards' pin_mapping.h */
+#define IOCON_FUNC0             0x0
+#define IOCON_FUNC1             0x1
+#define IOCON_FUNC2             0x2
+#define IOCON_FUNC3             0x3
+#define IOCON_MODE_INACT        (0x2 << 2)
+#define IOCON_MODE_PULLDOWN     (0x3 << 2)
+#define IOCON_MODE_PULLUP       (0x0 << 2)
+
+#define pin_config( port, pin, cfg )
+
+/* GPIOs */
+#define GPIO_LEVEL_LOW          0
+#define GPIO_LEVEL_HIGH         1
+
+#define GPIO_DIR_INPUT          0
+#define GPIO_DIR_OUTPUT         1
+
+#define HOST_GPIO_PORTS         5
+
+/** @brief Pin levels, indexed by port, set by the harness for the inputs and by the modules for the outputs */
+extern volatile uint32_t host_gpio[HOST_GPIO_PORTS];
+
+#define gpio_init()
+#define gpio_read_pin( port, pin )              ( ( host_gpio[port] >> (pin) ) & 1 )
+#define gpio_read_port( port )                  ( host_gpio[port] )
+#define gpio_set_pin_high( port, pin )          ( host_gpio[port] |= ( 1UL << (pin) ) )
+#define gpio_set_pin_low( port, pin )           ( host_gpio[port] &= ~( 1UL << (pin) ) )
+#define gpio_set_pin_state( port, pin, state )  do { if ( state ) { gpio_set_pin_high( port, pin ); } else { gpio_set_pin_low( port, pin ); } } while (0)
+#define gpio_pin_toggle( port, pin )            ( host_gpio[port] ^= ( 1UL << (pin) ) )
+#define gpio_set_pin_dir( port, pin, dir )
+
+/* Cycle counter, counting at configCPU_CLOCK_HZ from the host monotonic clock */
+uint32_t host_cycle_counter( void );
+
+#define cycle_counter_init()
+#define cycle_counter_read()    host_cycle_counter()
+
+#include "pin_mapping.h"
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sdr_dump.c
+ *
+ * @brief Full SDR repository dump time, on the host build
+ *
+ * Reads the whole repository the way an MCH does during discovery: a reservation, then for each record its 5-byte
+ * header followed by the body in small chunks, following the next record IDs. The dump is timed twice:
+ * - calling the Get Device SDR handler directly, before the scheduler starts (handler cost only);
+ * - through the fake MCH over IPMB (end to end, bus time included).
+ *
+ * Every dump is compared to the active records as the specification defines them, with the runtime fields (record ID,
+ * owner ID, sensor number and entity instance) filled in.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "port.h"
+#include "host_i2c.h"
+#include "ipmi.h"
+#include "sdr.h"
+#include "dut.h"
+#include "mch.h"
+
+#define DUMP_MAX_SIZE   ( SDR_MAX_ENTRIES * 64 )
+
+typedef struct {
+    uint8_t data[DUMP_MAX_SIZE];
+    uint16_t size;
+    uint16_t records;
+    uint16_t requests;
+} sdr_dump_t;
+
+/* Runs one Get Device SDR request, returns its completion code and fills data/len with the response data */
+typedef uint8_t (*sdr_request_fn)( uint8_t cmd, uint8_t * req, uint8_t req_len, uint8_t * data, uint8_t * len );
+
+static uint8_t chunk = 16;
+static uint32_t handler_dumps = 2000;
+static uint32_t ipmb_dumps = 5;
+static int all_groups;
+static int failures;
+
+static sdr_dump_t reference;
+
+static void reference_build( void )
+{
+    sensor_t *s;
+    uint8_t *rec;
+
+    memset( &reference, 0, sizeof( reference ) );
+    for ( s = sdr_first(); s != NULL; s = sdr_next( s ) ) {
+        /* Sensors of absent hardware aren't listed */
+        if ( !s->active ) {
+            continue;
+        }
+        rec = &reference.data[reference.size];
+        memcpy( rec, s->sdr, s->sdr_length );
+
+        /* Record ID, owner ID, then the sensor number and entity instance, whose position depends on the type */
+        rec[0] = s->num;
+        rec[5] = s->ownerID;
+        if ( ( rec[3] == TYPE_01 ) || ( rec[3] == TYPE_02 ) ) {
+            rec[7] = s->num;
+            rec[9] = s->entityinstance;
+        } else if ( ( rec[3] == TYPE_11 ) || ( rec[3] == TYPE_12 ) ) {
+            rec[13] = s->entityinstance;
+        }
+
+        reference.size += s->sdr_length;
+        reference.records++;
+    }
+}
+
+static int sdr_dump( sdr_request_fn request, sdr_dump_t * dump )
+{
+    uint8_t req[6], data[IPMI_MSG_MAX_LENGTH], len, cc;
+    uint16_t reservation, record = 0, next, rec_len, offset, start;
+    uint8_t size;
+
+    dump->size = 0;
+    dump->records = 0;
+    dump->requests = 1;
+
+    if ( ( request( IPMI_RESERVE_DEVICE_SDR_REPOSITORY_CMD, NULL, 0, data, &len ) != IPMI_CC_OK ) || ( len < 2 ) ) {
+        return -1;
+    }
+    reservation = data[0] | ( data[1] << 8 );
+
+    while ( record != 0xFFFF ) {
+        start = dump->size;
+        rec_len = 5;
+        next = 0xFFFF;
+
+        for ( offset = 0; offset < rec_len; offset += size ) {
+            /* The header first, it tells the record length */
+            size = ( offset == 0 ) ? 5 : ( ( rec_len - offset > chunk ) ? chunk : rec_len - offset );
+
+            req[0] = reservation & 0xFF;
+            req[1] = reservation >> 8;
+            req[2] = record & 0xFF;
+            req[3] = record >> 8;
+            req[4] = offset;
+            req[5] = size;
+            cc = request( IPMI_GET_DEVICE_SDR_CMD, req, 6, data, &len );
+            dump->requests++;
+
+            if ( ( cc != IPMI_CC_OK ) || ( len != size + 2 ) || ( start + offset + size > DUMP_MAX_SIZE ) ) {
+                fprintf( stderr, "Get Device SDR of record %u at %u failed: cc 0x%02x, %u bytes\n", record, offset, cc,
+                         len );
+                return -1;
+            }
+            memcpy( &dump->data[start + offset], &data[2], size );
+            next = data[0] | ( data[1] << 8 );
+            if ( offset == 0 ) {
+                rec_len = 5 + data[2 + 4];
+            }
+        }
+
+        dump->size += rec_len;
+        dump->records++;
+        record = next;
+    }
+
+    return 0;
+}
+
+static void dump_check( const char * how, sdr_dump_t * dump )
+{
+    if ( ( dump->records != reference.records ) || ( dump->size != reference.size ) ||
+         memcmp( dump->data, reference.data, reference.size ) ) {
+        fprintf( stderr, "%s dump differs from the repository: %u records, %u bytes (expected %u records, %u bytes)\n",
+                 how, dump->records, dump->size, reference.records, reference.size );
+        failures++;
+    }
+}
+
+/* Handler called directly, as the IPMI dispatcher does */
+static uint8_t handler_request( uint8_t cmd, uint8_t * data, uint8_t data_len, uint8_t * rsp_data, uint8_t * rsp_len )
+{
+    ipmi_msg req, rsp;
+
+    req.netfn = NETFN_SE;
+    req.cmd = cmd;
+    req.data_len = data_len;
+    if ( data_len ) {
+        memcpy( req.data, data, data_len );
+    }
+    rsp.data_len = 0;
+    rsp.completion_code = IPMI_CC_OK;
+
+    ipmi_retrieve_handler( NETFN_SE, cmd )( &req, &rsp );
+
+    *rsp_len = rsp.data_len;
+    memcpy( rsp_data, rsp.data, rsp.data_len );
+    return rsp.completion_code;
+}
+
+static uint8_t ipmb_request( uint8_t cmd, uint8_t * data, uint8_t data_len, uint8_t * rsp_data, uint8_t * rsp_len )
+{
+    mch_xfer_t xfer;
+    int cc;
+
+    memset( &xfer, 0, sizeof( xfer ) );
+    xfer.netfn = NETFN_SE;
+    xfer.cmd = cmd;
+    xfer.data_len = data_len;
+    if ( data_len ) {
+        memcpy( xfer.data, data, data_len );
+    }
+
+    cc = mch_transact( &xfer );
+    if ( cc < 0 ) {
+        *rsp_len = 0;
+        return 0xFF;
+    }
+    *rsp_len = xfer.resp_len;
+    memcpy( rsp_data, xfer.resp, xfer.resp_len );
+    return cc;
+}
+
+static void handler_bench( void )
+{
+    static sdr_dump_t dump;
+    uint64_t start, elapsed;
+    uint32_t i;
+
+    /* The first dump also builds whatever the handler caches */
+    if ( sdr_dump( handler_request, &dump ) < 0 ) {
+        failures++;
+        return;
+    }
+    dump_check( "Handler", &dump );
+
+    start = host_time_ns();
+    for ( i = 0; i < handler_dumps; i++ ) {
+        sdr_dump( handler_request, &dump );
+    }
+    elapsed = host_time_ns() - start;
+
+    printf( "SDR repository: %u records, %u bytes, %u requests per dump with %u-byte reads\n", reference.records,
+            reference.size, dump.requests, chunk );
+    printf( "Handler: %.2f us per full dump, %.0f ns per request (%u dumps)\n",
+            elapsed / 1e3 / handler_dumps, ( double ) elapsed / handler_dumps / dump.requests, handler_dumps );
+}
+
+static void ipmb_bench( void * arg )
+{
+    static sdr_dump_t dump;
+    uint64_t start, elapsed, min = UINT64_MAX, total = 0;
+    uint32_t i;
+    mch_stats_t ms;
+
+    mch_init( NULL );
+
+    for ( i = 0; i < ipmb_dumps; i++ ) {
+        start = host_time_ns();
+        if ( sdr_dump( ipmb_request, &dump ) < 0 ) {
+            failures++;
+            break;
+        }
+        elapsed = host_time_ns() - start;
+        dump_check( "IPMB", &dump );
+
+        total += elapsed;
+        if ( elapsed < min ) {
+            min = elapsed;
+        }
+    }
+
+    mch_get_stats( &ms );
+    if ( i > 0 ) {
+        printf( "IPMB: %.1f ms per full dump (min %.1f ms, %u dumps, %u retries)\n", total / 1e6 / i, min / 1e6, i,
+                ms.retries );
+    }
+
+    fflush( stdout );
+    exit( failures ? 1 : 0 );
+}
+
+int main( int argc, char ** argv )
+{
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "ab:k:n:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'a':
+            all_groups = 1;
+            break;
+        case 'b':
+            chunk = strtoul( optarg, NULL, 0 );
+            break;
+        case 'k':
+            handler_dumps = strtoul( optarg, NULL, 0 );
+            break;
+        case 'n':
+            ipmb_dumps = strtoul( optarg, NULL, 0 );
+            break;
+        default:
+            fprintf( stderr,
+                     "Usage: %s [-a] [-b read size] [-k handler dumps] [-n IPMB dumps]\n"
+                     "  -a           List the RTM sensors too, as if the RTM was present\n"
+                     "  -b bytes     Bytes per Get Device SDR after the header (default 16, max %d)\n"
+                     "  -k count     Dumps timed on the handler alone (default 2000)\n"
+                     "  -n count     Dumps timed through the MCH (default 5)\n",
+                     argv[0], IPMI_MAX_DATA_LEN - 2 );
+            return 2;
+        }
+    }
+    if ( ( chunk == 0 ) || ( chunk > IPMI_MAX_DATA_LEN - 2 ) || ( handler_dumps == 0 ) ) {
+        fprintf( stderr, "Bad arguments\n" );
+        return 2;
+    }
+
+    dut_init();
+
+    if ( all_groups ) {
+        sdr_set_group_active( SDR_GROUP_RTM, true );
+    }
+
+    reference_build();
+    handler_bench();
+
+    dut_run( ipmb_bench, NULL );
+    return 0;
+}
@@ -0,0 +1,758 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file test_i2c_recovery.c
+ *
+ * @brief Unit tests of the LPC17xx I2C bus recovery, against a simulated stuck slave, and of the combined transfers
+ *
+ * lpc17_i2c.c is built here unchanged, on the LPCOpen declarations of lpc17/port.h. The SDA and SCL pins of I2C0 are
+ * wired to a slave which was interrupted in the middle of a read: it holds SDA low until it has seen the SCL falling
+ * edges of the rest of its byte. The cycle counter only moves when it is read (or when the task sleeps), so the busy
+ * waits of the driver are measured exactly.
+ *
+ * Each recovery case checks that the stuck bus is detected, that the slave lets go after the clocks it needed and a
+ * STOP follows, the health counters, and the longest stretch the driver spins without giving the CPU away, with and
+ * without the scheduler running.
+ *
+ * Once the bus is free, Chip_I2C_MasterTransfer() runs the controller against an EEPROM-like device: each bus state is
+ * handed to the driver's interrupt handler, as the hardware would, and LPCOpen's master state machine is reproduced
+ * below, so the segment chaining of the driver is exercised as on the target. The transfer cases check what the device
+ * saw on the bus and the byte counts returned, which the EEPROM drivers and the OEM I2C command rely on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "port.h"
+
+/* The driver under test, with its static functions */
+#include "lpc17_i2c.c"
+
+#define HELD_FOREVER    1000
+
+static int failures;
+static int checks;
+
+#define CHECK( cond, ... )                                              \
+    do {                                                                \
+        checks++;                                                       \
+        if ( !( cond ) ) {                                              \
+            failures++;                                                 \
+            fprintf( stderr, "%s:%d: ", __FILE__, __LINE__ );           \
+            fprintf( stderr, __VA_ARGS__ );                             \
+            fprintf( stderr, "\n" );                                    \
+        }                                                               \
+    } while ( 0 )
+
+LPC_I2C_T host_lpc_i2c[I2C_NUM_INTERFACE];
+uint32_t SystemCoreClock = configCPU_CLOCK_HZ;
+
+/*
+ * Bus model: each line is high unless the controller pin drives it (pin as output, low latch) or, for SDA, the slave
+ * holds it. The slave shifts its next bit on each SCL falling edge.
+ */
+static bool drive_sda, drive_scl;
+static int slave_bits;                  /* SCL falling edges before the slave releases SDA */
+static bool scl_prev;
+static int clocks;                      /* SCL rising edges */
+static int stops;                       /* SDA rising edges with SCL high */
+static int controller_inits;
+
+/* Simulated time */
+static uint32_t cycles;
+static bool scheduler_running;
+static int delays;
+static uint32_t busy_start;
+static uint32_t busy_max;               /* Longest run of cycles without sleeping */
+static bool scl_low_asleep;
+
+static bool line_sda( void )
+{
+    return !( drive_sda || ( slave_bits > 0 ) );
+}
+
+static bool line_scl( void )
+{
+    return !drive_scl;
+}
+
+static bool is_sda( uint8_t port, uint8_t pin )
+{
+    return ( port == PIN_PORT( I2C0_SDA ) ) && ( pin == PIN_NUMBER( I2C0_SDA ) );
+}
+
+static bool is_scl( uint8_t port, uint8_t pin )
+{
+    return ( port == PIN_PORT( I2C0_SCL ) ) && ( pin == PIN_NUMBER( I2C0_SCL ) );
+}
+
+bool gpio_read_pin( uint8_t port, uint8_t pin )
+{
+    if ( is_sda( port, pin ) ) {
+        return line_sda();
+    }
+    if ( is_scl( port, pin ) ) {
+        return line_scl();
+    }
+    return true;
+}
+
+void gpio_set_pin_low( uint8_t port, uint8_t pin )
+{
+}
+
+void gpio_set_pin_dir( uint8_t port, uint8_t pin, bool dir )
+{
+    bool sda_before = line_sda();
+    bool scl;
+
+    if ( is_sda( port, pin ) ) {
+        drive_sda = dir;
+    } else if ( is_scl( port, pin ) ) {
+        drive_scl = dir;
+    } else {
+        return;
+    }
+
+    scl = line_scl();
+    if ( scl_prev && !scl && ( slave_bits > 0 ) ) {
+        slave_bits--;
+    }
+    if ( !scl_prev && scl ) {
+        clocks++;
+    }
+    scl_prev = scl;
+
+    if ( !sda_before && line_sda() && scl ) {
+        stops++;
+    }
+}
+
+void pin_config( uint8_t port, uint8_t pin, uint32_t cfg )
+{
+}
+
+uint32_t host_cycle_counter( void )
+{
+    /* About what a read and compare of DWT->CYCCNT takes */
+    cycles += 4;
+    return cycles;
+}
+
+/* LPCOpen I2C driver */
+void Chip_I2C_Init( I2C_ID_T id )
+{
+    controller_inits++;
+}
+
+void Chip_I2C_DeInit( I2C_ID_T id )
+{
+}
+
+void Chip_I2C_SetClockRate( I2C_ID_T id, uint32_t clockrate )
+{
+}
+
+void Chip_I2C_Enable( I2C_ID_T id )
+{
+}
+
+/*
+ * Device of the transfer cases, at DEV_ADDR. What it sees on the bus is logged as text: S and Sr for the STARTs,
+ * the address and the written bytes in hex, "rd" for each byte it sends, N for a NACK, AL when another master wins the
+ * arbitration and P for the STOP. Each read returns mem[] from its first byte.
+ */
+#define DEV_ADDR        0x50
+#define DAT_EMPTY       0x100           /* DAT value the driver never writes */
+
+static struct {
+    uint8_t addr;
+    bool nack_addr;                     /* NACK its address */
+    int nack_data;                      /* Written bytes acknowledged before a NACK, -1 for none */
+    int arblost_at;                     /* Bus state of the first attempt where the arbitration is lost, -1 for none */
+    uint8_t mem[16];
+    char log[256];
+} dev;
+
+static int transfers;
+static bool master_active;
+static I2C_XFER_T *master_xfer;
+static I2C_EVENTHANDLER_T master_event;
+
+static void dev_log( const char * fmt, unsigned val )
+{
+    size_t len = strlen( dev.log );
+
+    snprintf( &dev.log[len], sizeof( dev.log ) - len, len ? " " : "" );
+    len = strlen( dev.log );
+    snprintf( &dev.log[len], sizeof( dev.log ) - len, fmt, val );
+}
+
+int Chip_I2C_IsMasterActive( I2C_ID_T id )
+{
+    return master_active;
+}
+
+/* As handleMasterXferState() of LPCOpen's i2c_17xx_40xx.c */
+#define I2C_CON_FLAGS   ( I2C_CON_AA | I2C_CON_SI | I2C_CON_STO | I2C_CON_STA )
+
+void Chip_I2C_MasterStateHandler( I2C_ID_T id )
+{
+    LPC_I2C_T *pI2C = &host_lpc_i2c[id];
+    I2C_XFER_T *xfer = master_xfer;
+    uint32_t cclr = I2C_CON_FLAGS;
+
+    switch ( pI2C->STAT & I2C_STAT_CODE_BITMASK ) {
+    case 0x08:
+    case 0x10:
+        pI2C->DAT = ( xfer->slaveAddr << 1 ) | ( xfer->txSz == 0 );
+        break;
+
+    case 0x18:
+    case 0x28:
+        if ( !xfer->txSz ) {
+            cclr &= ~( xfer->rxSz ? I2C_CON_STA : I2C_CON_STO );
+        } else {
+            pI2C->DAT = *xfer->txBuff++;
+            xfer->txSz--;
+        }
+        break;
+
+    case 0x58:
+        cclr &= ~I2C_CON_STO;
+        /* Fall through */
+    case 0x50:
+        *xfer->rxBuff++ = pI2C->DAT;
+        xfer->rxSz--;
+        /* Fall through */
+    case 0x40:
+        if ( xfer->rxSz > 1 ) {
+            cclr &= ~I2C_CON_AA;
+        }
+        break;
+
+    case 0x20:
+    case 0x30:
+    case 0x48:
+        xfer->status = I2C_STATUS_NAK;
+        cclr &= ~I2C_CON_STO;
+        break;
+
+    case 0x38:
+        xfer->status = I2C_STATUS_ARBLOST;
+        break;
+
+    case 0x00:
+        xfer->status = I2C_STATUS_BUSERR;
+        cclr &= ~I2C_CON_STO;
+    }
+
+    pI2C->CONSET = cclr ^ I2C_CON_FLAGS;
+    pI2C->CONCLR = cclr;
+
+    if ( !( cclr & I2C_CON_STO ) || ( xfer->status == I2C_STATUS_ARBLOST ) ) {
+        if ( xfer->status == I2C_STATUS_BUSY ) {
+            xfer->status = I2C_STATUS_DONE;
+        }
+        master_event( id, I2C_EVENT_DONE );
+    }
+}
+
+void Chip_I2C_SlaveStateHandler( I2C_ID_T id )
+{
+}
+
+int Chip_I2C_SetMasterEventHandler( I2C_ID_T id, I2C_EVENTHANDLER_T event )
+{
+    master_event = event;
+    return 1;
+}
+
+/* Moves the bus on from a state, after the interrupt handler set the controller up for the next one */
+static uint32_t bus_next_state( LPC_I2C_T * lpc, uint32_t state, bool * reading, int * acked, int * read_count )
+{
+    if ( lpc->CONSET & I2C_CON_STA ) {
+        dev_log( "Sr", 0 );
+        return 0x10;
+    }
+
+    switch ( state ) {
+    case 0x08:
+    case 0x10:
+        /* SLA+R/W */
+        CHECK( lpc->DAT != DAT_EMPTY, "no address sent after a START" );
+        dev_log( "%02x", lpc->DAT );
+        *reading = lpc->DAT & 1;
+        *read_count = 0;
+        if ( ( ( lpc->DAT >> 1 ) != dev.addr ) || dev.nack_addr ) {
+            dev_log( "N", 0 );
+            return *reading ? 0x48 : 0x20;
+        }
+        return *reading ? 0x40 : 0x18;
+
+    case 0x18:
+    case 0x28:
+        /* Data byte written */
+        CHECK( lpc->DAT != DAT_EMPTY, "no data sent, nor a START or a STOP" );
+        dev_log( "%02x", lpc->DAT );
+        if ( *acked == dev.nack_data ) {
+            dev_log( "N", 0 );
+            return 0x30;
+        }
+        ( *acked )++;
+        return 0x28;
+
+    case 0x40:
+    case 0x50:
+        /* Data byte read, acknowledged by the controller unless it's the last one */
+        dev_log( "rd", 0 );
+        lpc->DAT = dev.mem[( *read_count )++ % sizeof( dev.mem )];
+        return ( lpc->CONSET & I2C_CON_AA ) ? 0x50 : 0x58;
+
+    default:
+        CHECK( false, "bus left in state 0x%02x", state );
+        return 0x00;
+    }
+}
+
+/* A transfer only goes through on a free bus, where it's driven state by state through the interrupt handler */
+int Chip_I2C_MasterTransfer( I2C_ID_T id, I2C_XFER_T * xfer )
+{
+    LPC_I2C_T *lpc = &host_lpc_i2c[id];
+    uint32_t state = 0x08;
+    uint32_t dat = DAT_EMPTY;
+    bool reading = false;
+    int acked = 0, read_count = 0, events = 0;
+
+    transfers++;
+    if ( !line_sda() || !line_scl() ) {
+        xfer->status = I2C_STATUS_BUSERR;
+        return xfer->status;
+    }
+
+    master_event( id, I2C_EVENT_LOCK );
+    xfer->status = I2C_STATUS_BUSY;
+    master_xfer = xfer;
+    master_active = true;
+    dev_log( "S", 0 );
+
+    while ( xfer->status == I2C_STATUS_BUSY ) {
+        if ( ( transfers == 1 ) && ( events == dev.arblost_at ) ) {
+            dev_log( "AL", 0 );
+            state = 0x38;
+        }
+        if ( events++ > 1000 ) {
+            CHECK( false, "transfer never ends" );
+            break;
+        }
+
+        lpc->STAT = state;
+        lpc->DAT = ( state == 0x50 || state == 0x58 ) ? dat : DAT_EMPTY;
+        lpc->CONSET = 0;
+        lpc->CONCLR = 0;
+        I2C0_IRQHandler();
+        if ( xfer->status != I2C_STATUS_BUSY ) {
+            break;
+        }
+        state = bus_next_state( lpc, state, &reading, &acked, &read_count );
+        dat = lpc->DAT;
+    }
+    if ( xfer->status != I2C_STATUS_ARBLOST ) {
+        dev_log( "P", 0 );
+    }
+    master_active = false;
+
+    master_event( id, I2C_EVENT_WAIT );
+    master_xfer = NULL;
+    master_event( id, I2C_EVENT_UNLOCK );
+    return xfer->status;
+}
+
+void Chip_I2C_SlaveSetup( I2C_ID_T id, I2C_SLAVE_ID sid, I2C_XFER_T * xfer, I2C_EVENTHANDLER_T event, uint8_t addrMask )
+{
+}
+
+/* Kernel */
+BaseType_t xTaskGetSchedulerState( void )
+{
+    return scheduler_running ? taskSCHEDULER_RUNNING : taskSCHEDULER_NOT_STARTED;
+}
+
+void vTaskDelay( const TickType_t xTicksToDelay )
+{
+    if ( cycles - busy_start > busy_max ) {
+        busy_max = cycles - busy_start;
+    }
+    if ( !line_scl() ) {
+        scl_low_asleep = true;
+    }
+    delays++;
+    cycles += xTicksToDelay * ( SystemCoreClock / configTICK_RATE_HZ );
+    busy_start = cycles;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+    return NULL;
+}
+
+BaseType_t xTaskGenericNotifyFromISR( TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction,
+                                      uint32_t * pulPreviousNotificationValue, BaseType_t * pxHigherPriorityTaskWoken )
+{
+    return pdPASS;
+}
+
+uint32_t task_notify_wait( uint32_t bits, TickType_t timeout )
+{
+    return 0;
+}
+
+void vPortEnterCritical( void )
+{
+}
+
+void vPortExitCritical( void )
+{
+}
+
+void vPortDisableInterrupts( void )
+{
+}
+
+void vPortEnableInterrupts( void )
+{
+}
+
+void vPortYieldFromISR( void )
+{
+}
+
+void vAssertCalled( char * file, uint32_t line )
+{
+    fprintf( stderr, "Assertion failed at %s:%lu\n", file, ( unsigned long ) line );
+    abort();
+}
+
+/* A slave which needs held_bits more clocks, on a bus that was otherwise idle */
+static void bus_reset( int held_bits, uint32_t speed )
+{
+    unsigned i;
+
+    drive_sda = false;
+    drive_scl = false;
+    slave_bits = held_bits;
+    scl_prev = true;
+    clocks = 0;
+    stops = 0;
+    controller_inits = 0;
+    transfers = 0;
+
+    memset( &dev, 0, sizeof( dev ) );
+    dev.addr = DEV_ADDR;
+    dev.nack_data = -1;
+    dev.arblost_at = -1;
+    for ( i = 0; i < sizeof( dev.mem ); i++ ) {
+        dev.mem[i] = 0xc0 + i;
+    }
+
+    cycles = 0;
+    delays = 0;
+    busy_start = 0;
+    busy_max = 0;
+    scl_low_asleep = false;
+
+    i2c_master[I2C0].speed = speed;
+    memset( &i2c_master[I2C0].health, 0, sizeof( i2c_health_t ) );
+}
+
+static void busy_end( void )
+{
+    if ( cycles - busy_start > busy_max ) {
+        busy_max = cycles - busy_start;
+    }
+}
+
+static void test_recovery( uint32_t speed, bool running )
+{
+    static const int held[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, HELD_FOREVER };
+    uint32_t half_bit = SystemCoreClock / ( 2 * speed );
+    uint32_t spin_max = 0;
+    int pulses, expected_delays;
+    bool stuck, freed;
+    unsigned i;
+
+    scheduler_running = running;
+
+    for ( i = 0; i < sizeof( held ) / sizeof( held[0] ); i++ ) {
+        bus_reset( held[i], speed );
+
+        stuck = i2c_bus_stuck( I2C0 );
+        CHECK( stuck == ( held[i] > 0 ), "%u kHz, %d bits held: stuck %d", speed / 1000, held[i], stuck );
+
+        busy_start = cycles;
+        freed = i2c_bus_recover( I2C0 );
+        busy_end();
+
+        pulses = ( held[i] < i2cRECOVERY_CLOCKS ) ? held[i] : i2cRECOVERY_CLOCKS;
+        expected_delays = ( running && pulses > 0 ) ? ( pulses - 1 ) / i2cRECOVERY_GROUP_CLOCKS : 0;
+
+        /* The STOP starts with one more SCL falling edge */
+        CHECK( freed == ( held[i] <= i2cRECOVERY_CLOCKS + 1 ), "%u kHz, %d bits held: freed %d", speed / 1000, held[i],
+               freed );
+        CHECK( clocks == pulses + 1, "%u kHz, %d bits held: %d clocks, expected %d and the STOP's", speed / 1000,
+               held[i], clocks, pulses );
+        CHECK( stops == ( freed ? 1 : 0 ), "%u kHz, %d bits held: %d STOPs", speed / 1000, held[i], stops );
+        CHECK( line_scl() && ( line_sda() == freed ), "%u kHz, %d bits held: lines left SCL %d SDA %d", speed / 1000,
+               held[i], line_scl(), line_sda() );
+        CHECK( controller_inits == 1, "%u kHz, %d bits held: controller initialized %d times", speed / 1000, held[i],
+               controller_inits );
+
+        CHECK( ( i2c_master[I2C0].health.recoveries == 1 ) &&
+               ( i2c_master[I2C0].health.recovery_failures == ( freed ? 0u : 1u ) ),
+               "%u kHz, %d bits held: %u recoveries, %u failures", speed / 1000, held[i],
+               i2c_master[I2C0].health.recoveries, i2c_master[I2C0].health.recovery_failures );
+
+        CHECK( delays == expected_delays, "%u kHz, %d bits held: slept %d times, expected %d", speed / 1000, held[i],
+               delays, expected_delays );
+        CHECK( !scl_low_asleep, "%u kHz, %d bits held: slept with SCL low", speed / 1000, held[i] );
+
+        if ( busy_max > spin_max ) {
+            spin_max = busy_max;
+        }
+    }
+
+    /* The pulses and the STOP take 2 and 4 half bits, the rest is the counter reads and the controller restart */
+    if ( running ) {
+        CHECK( spin_max <= ( 2 * i2cRECOVERY_GROUP_CLOCKS + 4 ) * half_bit + 200,
+               "%u kHz: spun for %u cycles in a row", speed / 1000, spin_max );
+    } else {
+        CHECK( spin_max >= ( 2 * i2cRECOVERY_CLOCKS + 4 ) * half_bit, "%u kHz: spun for only %u cycles",
+               speed / 1000, spin_max );
+    }
+
+    printf( "  %3u kHz, scheduler %s: longest spin %5.1f us\n", speed / 1000, running ? "running    " : "not started",
+            ( double ) spin_max / ( SystemCoreClock / 1000000 ) );
+}
+
+static void test_recovery_100k( void )
+{
+    test_recovery( 100000, false );
+    test_recovery( 100000, true );
+}
+
+static void test_recovery_400k( void )
+{
+    test_recovery( 400000, false );
+    test_recovery( 400000, true );
+}
+
+/* A transfer on a stuck bus: recovered first, or failed at once when the slave never lets go */
+static void test_transfer( void )
+{
+    uint8_t buff[2];
+    int done;
+
+    scheduler_running = true;
+
+    bus_reset( 5, 100000 );
+    done = xI2CMasterRead( I2C0, DEV_ADDR, buff, sizeof( buff ) );
+    CHECK( ( done == 2 ) && ( transfers == 1 ), "read on a recoverable bus: %d bytes, %d transfers", done, transfers );
+    CHECK( i2c_master[I2C0].health.recoveries == 1, "read on a recoverable bus: %u recoveries",
+           i2c_master[I2C0].health.recoveries );
+
+    bus_reset( HELD_FOREVER, 100000 );
+    done = xI2CMasterRead( I2C0, DEV_ADDR, buff, sizeof( buff ) );
+    CHECK( ( done == 0 ) && ( transfers == 0 ), "read on a dead bus: %d bytes, %d transfers", done, transfers );
+    CHECK( i2c_master[I2C0].health.recovery_failures == 1, "read on a dead bus: %u failed recoveries",
+           i2c_master[I2C0].health.recovery_failures );
+}
+
+/* Word address, then the data after a repeated START: at24mac_read_at(), eeprom_24xx64_read() and the OEM command */
+static void test_write_read( void )
+{
+    uint8_t word = 0x10;
+    uint8_t buff[4];
+    i2c_seg_t segs[2] = {
+        { &word, 1, 0 },
+        { buff, sizeof( buff ), I2C_SEG_READ },
+    };
+    int done;
+
+    bus_reset( 0, 100000 );
+    memset( buff, 0, sizeof( buff ) );
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, segs, 2 );
+    CHECK( !strcmp( dev.log, "S a0 10 Sr a1 rd rd rd rd P" ), "write+read: bus saw '%s'", dev.log );
+    /* The OEM command compares with write_len + read_len, the EEPROM drivers take the address length away */
+    CHECK( done == 5, "write+read: %d bytes", done );
+    CHECK( !memcmp( buff, dev.mem, sizeof( buff ) ), "write+read: read %02x %02x %02x %02x", buff[0], buff[1], buff[2],
+           buff[3] );
+
+    bus_reset( 0, 100000 );
+    done = xI2CMasterWriteRead( I2C0, DEV_ADDR, 0x02, buff, 1 );
+    CHECK( ( done == 1 ) && !strcmp( dev.log, "S a0 02 Sr a1 rd P" ), "register read: %d bytes, bus saw '%s'", done,
+           dev.log );
+}
+
+/* Word address and the data from another buffer in one write: at24mac_write() and eeprom_24xx64_write() */
+static void test_gathered_write( void )
+{
+    uint8_t addr8[2] = { 0x00, 0x20 };
+    uint8_t data[3] = { 0x11, 0x22, 0x33 };
+    i2c_seg_t segs[2] = {
+        { addr8, sizeof( addr8 ), 0 },
+        { data, sizeof( data ), I2C_SEG_NOSTART },
+    };
+    int done;
+
+    bus_reset( 0, 100000 );
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, segs, 2 );
+    CHECK( !strcmp( dev.log, "S a0 00 20 11 22 33 P" ), "gathered write: bus saw '%s'", dev.log );
+    CHECK( done == 5, "gathered write: %d bytes", done );
+
+    /* Without the flag, the second write gets its own START */
+    segs[1].flags = 0;
+    bus_reset( 0, 100000 );
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, segs, 2 );
+    CHECK( ( done == 5 ) && !strcmp( dev.log, "S a0 00 20 Sr a0 11 22 33 P" ), "write, write: %d bytes, bus saw '%s'",
+           done, dev.log );
+}
+
+/* A device that doesn't answer its address: nothing was transferred, at24mac_write() polls on that while it's busy */
+static void test_nack_address( void )
+{
+    uint8_t word = 0x10;
+    uint8_t data[2] = { 0x11, 0x22 };
+    uint8_t buff[4];
+    i2c_seg_t wr[2] = {
+        { &word, 1, 0 },
+        { data, sizeof( data ), I2C_SEG_NOSTART },
+    };
+    i2c_seg_t rd[2] = {
+        { &word, 1, 0 },
+        { buff, sizeof( buff ), I2C_SEG_READ },
+    };
+    int done;
+
+    bus_reset( 0, 100000 );
+    dev.nack_addr = true;
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, wr, 2 );
+    CHECK( !strcmp( dev.log, "S a0 N P" ), "NACKed write: bus saw '%s'", dev.log );
+    CHECK( ( done == 0 ) && ( transfers == 1 ), "NACKed write: %d bytes, %d transfers", done, transfers );
+
+    bus_reset( 0, 100000 );
+    dev.nack_addr = true;
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, rd, 2 );
+    CHECK( ( done == 0 ) && !strcmp( dev.log, "S a0 N P" ), "NACKed write+read: %d bytes, bus saw '%s'", done,
+           dev.log );
+
+    /* Another address than the device's */
+    bus_reset( 0, 100000 );
+    done = xI2CMasterWriteRead( I2C0, DEV_ADDR + 1, 0x02, buff, 1 );
+    CHECK( ( done == 0 ) && !strcmp( dev.log, "S a2 N P" ), "absent device: %d bytes, bus saw '%s'", done, dev.log );
+}
+
+/* The device stops acknowledging in the middle of the data: only the bytes it took are counted as written */
+static void test_nack_data( void )
+{
+    uint8_t addr8[2] = { 0x00, 0x20 };
+    uint8_t data[3] = { 0x11, 0x22, 0x33 };
+    i2c_seg_t segs[2] = {
+        { addr8, sizeof( addr8 ), 0 },
+        { data, sizeof( data ), I2C_SEG_NOSTART },
+    };
+    int done;
+
+    bus_reset( 0, 100000 );
+    dev.nack_data = 3;
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, segs, 2 );
+    CHECK( !strcmp( dev.log, "S a0 00 20 11 22 N P" ), "NACK on the 2nd data byte: bus saw '%s'", dev.log );
+    CHECK( done == 3, "NACK on the 2nd data byte: %d bytes", done );
+
+    /* Right on the first byte of the gathered segment */
+    bus_reset( 0, 100000 );
+    dev.nack_data = 2;
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, segs, 2 );
+    CHECK( ( done == 2 ) && !strcmp( dev.log, "S a0 00 20 11 N P" ), "NACK on the 1st data byte: %d bytes, bus saw '%s'",
+           done, dev.log );
+
+    /* On the word address */
+    bus_reset( 0, 100000 );
+    dev.nack_data = 0;
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, segs, 2 );
+    CHECK( ( done == 0 ) && !strcmp( dev.log, "S a0 00 N P" ), "NACK on the word address: %d bytes, bus saw '%s'",
+           done, dev.log );
+}
+
+/* Arbitration lost in the read segment: the retry starts over from the first segment, with the buffers reloaded */
+static void test_arblost_retry( void )
+{
+    uint8_t word = 0x10;
+    uint8_t buff[4];
+    i2c_seg_t segs[2] = {
+        { &word, 1, 0 },
+        { buff, sizeof( buff ), I2C_SEG_READ },
+    };
+    int done;
+
+    bus_reset( 0, 100000 );
+    dev.arblost_at = 5;
+    memset( buff, 0, sizeof( buff ) );
+    done = xI2CMasterTransfer( I2C0, DEV_ADDR, segs, 2 );
+    CHECK( !strcmp( dev.log, "S a0 10 Sr a1 rd AL S a0 10 Sr a1 rd rd rd rd P" ), "lost arbitration: bus saw '%s'",
+           dev.log );
+    CHECK( ( done == 5 ) && ( transfers == 2 ), "lost arbitration: %d bytes, %d transfers", done, transfers );
+    CHECK( !memcmp( buff, dev.mem, sizeof( buff ) ), "lost arbitration: read %02x %02x %02x %02x", buff[0], buff[1],
+           buff[2], buff[3] );
+    CHECK( i2c_master[I2C0].health.arb_lost == 1, "lost arbitration: %u counted", i2c_master[I2C0].health.arb_lost );
+}
+
+int main( int argc, char ** argv )
+{
+    static const struct {
+        void (*fn)( void );
+        const char *name;
+    } tests[] = {
+        { test_recovery_100k, "recovery at 100 kHz" },
+        { test_recovery_400k, "recovery at 400 kHz" },
+        { test_transfer, "transfer on a stuck bus" },
+        { test_write_read, "write+read" },
+        { test_gathered_write, "gathered write" },
+        { test_nack_address, "NACK on the address" },
+        { test_nack_data, "NACK in the data" },
+        { test_arblost_retry, "arbitration lost and retried" },
+    };
+    unsigned i;
+    int before;
+
+    vI2CConfig( I2C0, 100000 );
+
+    for ( i = 0; i < sizeof( tests ) / sizeof( tests[0] ); i++ ) {
+        before = failures;
+        tests[i].fn();
+        printf( "%-28s %s\n", tests[i].name, ( failures == before ) ? "ok" : "FAILED" );
+    }
+
+    printf( "%d checks, %d failed\n", checks, failures );
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,411 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file test_linear.c
+ *
+ * @brief Unit tests of the measurement/reading conversion (sensor_linear.c), on the host build
+ *
+ * The integer coefficients computed by sensor_linear_init are checked against the SDR formula evaluated in floating
+ * point, <tt>reading = (measurement * lsb * 10^lsb_exp * 10^-Rexp - B * 10^Bexp) / M</tt>, rounded to nearest and
+ * saturated to the reading range:
+ * - for every SDR of one board's sdr_list.c (linked in place of the SDR repository), over the whole range of the
+ *   driver's measurement, and every reading converted back;
+ * - for random M, B, Rexp, Bexp and LSBs, at the measurements just around each rounding and saturation edge, negative
+ *   ones included, and at the ends of the 32-bit range.
+ *
+ * Built once per board, see CMakeLists.txt.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "port.h"
+#include "sdr.h"
+#include "lm75.h"
+#include "max6642.h"
+#include "sensor_linear.h"
+
+/* Measurements of the drivers calling sensor_linear_init, in their LSBs (see ina220_cfg for the INA220) */
+#define LM75_MEAS_MIN           ( -256 )
+#define LM75_MEAS_MAX           255
+#define INA220_VOLTAGE_LSB      4
+#define INA220_CURRENT_LSB      1
+#define INA220_LSB_EXP          ( -3 )
+
+#define MAX_REPORTED            20
+
+typedef struct {
+    int32_t m, b;
+    int8_t r_exp, b_exp;
+    int32_t lsb_num;
+    int8_t lsb_exp;
+} linear_params_t;
+
+static sensor_t sensors[SDR_MAX_ENTRIES];
+static int sensor_count;
+
+static int failures;
+static long checks;
+
+#define CHECK( cond, ... )                                              \
+    do {                                                                \
+        checks++;                                                       \
+        if ( !( cond ) ) {                                              \
+            if ( failures++ < MAX_REPORTED ) {                          \
+                fprintf( stderr, "%s:%d: ", __FILE__, __LINE__ );       \
+                fprintf( stderr, __VA_ARGS__ );                         \
+                fprintf( stderr, "\n" );                                \
+            }                                                           \
+        }                                                               \
+    } while ( 0 )
+
+/* The SDR repository is replaced by a plain table, the board's SDR list is only used for its records */
+TaskHandle_t vTaskHotSwap_Handle;
+TaskHandle_t vTaskLM75_Handle;
+TaskHandle_t vTaskMAX6642_Handle;
+TaskHandle_t vTaskINA220_Handle;
+
+sensor_t * sdr_insert_entry( SDR_TYPE type, void * sdr, TaskHandle_t *monitor_task, uint8_t diag_id, uint8_t slave_addr )
+{
+    sensor_t *s;
+
+    if ( sensor_count >= SDR_MAX_ENTRIES ) {
+        return NULL;
+    }
+    s = &sensors[sensor_count];
+    memset( s, 0, sizeof( *s ) );
+    s->num = sensor_count++;
+    s->sdr_type = type;
+    s->sdr = sdr;
+    s->task_handle = monitor_task;
+    s->chipid = slave_addr;
+    return s;
+}
+
+void sdr_set_group( sensor_t * entry, uint8_t group )
+{
+}
+
+extern void BOARD_SDR_INIT( void );
+
+static void sdr_encode( SDR_type_01h_t * sdr, const linear_params_t * p )
+{
+    memset( sdr, 0, sizeof( *sdr ) );
+    sdr->hdr.rectype = TYPE_01;
+    sdr->M = p->m & 0xFF;
+    sdr->M_tol = ( p->m >> 2 ) & 0xC0;
+    sdr->B = p->b & 0xFF;
+    sdr->B_accuracy = ( p->b >> 2 ) & 0xC0;
+    sdr->Rexp_Bexp = ( ( p->r_exp & 0x0F ) << 4 ) | ( p->b_exp & 0x0F );
+}
+
+static void sdr_decode( const SDR_type_01h_t * sdr, linear_params_t * p )
+{
+    p->m = sdr->M | ( ( sdr->M_tol & 0xC0 ) << 2 );
+    p->m -= ( p->m & 0x200 ) ? 0x400 : 0;
+    p->b = sdr->B | ( ( sdr->B_accuracy & 0xC0 ) << 2 );
+    p->b -= ( p->b & 0x200 ) ? 0x400 : 0;
+    p->r_exp = ( sdr->Rexp_Bexp >> 4 ) - ( ( sdr->Rexp_Bexp & 0x80 ) ? 16 : 0 );
+    p->b_exp = ( sdr->Rexp_Bexp & 0x0F ) - ( ( sdr->Rexp_Bexp & 0x08 ) ? 16 : 0 );
+}
+
+static long double ref_reading( const linear_params_t * p, int64_t measurement )
+{
+    return ( measurement * p->lsb_num * powl( 10, p->lsb_exp - p->r_exp ) - p->b * powl( 10, p->b_exp ) ) / p->m;
+}
+
+static long double ref_measurement( const linear_params_t * p, int32_t reading )
+{
+    return ( p->m * (long double) reading + p->b * powl( 10, p->b_exp ) ) * powl( 10, p->r_exp - p->lsb_exp ) /
+           p->lsb_num;
+}
+
+static int64_t clamp( long double v, int64_t lo, int64_t hi )
+{
+    return ( v < lo ) ? lo : ( ( v > hi ) ? hi : (int64_t) v );
+}
+
+/*
+ * Error of the integer conversion, on top of the final rounding: the multiplier is rounded to 1 / 2^shift and the
+ * offset to 2^off_shift / 2^shift. It only shows with huge measurements or offsets, the board SDRs must be exact.
+ */
+static long double coeff_error( int64_t x, int32_t shift, int32_t off_shift )
+{
+    return ( 0.5L * ( x < 0 ? -x : x ) + ldexpl( 1, off_shift ) + 1 ) / ldexpl( 1, shift );
+}
+
+/*
+ * True if value is the exact result rounded to nearest, then saturated. The float reference can't tell which side of
+ * an exact half the true value lies on, so both neighbours are accepted that close to it.
+ */
+static int rounded( long double exact, long double error, int64_t value, int64_t lo, int64_t hi )
+{
+    long double tol = 1e-12L * ( 1 + fabsl( exact ) ) + error;
+
+    return ( value >= clamp( floorl( exact + 0.5L - tol ), lo, hi ) ) &&
+           ( value <= clamp( floorl( exact + 0.5L + tol ), lo, hi ) );
+}
+
+static void check_reading( const sensor_t * s, const linear_params_t * p, int32_t measurement, int exact_coeffs )
+{
+    uint8_t reading = sensor_linear_to_reading( s, measurement );
+    int32_t value = s->signed_flag ? (int8_t) reading : reading;
+    long double exact = ref_reading( p, measurement );
+    long double error = exact_coeffs ? 0 : coeff_error( measurement, s->lin.shift, s->lin.off_shift );
+
+    CHECK( rounded( exact, error, value, s->signed_flag ? INT8_MIN : 0, s->signed_flag ? INT8_MAX : UINT8_MAX ),
+           "M %d B %d Rexp %d Bexp %d LSB %de%d%s: measurement %d read as %d, expected %.4Lf", p->m, p->b, p->r_exp,
+           p->b_exp, p->lsb_num, p->lsb_exp, s->signed_flag ? " (signed)" : "", measurement, value, exact );
+}
+
+static void check_measurement( const sensor_t * s, const linear_params_t * p, uint8_t reading, int exact_coeffs )
+{
+    int32_t value = s->signed_flag ? (int8_t) reading : reading;
+    int32_t measurement = sensor_linear_to_measurement( s, reading );
+    long double exact = ref_measurement( p, value );
+    long double error = exact_coeffs ? 0 : coeff_error( value, s->lin.inv_shift, s->lin.inv_off_shift );
+
+    CHECK( rounded( exact, error, measurement, INT32_MIN, INT32_MAX ),
+           "M %d B %d Rexp %d Bexp %d LSB %de%d%s: reading %d converted to %d, expected %.4Lf", p->m, p->b, p->r_exp,
+           p->b_exp, p->lsb_num, p->lsb_exp, s->signed_flag ? " (signed)" : "", value, measurement, exact );
+}
+
+/*
+ * The tolerance above is only fair if the coefficients use the precision they have: a 31-bit multiplier, unless the
+ * shift is already the largest one or a larger shift would overflow the offset
+ */
+static void check_precision( const linear_params_t * p, const char * dir, int32_t mul, int32_t shift,
+                             long double offset )
+{
+    CHECK( ( mul >= ( 1 << 30 ) ) || ( mul <= -( 1 << 30 ) ) || ( shift >= 60 ) ||
+           ( fabsl( offset ) >= ldexpl( 1, 59 - shift ) ),
+           "M %d B %d Rexp %d Bexp %d LSB %de%d: %s multiplier %d with a shift of %d", p->m, p->b, p->r_exp, p->b_exp,
+           p->lsb_num, p->lsb_exp, dir, mul, shift );
+}
+
+/* Every measurement the driver can return, and every reading back */
+static void check_range( const sensor_t * s, const linear_params_t * p, int32_t min, int32_t max )
+{
+    int32_t x;
+    int r;
+
+    for ( x = min; x <= max; x++ ) {
+        check_reading( s, p, x, 1 );
+    }
+    for ( r = 0; r <= UINT8_MAX; r++ ) {
+        check_measurement( s, p, r, 1 );
+    }
+}
+
+static void test_board( void )
+{
+    sensor_t *s;
+    SDR_type_01h_t *sdr;
+    linear_params_t p;
+    int i, tested = 0;
+
+    BOARD_SDR_INIT();
+
+    for ( i = 0; i < sensor_count; i++ ) {
+        s = &sensors[i];
+        sdr = (SDR_type_01h_t *) s->sdr;
+        if ( ( s->sdr_type != TYPE_01 ) || ( ( sdr->linearization & 0x7F ) != 0 ) ) {
+            continue;
+        }
+        sdr_decode( sdr, &p );
+
+        /* Same LSBs and signedness as the drivers */
+        if ( s->task_handle == &vTaskLM75_Handle ) {
+            p.lsb_num = LM75_LSB;
+            p.lsb_exp = LM75_LSB_EXP;
+        } else if ( s->task_handle == &vTaskMAX6642_Handle ) {
+            p.lsb_num = MAX6642_LSB;
+            p.lsb_exp = MAX6642_LSB_EXP;
+        } else if ( ( s->task_handle == &vTaskINA220_Handle ) && ( sdr->sensortype == SENSOR_TYPE_VOLTAGE ) ) {
+            p.lsb_num = INA220_VOLTAGE_LSB;
+            p.lsb_exp = INA220_LSB_EXP;
+        } else if ( ( s->task_handle == &vTaskINA220_Handle ) && ( sdr->sensortype == SENSOR_TYPE_CURRENT ) ) {
+            p.lsb_num = INA220_CURRENT_LSB;
+            p.lsb_exp = INA220_LSB_EXP;
+            s->signed_flag = 1;
+        } else {
+            continue;
+        }
+
+        CHECK( sensor_linear_init( s, p.lsb_num, p.lsb_exp ), "%.16s: SDR can't be linearized", sdr->IDstring );
+
+        if ( s->task_handle == &vTaskLM75_Handle ) {
+            check_range( s, &p, LM75_MEAS_MIN, LM75_MEAS_MAX );
+        } else if ( s->task_handle == &vTaskMAX6642_Handle ) {
+            check_range( s, &p, 0, UINT8_MAX );
+        } else if ( s->signed_flag ) {
+            check_range( s, &p, INT16_MIN, INT16_MAX );
+        } else {
+            /* 13-bit bus voltage */
+            check_range( s, &p, 0, 0x1FFF );
+        }
+        tested++;
+    }
+
+    printf( "Board SDRs: %d linear sensors checked\n", tested );
+}
+
+/* The SDR limits of sensor_linear_init: the exponents must fit in 10^9 and both slopes in 32 bits */
+static int representable( const linear_params_t * p )
+{
+    int e = p->lsb_exp - p->r_exp, base = 0;
+    long double slope;
+
+    if ( p->m == 0 ) {
+        return 0;
+    }
+    base = ( e < base ) ? e : base;
+    base = ( p->b_exp < base ) ? p->b_exp : base;
+    if ( ( e - base > 9 ) || ( p->b_exp - base > 9 ) || ( -base > 9 ) ) {
+        return 0;
+    }
+
+    slope = fabsl( p->lsb_num * powl( 10, e ) / p->m );
+    return ( slope < 0x1p30L ) && ( 1 / slope < 0x1p30L );
+}
+
+static int32_t random_int( int32_t min, int32_t max )
+{
+    return (int32_t) ( min + (int64_t) ( ( (uint64_t) random() << 31 | random() ) % ( (int64_t) max - min + 1 ) ) );
+}
+
+/* Measurements just around the point where the reading crosses from k to k + 1 */
+static void check_edge( const sensor_t * s, const linear_params_t * p, int32_t k )
+{
+    long double x = ref_measurement( p, k ) + ( ref_measurement( p, k + 1 ) - ref_measurement( p, k ) ) / 2;
+    int64_t i;
+
+    for ( i = (int64_t) floorl( x ) - 1; i <= (int64_t) ceill( x ) + 1; i++ ) {
+        if ( ( x > -0x1p40L ) && ( x < 0x1p40L ) && ( i >= INT32_MIN ) && ( i <= INT32_MAX ) ) {
+            check_reading( s, p, i, 0 );
+        }
+    }
+}
+
+static void test_random( uint32_t count )
+{
+    static const int32_t fixed[] = { 0, 1, -1, 2, -2, INT32_MAX, INT32_MIN, INT32_MAX - 1, INT32_MIN + 1 };
+    SDR_type_01h_t sdr;
+    sensor_t s;
+    linear_params_t p, d;
+    uint32_t i, valid = 0;
+    int32_t k, lo, hi;
+    unsigned j;
+
+    for ( i = 0; i < count; i++ ) {
+        p.m = random_int( -512, 511 );
+        p.b = random_int( -512, 511 );
+        p.r_exp = random_int( -8, 7 );
+        p.b_exp = random_int( -8, 7 );
+        p.lsb_num = random_int( 1, 1 << random_int( 0, 20 ) ) * ( ( random() & 1 ) ? -1 : 1 );
+        p.lsb_exp = random_int( -9, 3 );
+
+        sdr_encode( &sdr, &p );
+        sdr_decode( &sdr, &d );
+        CHECK( ( d.m == p.m ) && ( d.b == p.b ) && ( d.r_exp == p.r_exp ) && ( d.b_exp == p.b_exp ),
+               "M %d B %d Rexp %d Bexp %d: SDR encoded as M %d B %d Rexp %d Bexp %d", p.m, p.b, p.r_exp, p.b_exp, d.m,
+               d.b, d.r_exp, d.b_exp );
+
+        memset( &s, 0, sizeof( s ) );
+        s.sdr_type = TYPE_01;
+        s.sdr = &sdr;
+        s.signed_flag = random() & 1;
+
+        if ( !sensor_linear_init( &s, p.lsb_num, p.lsb_exp ) ) {
+            CHECK( !representable( &p ), "M %d B %d Rexp %d Bexp %d LSB %de%d: SDR wrongly refused", p.m, p.b, p.r_exp,
+                   p.b_exp, p.lsb_num, p.lsb_exp );
+            continue;
+        }
+        CHECK( p.m != 0, "M 0 accepted" );
+        check_precision( &p, "forward", s.lin.mul, s.lin.shift, ref_reading( &p, 0 ) );
+        check_precision( &p, "inverse", s.lin.inv_mul, s.lin.inv_shift, ref_measurement( &p, 0 ) );
+        valid++;
+
+        for ( j = 0; j < sizeof( fixed ) / sizeof( fixed[0] ); j++ ) {
+            check_reading( &s, &p, fixed[j], 0 );
+        }
+        for ( j = 0; j < 8; j++ ) {
+            check_reading( &s, &p, random_int( INT32_MIN, INT32_MAX ), 0 );
+            check_reading( &s, &p, random_int( -1000, 1000 ), 0 );
+        }
+
+        /* Rounding edges inside the range, then the saturation edges at both ends */
+        lo = s.signed_flag ? INT8_MIN : 0;
+        hi = s.signed_flag ? INT8_MAX : UINT8_MAX;
+        for ( j = 0; j < 8; j++ ) {
+            check_edge( &s, &p, random_int( lo, hi - 1 ) );
+        }
+        for ( k = lo - 2; k <= lo; k++ ) {
+            check_edge( &s, &p, k );
+        }
+        for ( k = hi - 1; k <= hi + 1; k++ ) {
+            check_edge( &s, &p, k );
+        }
+
+        for ( k = 0; k <= UINT8_MAX; k++ ) {
+            check_measurement( &s, &p, k, 0 );
+        }
+    }
+
+    printf( "Random SDRs: %u, %u of them linearized\n", count, valid );
+}
+
+int main( int argc, char ** argv )
+{
+    uint32_t count = 0;
+    long seed = 1;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "r:s:" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'r':
+            count = strtoul( optarg, NULL, 0 );
+            break;
+        case 's':
+            seed = strtol( optarg, NULL, 0 );
+            break;
+        default:
+            fprintf( stderr,
+                     "Usage: %s [-r count] [-s seed]\n"
+                     "  -r count     Random SDRs checked after the board ones (default 0)\n"
+                     "  -s seed      Seed of the random SDRs (default 1)\n",
+                     argv[0] );
+            return 2;
+        }
+    }
+
+    srandom( seed );
+    test_board();
+    test_random( count );
+
+    printf( "test_linear %s\n", failures ? "FAILED" : "ok" );
+    printf( "%ld checks, %d failed\n", checks, failures );
+    return failures ? 1 : 0;
+}
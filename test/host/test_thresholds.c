@@ -0,0 +1,431 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   Copyright (C) 2026  agent <agent@local>
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file test_thresholds.c
+ *
+ * @brief Unit tests of the threshold evaluator (check_sensor_event), on the host build
+ *
+ * The events are caught by wrapping ipmi_event_send at link time, so check_sensor_event runs unchanged, without the
+ * scheduler. Each case feeds a sequence of raw readings and compares the events sent with the ones the IPMI
+ * specification expects (section 36.3, threshold based event generation). The evaluator cost per sample is printed
+ * at the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "port.h"
+#include "host_i2c.h"
+#include "ipmi.h"
+#include "sdr.h"
+
+#define EV(dir, ofs)    ( ( ( dir ) << 8 ) | ( ofs ) )
+#define A(ofs)          EV( ASSERTION_EVENT, ofs )
+#define D(ofs)          EV( DEASSERTION_EVENT, ofs )
+#define END             0xFFFF
+
+#define MAX_EVENTS      32
+
+typedef struct {
+    uint16_t ev;                /* Direction and offset, as EV() */
+    uint8_t data[3];
+} event_t;
+
+static event_t events[MAX_EVENTS];
+static int event_count;
+static int record_events = 1;
+
+static int failures;
+static int checks;
+
+#define CHECK( cond, ... )                                              \
+    do {                                                                \
+        checks++;                                                       \
+        if ( !( cond ) ) {                                              \
+            failures++;                                                 \
+            fprintf( stderr, "%s:%d: ", __FILE__, __LINE__ );           \
+            fprintf( stderr, __VA_ARGS__ );                             \
+            fprintf( stderr, "\n" );                                    \
+        }                                                               \
+    } while ( 0 )
+
+ipmb_error __wrap_ipmi_event_send( sensor_t * sensor, uint8_t assert_deassert, uint8_t * evData, uint8_t length )
+{
+    if ( record_events && ( event_count < MAX_EVENTS ) ) {
+        events[event_count].ev = EV( assert_deassert, evData[0] & 0x0F );
+        memcpy( events[event_count].data, evData, 3 );
+        event_count++;
+    }
+    return ipmb_error_success;
+}
+
+/* Thresholds in raw counts: lnr, lc, lnc, unc, uc, unr */
+static void sensor_setup( sensor_t * sensor, SDR_type_01h_t * sdr, bool is_signed, const int thr[6], uint8_t pos_hyst,
+                          uint8_t neg_hyst )
+{
+    memset( sensor, 0, sizeof( *sensor ) );
+    memset( sdr, 0, sizeof( *sdr ) );
+
+    sdr->hdr.rectype = TYPE_01;
+    sdr->sensortype = 0x01;
+    sdr->event_reading_type = 0x01;
+    sdr->assertion_event_mask[0] = 0xFF;
+    sdr->assertion_event_mask[1] = 0x0F;
+    sdr->deassertion_event_mask[0] = 0xFF;
+    sdr->deassertion_event_mask[1] = 0x0F;
+    sdr->readable_threshold_mask = THR_ALL_MASK;
+    sdr->lower_nonrecover_thr = ( uint8_t ) thr[0];
+    sdr->lower_critical_thr = ( uint8_t ) thr[1];
+    sdr->lower_noncritical_thr = ( uint8_t ) thr[2];
+    sdr->upper_noncritical_thr = ( uint8_t ) thr[3];
+    sdr->upper_critical_thr = ( uint8_t ) thr[4];
+    sdr->upper_nonrecover_thr = ( uint8_t ) thr[5];
+    sdr->pos_thr_hysteresis = pos_hyst;
+    sdr->neg_thr_hysteresis = neg_hyst;
+
+    sensor->num = 1;
+    sensor->sdr = sdr;
+    sensor->sdr_type = TYPE_01;
+    sensor->signed_flag = is_signed;
+}
+
+/* Feeds one reading and compares the events sent with the END terminated list */
+static void step( const char * name, sensor_t * sensor, int reading, const uint16_t * expected )
+{
+    int i;
+
+    event_count = 0;
+    sensor->readout_value = ( uint8_t ) reading;
+    check_sensor_event( sensor );
+
+    for ( i = 0; expected[i] != END; i++ ) {
+        CHECK( ( i < event_count ) && ( events[i].ev == expected[i] ),
+               "%s, reading %d: event %d is %s 0x%x, expected %s 0x%x", name, reading, i,
+               ( i >= event_count ) ? "none" : ( ( events[i].ev >> 8 ) ? "deassert" : "assert" ),
+               ( i >= event_count ) ? 0 : events[i].ev & 0xF, ( expected[i] >> 8 ) ? "deassert" : "assert",
+               expected[i] & 0xF );
+    }
+    CHECK( event_count == i, "%s, reading %d: %d events, expected %d", name, reading, event_count, i );
+}
+
+#define STEP( sensor, reading, ... )                                    \
+    do {                                                                \
+        static const uint16_t exp[] = { __VA_ARGS__ };                  \
+        step( __func__, sensor, reading, exp );                         \
+    } while ( 0 )
+
+static const int thr_unsigned[6] = { 10, 20, 30, 100, 110, 120 };
+static const int thr_signed[6] = { -40, -30, -20, 20, 30, 40 };
+
+/* Upper thresholds crossed one at a time, with their hysteresis band */
+static void test_upper_single( void )
+{
+    SDR_type_01h_t sdr;
+    sensor_t s;
+
+    sensor_setup( &s, &sdr, false, thr_unsigned, 2, 2 );
+
+    STEP( &s, 50, END );
+    STEP( &s, 99, END );
+    STEP( &s, 100, A( IPMI_THRESHOLD_UNC_GH ), END );
+    CHECK( s.state == SENSOR_STATE_HIGH, "state 0x%02x after UNC", s.state );
+
+    /* Released at threshold - 1 - hysteresis, not before */
+    STEP( &s, 99, END );
+    STEP( &s, 98, END );
+    STEP( &s, 97, D( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UNC_GL ), END );
+    CHECK( s.state == SENSOR_STATE_NORMAL, "state 0x%02x back to normal", s.state );
+    STEP( &s, 100, D( IPMI_THRESHOLD_UNC_GL ), A( IPMI_THRESHOLD_UNC_GH ), END );
+
+    STEP( &s, 110, A( IPMI_THRESHOLD_UC_GH ), END );
+    CHECK( s.state == SENSOR_STATE_HIGH_CRIT, "state 0x%02x after UC", s.state );
+    STEP( &s, 108, END );
+    STEP( &s, 107, D( IPMI_THRESHOLD_UC_GH ), A( IPMI_THRESHOLD_UC_GL ), END );
+    STEP( &s, 110, D( IPMI_THRESHOLD_UC_GL ), A( IPMI_THRESHOLD_UC_GH ), END );
+
+    STEP( &s, 120, A( IPMI_THRESHOLD_UNR_GH ), END );
+    CHECK( s.state == SENSOR_STATE_HIGH_NON_REC, "state 0x%02x after UNR", s.state );
+    STEP( &s, 255, END );
+    STEP( &s, 118, END );
+    STEP( &s, 117, D( IPMI_THRESHOLD_UNR_GH ), A( IPMI_THRESHOLD_UNR_GL ), END );
+    STEP( &s, 120, D( IPMI_THRESHOLD_UNR_GL ), A( IPMI_THRESHOLD_UNR_GH ), END );
+}
+
+/* Lower thresholds crossed one at a time, with their hysteresis band */
+static void test_lower_single( void )
+{
+    SDR_type_01h_t sdr;
+    sensor_t s;
+
+    sensor_setup( &s, &sdr, false, thr_unsigned, 3, 3 );
+
+    STEP( &s, 50, END );
+    STEP( &s, 31, END );
+    STEP( &s, 30, A( IPMI_THRESHOLD_LNC_GL ), END );
+    CHECK( s.state == SENSOR_STATE_LOW, "state 0x%02x after LNC", s.state );
+    STEP( &s, 33, END );
+    STEP( &s, 34, D( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LNC_GH ), END );
+    STEP( &s, 30, D( IPMI_THRESHOLD_LNC_GH ), A( IPMI_THRESHOLD_LNC_GL ), END );
+
+    STEP( &s, 20, A( IPMI_THRESHOLD_LC_GL ), END );
+    CHECK( s.state == SENSOR_STATE_LOW_CRIT, "state 0x%02x after LC", s.state );
+    STEP( &s, 23, END );
+    STEP( &s, 24, D( IPMI_THRESHOLD_LC_GL ), A( IPMI_THRESHOLD_LC_GH ), END );
+    STEP( &s, 20, D( IPMI_THRESHOLD_LC_GH ), A( IPMI_THRESHOLD_LC_GL ), END );
+
+    STEP( &s, 10, A( IPMI_THRESHOLD_LNR_GL ), END );
+    CHECK( s.state == SENSOR_STATE_LOW_NON_REC, "state 0x%02x after LNR", s.state );
+    STEP( &s, 0, END );
+    STEP( &s, 13, END );
+    STEP( &s, 14, D( IPMI_THRESHOLD_LNR_GL ), A( IPMI_THRESHOLD_LNR_GH ), END );
+    STEP( &s, 10, D( IPMI_THRESHOLD_LNR_GH ), A( IPMI_THRESHOLD_LNR_GL ), END );
+}
+
+/* Several thresholds crossed by one sample, in both directions */
+static void test_jumps( void )
+{
+    SDR_type_01h_t sdr;
+    sensor_t s;
+
+    sensor_setup( &s, &sdr, false, thr_unsigned, 2, 2 );
+
+    STEP( &s, 50, END );
+    STEP( &s, 200, A( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UC_GH ), A( IPMI_THRESHOLD_UNR_GH ), END );
+    CHECK( s.state == SENSOR_STATE_HIGH_NON_REC, "state 0x%02x after normal -> UNR", s.state );
+    STEP( &s, 50, D( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UNC_GL ), D( IPMI_THRESHOLD_UC_GH ),
+          A( IPMI_THRESHOLD_UC_GL ), D( IPMI_THRESHOLD_UNR_GH ), A( IPMI_THRESHOLD_UNR_GL ), END );
+    CHECK( s.state == SENSOR_STATE_NORMAL, "state 0x%02x after UNR -> normal", s.state );
+
+    /* From one side to the other */
+    STEP( &s, 0, A( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LC_GL ), A( IPMI_THRESHOLD_LNR_GL ), END );
+    STEP( &s, 255, D( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LNC_GH ), D( IPMI_THRESHOLD_LC_GL ),
+          A( IPMI_THRESHOLD_LC_GH ), D( IPMI_THRESHOLD_LNR_GL ), A( IPMI_THRESHOLD_LNR_GH ),
+          D( IPMI_THRESHOLD_UNC_GL ), A( IPMI_THRESHOLD_UNC_GH ), D( IPMI_THRESHOLD_UC_GL ), A( IPMI_THRESHOLD_UC_GH ),
+          D( IPMI_THRESHOLD_UNR_GL ), A( IPMI_THRESHOLD_UNR_GH ), END );
+
+    /* Partly back: inside the UC hysteresis band only UNR is released */
+    STEP( &s, 108, D( IPMI_THRESHOLD_UNR_GH ), A( IPMI_THRESHOLD_UNR_GL ), END );
+    CHECK( s.state == SENSOR_STATE_HIGH_CRIT, "state 0x%02x inside the UC band", s.state );
+}
+
+/* Signed readings: negative thresholds, and values that are above the upper ones if read as unsigned */
+static void test_signed( void )
+{
+    SDR_type_01h_t sdr;
+    sensor_t s;
+
+    sensor_setup( &s, &sdr, true, thr_signed, 1, 1 );
+
+    STEP( &s, 0, END );
+    STEP( &s, -19, END );
+    STEP( &s, -20, A( IPMI_THRESHOLD_LNC_GL ), END );
+    STEP( &s, -35, A( IPMI_THRESHOLD_LC_GL ), END );
+    STEP( &s, -128, A( IPMI_THRESHOLD_LNR_GL ), END );
+    CHECK( s.state == SENSOR_STATE_LOW_NON_REC, "state 0x%02x at -128", s.state );
+    STEP( &s, -39, END );
+    STEP( &s, -38, D( IPMI_THRESHOLD_LNR_GL ), A( IPMI_THRESHOLD_LNR_GH ), END );
+    STEP( &s, 0, D( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LNC_GH ), D( IPMI_THRESHOLD_LC_GL ),
+          A( IPMI_THRESHOLD_LC_GH ), END );
+    STEP( &s, 127, A( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UC_GH ),
+          A( IPMI_THRESHOLD_UNR_GH ), END );
+    STEP( &s, 38, D( IPMI_THRESHOLD_UNR_GH ), A( IPMI_THRESHOLD_UNR_GL ), END );
+
+    /* The same SDR on an unsigned sensor: -20 is 236 raw, over every upper threshold (20, 30, 40) */
+    sensor_setup( &s, &sdr, false, ( const int[6] ) { 5, 6, 7, 20, 30, 40 }, 1, 1 );
+    STEP( &s, -20, A( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UC_GH ), A( IPMI_THRESHOLD_UNR_GH ), END );
+
+    /* Extremes of both domains */
+    sensor_setup( &s, &sdr, true, ( const int[6] ) { -128, -127, -126, 125, 126, 127 }, 0, 0 );
+    STEP( &s, 0, END );
+    STEP( &s, 127, A( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UC_GH ), A( IPMI_THRESHOLD_UNR_GH ), END );
+    STEP( &s, -128, A( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LC_GL ), A( IPMI_THRESHOLD_LNR_GL ),
+          D( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UNC_GL ), D( IPMI_THRESHOLD_UC_GH ), A( IPMI_THRESHOLD_UC_GL ),
+          D( IPMI_THRESHOLD_UNR_GH ), A( IPMI_THRESHOLD_UNR_GL ), END );
+
+    sensor_setup( &s, &sdr, false, ( const int[6] ) { 0, 1, 2, 253, 254, 255 }, 0, 0 );
+    STEP( &s, 128, END );
+    STEP( &s, 255, A( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UC_GH ), A( IPMI_THRESHOLD_UNR_GH ), END );
+    STEP( &s, 254, D( IPMI_THRESHOLD_UNR_GH ), A( IPMI_THRESHOLD_UNR_GL ), END );
+    STEP( &s, 0, A( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LC_GL ), A( IPMI_THRESHOLD_LNR_GL ),
+          D( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UNC_GL ), D( IPMI_THRESHOLD_UC_GH ), A( IPMI_THRESHOLD_UC_GL ),
+          END );
+}
+
+/* The signedness is set by the driver after the first check, the thresholds must follow it */
+static void test_signedness_change( void )
+{
+    SDR_type_01h_t sdr;
+    sensor_t s;
+
+    sensor_setup( &s, &sdr, false, thr_signed, 0, 0 );
+    STEP( &s, 0, A( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LC_GL ), A( IPMI_THRESHOLD_LNR_GL ), END );
+
+    s.signed_flag = 1;
+    STEP( &s, 0, D( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LNC_GH ), D( IPMI_THRESHOLD_LC_GL ),
+          A( IPMI_THRESHOLD_LC_GH ), D( IPMI_THRESHOLD_LNR_GL ), A( IPMI_THRESHOLD_LNR_GH ), END );
+}
+
+/* Unreadable thresholds are ignored, masked events are tracked but not sent */
+static void test_masks( void )
+{
+    SDR_type_01h_t sdr;
+    sensor_t s;
+
+    sensor_setup( &s, &sdr, false, thr_unsigned, 0, 0 );
+    sdr.readable_threshold_mask = ( 1 << THR_UNC ) | ( 1 << THR_UNR );
+    STEP( &s, 115, A( IPMI_THRESHOLD_UNC_GH ), END );
+    CHECK( s.state == SENSOR_STATE_HIGH, "state 0x%02x with UC unreadable", s.state );
+    STEP( &s, 0, D( IPMI_THRESHOLD_UNC_GH ), A( IPMI_THRESHOLD_UNC_GL ), END );
+
+    sensor_setup( &s, &sdr, false, thr_unsigned, 0, 0 );
+    sdr.assertion_event_mask[0] = 1 << IPMI_THRESHOLD_UNC_GH;
+    sdr.assertion_event_mask[1] = 0;
+    sdr.deassertion_event_mask[0] = 0;
+    sdr.deassertion_event_mask[1] = 1 << ( IPMI_THRESHOLD_UC_GH - 8 );
+    STEP( &s, 112, A( IPMI_THRESHOLD_UNC_GH ), END );
+    CHECK( s.asserted_events == ( ( 1 << IPMI_THRESHOLD_UNC_GH ) | ( 1 << IPMI_THRESHOLD_UC_GH ) ),
+           "asserted events 0x%04x", s.asserted_events );
+    STEP( &s, 50, D( IPMI_THRESHOLD_UC_GH ), END );
+    CHECK( s.asserted_events == ( ( 1 << IPMI_THRESHOLD_UNC_GL ) | ( 1 << IPMI_THRESHOLD_UC_GL ) ),
+           "asserted events 0x%04x", s.asserted_events );
+}
+
+/* Event data: offset with the threshold flags, raw trigger reading and raw trigger threshold */
+static void test_event_data( void )
+{
+    SDR_type_01h_t sdr;
+    sensor_t s;
+
+    sensor_setup( &s, &sdr, true, thr_signed, 0, 0 );
+    STEP( &s, -30, A( IPMI_THRESHOLD_LNC_GL ), A( IPMI_THRESHOLD_LC_GL ), END );
+    CHECK( ( events[1].data[0] == ( 0x50 | IPMI_THRESHOLD_LC_GL ) ) && ( events[1].data[1] == ( uint8_t ) -30 ) &&
+           ( events[1].data[2] == ( uint8_t ) -30 ), "event data %02x %02x %02x", events[1].data[0],
+           events[1].data[1], events[1].data[2] );
+    CHECK( events[0].data[2] == ( uint8_t ) -20, "LNC trigger threshold %02x", events[0].data[2] );
+}
+
+/* Every one of the 12 threshold events must have been asserted and deasserted by the cases above */
+static uint16_t seen_assert, seen_deassert;
+
+static void coverage_track( void )
+{
+    int i;
+
+    for ( i = 0; i < event_count; i++ ) {
+        if ( events[i].ev >> 8 ) {
+            seen_deassert |= 1 << ( events[i].ev & 0xF );
+        } else {
+            seen_assert |= 1 << ( events[i].ev & 0xF );
+        }
+    }
+}
+
+static uint64_t host_cycles( void )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+    return __builtin_ia32_rdtsc();
+#else
+    return host_time_ns();
+#endif
+}
+
+static void bench( const char * name, const uint8_t * samples, int count, int rounds )
+{
+    SDR_type_01h_t sdr;
+    sensor_t s;
+    uint64_t t0, c0, ns, cycles;
+    int r, i;
+
+    sensor_setup( &s, &sdr, false, thr_unsigned, 2, 2 );
+    record_events = 0;
+
+    t0 = host_time_ns();
+    c0 = host_cycles();
+    for ( r = 0; r < rounds; r++ ) {
+        for ( i = 0; i < count; i++ ) {
+            s.readout_value = samples[i];
+            check_sensor_event( &s );
+        }
+    }
+    cycles = host_cycles() - c0;
+    ns = host_time_ns() - t0;
+
+    record_events = 1;
+    printf( "  %-28s %6.1f ns, %6.1f host cycles per sample\n", name, ( double ) ns / rounds / count,
+            ( double ) cycles / rounds / count );
+}
+
+int main( int argc, char ** argv )
+{
+    static const struct {
+        void (*fn)( void );
+        const char *name;
+    } tests[] = {
+        { test_upper_single, "upper thresholds" },
+        { test_lower_single, "lower thresholds" },
+        { test_jumps, "multi-threshold jumps" },
+        { test_signed, "signed sensors" },
+        { test_signedness_change, "signedness change" },
+        { test_masks, "readable and event masks" },
+        { test_event_data, "event data" },
+    };
+    static uint8_t steady[256], crossing[256];
+    unsigned i;
+    int before;
+
+    for ( i = 0; i < sizeof( tests ) / sizeof( tests[0] ); i++ ) {
+        before = failures;
+        tests[i].fn();
+        printf( "%-28s %s\n", tests[i].name, ( failures == before ) ? "ok" : "FAILED" );
+    }
+
+    /* Coverage, over a full up and down sweep on each side */
+    {
+        SDR_type_01h_t sdr;
+        sensor_t s;
+        static const int sweep[] = { 50, 200, 50, 200, 50, 0, 50, 0, 50 };
+
+        sensor_setup( &s, &sdr, false, thr_unsigned, 0, 0 );
+        for ( i = 0; i < sizeof( sweep ) / sizeof( sweep[0] ); i++ ) {
+            event_count = 0;
+            s.readout_value = sweep[i];
+            check_sensor_event( &s );
+            coverage_track();
+        }
+        CHECK( ( seen_assert == 0x0FFF ) && ( seen_deassert == 0x0FFF ),
+               "events asserted 0x%03x, deasserted 0x%03x, expected all 12", seen_assert, seen_deassert );
+    }
+
+    printf( "%d checks, %d failed\n", checks, failures );
+
+    /* Evaluator cost: readings that stay in range, and readings that cross thresholds on every sample */
+    for ( i = 0; i < 256; i++ ) {
+        steady[i] = 40 + ( i % 50 );
+        crossing[i] = ( i & 1 ) ? 5 : 125;
+    }
+    printf( "check_sensor_event cost (host, events not sent):\n" );
+    bench( "no threshold crossed", steady, 256, 20000 );
+    bench( "all thresholds toggling", crossing, 256, 2000 );
+
+    return failures ? 1 : 0;
+}